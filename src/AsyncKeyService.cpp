@@ -0,0 +1,296 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <AsyncKeyService.h>
+#include <KeyFileOps.h>
+#include <ThreadPool.h>
+#include <algorithm>
+
+namespace ripple {
+
+namespace {
+
+// Callbacks that complete a promise
+
+template <class T>
+std::function<void (std::exception_ptr, T)>
+fulfil (std::shared_ptr<std::promise<T>> const& promise)
+{
+    return [promise](std::exception_ptr error, T result)
+    {
+        if (error)
+            promise->set_exception (error);
+        else
+            promise->set_value (std::move (result));
+    };
+}
+
+std::function<void (std::exception_ptr)>
+fulfil (std::shared_ptr<std::promise<void>> const& promise)
+{
+    return [promise](std::exception_ptr error)
+    {
+        if (error)
+            promise->set_exception (error);
+        else
+            promise->set_value ();
+    };
+}
+
+void
+startThreads (
+    std::vector<std::thread>& threads,
+    unsigned count,
+    boost::asio::io_service& ios)
+{
+    for (unsigned i = 0; i < count; ++i)
+        threads.emplace_back ([&ios] { ios.run (); });
+}
+
+} // namespace
+
+AsyncKeyService::AsyncKeyService (
+    unsigned cpuThreads,
+    unsigned ioThreads,
+    KeyStore& store)
+    : store_ (store)
+    , cpuWork_ (std::make_unique<boost::asio::io_service::work> (cpu_))
+    , ioWork_ (std::make_unique<boost::asio::io_service::work> (io_))
+{
+    if (cpuThreads == 0)
+        cpuThreads = ThreadPool::defaultSize ();
+
+    startThreads (cpuThreads_, cpuThreads, cpu_);
+    startThreads (ioThreads_, std::max (1u, ioThreads), io_);
+}
+
+AsyncKeyService::~AsyncKeyService ()
+{
+    // Loads queue their decoding on the CPU threads once read, so the
+    // I/O threads must finish first
+    ioWork_.reset ();
+    for (auto& thread : ioThreads_)
+        thread.join ();
+
+    cpuWork_.reset ();
+    for (auto& thread : cpuThreads_)
+        thread.join ();
+}
+
+void
+AsyncKeyService::sign (
+    std::shared_ptr<ValidatorKeys const> keys,
+    std::string data,
+    Callback<std::string> done)
+{
+    cpu_.post ([keys, data, done]
+    {
+        std::string signature;
+        try
+        {
+            signature = keys->sign (data);
+        }
+        catch (...)
+        {
+            done (std::current_exception (), {});
+            return;
+        }
+        done (nullptr, std::move (signature));
+    });
+}
+
+void
+AsyncKeyService::createToken (
+    std::shared_ptr<ValidatorKeys> keys,
+    KeyType keyType,
+    TokenKeySource source,
+    Callback<boost::optional<ValidatorToken>> done)
+{
+    cpu_.post ([keys, keyType, source, done]
+    {
+        boost::optional<ValidatorToken> token;
+        try
+        {
+            // Tokens cannot be assigned, only constructed
+            if (auto created = keys->createValidatorToken (keyType, source))
+                token.emplace (std::move (*created));
+        }
+        catch (...)
+        {
+            done (std::current_exception (), boost::none);
+            return;
+        }
+        done (nullptr, std::move (token));
+    });
+}
+
+void
+AsyncKeyService::load (
+    boost::filesystem::path keyFile,
+    Callback<std::shared_ptr<ValidatorKeys>> done)
+{
+    io_.post ([this, keyFile, done]
+    {
+        std::shared_ptr<std::string> contents;
+        try
+        {
+            // Locking creates a lock file beside the key file, so a
+            // missing key file is reported by the store first
+            if (! store_.exists (keyFile))
+                store_.load (keyFile);
+
+            auto const lock =
+                store_.lock (keyFile, KeyFileLock::Mode::shared);
+            contents = std::make_shared<std::string> (
+                store_.load (keyFile));
+        }
+        catch (...)
+        {
+            done (std::current_exception (), nullptr);
+            return;
+        }
+
+        cpu_.post ([contents, keyFile, done]
+        {
+            std::shared_ptr<ValidatorKeys> keys;
+            try
+            {
+                keys = std::make_shared<ValidatorKeys> (
+                    ValidatorKeys::fromJson (*contents, keyFile));
+            }
+            catch (...)
+            {
+                done (std::current_exception (), nullptr);
+                return;
+            }
+            done (nullptr, std::move (keys));
+        });
+    });
+}
+
+void
+AsyncKeyService::store (
+    std::shared_ptr<ValidatorKeys const> const& keys,
+    boost::filesystem::path keyFile,
+    Callback<> done)
+{
+    auto const contents = keys->toJson ();
+    io_.post ([this, contents, keyFile, done]
+    {
+        try
+        {
+            store_.prepare (keyFile);
+            auto const lock =
+                store_.lock (keyFile, KeyFileLock::Mode::exclusive);
+            store_.store (keyFile, contents);
+        }
+        catch (...)
+        {
+            done (std::current_exception ());
+            return;
+        }
+        done (nullptr);
+    });
+}
+
+void
+AsyncKeyService::issueToken (
+    boost::filesystem::path keyFile,
+    KeyType keyType,
+    TokenKeySource source,
+    Callback<SecureString> done)
+{
+    // The lock is held from the read to the write, and is released on
+    // the thread that took it
+    io_.post ([this, keyFile, keyType, source, done]
+    {
+        SecureString token;
+        try
+        {
+            token = issueValidatorToken (
+                keyFile, store_, keyType, source).value;
+        }
+        catch (...)
+        {
+            done (std::current_exception (), {});
+            return;
+        }
+        done (nullptr, std::move (token));
+    });
+}
+
+std::future<std::string>
+AsyncKeyService::sign (
+    std::shared_ptr<ValidatorKeys const> keys,
+    std::string data)
+{
+    auto promise = std::make_shared<std::promise<std::string>> ();
+    auto future = promise->get_future ();
+    sign (std::move (keys), std::move (data), fulfil (promise));
+    return future;
+}
+
+std::future<boost::optional<ValidatorToken>>
+AsyncKeyService::createToken (
+    std::shared_ptr<ValidatorKeys> keys,
+    KeyType keyType,
+    TokenKeySource source)
+{
+    auto promise = std::make_shared<
+        std::promise<boost::optional<ValidatorToken>>> ();
+    auto future = promise->get_future ();
+    createToken (std::move (keys), keyType, source, fulfil (promise));
+    return future;
+}
+
+std::future<std::shared_ptr<ValidatorKeys>>
+AsyncKeyService::load (boost::filesystem::path keyFile)
+{
+    auto promise = std::make_shared<
+        std::promise<std::shared_ptr<ValidatorKeys>>> ();
+    auto future = promise->get_future ();
+    load (std::move (keyFile), fulfil (promise));
+    return future;
+}
+
+std::future<void>
+AsyncKeyService::store (
+    std::shared_ptr<ValidatorKeys const> const& keys,
+    boost::filesystem::path keyFile)
+{
+    auto promise = std::make_shared<std::promise<void>> ();
+    auto future = promise->get_future ();
+    store (keys, std::move (keyFile), fulfil (promise));
+    return future;
+}
+
+std::future<SecureString>
+AsyncKeyService::issueToken (
+    boost::filesystem::path keyFile,
+    KeyType keyType,
+    TokenKeySource source)
+{
+    auto promise = std::make_shared<std::promise<SecureString>> ();
+    auto future = promise->get_future ();
+    issueToken (std::move (keyFile), keyType, source, fulfil (promise));
+    return future;
+}
+
+} // ripple
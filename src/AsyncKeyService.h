@@ -0,0 +1,260 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_ASYNCKEYSERVICE_H_INCLUDED
+#define VALIDATOR_KEYS_ASYNCKEYSERVICE_H_INCLUDED
+
+#include <KeyStore.h>
+#include <SecureArena.h>
+#include <ValidatorKeys.h>
+#include <boost/asio/io_service.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace ripple {
+
+/** Runs validator key operations without blocking the caller
+
+    Signing, token creation and key file decoding run on a fixed number
+    of threads, however many operations are queued. Key files are read
+    and written on threads of their own, so a slow disk never holds up
+    signing.
+
+    Each operation comes in two forms. One returns a std::future. The
+    other takes an io_service and a handler, and posts the handler to
+    that io_service once the operation completes, so a service built on
+    Boost.Asio can use the keys from its event loop. The handler is
+    called with a std::exception_ptr, which is null on success, followed
+    by the result, if any. The io_service does not run out of work
+    while a handler is pending.
+
+    Keys are passed as shared_ptr and kept alive until the operation
+    completes. Operations complete in no particular order, even on the
+    same keys. Key files are locked as by loadKeyFile and
+    issueValidatorToken: shared while read and exclusive while written.
+*/
+class AsyncKeyService
+{
+private:
+    template <class... T>
+    using Callback = std::function<void (std::exception_ptr, T...)>;
+
+    KeyStore& store_;
+    boost::asio::io_service cpu_;
+    boost::asio::io_service io_;
+    std::unique_ptr<boost::asio::io_service::work> cpuWork_;
+    std::unique_ptr<boost::asio::io_service::work> ioWork_;
+    std::vector<std::thread> cpuThreads_;
+    std::vector<std::thread> ioThreads_;
+
+    // Returns a callback that posts handler to ios with its arguments
+    template <class... T, class Handler>
+    static
+    Callback<T...>
+    postTo (boost::asio::io_service& ios, Handler handler)
+    {
+        boost::asio::io_service::work const work (ios);
+        return [&ios, work, handler](std::exception_ptr error, T... result)
+        {
+            ios.post (std::bind (handler, error, std::move (result)...));
+        };
+    }
+
+    void
+    sign (
+        std::shared_ptr<ValidatorKeys const> keys,
+        std::string data,
+        Callback<std::string> done);
+
+    void
+    createToken (
+        std::shared_ptr<ValidatorKeys> keys,
+        KeyType keyType,
+        TokenKeySource source,
+        Callback<boost::optional<ValidatorToken>> done);
+
+    void
+    load (
+        boost::filesystem::path keyFile,
+        Callback<std::shared_ptr<ValidatorKeys>> done);
+
+    void
+    store (
+        std::shared_ptr<ValidatorKeys const> const& keys,
+        boost::filesystem::path keyFile,
+        Callback<> done);
+
+    void
+    issueToken (
+        boost::filesystem::path keyFile,
+        KeyType keyType,
+        TokenKeySource source,
+        Callback<SecureString> done);
+
+public:
+    /**
+        @param cpuThreads Threads for signing, token creation and key
+        file decoding, or zero for one per core
+
+        @param ioThreads Threads for key file reads and writes
+
+        @param store Storage backend holding the key files, which must
+        outlive the service
+    */
+    explicit
+    AsyncKeyService (
+        unsigned cpuThreads = 0,
+        unsigned ioThreads = 1,
+        KeyStore& store = defaultKeyStore ());
+
+    /** Completes every queued operation, then stops the threads */
+    ~AsyncKeyService ();
+
+    AsyncKeyService (AsyncKeyService const&) = delete;
+    AsyncKeyService& operator= (AsyncKeyService const&) = delete;
+
+    /** Signs data with the validator key
+
+        The result is the hex-encoded signature, as from
+        ValidatorKeys::sign.
+    */
+    std::future<std::string>
+    sign (
+        std::shared_ptr<ValidatorKeys const> keys,
+        std::string data);
+
+    template <class Handler>
+    void
+    sign (
+        std::shared_ptr<ValidatorKeys const> keys,
+        std::string data,
+        boost::asio::io_service& ios,
+        Handler handler)
+    {
+        sign (std::move (keys), std::move (data),
+            postTo<std::string> (ios, std::move (handler)));
+    }
+
+    /** Creates a validator token for the next sequence
+
+        The result is as from ValidatorKeys::createValidatorToken. The
+        new token sequence is not stored until the keys are.
+    */
+    std::future<boost::optional<ValidatorToken>>
+    createToken (
+        std::shared_ptr<ValidatorKeys> keys,
+        KeyType keyType = KeyType::secp256k1,
+        TokenKeySource source = TokenKeySource::random);
+
+    template <class Handler>
+    void
+    createToken (
+        std::shared_ptr<ValidatorKeys> keys,
+        KeyType keyType,
+        TokenKeySource source,
+        boost::asio::io_service& ios,
+        Handler handler)
+    {
+        createToken (std::move (keys), keyType, source,
+            postTo<boost::optional<ValidatorToken>> (
+                ios, std::move (handler)));
+    }
+
+    /** Loads keys from a key file
+
+        The file is read on an I/O thread and decoded on a CPU thread.
+        Errors are those of ValidatorKeys::make_ValidatorKeys.
+    */
+    std::future<std::shared_ptr<ValidatorKeys>>
+    load (boost::filesystem::path keyFile);
+
+    template <class Handler>
+    void
+    load (
+        boost::filesystem::path keyFile,
+        boost::asio::io_service& ios,
+        Handler handler)
+    {
+        load (std::move (keyFile),
+            postTo<std::shared_ptr<ValidatorKeys>> (
+                ios, std::move (handler)));
+    }
+
+    /** Writes keys to a key file
+
+        The keys are encoded before returning, so later changes to them,
+        such as new token sequences, are not written. Errors are those
+        of ValidatorKeys::writeToFile.
+    */
+    std::future<void>
+    store (
+        std::shared_ptr<ValidatorKeys const> const& keys,
+        boost::filesystem::path keyFile);
+
+    template <class Handler>
+    void
+    store (
+        std::shared_ptr<ValidatorKeys const> const& keys,
+        boost::filesystem::path keyFile,
+        boost::asio::io_service& ios,
+        Handler handler)
+    {
+        store (keys, std::move (keyFile),
+            postTo<> (ios, std::move (handler)));
+    }
+
+    /** Creates a validator token for the next sequence of a key file
+
+        The key file is locked exclusively from when it is read until
+        the new token sequence is written, as by issueValidatorToken, so
+        concurrent calls on the same key file never issue the same
+        sequence. The whole update runs on an I/O thread. The result is
+        the base64-encoded token, and errors are those of
+        issueValidatorToken.
+    */
+    std::future<SecureString>
+    issueToken (
+        boost::filesystem::path keyFile,
+        KeyType keyType = KeyType::secp256k1,
+        TokenKeySource source = TokenKeySource::random);
+
+    template <class Handler>
+    void
+    issueToken (
+        boost::filesystem::path keyFile,
+        KeyType keyType,
+        TokenKeySource source,
+        boost::asio::io_service& ios,
+        Handler handler)
+    {
+        issueToken (std::move (keyFile), keyType, source,
+            postTo<SecureString> (ios, std::move (handler)));
+    }
+};
+
+} // ripple
+
+#endif
@@ -0,0 +1,393 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <ConfigStamper.h>
+#include <KeyFileOps.h>
+#include <Parallel.h>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem.hpp>
+#include <openssl/crypto.h>
+#include <array>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <streambuf>
+#ifndef _WIN32
+# include <cerrno>
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace ripple {
+
+namespace {
+
+char const* const tokenSection = "validator_token";
+char const* const revocationSection = "validator_key_revocation";
+
+// Flushes every file system holding one of the directories to disk,
+// each of them once
+void
+syncFileSystems (std::set<boost::filesystem::path> const& dirs)
+{
+#ifndef _WIN32
+    std::set<dev_t> synced;
+    for (auto const& dir : dirs)
+    {
+        // Key files in a memory or tmpfs store have no directory here
+        int const fd = ::open (dir.empty () ? "." : dir.c_str (),
+            O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            continue;
+
+        struct stat st;
+        if (fstat (fd, &st) == 0 && synced.insert (st.st_dev).second)
+        {
+# ifdef __linux__
+            ::syncfs (fd);
+# else
+            ::sync ();
+# endif
+        }
+        ::close (fd);
+    }
+#endif
+}
+
+#ifndef _WIN32
+// Writes to a file it creates, so a file or link already at the path is
+// never written through. Until copyAttributes runs, only the owner can
+// read the file, which holds a token or revocation.
+class NewFileBuf : public std::streambuf
+{
+public:
+    NewFileBuf ()
+    {
+        setp (buffer_.data (), buffer_.data () + buffer_.size ());
+    }
+
+    ~NewFileBuf () override
+    {
+        close ();
+        OPENSSL_cleanse (buffer_.data (), buffer_.size ());
+    }
+
+    NewFileBuf (NewFileBuf const&) = delete;
+    NewFileBuf& operator= (NewFileBuf const&) = delete;
+
+    /** Returns false if the file exists or cannot be created */
+    bool
+    open (boost::filesystem::path const& path)
+    {
+        do
+            fd_ = ::open (path.c_str (),
+                O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        while (fd_ == -1 && errno == EINTR);
+        return fd_ != -1;
+    }
+
+    /** Returns false if any write failed */
+    bool
+    close ()
+    {
+        if (fd_ != -1)
+        {
+            flush ();
+            if (::close (fd_) != 0)
+                failed_ = true;
+            fd_ = -1;
+        }
+        return ! failed_;
+    }
+
+protected:
+    int_type
+    overflow (int_type c) override
+    {
+        if (! flush ())
+            return traits_type::eof ();
+        if (! traits_type::eq_int_type (c, traits_type::eof ()))
+        {
+            *pptr () = traits_type::to_char_type (c);
+            pbump (1);
+        }
+        return traits_type::not_eof (c);
+    }
+
+    int
+    sync () override
+    {
+        return flush () ? 0 : -1;
+    }
+
+private:
+    bool
+    flush ()
+    {
+        for (auto p = pbase (); ! failed_ && p != pptr ();)
+        {
+            auto const n = ::write (fd_, p, pptr () - p);
+            if (n > 0)
+                p += n;
+            else if (errno != EINTR)
+                failed_ = true;
+        }
+        setp (buffer_.data (), buffer_.data () + buffer_.size ());
+        return ! failed_;
+    }
+
+    int fd_ = -1;
+    bool failed_ = false;
+    std::array<char, 4096> buffer_;
+};
+#endif
+
+// Gives the copy of a config the mode and owner of the config
+void
+copyAttributes (
+    boost::filesystem::path const& from,
+    boost::filesystem::path const& to)
+{
+    boost::system::error_code ec;
+    auto const status = boost::filesystem::status (from, ec);
+    if (ec)
+        return;
+    boost::filesystem::permissions (to, status.permissions (), ec);
+
+#ifndef _WIN32
+    // Only permitted to root, which is who usually owns rippled.cfg
+    struct stat st;
+    if (::stat (from.c_str (), &st) == 0)
+        (void) ::chown (to.c_str (), st.st_uid, st.st_gid);
+#endif
+}
+
+}
+
+bool
+stampConfigSection (std::istream& in, std::ostream& out,
+    std::string const& section,
+    std::vector<SecureString> const& values)
+{
+    auto const header = "[" + section + "]";
+
+    bool found = false;
+    bool inSection = false;
+    bool empty = true;
+    bool endsWithNewline = true;
+
+    std::string line;
+    while (std::getline (in, line))
+    {
+        empty = false;
+        endsWithNewline = ! in.eof ();
+
+        auto const trimmed = boost::algorithm::trim_copy (line);
+        if (! trimmed.empty () &&
+            trimmed.front () == '[' && trimmed.back () == ']')
+        {
+            inSection = trimmed == header;
+            if (inSection && found)
+                continue;
+
+            if (inSection)
+            {
+                found = true;
+                out << line << '\n';
+                for (auto const& value : values)
+                    out << value << '\n';
+                continue;
+            }
+        }
+        else if (inSection && ! trimmed.empty () && trimmed.front () != '#')
+        {
+            // An old value
+            continue;
+        }
+
+        out << line;
+        if (endsWithNewline)
+            out << '\n';
+    }
+
+    if (! found)
+    {
+        if (! endsWithNewline)
+            out << '\n';
+        if (! empty)
+            out << '\n';
+        out << header << '\n';
+        for (auto const& value : values)
+            out << value << '\n';
+    }
+
+    return found;
+}
+
+std::vector<SecureString>
+wrapConfigValue (SecureString const& value, std::size_t width)
+{
+    std::vector<SecureString> lines;
+    for (std::size_t i = 0; i < value.size (); i += width)
+        lines.push_back (value.substr (i, width));
+    return lines;
+}
+
+std::vector<ConfigStampResult>
+stampConfigs (std::vector<ConfigStamp> const& stamps,
+    ConfigStampKind kind,
+    KeyStore& store,
+    KeyType tokenKeyType,
+    TokenKeySource source,
+    unsigned threads)
+{
+    using namespace boost::filesystem;
+
+    // The file each config path names. Renaming over a symbolic link
+    // would replace the link rather than the config it points to.
+    std::vector<path> configs (stamps.size ());
+    {
+        std::set<std::string> keyFiles;
+        std::set<std::string> configFiles;
+        for (std::size_t i = 0; i < stamps.size (); ++i)
+        {
+            auto const& stamp = stamps[i];
+            if (! keyFiles.insert (stamp.keyFile.string ()).second)
+                throw std::runtime_error (
+                    "Key file listed twice: " + stamp.keyFile.string ());
+
+            // A config that cannot be resolved fails when it is opened
+            boost::system::error_code ec;
+            configs[i] = canonical (stamp.configFile, ec);
+            if (ec)
+                configs[i] = stamp.configFile;
+            if (! configFiles.insert (configs[i].string ()).second)
+                throw std::runtime_error (
+                    "Config listed twice: " + stamp.configFile.string ());
+        }
+    }
+
+    auto const section = kind == ConfigStampKind::token ?
+        tokenSection : revocationSection;
+
+    std::vector<ConfigStampResult> results (stamps.size ());
+
+    // The copy of each config waiting to be renamed over it
+    std::vector<path> copies (stamps.size ());
+
+    // Each stamp touches only its own key file and config
+    parallelFor (stamps.size (), threads, 1, [&](std::size_t i)
+    {
+        auto const& stamp = stamps[i];
+        auto const& config = configs[i];
+        auto& result = results[i];
+        auto& copy = copies[i];
+        try
+        {
+            std::ifstream in (config.string ());
+            if (! in)
+                throw std::runtime_error (
+                    "Cannot open config: " + stamp.configFile.string ());
+
+            auto const update = kind == ConfigStampKind::token ?
+                issueValidatorToken (
+                    stamp.keyFile, store, tokenKeyType, source) :
+                revokeKeyFile (stamp.keyFile, store);
+            result.publicKey = update.publicKey;
+
+            auto const name = config.parent_path () / unique_path (
+                "." + config.filename ().string () + ".%%%%%%%%.tmp");
+#ifdef _WIN32
+            std::ofstream out (name.string (), std::ios::trunc);
+            if (! out)
+                throw std::runtime_error (
+                    "Cannot write config: " + name.string ());
+            copy = name;
+
+            stampConfigSection (
+                in, out, section, wrapConfigValue (update.value));
+            out.close ();
+            bool const written = ! out.fail ();
+#else
+            NewFileBuf file;
+            if (! file.open (name))
+                throw std::runtime_error (
+                    "Cannot write config: " + name.string ());
+            copy = name;
+
+            std::ostream out (&file);
+            stampConfigSection (
+                in, out, section, wrapConfigValue (update.value));
+            bool const written = file.close () && ! out.fail ();
+#endif
+            if (in.bad () || ! written)
+                throw std::runtime_error (
+                    "Cannot write config: " + copy.string ());
+
+            copyAttributes (config, copy);
+        }
+        catch (std::exception const& e)
+        {
+            result.error = e.what ();
+            if (! copy.empty ())
+            {
+                boost::system::error_code ec;
+                remove (copy, ec);
+                copy.clear ();
+            }
+        }
+    });
+
+    std::set<path> dirs;
+    for (std::size_t i = 0; i < stamps.size (); ++i)
+    {
+        dirs.insert (stamps[i].keyFile.parent_path ());
+        dirs.insert (configs[i].parent_path ());
+    }
+
+    // The key files and copies must be on disk before any config is
+    // replaced, or a crash could leave a token whose sequence the key
+    // file no longer records
+    syncFileSystems (dirs);
+
+    for (std::size_t i = 0; i < stamps.size (); ++i)
+    {
+        if (copies[i].empty ())
+            continue;
+
+        boost::system::error_code ec;
+        rename (copies[i], configs[i], ec);
+        if (ec)
+        {
+            results[i].error = "Cannot replace config: " +
+                stamps[i].configFile.string ();
+            remove (copies[i], ec);
+        }
+    }
+
+    syncFileSystems (dirs);
+
+    return results;
+}
+
+} // ripple
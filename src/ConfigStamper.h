@@ -0,0 +1,115 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_CONFIGSTAMPER_H_INCLUDED
+#define VALIDATOR_KEYS_CONFIGSTAMPER_H_INCLUDED
+
+#include <KeyStore.h>
+#include <ValidatorKeys.h>
+#include <ripple/crypto/KeyType.h>
+#include <ripple/protocol/PublicKey.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** Copies a rippled config, replacing the values of one section
+
+    The config is read a line at a time, so it is never held in memory.
+    The values stay in secure memory, as tokens carry secret keys.
+    The value lines of the first [section] are replaced by values, while
+    its comments and blank lines are kept after them. The values of
+    later copies of the section are dropped, as rippled accepts only one.
+    If the section is missing, it is added at the end.
+
+    @return true if the section was present
+*/
+bool
+stampConfigSection (std::istream& in, std::ostream& out,
+    std::string const& section,
+    std::vector<SecureString> const& values);
+
+/** Returns a value split into lines of at most width characters, as
+    create_token prints tokens */
+std::vector<SecureString>
+wrapConfigValue (SecureString const& value, std::size_t width = 72);
+
+/** A key file and the config of the server that runs as its validator */
+struct ConfigStamp
+{
+    boost::filesystem::path keyFile;
+    boost::filesystem::path configFile;
+};
+
+/** What stampConfigs writes into each config */
+enum class ConfigStampKind
+{
+    /// A new token, in [validator_token]
+    token,
+
+    /// A revocation, in [validator_key_revocation]
+    revocation
+};
+
+/** What stamping one config did */
+struct ConfigStampResult
+{
+    /// The validator public key, if a token or revocation was issued
+    boost::optional<PublicKey> publicKey;
+
+    /// Why the config was not updated, or empty if it was
+    std::string error;
+};
+
+/** Issues a token or revocation for each key file and stamps its config
+
+    Stamps are handled on several threads. Each config is opened before
+    its key file is touched, then copied with stampConfigSection to a
+    new temporary file beside it. Only the owner can read the copy until
+    it is written, when it takes the mode and owner of the config. A
+    config named by a symbolic link is resolved first, so the file it
+    points to is replaced and the link is kept.
+
+    Once every copy is written, each file system holding a key file or
+    config is synced, then the copies are renamed over the configs and
+    the file systems synced again. After a crash each config is thus
+    either old or new, and never newer than its key file, while the
+    batch costs two syncs rather than one per file.
+
+    @param threads Threads to use, or zero for one per CPU
+
+    @return A result for each stamp, in the same order
+
+    @throws std::runtime_error if a key file or config is listed twice
+*/
+std::vector<ConfigStampResult>
+stampConfigs (std::vector<ConfigStamp> const& stamps,
+    ConfigStampKind kind,
+    KeyStore& store = defaultKeyStore (),
+    KeyType tokenKeyType = KeyType::secp256k1,
+    TokenKeySource source = TokenKeySource::random,
+    unsigned threads = 0);
+
+} // ripple
+
+#endif
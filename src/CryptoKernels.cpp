@@ -0,0 +1,351 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <CryptoKernels.h>
+#include <ripple/protocol/digest.h>
+#include <ripple/protocol/Serializer.h>
+#include <ripple/protocol/Sign.h>
+#include <ripple/protocol/STObject.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef VK_CRYPTO_VARIANTS
+
+// Each variant is a separate build of ed25519-donna and libsecp256k1,
+// with its symbols renamed, in src/unity.
+extern "C"
+{
+#define VK_DECLARE_VARIANT(v) \
+    void ed25519_publickey_##v (unsigned char const* sk, \
+        unsigned char* pk); \
+    void ed25519_sign_##v (unsigned char const* m, std::size_t mlen, \
+        unsigned char const* sk, unsigned char const* pk, \
+        unsigned char* signature); \
+    void* vk_##v##_secp256k1_new (void); \
+    int vk_##v##_secp256k1_public_key (void const* context, \
+        unsigned char const* sk, unsigned char* pk); \
+    int vk_##v##_secp256k1_sign_digest (void const* context, \
+        unsigned char const* digest, unsigned char const* sk, \
+        unsigned char* signature, std::size_t* size);
+
+VK_DECLARE_VARIANT(sse2)
+VK_DECLARE_VARIANT(x64)
+VK_DECLARE_VARIANT(avx2)
+
+#undef VK_DECLARE_VARIANT
+}
+
+#endif
+
+namespace ripple {
+
+struct CryptoKernels::Functions
+{
+    void (*ed25519PublicKey) (unsigned char const*, unsigned char*);
+    void (*ed25519Sign) (unsigned char const*, std::size_t,
+        unsigned char const*, unsigned char const*, unsigned char*);
+    void* (*secp256k1New) ();
+    int (*secp256k1PublicKey) (void const*, unsigned char const*,
+        unsigned char*);
+    int (*secp256k1Sign) (void const*, unsigned char const*,
+        unsigned char const*, unsigned char*, std::size_t*);
+};
+
+namespace {
+
+std::atomic<CryptoKernels const*> activeKernels {nullptr};
+
+#ifdef VK_CRYPTO_VARIANTS
+bool
+cpuHasAvx2 ()
+{
+    // Also checks that the OS saves the AVX registers
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("avx2") &&
+        __builtin_cpu_supports ("bmi2");
+}
+#endif
+
+}
+
+std::string
+to_string (CryptoVariant variant)
+{
+    switch (variant)
+    {
+    case CryptoVariant::library:
+        return "library";
+    case CryptoVariant::sse2:
+        return "sse2";
+    case CryptoVariant::x86_64:
+        return "x86_64";
+    case CryptoVariant::avx2:
+        return "avx2";
+    }
+    return "unknown";
+}
+
+boost::optional<CryptoVariant>
+cryptoVariantFromString (std::string const& name)
+{
+    for (auto const variant : {CryptoVariant::library, CryptoVariant::sse2,
+        CryptoVariant::x86_64, CryptoVariant::avx2})
+    {
+        if (to_string (variant) == name)
+            return variant;
+    }
+    return boost::none;
+}
+
+//------------------------------------------------------------------------------
+
+CryptoKernels::CryptoKernels (
+    CryptoVariant variant,
+    Functions const* functions)
+    : variant_ (variant)
+    , functions_ (functions)
+{
+}
+
+std::vector<CryptoVariant>
+CryptoKernels::supported ()
+{
+    std::vector<CryptoVariant> variants {CryptoVariant::library};
+#ifdef VK_CRYPTO_VARIANTS
+    variants.push_back (CryptoVariant::sse2);
+    variants.push_back (CryptoVariant::x86_64);
+    if (cpuHasAvx2 ())
+        variants.push_back (CryptoVariant::avx2);
+#endif
+    return variants;
+}
+
+CryptoKernels const&
+CryptoKernels::get (CryptoVariant variant)
+{
+    auto const variants = supported ();
+    if (std::find (variants.begin (), variants.end (), variant) ==
+        variants.end ())
+    {
+        throw std::runtime_error (
+            "Crypto variant is not supported on this host: " +
+            to_string (variant));
+    }
+
+    static CryptoKernels const library (CryptoVariant::library, nullptr);
+
+#ifdef VK_CRYPTO_VARIANTS
+#define VK_VARIANT_FUNCTIONS(v) \
+    { \
+        &ed25519_publickey_##v, &ed25519_sign_##v, \
+        &vk_##v##_secp256k1_new, &vk_##v##_secp256k1_public_key, \
+        &vk_##v##_secp256k1_sign_digest \
+    }
+
+    static Functions const sse2Functions = VK_VARIANT_FUNCTIONS(sse2);
+    static Functions const x64Functions = VK_VARIANT_FUNCTIONS(x64);
+    static Functions const avx2Functions = VK_VARIANT_FUNCTIONS(avx2);
+
+#undef VK_VARIANT_FUNCTIONS
+
+    static CryptoKernels const sse2 (CryptoVariant::sse2, &sse2Functions);
+    static CryptoKernels const x64 (CryptoVariant::x86_64, &x64Functions);
+    static CryptoKernels const avx2 (CryptoVariant::avx2, &avx2Functions);
+
+    switch (variant)
+    {
+    case CryptoVariant::sse2:
+        return sse2;
+    case CryptoVariant::x86_64:
+        return x64;
+    case CryptoVariant::avx2:
+        return avx2;
+    default:
+        break;
+    }
+#endif
+
+    return library;
+}
+
+CryptoKernels const&
+CryptoKernels::active ()
+{
+    if (auto const kernels = activeKernels.load ())
+        return *kernels;
+
+    // Prefer the fastest variant, but never one that gives different
+    // results. The library variant is the reference, so always passes.
+    auto const variants = supported ();
+    auto chosen = &get (CryptoVariant::library);
+    for (auto it = variants.rbegin (); it != variants.rend (); ++it)
+    {
+        auto const& kernels = get (*it);
+        if (kernels.selfTest ())
+        {
+            chosen = &kernels;
+            break;
+        }
+    }
+
+    CryptoKernels const* expected = nullptr;
+    activeKernels.compare_exchange_strong (expected, chosen);
+    return *activeKernels.load ();
+}
+
+void
+CryptoKernels::activate (CryptoVariant variant)
+{
+    auto const& kernels = get (variant);
+    if (! kernels.selfTest ())
+        throw std::runtime_error (
+            "Crypto variant failed its self test: " + to_string (variant));
+    activeKernels.store (&kernels);
+}
+
+bool
+CryptoKernels::selfTest () const
+{
+    if (! functions_)
+        return true;
+
+    std::uint8_t bytes[32];
+    for (std::size_t i = 0; i < sizeof (bytes); ++i)
+        bytes[i] = static_cast<std::uint8_t> (0x5A ^ (i * 7));
+    SecretKey const sk (Slice (bytes, sizeof (bytes)));
+
+    std::string const message = "validator-keys crypto self test";
+
+    for (auto const type : {KeyType::secp256k1, KeyType::ed25519})
+    {
+        auto const pk = ripple::derivePublicKey (type, sk);
+        if (derivePublicKey (type, sk) != pk)
+            return false;
+
+        auto const expected = ripple::sign (pk, sk, makeSlice (message));
+        auto const signature = sign (pk, sk, makeSlice (message));
+        if (signature.size () != expected.size () ||
+            std::memcmp (signature.data (), expected.data (),
+                expected.size ()) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void const*
+CryptoKernels::secp256k1Context () const
+{
+    // Creating a context builds its precomputed tables, so it is only
+    // done when a variant first signs with secp256k1
+    std::call_once (contextOnce_, [this]
+    {
+        context_ = functions_->secp256k1New ();
+    });
+    return context_;
+}
+
+PublicKey
+CryptoKernels::derivePublicKey (KeyType type, SecretKey const& sk) const
+{
+    if (! functions_)
+        return ripple::derivePublicKey (type, sk);
+
+    unsigned char pk[33];
+    switch (type)
+    {
+    case KeyType::secp256k1:
+        if (functions_->secp256k1PublicKey (
+                secp256k1Context (), sk.data (), pk) != 1)
+            throw std::runtime_error ("derivePublicKey: secp256k1 failed");
+        break;
+    case KeyType::ed25519:
+        pk[0] = 0xED;
+        functions_->ed25519PublicKey (sk.data (), &pk[1]);
+        break;
+    default:
+        throw std::runtime_error ("derivePublicKey: bad key type");
+    }
+    return PublicKey (Slice (pk, sizeof (pk)));
+}
+
+Buffer
+CryptoKernels::sign (
+    PublicKey const& pk,
+    SecretKey const& sk,
+    Slice const& message) const
+{
+    if (! functions_)
+        return ripple::sign (pk, sk, message);
+
+    auto const type = publicKeyType (pk.slice ());
+    if (! type)
+        throw std::runtime_error ("sign: invalid type");
+
+    switch (*type)
+    {
+    case KeyType::ed25519:
+    {
+        Buffer b (64);
+        functions_->ed25519Sign (message.data (), message.size (),
+            sk.data (), pk.data () + 1, b.data ());
+        return b;
+    }
+    case KeyType::secp256k1:
+    {
+        sha512_half_hasher h;
+        h (message.data (), message.size ());
+        auto const digest = sha512_half_hasher::result_type (h);
+
+        unsigned char signature[72];
+        std::size_t size = sizeof (signature);
+        if (functions_->secp256k1Sign (secp256k1Context (), digest.data (),
+                sk.data (), signature, &size) != 1)
+            throw std::runtime_error ("sign: secp256k1 failed");
+        return Buffer (signature, size);
+    }
+    default:
+        throw std::runtime_error ("sign: invalid type");
+    }
+}
+
+void
+CryptoKernels::sign (
+    STObject& st,
+    HashPrefix const& prefix,
+    KeyType type,
+    SecretKey const& sk,
+    SF_Blob const& sigField) const
+{
+    if (! functions_)
+        return ripple::sign (st, prefix, type, sk, sigField);
+
+    Serializer ss;
+    ss.add32 (prefix);
+    st.addWithoutSigningFields (ss);
+
+    auto const signature = sign (derivePublicKey (type, sk), sk, ss.slice ());
+    st.setFieldVL (sigField, Slice (signature.data (), signature.size ()));
+}
+
+} // ripple
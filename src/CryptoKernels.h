@@ -0,0 +1,165 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_CRYPTOKERNELS_H_INCLUDED
+#define VALIDATOR_KEYS_CRYPTOKERNELS_H_INCLUDED
+
+#include <ripple/basics/Buffer.h>
+#include <ripple/basics/Slice.h>
+#include <ripple/crypto/KeyType.h>
+#include <ripple/protocol/HashPrefix.h>
+#include <ripple/protocol/PublicKey.h>
+#include <ripple/protocol/SecretKey.h>
+#include <ripple/protocol/SField.h>
+#include <boost/optional.hpp>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+class STObject;
+
+/** Builds of the ed25519 and secp256k1 code for different CPUs */
+enum class CryptoVariant
+{
+    /// The build in ripple-libpp, for any CPU
+    library,
+
+    /// ed25519 with SSE2 field arithmetic; secp256k1 with 32 bit limbs
+    sse2,
+
+    /// 64 bit field arithmetic, and x86-64 assembly for secp256k1
+    x86_64,
+
+    /// 64 bit field arithmetic built for AVX2 and BMI2 CPUs
+    avx2
+};
+
+std::string
+to_string (CryptoVariant variant);
+
+/** Returns the variant named by a string, as printed by to_string */
+boost::optional<CryptoVariant>
+cryptoVariantFromString (std::string const& name);
+
+/** Key derivation and signing with one build of the crypto libraries
+
+    Builds for x86-64 with GCC or Clang include every variant, and the
+    fastest one the CPU supports is used unless another is activated.
+    Other builds, and those configured with -Dcrypto_variants=OFF, only
+    include the library variant. A variant is only used after a self
+    test shows it derives the same keys and makes the same signatures
+    as the library, so callers get identical results whichever is
+    active. Signatures are deterministic for both key types, so this
+    is checked byte for byte.
+*/
+class CryptoKernels
+{
+public:
+    CryptoKernels (CryptoKernels const&) = delete;
+    CryptoKernels& operator= (CryptoKernels const&) = delete;
+
+    /** Returns the variants built in and supported by this CPU
+
+        The library variant is first, and the others follow from
+        slowest to fastest.
+    */
+    static
+    std::vector<CryptoVariant>
+    supported ();
+
+    /** Returns the kernels for a variant
+
+        @throws std::runtime_error if the variant is not supported
+    */
+    static
+    CryptoKernels const&
+    get (CryptoVariant variant);
+
+    /** Returns the kernels in use
+
+        On first use, the fastest supported variant that passes its
+        self test is chosen.
+    */
+    static
+    CryptoKernels const&
+    active ();
+
+    /** Uses a variant from now on
+
+        @throws std::runtime_error if the variant is not supported or
+        fails its self test
+    */
+    static
+    void
+    activate (CryptoVariant variant);
+
+    CryptoVariant
+    variant () const
+    {
+        return variant_;
+    }
+
+    /** Returns true if this variant gives the same results as the
+        library variant
+    */
+    bool
+    selfTest () const;
+
+    /** Returns the public key of a secret key, as ripple::derivePublicKey */
+    PublicKey
+    derivePublicKey (KeyType type, SecretKey const& sk) const;
+
+    /** Signs a message, as ripple::sign */
+    Buffer
+    sign (PublicKey const& pk, SecretKey const& sk, Slice const& message) const;
+
+    /** Signs an object, as ripple::sign
+
+        @param prefix Prefix of the signed data
+
+        @param sigField Field to hold the signature
+    */
+    void
+    sign (STObject& st, HashPrefix const& prefix, KeyType type,
+        SecretKey const& sk, SF_Blob const& sigField = sfSignature) const;
+
+private:
+    struct Functions;
+
+    CryptoKernels (CryptoVariant variant, Functions const* functions);
+
+    void const*
+    secp256k1Context () const;
+
+    CryptoVariant const variant_;
+
+    // Null for the library variant
+    Functions const* const functions_;
+
+    mutable std::once_flag contextOnce_;
+    mutable void const* context_ = nullptr;
+};
+
+} // ripple
+
+#endif
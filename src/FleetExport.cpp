@@ -0,0 +1,459 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <FleetExport.h>
+#include <Parallel.h>
+#include <ripple/basics/base_uint.h>
+#include <ripple/protocol/digest.h>
+#include <ripple/protocol/SecretKey.h>
+#include <beast/core/detail/base64.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <tuple>
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace ripple {
+
+namespace {
+
+using namespace fleet_export;
+
+// Where the checksum is in the header
+std::size_t constexpr checksumOffset = 24;
+std::size_t constexpr checksumSize = 32;
+
+template <class Int>
+void
+put (std::uint8_t* p, Int value)
+{
+    for (std::size_t i = 0; i < sizeof (Int); ++i)
+        p[i] = static_cast<std::uint8_t> (value >> (8 * i));
+}
+
+template <class Int>
+Int
+get (std::uint8_t const* p)
+{
+    Int value = 0;
+    for (std::size_t i = 0; i < sizeof (Int); ++i)
+        value |= static_cast<Int> (p[i]) << (8 * i);
+    return value;
+}
+
+std::size_t
+align (std::size_t offset)
+{
+    return (offset + 7) & ~std::size_t (7);
+}
+
+uint256
+checksum (std::uint8_t const* data, std::size_t size)
+{
+    std::uint8_t const zero[checksumSize] = {};
+    sha512_half_hasher h;
+    h (data, checksumOffset);
+    h (zero, checksumSize);
+    h (data + checksumOffset + checksumSize,
+        size - checksumOffset - checksumSize);
+    return static_cast<uint256> (h);
+}
+
+[[noreturn]]
+void
+corrupt ()
+{
+    throw std::runtime_error ("Corrupt fleet export");
+}
+
+}
+
+//------------------------------------------------------------------------------
+
+void
+FleetExportWriter::add (PublicKey const& masterKey,
+    boost::optional<PublicKey> const& signingKey,
+    std::uint32_t tokenSequence,
+    bool revoked,
+    std::string const& manifest)
+{
+    Row row;
+    std::memcpy (row.masterKey.data (), masterKey.data (), keySize);
+    row.signingKey.fill (0);
+    if (signingKey)
+        std::memcpy (row.signingKey.data (), signingKey->data (), keySize);
+    row.tokenSequence = tokenSequence;
+    row.revoked = revoked;
+    row.manifest = manifests_.size ();
+    row.manifestSize = manifest.size ();
+    manifests_ += manifest;
+    rows_.push_back (row);
+}
+
+std::size_t
+FleetExportWriter::write (std::ostream& out) const
+{
+    // The row kept for each master key sorts last
+    std::vector<std::size_t> order (rows_.size ());
+    std::iota (order.begin (), order.end (), std::size_t (0));
+    std::sort (order.begin (), order.end (),
+        [this](std::size_t a, std::size_t b)
+        {
+            auto const& x = rows_[a];
+            auto const& y = rows_[b];
+            return std::tie (x.masterKey, x.revoked, x.tokenSequence) <
+                std::tie (y.masterKey, y.revoked, y.tokenSequence);
+        });
+
+    std::vector<Row const*> kept;
+    kept.reserve (order.size ());
+    std::size_t manifestsSize = 0;
+    for (std::size_t i = 0; i < order.size (); ++i)
+    {
+        if (i + 1 < order.size () &&
+                rows_[order[i]].masterKey == rows_[order[i + 1]].masterKey)
+            continue;
+        kept.push_back (&rows_[order[i]]);
+        manifestsSize += kept.back ()->manifestSize;
+    }
+
+    auto const rows = kept.size ();
+    std::array<std::size_t, columnCount> const sizes = {{
+        keySize * rows, keySize * rows, 4 * rows, rows, 8 * rows,
+        manifestsSize}};
+    std::array<std::size_t, columnCount> offsets;
+    std::size_t fileSize = headerSize;
+    for (std::size_t c = 0; c < columnCount; ++c)
+    {
+        offsets[c] = align (fileSize);
+        fileSize = offsets[c] + sizes[c];
+    }
+
+    // Built whole, as the checksum in the header covers the columns
+    std::vector<std::uint8_t> file (fileSize, 0);
+    auto const p = file.data ();
+    put (p, magic);
+    put (p + 4, version);
+    put (p + 8, std::uint64_t (rows));
+    put (p + 16, std::uint64_t (fileSize));
+    for (std::size_t c = 0; c < columnCount; ++c)
+    {
+        put (p + 64 + 16 * c, std::uint64_t (offsets[c]));
+        put (p + 72 + 16 * c, std::uint64_t (sizes[c]));
+    }
+
+    std::uint64_t end = 0;
+    for (std::size_t i = 0; i < rows; ++i)
+    {
+        auto const& row = *kept[i];
+        std::memcpy (p + offsets[0] + keySize * i,
+            row.masterKey.data (), keySize);
+        std::memcpy (p + offsets[1] + keySize * i,
+            row.signingKey.data (), keySize);
+        put (p + offsets[2] + 4 * i, row.tokenSequence);
+        p[offsets[3] + i] = row.revoked ? revokedFlag : 0;
+        std::memcpy (p + offsets[5] + end,
+            manifests_.data () + row.manifest, row.manifestSize);
+        end += row.manifestSize;
+        put (p + offsets[4] + 8 * i, end);
+    }
+
+    auto const digest = checksum (p, fileSize);
+    std::memcpy (p + checksumOffset, digest.data (), checksumSize);
+
+    out.write (reinterpret_cast<char const*> (p), fileSize);
+    return rows;
+}
+
+//------------------------------------------------------------------------------
+
+std::vector<std::pair<boost::filesystem::path, std::string>>
+addKeyFiles (FleetExportWriter& writer,
+    std::vector<boost::filesystem::path> const& files,
+    KeyStore& store,
+    unsigned threads)
+{
+    struct Entry
+    {
+        PublicKey masterKey;
+        boost::optional<PublicKey> signingKey;
+        std::uint32_t tokenSequence;
+        bool revoked;
+        std::string manifest;
+    };
+
+    // Decoding keys and signing manifests dominates, so batches of key
+    // files are read and decoded on each thread, as inspectKeyFiles does
+    std::size_t const batchSize = 256;
+    auto const batches = (files.size () + batchSize - 1) / batchSize;
+
+    std::vector<boost::optional<Entry>> entries (files.size ());
+    std::vector<std::string> errors (files.size ());
+    parallelFor (batches, threads, 1, [&](std::size_t batch)
+    {
+        auto const first = batch * batchSize;
+        auto const last = std::min (files.size (), first + batchSize);
+
+        auto const contents = store.loadBatch (
+            std::vector<boost::filesystem::path> (
+                files.begin () + first, files.begin () + last));
+
+        for (auto i = first; i < last; ++i)
+        {
+            auto const& c = contents[i - first];
+            if (! c)
+            {
+                errors[i] = "Failed to open key file: " + files[i].string ();
+                continue;
+            }
+
+            try
+            {
+                auto keys = ValidatorKeys::fromJson (*c, files[i]);
+                Entry entry {keys.publicKey (), boost::none,
+                    keys.tokenSequence (), keys.revoked (), {}};
+
+                if (keys.revoked ())
+                {
+                    entry.manifest = beast::detail::base64_decode (
+                        keys.revoke ());
+                }
+                else if (auto const token = keys.regenerateValidatorToken (
+                        keys.tokenSequence ()))
+                {
+                    // Only tokens recorded as derived are regenerated
+                    entry.signingKey = derivePublicKey (
+                        keys.tokenKeys (keys.tokenSequence ())->keyType,
+                        *token->secretKey);
+                    entry.manifest = beast::detail::base64_decode (
+                        token->manifest);
+                }
+                entries[i] = std::move (entry);
+            }
+            catch (std::exception const& e)
+            {
+                errors[i] = e.what ();
+            }
+        }
+    });
+
+    std::vector<std::pair<boost::filesystem::path, std::string>> failed;
+    for (std::size_t i = 0; i < files.size (); ++i)
+    {
+        if (auto const& entry = entries[i])
+            writer.add (entry->masterKey, entry->signingKey,
+                entry->tokenSequence, entry->revoked, entry->manifest);
+        else
+            failed.emplace_back (files[i], errors[i]);
+    }
+    return failed;
+}
+
+//------------------------------------------------------------------------------
+
+FleetExport::FleetExport (boost::filesystem::path const& file, bool verify)
+{
+#ifdef _WIN32
+    std::ifstream in (file.string (), std::ios::binary);
+    if (! in)
+        throw std::runtime_error (
+            "Cannot open fleet export: " + file.string ());
+    buffer_.assign (std::istreambuf_iterator<char> (in),
+        std::istreambuf_iterator<char> ());
+    data_ = reinterpret_cast<std::uint8_t const*> (buffer_.data ());
+    size_ = buffer_.size ();
+#else
+    int const fd = ::open (file.c_str (), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd == -1 || fstat (fd, &st) != 0)
+    {
+        if (fd != -1)
+            ::close (fd);
+        throw std::runtime_error (
+            "Cannot open fleet export: " + file.string ());
+    }
+
+    size_ = static_cast<std::size_t> (st.st_size);
+    if (size_ >= headerSize)
+    {
+        auto const p = mmap (nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            mapping_ = p;
+            data_ = static_cast<std::uint8_t const*> (p);
+        }
+    }
+    ::close (fd);
+
+    if (size_ >= headerSize && ! mapping_)
+        throw std::runtime_error (
+            "Cannot open fleet export: " + file.string ());
+#endif
+
+    try
+    {
+        open (verify);
+    }
+    catch (...)
+    {
+#ifndef _WIN32
+        if (mapping_)
+            munmap (mapping_, size_);
+#endif
+        throw;
+    }
+}
+
+FleetExport::FleetExport (void const* data, std::size_t size, bool verify)
+    : data_ (static_cast<std::uint8_t const*> (data))
+    , size_ (size)
+{
+    open (verify);
+}
+
+FleetExport::~FleetExport ()
+{
+#ifndef _WIN32
+    if (mapping_)
+        munmap (mapping_, size_);
+#endif
+}
+
+void
+FleetExport::open (bool verify)
+{
+    if (size_ < headerSize || get<std::uint32_t> (data_) != magic)
+        throw std::runtime_error ("Not a fleet export");
+
+    auto const v = get<std::uint32_t> (data_ + 4);
+    if (v != version)
+        throw std::runtime_error (
+            "Unsupported fleet export version: " + std::to_string (v));
+
+    auto const rows = get<std::uint64_t> (data_ + 8);
+    if (get<std::uint64_t> (data_ + 16) != size_ ||
+            rows > size_ / (2 * keySize + 4 + 1 + 8))
+        corrupt ();
+    rows_ = static_cast<std::size_t> (rows);
+
+    std::array<std::size_t, columnCount> const sizes = {{
+        keySize * rows_, keySize * rows_, 4 * rows_, rows_, 8 * rows_, 0}};
+    for (std::size_t c = 0; c < columnCount; ++c)
+    {
+        auto const offset = get<std::uint64_t> (data_ + 64 + 16 * c);
+        auto const size = get<std::uint64_t> (data_ + 72 + 16 * c);
+        if (offset < headerSize || offset > size_ || size > size_ - offset ||
+                (c + 1 < columnCount && size != sizes[c]))
+            corrupt ();
+        columns_[c] = data_ + offset;
+        if (c + 1 == columnCount)
+            manifestsSize_ = static_cast<std::size_t> (size);
+    }
+
+    if (verify && checksum (data_, size_) !=
+            uint256::fromVoid (data_ + checksumOffset))
+        throw std::runtime_error ("Fleet export checksum mismatch");
+}
+
+PublicKey
+FleetExport::masterKey (std::size_t row) const
+{
+    // PublicKey calls LogicError on bytes that are not a key
+    Slice const key (columns_[0] + keySize * row, keySize);
+    if (! publicKeyType (key))
+        corrupt ();
+    return PublicKey (key);
+}
+
+boost::optional<PublicKey>
+FleetExport::signingKey (std::size_t row) const
+{
+    Slice const key (columns_[1] + keySize * row, keySize);
+    if (key[0] == 0)
+        return boost::none;
+    if (! publicKeyType (key))
+        corrupt ();
+    return PublicKey (key);
+}
+
+std::uint32_t
+FleetExport::tokenSequence (std::size_t row) const
+{
+    return get<std::uint32_t> (columns_[2] + 4 * row);
+}
+
+bool
+FleetExport::revoked (std::size_t row) const
+{
+    return columns_[3][row] & revokedFlag;
+}
+
+Slice
+FleetExport::manifest (std::size_t row) const
+{
+    auto const end = get<std::uint64_t> (columns_[4] + 8 * row);
+    auto const start = row == 0 ?
+        0 : get<std::uint64_t> (columns_[4] + 8 * (row - 1));
+    if (start > end || end > manifestsSize_)
+        corrupt ();
+    return Slice (columns_[5] + start, static_cast<std::size_t> (
+        end - start));
+}
+
+boost::optional<std::size_t>
+FleetExport::find (PublicKey const& masterKey) const
+{
+    if (masterKey.size () != keySize)
+        return boost::none;
+
+    // Binary search on row numbers, comparing keys in place
+    std::size_t first = 0;
+    std::size_t count = rows_;
+    while (count > 0)
+    {
+        auto const half = count / 2;
+        if (std::memcmp (columns_[0] + keySize * (first + half),
+                masterKey.data (), keySize) < 0)
+        {
+            first += half + 1;
+            count -= half + 1;
+        }
+        else
+        {
+            count = half;
+        }
+    }
+
+    if (first < rows_ && std::memcmp (columns_[0] + keySize * first,
+            masterKey.data (), keySize) == 0)
+        return first;
+    return boost::none;
+}
+
+} // ripple
@@ -0,0 +1,245 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_FLEETEXPORT_H_INCLUDED
+#define VALIDATOR_KEYS_FLEETEXPORT_H_INCLUDED
+
+#include <KeyStore.h>
+#include <ValidatorKeys.h>
+#include <ripple/basics/Slice.h>
+#include <ripple/crypto/KeyType.h>
+#include <ripple/protocol/PublicKey.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ripple {
+
+/*  An export holds the public data of many validators in columns, so a
+    consumer can map the file and read any row in place.
+
+    Every integer is little-endian. The file starts with a header:
+
+        offset  size
+             0     4  magic, "VKX1"
+             4     4  version, 1
+             8     8  row count
+            16     8  file size
+            24    32  SHA-512 half of the file with these 32 bytes zeroed
+            56     8  zero
+            64    96  offset and size (8 bytes each) of the six columns
+
+    followed by the columns, each starting at a multiple of 8 bytes:
+
+        master keys     33 bytes per row, sorted
+        signing keys    33 bytes per row, zero if there is no manifest
+        token sequences  4 bytes per row
+        flags            1 byte per row, 1 if revoked
+        manifest ends    8 bytes per row, where each manifest ends
+        manifests       serialized manifests, one after the other
+*/
+namespace fleet_export {
+
+std::uint32_t constexpr magic = 0x31584b56;         // "VKX1"
+std::uint32_t constexpr version = 1;
+std::size_t constexpr columnCount = 6;
+std::size_t constexpr headerSize = 64 + columnCount * 16;
+std::size_t constexpr keySize = 33;
+
+enum Flags : std::uint8_t
+{
+    revokedFlag = 1
+};
+
+}
+
+/** Builds an export of the public data of many validators */
+class FleetExportWriter
+{
+public:
+    /** Adds a validator
+
+        If the master key was already added, the row kept is the one
+        that is revoked or else has the highest token sequence.
+
+        @param signingKey The signing key of the manifest, if any
+
+        @param manifest Serialized current manifest, or empty
+    */
+    void
+    add (PublicKey const& masterKey,
+        boost::optional<PublicKey> const& signingKey,
+        std::uint32_t tokenSequence,
+        bool revoked,
+        std::string const& manifest);
+
+    /** Returns the number of validators added */
+    std::size_t
+    size () const
+    {
+        return rows_.size ();
+    }
+
+    /** Writes the export, one row per master key
+
+        @return Number of rows written
+    */
+    std::size_t
+    write (std::ostream& out) const;
+
+private:
+    using Key = std::array<std::uint8_t, fleet_export::keySize>;
+
+    struct Row
+    {
+        Key masterKey;
+        Key signingKey;
+        std::uint32_t tokenSequence;
+        bool revoked;
+
+        // Where the manifest is in manifests_
+        std::size_t manifest;
+        std::size_t manifestSize;
+    };
+
+    std::vector<Row> rows_;
+    std::string manifests_;
+};
+
+/** Adds the validators in key files to an export
+
+    Key files are read in batches (see KeyStore::loadBatch) and decoded
+    on several threads, then added in order. The current manifest of a
+    revoked validator is its revocation. Otherwise, if the key file
+    records that the current token was issued with derived token keys,
+    it is that token, regenerated with the recorded key type. Random
+    token keys cannot be regenerated, and a token issued before key files
+    recorded how cannot be trusted to regenerate, so those validators are
+    added without a manifest or signing key.
+
+    @param threads Threads to use, or zero for one per CPU
+
+    @return Each key file that could not be added, with the reason
+*/
+std::vector<std::pair<boost::filesystem::path, std::string>>
+addKeyFiles (FleetExportWriter& writer,
+    std::vector<boost::filesystem::path> const& files,
+    KeyStore& store = defaultKeyStore (),
+    unsigned threads = 0);
+
+/** Reads an export in place
+
+    A file is mapped into memory, and opening it only checks the header
+    and, optionally, the checksum. Rows are read straight from the
+    mapping, so millions of them cost nothing until they are used, and
+    a row is only checked when it is read. Rows are not bounds checked:
+    callers must pass a row less than size (). The reader does not
+    change after construction, so it may be shared between threads.
+*/
+class FleetExport
+{
+public:
+    /** Maps an export file
+
+        @param verify Whether to check the checksum, which reads the
+                      whole file
+
+        @throws std::runtime_error if the file cannot be read or is not
+                a valid export
+    */
+    explicit
+    FleetExport (boost::filesystem::path const& file, bool verify = true);
+
+    /** Reads an export in memory, which must outlive the reader
+
+        @throws std::runtime_error if the data is not a valid export
+    */
+    FleetExport (void const* data, std::size_t size, bool verify = true);
+
+    FleetExport (FleetExport const&) = delete;
+    FleetExport& operator= (FleetExport const&) = delete;
+
+    ~FleetExport ();
+
+    /** Returns the number of rows */
+    std::size_t
+    size () const
+    {
+        return rows_;
+    }
+
+    /** Returns the master key
+
+        @throws std::runtime_error if the key is corrupt
+    */
+    PublicKey
+    masterKey (std::size_t row) const;
+
+    /** Returns the signing key of the current manifest, if any
+
+        @throws std::runtime_error if the key is corrupt
+    */
+    boost::optional<PublicKey>
+    signingKey (std::size_t row) const;
+
+    /** Returns the last token sequence issued */
+    std::uint32_t
+    tokenSequence (std::size_t row) const;
+
+    bool
+    revoked (std::size_t row) const;
+
+    /** Returns the serialized current manifest, or an empty slice
+
+        @throws std::runtime_error if the manifest ends are corrupt
+    */
+    Slice
+    manifest (std::size_t row) const;
+
+    /** Returns the row of a master key, searching the sorted column */
+    boost::optional<std::size_t>
+    find (PublicKey const& masterKey) const;
+
+private:
+    std::uint8_t const* data_ = nullptr;
+    std::size_t size_ = 0;
+
+    // The mapping to release, if the reader made one
+    void* mapping_ = nullptr;
+
+    // The file, where it cannot be mapped
+    std::string buffer_;
+
+    std::size_t rows_ = 0;
+    std::array<std::uint8_t const*, fleet_export::columnCount> columns_;
+    std::size_t manifestsSize_ = 0;
+
+    void
+    open (bool verify);
+};
+
+} // ripple
+
+#endif
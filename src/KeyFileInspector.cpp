@@ -0,0 +1,210 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyFileInspector.h>
+#include <CryptoKernels.h>
+#include <Parallel.h>
+#include <TokenKeyDerivation.h>
+#include <ripple/json/json_reader.h>
+#include <ripple/protocol/SecretKey.h>
+#include <algorithm>
+#include <limits>
+
+namespace ripple {
+
+char const*
+to_string (KeyFileReport::Finding finding)
+{
+    switch (finding)
+    {
+    case KeyFileReport::unreadable:
+        return "unreadable";
+    case KeyFileReport::malformed:
+        return "malformed";
+    case KeyFileReport::badKeyType:
+        return "bad key type";
+    case KeyFileReport::badSecretKey:
+        return "bad secret key";
+    case KeyFileReport::publicKeyMismatch:
+        return "public key mismatch";
+    case KeyFileReport::sequenceNearLimit:
+        return "sequence near limit";
+    case KeyFileReport::revoked:
+        return "revoked";
+    }
+    return "unknown";
+}
+
+KeyFileReport
+inspectKeyFile (boost::filesystem::path const& file,
+    std::string const& contents,
+    std::uint32_t sequenceMargin)
+{
+    KeyFileReport report;
+    report.file = file;
+
+    // Keeps the first reason the key file is malformed
+    auto const malformed = [&report](std::string const& error)
+    {
+        if (! (report.findings & KeyFileReport::malformed))
+            report.error = error;
+        report.findings |= KeyFileReport::malformed;
+    };
+
+    Json::Value jKeys;
+    if (! Json::Reader ().parse (contents, jKeys) || ! jKeys.isObject ())
+    {
+        malformed ("Unable to parse json key file");
+        return report;
+    }
+
+    for (auto const field : {"key_type", "secret_key", "token_sequence",
+        "revoked"})
+    {
+        if (! jKeys.isMember (field))
+            malformed (std::string ("Missing \"") + field + "\" field");
+    }
+
+    auto const& jKeyType = jKeys["key_type"];
+    if (jKeyType.isString ())
+        report.keyType = keyTypeFromString (jKeyType.asString ());
+    if (report.keyType == KeyType::invalid && ! jKeyType.isNull ())
+        report.findings |= KeyFileReport::badKeyType;
+
+    boost::optional<SecretKey> secret;
+    auto const& jSecret = jKeys["secret_key"];
+    if (jSecret.isString ())
+        secret = parseBase58<SecretKey> (
+            TokenType::TOKEN_NODE_PRIVATE, jSecret.asString ());
+    if (! secret && ! jSecret.isNull ())
+        report.findings |= KeyFileReport::badSecretKey;
+
+    auto const& jSequence = jKeys["token_sequence"];
+    if (! jSequence.isNull ())
+    {
+        try
+        {
+            if (! jSequence.isIntegral ())
+                throw std::runtime_error ("");
+            report.tokenSequence = jSequence.asUInt ();
+        }
+        catch (std::runtime_error const&)
+        {
+            malformed ("Invalid \"token_sequence\" field");
+        }
+    }
+
+    auto const& jRevoked = jKeys["revoked"];
+    if (jRevoked.isBool ())
+    {
+        if (jRevoked.asBool ())
+            report.findings |= KeyFileReport::revoked;
+    }
+    else if (! jRevoked.isNull ())
+    {
+        malformed ("Invalid \"revoked\" field");
+    }
+
+    // The maximum sequence is reserved for revocations
+    auto const limit = std::numeric_limits<std::uint32_t>::max () - 1;
+    if (! (report.findings & KeyFileReport::revoked) &&
+            limit - std::min (report.tokenSequence, limit) < sequenceMargin)
+        report.findings |= KeyFileReport::sequenceNearLimit;
+
+    // The crypto libraries reject a secp256k1 secret that is zero or not
+    // below the group order, the reference one with LogicError
+    if (report.keyType != KeyType::invalid && secret &&
+        ! validSecretKey (report.keyType,
+            Slice (secret->data (), secret->size ())))
+    {
+        report.findings |= KeyFileReport::badSecretKey;
+        secret = boost::none;
+    }
+
+    if (report.keyType != KeyType::invalid && secret)
+    {
+        try
+        {
+            report.publicKey = CryptoKernels::active ().derivePublicKey (
+                report.keyType, *secret);
+        }
+        catch (std::exception const&)
+        {
+            report.findings |= KeyFileReport::badSecretKey;
+            return report;
+        }
+
+        // Older key files may not hold the public key at all
+        auto const& jPublic = jKeys["public_key"];
+        if (! jPublic.isNull ())
+        {
+            boost::optional<PublicKey> stored;
+            if (jPublic.isString ())
+                stored = parseBase58<PublicKey> (
+                    TokenType::TOKEN_NODE_PUBLIC, jPublic.asString ());
+            if (stored != report.publicKey)
+                report.findings |= KeyFileReport::publicKeyMismatch;
+        }
+    }
+
+    return report;
+}
+
+std::vector<KeyFileReport>
+inspectKeyFiles (std::vector<boost::filesystem::path> const& files,
+    KeyStore& store,
+    std::uint32_t sequenceMargin,
+    unsigned threads)
+{
+    // Each batch is read and then decoded by one thread, while other
+    // threads are reading theirs
+    std::size_t const batchSize = 256;
+    auto const batches = (files.size () + batchSize - 1) / batchSize;
+
+    std::vector<KeyFileReport> reports (files.size ());
+    parallelFor (batches, threads, 1, [&](std::size_t batch)
+    {
+        auto const first = batch * batchSize;
+        auto const last = std::min (files.size (), first + batchSize);
+
+        auto const contents = store.loadBatch (
+            std::vector<boost::filesystem::path> (
+                files.begin () + first, files.begin () + last));
+
+        for (auto i = first; i < last; ++i)
+        {
+            if (auto const& c = contents[i - first])
+            {
+                reports[i] = inspectKeyFile (files[i], *c, sequenceMargin);
+            }
+            else
+            {
+                reports[i].file = files[i];
+                reports[i].findings = KeyFileReport::unreadable;
+                reports[i].error =
+                    "Failed to open key file: " + files[i].string ();
+            }
+        }
+    });
+
+    return reports;
+}
+
+} // ripple
@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_KEYFILEINSPECTOR_H_INCLUDED
+#define VALIDATOR_KEYS_KEYFILEINSPECTOR_H_INCLUDED
+
+#include <KeyStore.h>
+#include <ripple/crypto/KeyType.h>
+#include <ripple/protocol/PublicKey.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** What an inspection found in one key file */
+struct KeyFileReport
+{
+    /** Findings, most severe first */
+    enum Finding : std::uint32_t
+    {
+        /// The key file cannot be read
+        unreadable = 1 << 0,
+
+        /// Not JSON, or a field is missing or has the wrong type
+        malformed = 1 << 1,
+
+        /// The key type is neither ed25519 nor secp256k1
+        badKeyType = 1 << 2,
+
+        /// The secret key cannot be decoded
+        badSecretKey = 1 << 3,
+
+        /// The stored public key is not that of the secret key
+        publicKeyMismatch = 1 << 4,
+
+        /// Few token sequences remain before createValidatorToken fails
+        sequenceNearLimit = 1 << 5,
+
+        /// The keys are revoked
+        revoked = 1 << 6
+    };
+
+    static std::size_t constexpr findingCount = 7;
+
+    boost::filesystem::path file;
+
+    /// Bitwise or of Finding values, zero if the key file is sound
+    std::uint32_t findings = 0;
+
+    KeyType keyType = KeyType::invalid;
+
+    /// Derived from the secret key, if it could be decoded
+    boost::optional<PublicKey> publicKey;
+
+    std::uint32_t tokenSequence = 0;
+
+    /// Why the key file is unreadable or malformed
+    std::string error;
+};
+
+/** Returns the name of a finding, such as "public key mismatch" */
+char const*
+to_string (KeyFileReport::Finding finding);
+
+/** Inspects the contents of a key file
+
+    Applies the checks of ValidatorKeys::fromJson, and also compares the
+    stored public key, which fromJson ignores, with the one derived from
+    the secret key.
+
+    @param sequenceMargin Report sequenceNearLimit when fewer than this
+                          many token sequences remain
+*/
+KeyFileReport
+inspectKeyFile (boost::filesystem::path const& file,
+    std::string const& contents,
+    std::uint32_t sequenceMargin = 1000000);
+
+/** Inspects key files on several threads
+
+    The key files are read in batches with KeyStore::loadBatch, without
+    locking them, so a key file being rewritten may be reported as
+    malformed. The public keys of each batch are derived on the thread
+    that read it.
+
+    @param threads Threads to use, or zero for one per CPU
+
+    @return A report for each key file, in the same order
+*/
+std::vector<KeyFileReport>
+inspectKeyFiles (std::vector<boost::filesystem::path> const& files,
+    KeyStore& store,
+    std::uint32_t sequenceMargin = 1000000,
+    unsigned threads = 0);
+
+} // ripple
+
+#endif
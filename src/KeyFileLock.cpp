@@ -0,0 +1,214 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyFileLock.h>
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <thread>
+#ifdef _WIN32
+# ifndef WIN32_LEAN_AND_MEAN // VC_EXTRALEAN
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  undef WIN32_LEAN_AND_MEAN
+# else
+#  include <windows.h>
+# endif
+#else
+# include <fcntl.h>
+# include <sys/file.h>
+# include <unistd.h>
+#endif
+
+namespace ripple {
+
+std::chrono::milliseconds const KeyFileLock::defaultTimeout {10000};
+
+#ifdef _WIN32
+KeyFileLock::handle_type const KeyFileLock::invalidHandle =
+    INVALID_HANDLE_VALUE;
+#else
+KeyFileLock::handle_type const KeyFileLock::invalidHandle = -1;
+#endif
+
+namespace {
+
+// Returns true if the lock was acquired, false if it is held elsewhere
+#ifdef _WIN32
+bool
+tryLock (HANDLE h, KeyFileLock::Mode mode)
+{
+    OVERLAPPED ov = {};
+    DWORD flags = LOCKFILE_FAIL_IMMEDIATELY;
+    if (mode == KeyFileLock::Mode::exclusive)
+        flags |= LOCKFILE_EXCLUSIVE_LOCK;
+
+    if (LockFileEx (h, flags, 0, MAXDWORD, MAXDWORD, &ov))
+        return true;
+
+    if (GetLastError () == ERROR_LOCK_VIOLATION)
+        return false;
+
+    throw std::runtime_error ("Unable to lock key file");
+}
+#else
+bool
+tryLock (int fd, KeyFileLock::Mode mode)
+{
+#ifdef F_OFD_SETLK
+    struct flock fl = {};
+    fl.l_type = mode == KeyFileLock::Mode::exclusive ? F_WRLCK : F_RDLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 0;
+
+    int ret;
+    do
+        ret = fcntl (fd, F_OFD_SETLK, &fl);
+    while (ret == -1 && errno == EINTR);
+
+    if (ret == 0)
+        return true;
+
+    // Kernels older than 3.15 do not know about OFD locks
+    if (errno != EINVAL)
+    {
+        if (errno == EAGAIN || errno == EACCES)
+            return false;
+
+        throw std::runtime_error ("Unable to lock key file");
+    }
+#endif
+
+    int const op = LOCK_NB |
+        (mode == KeyFileLock::Mode::exclusive ? LOCK_EX : LOCK_SH);
+
+    int rc;
+    do
+        rc = flock (fd, op);
+    while (rc == -1 && errno == EINTR);
+
+    if (rc == 0)
+        return true;
+
+    if (errno == EWOULDBLOCK)
+        return false;
+
+    throw std::runtime_error ("Unable to lock key file");
+}
+#endif
+
+}
+
+boost::filesystem::path
+KeyFileLock::lockPath (boost::filesystem::path const& keyFile)
+{
+    auto p = keyFile;
+    p += ".lock";
+    return p;
+}
+
+KeyFileLock::KeyFileLock (
+    boost::filesystem::path const& keyFile,
+    Mode mode,
+    std::chrono::milliseconds timeout)
+    : handle_ (invalidHandle)
+{
+    auto const lockFile = lockPath (keyFile);
+
+#ifdef _WIN32
+    auto h = CreateFileW (lockFile.c_str (),
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    bool const missingDir = h == INVALID_HANDLE_VALUE &&
+        GetLastError () == ERROR_PATH_NOT_FOUND;
+#else
+    int h;
+    do
+        h = ::open (lockFile.c_str (),
+            O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    while (h == -1 && errno == EINTR);
+    bool const missingDir = h == -1 && errno == ENOENT;
+#endif
+
+    if (h == invalidHandle)
+    {
+        if (missingDir || mode == Mode::shared)
+            return;
+
+        throw std::runtime_error (
+            "Cannot open lock file: " + lockFile.string ());
+    }
+
+    auto close = [h]
+    {
+#ifdef _WIN32
+        CloseHandle (h);
+#else
+        ::close (h);
+#endif
+    };
+
+    // Start with a short sleep so a briefly held lock is picked up
+    // quickly, and back off so many waiters do not hammer the kernel.
+    using namespace std::chrono;
+    auto const deadline = steady_clock::now () + timeout;
+    auto delay = microseconds {20};
+    auto const maxDelay = microseconds {5000};
+
+    try
+    {
+        while (! tryLock (h, mode))
+        {
+            auto const now = steady_clock::now ();
+            if (now >= deadline)
+                throw std::runtime_error (
+                    "Timed out waiting for lock on key file: " +
+                    keyFile.string ());
+
+            std::this_thread::sleep_for (std::min<steady_clock::duration> (
+                delay, deadline - now));
+            delay = std::min (delay * 2, maxDelay);
+        }
+    }
+    catch (...)
+    {
+        close ();
+        throw;
+    }
+
+    handle_ = h;
+}
+
+KeyFileLock::~KeyFileLock ()
+{
+    if (! locked ())
+        return;
+
+    // Closing the last descriptor releases OFD and flock locks
+#ifdef _WIN32
+    CloseHandle (handle_);
+#else
+    ::close (handle_);
+#endif
+}
+
+} // ripple
@@ -0,0 +1,101 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_KEYFILELOCK_H_INCLUDED
+#define VALIDATOR_KEYS_KEYFILELOCK_H_INCLUDED
+
+#include <boost/filesystem/path.hpp>
+#include <chrono>
+
+namespace ripple {
+
+/** Advisory lock on a key file shared between processes
+
+    The lock is held on a "<keyfile>.lock" file next to the key file, so
+    key files can be rewritten without disturbing the lock. Open file
+    description locks are used where available, so the lock also excludes
+    other threads of the same process. Exclusive locks guard the
+    read-modify-write of commands that update the key file; shared locks
+    guard commands that only read it.
+
+    Acquisition polls with exponential backoff until the timeout expires.
+*/
+class KeyFileLock
+{
+public:
+    enum class Mode
+    {
+        shared,
+        exclusive
+    };
+
+    static std::chrono::milliseconds const defaultTimeout;
+
+    /** Acquire a lock on a key file
+
+        If the key file's directory does not exist, or a shared lock file
+        cannot be created, no lock is taken: the key file cannot be read
+        or written by anyone else in that case either.
+
+        @param keyFile Path to the key file to lock
+
+        @param mode Shared or exclusive
+
+        @param timeout Maximum time to wait for the lock
+
+        @throws std::runtime_error if the lock file cannot be opened for an
+        exclusive lock or the lock is not acquired before the timeout
+    */
+    KeyFileLock (
+        boost::filesystem::path const& keyFile,
+        Mode mode,
+        std::chrono::milliseconds timeout = defaultTimeout);
+
+    ~KeyFileLock ();
+
+    KeyFileLock (KeyFileLock const&) = delete;
+    KeyFileLock& operator= (KeyFileLock const&) = delete;
+
+    /** Returns true if a lock is held. */
+    bool
+    locked () const
+    {
+        return handle_ != invalidHandle;
+    }
+
+    /** Returns path to the lock file guarding a key file. */
+    static
+    boost::filesystem::path
+    lockPath (boost::filesystem::path const& keyFile);
+
+private:
+#ifdef _WIN32
+    using handle_type = void*;
+#else
+    using handle_type = int;
+#endif
+    static handle_type const invalidHandle;
+
+    handle_type handle_;
+};
+
+} // ripple
+
+#endif
@@ -0,0 +1,167 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyFileOps.h>
+
+namespace ripple {
+
+namespace {
+
+// Locking creates a lock file beside the key file, so a key file that
+// does not exist is reported, by its store, before it is locked
+void
+requireKeyFile (boost::filesystem::path const& keyFile, KeyStore& store)
+{
+    if (! store.exists (keyFile))
+        store.load (keyFile);
+}
+
+}
+
+ValidatorKeys
+loadKeyFile (boost::filesystem::path const& keyFile, KeyStore& store)
+{
+    requireKeyFile (keyFile, store);
+    auto const lock = store.lock (keyFile, KeyFileLock::Mode::shared);
+    return ValidatorKeys::make_ValidatorKeys (keyFile, store);
+}
+
+ValidatorKeys
+loadKeyFile (boost::filesystem::path const& keyFile, KeyStore& store,
+    KeyringCache const* cache)
+{
+    if (! cache)
+        return loadKeyFile (keyFile, store);
+
+    requireKeyFile (keyFile, store);
+
+    // Key files are rewritten in place, so the fingerprint is only
+    // consistent with the contents while writers are locked out.
+    auto const lock = store.lock (keyFile, KeyFileLock::Mode::shared);
+
+    auto const fingerprint = store.fingerprint (keyFile);
+    if (fingerprint)
+    {
+        if (auto cached = cache->load (keyFile, *fingerprint))
+            return *cached;
+    }
+
+    auto const keys = ValidatorKeys::make_ValidatorKeys (keyFile, store);
+    if (fingerprint)
+        cache->store (keyFile, *fingerprint, keys);
+    return keys;
+}
+
+PublicKey
+createValidatorKeyFile (boost::filesystem::path const& keyFile,
+    KeyStore& store, KeyType keyType)
+{
+    // Create the directory first so the lock file has somewhere to live
+    store.prepare (keyFile);
+
+    auto const lock = store.lock (keyFile, KeyFileLock::Mode::exclusive);
+
+    if (store.exists (keyFile))
+        throw std::runtime_error (
+            "Refusing to overwrite existing key file: " +
+                keyFile.string ());
+
+    ValidatorKeys const keys (keyType);
+    keys.writeToFile (keyFile, store);
+
+    return keys.publicKey ();
+}
+
+KeyFileUpdate
+issueValidatorToken (boost::filesystem::path const& keyFile,
+    KeyStore& store, KeyType tokenKeyType, TokenKeySource source,
+    KeyringCache const* cache)
+{
+    requireKeyFile (keyFile, store);
+    auto const lock = store.lock (keyFile, KeyFileLock::Mode::exclusive);
+
+    auto keys = ValidatorKeys::make_ValidatorKeys (keyFile, store);
+
+    if (keys.revoked ())
+        throw std::runtime_error (
+            "Validator keys have been revoked.");
+
+    auto const token = keys.createValidatorToken (tokenKeyType, source);
+
+    if (! token)
+        throw std::runtime_error (
+            "Maximum number of tokens have already been generated.\n"
+            "Revoke validator keys if previous token has been compromised.");
+
+    // Update key file with new token sequence
+    keys.writeToFile (keyFile, store);
+    if (cache)
+        cache->invalidate (keyFile);
+
+    return { keys.publicKey (), token->toString (), false };
+}
+
+KeyFileUpdate
+regenerateValidatorToken (boost::filesystem::path const& keyFile,
+    std::uint32_t sequence, KeyStore& store, KeyringCache const* cache)
+{
+    auto const keys = loadKeyFile (keyFile, store, cache);
+
+    if (keys.revoked ())
+        throw std::runtime_error (
+            "Validator keys have been revoked.");
+
+    if (sequence == 0 || sequence > keys.tokenSequence ())
+        throw std::runtime_error (
+            "Token sequence " + std::to_string (sequence) +
+            " has not been issued.");
+
+    auto const token = keys.regenerateValidatorToken (sequence);
+
+    if (! token)
+        throw std::runtime_error (
+            "Token sequence " + std::to_string (sequence) +
+            " was not issued with derived token keys.");
+
+    return { keys.publicKey (), token->toString (), false };
+}
+
+KeyFileUpdate
+revokeKeyFile (boost::filesystem::path const& keyFile, KeyStore& store,
+    KeyringCache const* cache)
+{
+    requireKeyFile (keyFile, store);
+    auto const lock = store.lock (keyFile, KeyFileLock::Mode::exclusive);
+
+    auto keys = ValidatorKeys::make_ValidatorKeys (keyFile, store);
+
+    bool const wasRevoked = keys.revoked ();
+    auto const revocation = keys.revoke ();
+
+    // Update key file with new token sequence
+    keys.writeToFile (keyFile, store);
+    if (cache)
+        cache->invalidate (keyFile);
+
+    return { keys.publicKey (),
+        SecureString (revocation.begin (), revocation.end ()), wasRevoked };
+}
+
+} // ripple
@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_KEYFILEOPS_H_INCLUDED
+#define VALIDATOR_KEYS_KEYFILEOPS_H_INCLUDED
+
+#include <KeyringCache.h>
+#include <KeyStore.h>
+#include <ValidatorKeys.h>
+#include <string>
+
+namespace ripple {
+
+/** Result of an operation that rewrites a key file */
+struct KeyFileUpdate
+{
+    PublicKey publicKey;
+
+    /// Base64-encoded token or revocation, held in secure memory
+    SecureString value;
+
+    /// True if the keys were revoked before the operation
+    bool wasRevoked;
+};
+
+/** Returns the keys in a key file, read under a shared lock
+
+    @throws std::runtime_error if the key file cannot be read
+*/
+ValidatorKeys
+loadKeyFile (boost::filesystem::path const& keyFile,
+    KeyStore& store = defaultKeyStore ());
+
+/** Returns the keys in a key file, from a keyring cache if possible
+
+    The cached keys are used while the key file fingerprint is unchanged.
+    Otherwise the key file is read under a shared lock and cached.
+
+    @param cache Cache to use, or nullptr to always read the key file
+
+    @throws std::runtime_error if the key file cannot be read
+*/
+ValidatorKeys
+loadKeyFile (boost::filesystem::path const& keyFile,
+    KeyStore& store,
+    KeyringCache const* cache);
+
+/** Creates a key file holding new validator keys
+
+    The key file is locked exclusively while it is created.
+
+    @param keyType Key type for the validator keys
+
+    @return The validator public key
+
+    @throws std::runtime_error if the key file already exists or cannot
+            be written
+*/
+PublicKey
+createValidatorKeyFile (boost::filesystem::path const& keyFile,
+    KeyStore& store = defaultKeyStore (),
+    KeyType keyType = KeyType::ed25519);
+
+/** Creates the next validator token and records its sequence
+
+    The key file is locked exclusively while it is read and rewritten.
+
+    @param tokenKeyType Key type for the token keys
+
+    @param source How the token secret key is generated
+
+    @param cache Keyring cache whose entry for the key file is removed
+
+    @throws std::runtime_error if the keys are revoked, no token
+            sequences remain, or the key file cannot be read or written
+*/
+KeyFileUpdate
+issueValidatorToken (boost::filesystem::path const& keyFile,
+    KeyStore& store = defaultKeyStore (),
+    KeyType tokenKeyType = KeyType::secp256k1,
+    TokenKeySource source = TokenKeySource::random,
+    KeyringCache const* cache = nullptr);
+
+/** Returns the token previously issued for a sequence with derived keys
+
+    The key file is only read. The token keys are derived with the key
+    type recorded when the token was issued.
+
+    @throws std::runtime_error if the keys are revoked, the sequence has
+            not been issued, was not recorded as issued with derived
+            token keys, or the key file cannot be read
+*/
+KeyFileUpdate
+regenerateValidatorToken (boost::filesystem::path const& keyFile,
+    std::uint32_t sequence,
+    KeyStore& store = defaultKeyStore (),
+    KeyringCache const* cache = nullptr);
+
+/** Revokes the keys in a key file
+
+    The key file is locked exclusively while it is read and rewritten.
+    Revoking keys that are already revoked issues a new revocation.
+
+    @throws std::runtime_error if the key file cannot be read or written
+*/
+KeyFileUpdate
+revokeKeyFile (boost::filesystem::path const& keyFile,
+    KeyStore& store = defaultKeyStore (),
+    KeyringCache const* cache = nullptr);
+
+} // ripple
+
+#endif
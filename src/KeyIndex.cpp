@@ -0,0 +1,146 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyIndex.h>
+#include <CryptoKernels.h>
+#include <ValidatorKeys.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/protocol/Sign.h>
+#include <cstring>
+
+namespace ripple {
+
+namespace {
+
+std::size_t
+slotsFor (std::size_t keys)
+{
+    std::size_t slots = 16;
+    while (slots < 2 * keys)
+        slots <<= 1;
+    return slots;
+}
+
+}
+
+KeyIndex::KeyIndex (std::size_t expected)
+    : mask_ (0)
+{
+    publicKeys_.reserve (expected);
+    secretKeys_.reserve (expected);
+    revoked_.reserve (expected);
+    rehash (slotsFor (expected));
+}
+
+std::uint64_t
+KeyIndex::hash (PublicKey const& publicKey)
+{
+    // Past the type prefix, public keys are uniformly distributed, so a
+    // multiplicative mix of eight of their bytes is enough.
+    std::uint64_t h;
+    std::memcpy (&h, publicKey.data () + 1, sizeof (h));
+    h *= 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+void
+KeyIndex::place (std::uint64_t h, std::size_t position)
+{
+    auto const slot = (h & 0xFFFFFFFF00000000ull) | (position + 1);
+    for (auto i = static_cast<std::size_t> (h) & mask_;; i = (i + 1) & mask_)
+    {
+        if (slots_[i] == 0)
+        {
+            slots_[i] = slot;
+            return;
+        }
+    }
+}
+
+void
+KeyIndex::rehash (std::size_t slots)
+{
+    slots_.assign (slots, 0);
+    mask_ = slots - 1;
+    for (std::size_t i = 0; i < publicKeys_.size (); ++i)
+        place (hash (publicKeys_[i]), i);
+}
+
+bool
+KeyIndex::insert (ValidatorKeys const& keys)
+{
+    if (find (keys.publicKey ()))
+        return false;
+
+    if (2 * (publicKeys_.size () + 1) > slots_.size ())
+        rehash (2 * slots_.size ());
+
+    auto const position = publicKeys_.size ();
+    publicKeys_.push_back (keys.publicKey ());
+    secretKeys_.push_back (keys.secretKey ());
+    revoked_.push_back (keys.revoked () ? 1 : 0);
+
+    place (hash (keys.publicKey ()), position);
+    return true;
+}
+
+boost::optional<std::size_t>
+KeyIndex::find (PublicKey const& publicKey) const
+{
+    auto const h = hash (publicKey);
+    auto const tag = h & 0xFFFFFFFF00000000ull;
+
+    for (auto i = static_cast<std::size_t> (h) & mask_;; i = (i + 1) & mask_)
+    {
+        auto const slot = slots_[i];
+        if (slot == 0)
+            return boost::none;
+
+        if ((slot & 0xFFFFFFFF00000000ull) == tag)
+        {
+            auto const position = static_cast<std::size_t> (
+                (slot & 0xFFFFFFFFull) - 1);
+            if (publicKeys_[position] == publicKey)
+                return position;
+        }
+    }
+}
+
+boost::optional<std::string>
+KeyIndex::sign (PublicKey const& publicKey, std::string const& data) const
+{
+    auto const position = find (publicKey);
+    if (! position || revoked (*position))
+        return boost::none;
+
+    return strHex (CryptoKernels::active ().sign (
+        publicKeys_[*position], secretKeys_[*position], makeSlice (data)));
+}
+
+std::size_t
+KeyIndex::memoryUsage () const
+{
+    return publicKeys_.capacity () * sizeof (PublicKey) +
+        secretKeys_.capacity () * sizeof (SecretKey) +
+        revoked_.capacity () * sizeof (std::uint8_t) +
+        slots_.capacity () * sizeof (std::uint64_t);
+}
+
+} // ripple
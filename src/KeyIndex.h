@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_KEYINDEX_H_INCLUDED
+#define VALIDATOR_KEYS_KEYINDEX_H_INCLUDED
+
+#include <SecureArena.h>
+#include <ripple/protocol/PublicKey.h>
+#include <ripple/protocol/SecretKey.h>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace ripple {
+
+class ValidatorKeys;
+
+/** Index of many validator keys for signing on their behalf
+
+    Keys are stored in parallel arrays: public keys and revoked flags in
+    ordinary memory, secret keys in one block of the secure arena. An
+    open addressing hash table with linear probing maps public keys to
+    array positions. Each slot packs a 32 bit hash tag with the position,
+    so a probe usually touches one cache line of the table and one public
+    key. The table is kept at most half full.
+
+    Lookups and signing do not modify the index and may run concurrently.
+*/
+class KeyIndex
+{
+public:
+    explicit
+    KeyIndex (std::size_t expected = 0);
+
+    /** Adds keys to the index
+
+        @return false if keys with the same public key are already present
+    */
+    bool
+    insert (ValidatorKeys const& keys);
+
+    /** Returns the position of a public key, if present */
+    boost::optional<std::size_t>
+    find (PublicKey const& publicKey) const;
+
+    /** Signs data with the key for a public key
+
+        Revoked keys never sign.
+
+        @return hex-encoded signature, or boost::none if the key is unknown
+                or revoked
+    */
+    boost::optional<std::string>
+    sign (PublicKey const& publicKey, std::string const& data) const;
+
+    /** Returns true if the keys at a position are revoked */
+    bool
+    revoked (std::size_t position) const
+    {
+        return revoked_[position] != 0;
+    }
+
+    std::size_t
+    size () const
+    {
+        return publicKeys_.size ();
+    }
+
+    /** Returns bytes allocated for keys and the hash table */
+    std::size_t
+    memoryUsage () const;
+
+private:
+    static
+    std::uint64_t
+    hash (PublicKey const& publicKey);
+
+    void
+    rehash (std::size_t slots);
+
+    void
+    place (std::uint64_t h, std::size_t position);
+
+    std::vector<PublicKey> publicKeys_;
+    std::vector<SecretKey, SecureAllocator<SecretKey>> secretKeys_;
+    std::vector<std::uint8_t> revoked_;
+
+    // Empty slots are zero, others hold (tag << 32) | (position + 1)
+    std::vector<std::uint64_t> slots_;
+    std::size_t mask_;
+};
+
+} // ripple
+
+#endif
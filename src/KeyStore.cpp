@@ -0,0 +1,610 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyStore.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#ifndef _WIN32
+# include <cerrno>
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# ifdef __linux__
+#  include <sys/vfs.h>
+# endif
+#endif
+
+namespace ripple {
+
+namespace {
+
+class FileLock : public KeyStore::Lock
+{
+public:
+    FileLock (
+        boost::filesystem::path const& keyFile,
+        KeyFileLock::Mode mode)
+        : lock_ (keyFile, mode)
+    {
+    }
+
+private:
+    KeyFileLock lock_;
+};
+
+void
+createParentDirectory (boost::filesystem::path const& keyFile)
+{
+    using namespace boost::filesystem;
+
+    if (keyFile.parent_path().empty())
+        return;
+
+    boost::system::error_code ec;
+    if (! exists (keyFile.parent_path()))
+        create_directories (keyFile.parent_path(), ec);
+
+    if (ec || ! is_directory (keyFile.parent_path()))
+        throw std::runtime_error ("Cannot create directory: " +
+                keyFile.parent_path().string());
+}
+
+#ifndef _WIN32
+// Key files are small, so size the buffer once and read it whole
+std::string
+readAll (int fd)
+{
+    std::string contents;
+    struct stat st;
+    if (fstat (fd, &st) == 0 && S_ISREG (st.st_mode))
+        contents.resize (static_cast<std::size_t> (st.st_size));
+
+    std::size_t done = 0;
+    while (done < contents.size ())
+    {
+        auto const n = ::read (fd, &contents[done], contents.size () - done);
+        if (n > 0)
+            done += n;
+        else if (n == 0 || errno != EINTR)
+            break;
+    }
+    contents.resize (done);
+    return contents;
+}
+#endif
+
+}
+
+//------------------------------------------------------------------------------
+
+std::vector<boost::optional<std::string>>
+KeyStore::loadBatch (std::vector<boost::filesystem::path> const& keyFiles)
+{
+    std::vector<boost::optional<std::string>> contents;
+    contents.reserve (keyFiles.size ());
+    for (auto const& keyFile : keyFiles)
+    {
+        try
+        {
+            contents.emplace_back (load (keyFile));
+        }
+        catch (std::runtime_error const&)
+        {
+            contents.emplace_back ();
+        }
+    }
+    return contents;
+}
+
+//------------------------------------------------------------------------------
+
+std::string
+FileKeyStore::load (boost::filesystem::path const& keyFile)
+{
+    std::ifstream ifs (keyFile.c_str (), std::ios::in);
+
+    if (! ifs)
+        throw std::runtime_error (
+            "Failed to open key file: " + keyFile.string());
+
+    std::stringstream ss;
+    ss << ifs.rdbuf ();
+    return ss.str ();
+}
+
+std::vector<boost::optional<std::string>>
+FileKeyStore::loadBatch (std::vector<boost::filesystem::path> const& keyFiles)
+{
+#ifdef _WIN32
+    return KeyStore::loadBatch (keyFiles);
+#else
+    std::vector<boost::optional<std::string>> contents (keyFiles.size ());
+
+    // Small enough that every pool thread may hold a window open
+    std::size_t const window = 32;
+
+    std::vector<std::pair<std::size_t, int>> opened;
+    opened.reserve (window);
+    std::size_t next = 0;
+    while (next < keyFiles.size ())
+    {
+        opened.clear ();
+        while (next < keyFiles.size () && opened.size () < window)
+        {
+            int fd;
+            do
+                fd = ::open (keyFiles[next].c_str (), O_RDONLY | O_CLOEXEC);
+            while (fd == -1 && errno == EINTR);
+
+            if (fd == -1)
+            {
+                // Out of descriptors: read those open, then try again
+                if ((errno == EMFILE || errno == ENFILE) && ! opened.empty ())
+                    break;
+                ++next;
+                continue;
+            }
+
+# ifdef POSIX_FADV_WILLNEED
+            ::posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED);
+# endif
+            opened.emplace_back (next++, fd);
+        }
+
+        for (auto const& file : opened)
+        {
+            contents[file.first] = readAll (file.second);
+            ::close (file.second);
+        }
+    }
+    return contents;
+#endif
+}
+
+void
+FileKeyStore::store (
+    boost::filesystem::path const& keyFile,
+    std::string const& contents)
+{
+    createParentDirectory (keyFile);
+
+    std::ofstream o (keyFile.string (), std::ios_base::trunc);
+    if (o.fail())
+        throw std::runtime_error ("Cannot open key file: " +
+            keyFile.string());
+
+    o << contents;
+}
+
+bool
+FileKeyStore::exists (boost::filesystem::path const& keyFile)
+{
+    return boost::filesystem::exists (keyFile);
+}
+
+void
+FileKeyStore::remove (boost::filesystem::path const& keyFile)
+{
+    boost::system::error_code ec;
+    boost::filesystem::remove (keyFile, ec);
+}
+
+std::vector<boost::filesystem::path>
+FileKeyStore::list (boost::filesystem::path const& dir)
+{
+    using namespace boost::filesystem;
+
+    boost::system::error_code ec;
+    std::vector<path> files;
+    for (directory_iterator it (dir, ec), end; ! ec && it != end;
+        it.increment (ec))
+    {
+        if (it->path ().extension () == ".json" &&
+                is_regular_file (it->status ()))
+            files.push_back (it->path ());
+    }
+
+    if (ec)
+        throw std::runtime_error (
+            "Cannot read key directory: " + dir.string ());
+
+    std::sort (files.begin (), files.end ());
+    return files;
+}
+
+boost::optional<std::string>
+FileKeyStore::fingerprint (boost::filesystem::path const& keyFile)
+{
+#ifdef _WIN32
+    boost::system::error_code ec;
+    auto const mtime = boost::filesystem::last_write_time (keyFile, ec);
+    auto const size = boost::filesystem::file_size (keyFile, ec);
+    if (ec)
+        return boost::none;
+    return std::to_string (mtime) + ":" + std::to_string (size);
+#else
+    struct stat st;
+    if (::stat (keyFile.c_str (), &st) != 0 || ! S_ISREG (st.st_mode))
+        return boost::none;
+
+# ifdef __APPLE__
+    auto const& mtime = st.st_mtimespec;
+# else
+    auto const& mtime = st.st_mtim;
+# endif
+    return std::to_string (st.st_dev) + ":" +
+        std::to_string (st.st_ino) + ":" +
+        std::to_string (mtime.tv_sec) + "." +
+        std::to_string (mtime.tv_nsec) + ":" +
+        std::to_string (st.st_size);
+#endif
+}
+
+void
+FileKeyStore::prepare (boost::filesystem::path const& keyFile)
+{
+    if (! keyFile.parent_path ().empty ())
+    {
+        boost::system::error_code ec;
+        create_directories (keyFile.parent_path (), ec);
+    }
+}
+
+std::unique_ptr<KeyStore::Lock>
+FileKeyStore::lock (
+    boost::filesystem::path const& keyFile,
+    KeyFileLock::Mode mode)
+{
+    return std::make_unique<FileLock> (keyFile, mode);
+}
+
+//------------------------------------------------------------------------------
+
+TmpfsKeyStore::TmpfsKeyStore (boost::filesystem::path root)
+    : root_ (std::move (root))
+{
+}
+
+boost::filesystem::path
+TmpfsKeyStore::defaultRoot ()
+{
+    boost::system::error_code ec;
+    if (boost::filesystem::is_directory ("/dev/shm", ec))
+        return "/dev/shm";
+    return boost::filesystem::temp_directory_path ();
+}
+
+bool
+TmpfsKeyStore::onTmpfs () const
+{
+#ifdef __linux__
+    struct statfs sfs;
+    return statfs (root_.c_str (), &sfs) == 0 &&
+        sfs.f_type == 0x01021994;   // TMPFS_MAGIC
+#else
+    return false;
+#endif
+}
+
+boost::filesystem::path
+TmpfsKeyStore::resolve (boost::filesystem::path const& keyFile) const
+{
+    return keyFile.is_absolute () ? keyFile : root_ / keyFile;
+}
+
+#ifdef _WIN32
+std::string
+TmpfsKeyStore::load (boost::filesystem::path const& keyFile)
+{
+    return FileKeyStore::load (resolve (keyFile));
+}
+
+void
+TmpfsKeyStore::store (
+    boost::filesystem::path const& keyFile,
+    std::string const& contents)
+{
+    FileKeyStore::store (resolve (keyFile), contents);
+}
+#else
+std::string
+TmpfsKeyStore::load (boost::filesystem::path const& keyFile)
+{
+    auto const path = resolve (keyFile);
+
+    int fd;
+    do
+        fd = ::open (path.c_str (), O_RDONLY | O_CLOEXEC);
+    while (fd == -1 && errno == EINTR);
+
+    if (fd == -1)
+        throw std::runtime_error (
+            "Failed to open key file: " + path.string());
+
+    auto contents = readAll (fd);
+    ::close (fd);
+    return contents;
+}
+
+void
+TmpfsKeyStore::store (
+    boost::filesystem::path const& keyFile,
+    std::string const& contents)
+{
+    auto const path = resolve (keyFile);
+
+    createParentDirectory (path);
+
+    int fd;
+    do
+        fd = ::open (path.c_str (),
+            O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    while (fd == -1 && errno == EINTR);
+
+    if (fd == -1)
+        throw std::runtime_error ("Cannot open key file: " +
+            path.string());
+
+    std::size_t done = 0;
+    while (done < contents.size ())
+    {
+        auto const n = ::write (fd, contents.data () + done,
+            contents.size () - done);
+        if (n > 0)
+            done += n;
+        else if (errno != EINTR)
+            break;
+    }
+
+    ::close (fd);
+
+    if (done != contents.size ())
+        throw std::runtime_error ("Cannot write key file: " +
+            path.string());
+}
+#endif
+
+std::vector<boost::optional<std::string>>
+TmpfsKeyStore::loadBatch (std::vector<boost::filesystem::path> const& keyFiles)
+{
+    return KeyStore::loadBatch (keyFiles);
+}
+
+bool
+TmpfsKeyStore::exists (boost::filesystem::path const& keyFile)
+{
+    return FileKeyStore::exists (resolve (keyFile));
+}
+
+void
+TmpfsKeyStore::remove (boost::filesystem::path const& keyFile)
+{
+    FileKeyStore::remove (resolve (keyFile));
+}
+
+std::vector<boost::filesystem::path>
+TmpfsKeyStore::list (boost::filesystem::path const& dir)
+{
+    // Return paths as callers name them, not as resolved
+    auto files = FileKeyStore::list (resolve (dir));
+    for (auto& f : files)
+        f = dir / f.filename ();
+    return files;
+}
+
+boost::optional<std::string>
+TmpfsKeyStore::fingerprint (boost::filesystem::path const& keyFile)
+{
+    return FileKeyStore::fingerprint (resolve (keyFile));
+}
+
+void
+TmpfsKeyStore::prepare (boost::filesystem::path const& keyFile)
+{
+    FileKeyStore::prepare (resolve (keyFile));
+}
+
+std::unique_ptr<KeyStore::Lock>
+TmpfsKeyStore::lock (
+    boost::filesystem::path const& keyFile,
+    KeyFileLock::Mode mode)
+{
+    return FileKeyStore::lock (resolve (keyFile), mode);
+}
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+class MemoryLock : public KeyStore::Lock
+{
+public:
+    MemoryLock (
+        std::shared_timed_mutex& m,
+        KeyFileLock::Mode mode,
+        boost::filesystem::path const& keyFile)
+        : m_ (m)
+        , mode_ (mode)
+    {
+        bool const locked = mode_ == KeyFileLock::Mode::exclusive ?
+            m_.try_lock_for (KeyFileLock::defaultTimeout) :
+            m_.try_lock_shared_for (KeyFileLock::defaultTimeout);
+
+        if (! locked)
+            throw std::runtime_error (
+                "Timed out waiting for lock on key file: " +
+                keyFile.string ());
+    }
+
+    ~MemoryLock ()
+    {
+        if (mode_ == KeyFileLock::Mode::exclusive)
+            m_.unlock ();
+        else
+            m_.unlock_shared ();
+    }
+
+private:
+    std::shared_timed_mutex& m_;
+    KeyFileLock::Mode const mode_;
+};
+
+}
+
+MemoryKeyStore::MemoryKeyStore ()
+    : id_ ([]
+        {
+            // Fingerprints may outlive the process, in a cache
+            static std::uint64_t const process = std::random_device {} ();
+            static std::atomic<std::uint64_t> instances {0};
+            return "memory:" + std::to_string (process) + ":" +
+                std::to_string (++instances);
+        }())
+{
+}
+
+std::string
+MemoryKeyStore::load (boost::filesystem::path const& keyFile)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    auto const it = files_.find (keyFile.generic_string ());
+    if (it == files_.end ())
+        throw std::runtime_error (
+            "Failed to open key file: " + keyFile.string());
+
+    return it->second;
+}
+
+void
+MemoryKeyStore::store (
+    boost::filesystem::path const& keyFile,
+    std::string const& contents)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    auto const parent = keyFile.parent_path ();
+    for (auto p = parent; ! p.empty (); p = p.parent_path ())
+    {
+        if (files_.count (p.generic_string ()))
+            throw std::runtime_error ("Cannot create directory: " +
+                parent.string());
+    }
+
+    auto const name = keyFile.generic_string ();
+    if (keyFile.filename () == "." || keyFile.filename () == ".." ||
+            dirs_.count (name))
+        throw std::runtime_error ("Cannot open key file: " +
+            keyFile.string());
+
+    for (auto p = parent; ! p.empty (); p = p.parent_path ())
+        dirs_.insert (p.generic_string ());
+
+    files_[name] = contents;
+    generations_[name] = ++writes_;
+}
+
+bool
+MemoryKeyStore::exists (boost::filesystem::path const& keyFile)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    auto const name = keyFile.generic_string ();
+    return files_.count (name) || dirs_.count (name);
+}
+
+void
+MemoryKeyStore::remove (boost::filesystem::path const& keyFile)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    files_.erase (keyFile.generic_string ());
+}
+
+boost::optional<std::string>
+MemoryKeyStore::fingerprint (boost::filesystem::path const& keyFile)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    auto const name = keyFile.generic_string ();
+    if (! files_.count (name))
+        return boost::none;
+    return id_ + ":" + std::to_string (generations_[name]);
+}
+
+std::vector<boost::filesystem::path>
+MemoryKeyStore::list (boost::filesystem::path const& dir)
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    auto const name = dir.generic_string ();
+    if (! name.empty () && ! dirs_.count (name))
+        throw std::runtime_error (
+            "Cannot read key directory: " + dir.string ());
+
+    // files_ is ordered, so the result is sorted
+    std::vector<boost::filesystem::path> files;
+    for (auto const& f : files_)
+    {
+        boost::filesystem::path const p (f.first);
+        if (p.parent_path ().generic_string () == name &&
+                p.extension () == ".json")
+            files.push_back (p);
+    }
+    return files;
+}
+
+std::unique_ptr<KeyStore::Lock>
+MemoryKeyStore::lock (
+    boost::filesystem::path const& keyFile,
+    KeyFileLock::Mode mode)
+{
+    std::shared_timed_mutex* m;
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        auto& slot = locks_[keyFile.generic_string ()];
+        if (! slot)
+            slot = std::make_unique<std::shared_timed_mutex> ();
+        m = slot.get ();
+    }
+
+    return std::make_unique<MemoryLock> (*m, mode, keyFile);
+}
+
+std::size_t
+MemoryKeyStore::size () const
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    return files_.size ();
+}
+
+//------------------------------------------------------------------------------
+
+KeyStore&
+defaultKeyStore ()
+{
+    static FileKeyStore store;
+    return store;
+}
+
+} // ripple
@@ -0,0 +1,312 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_KEYSTORE_H_INCLUDED
+#define VALIDATOR_KEYS_KEYSTORE_H_INCLUDED
+
+#include <KeyFileLock.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** Storage for key files
+
+    Key files are addressed by path, whatever the backend. All backends
+    report failures with the same messages as the file backend, so
+    callers do not need to know where keys are kept.
+*/
+class KeyStore
+{
+public:
+    /** Held for the duration of a read or read-modify-write */
+    class Lock
+    {
+    public:
+        virtual ~Lock () = default;
+    };
+
+    virtual ~KeyStore () = default;
+
+    /** Returns the contents of a key file
+
+        @throws std::runtime_error if the key file cannot be read
+    */
+    virtual
+    std::string
+    load (boost::filesystem::path const& keyFile) = 0;
+
+    /** Returns the contents of several key files
+
+        Backends may overlap the reads, so for many key files this is
+        faster than calling load for each.
+
+        @return The contents of each key file, or boost::none for those
+        that cannot be read
+    */
+    virtual
+    std::vector<boost::optional<std::string>>
+    loadBatch (std::vector<boost::filesystem::path> const& keyFiles);
+
+    /** Replaces the contents of a key file, creating its directory
+
+        @throws std::runtime_error if the directory cannot be created or
+        the key file cannot be written
+    */
+    virtual
+    void
+    store (
+        boost::filesystem::path const& keyFile,
+        std::string const& contents) = 0;
+
+    /** Returns true if the key file exists */
+    virtual
+    bool
+    exists (boost::filesystem::path const& keyFile) = 0;
+
+    /** Removes a key file if it exists */
+    virtual
+    void
+    remove (boost::filesystem::path const& keyFile) = 0;
+
+    /** Returns the JSON key files directly inside a directory, sorted
+
+        @throws std::runtime_error if the directory cannot be read
+    */
+    virtual
+    std::vector<boost::filesystem::path>
+    list (boost::filesystem::path const& dir) = 0;
+
+    /** Returns a string that changes whenever a key file is rewritten
+
+        What is decoded from a key file may be reused for as long as its
+        fingerprint is unchanged.
+
+        @return boost::none if the key file does not exist
+    */
+    virtual
+    boost::optional<std::string>
+    fingerprint (boost::filesystem::path const& keyFile) = 0;
+
+    /** Makes sure a key file's directory exists before it is locked
+
+        Errors are left for store to report.
+    */
+    virtual
+    void
+    prepare (boost::filesystem::path const& keyFile) = 0;
+
+    /** Locks a key file against concurrent updates
+
+        @throws std::runtime_error if the lock cannot be acquired
+    */
+    virtual
+    std::unique_ptr<Lock>
+    lock (
+        boost::filesystem::path const& keyFile,
+        KeyFileLock::Mode mode) = 0;
+};
+
+/** Key files on the local file system, locked with KeyFileLock */
+class FileKeyStore : public KeyStore
+{
+public:
+    std::string
+    load (boost::filesystem::path const& keyFile) override;
+
+    /** Opens a window of key files and asks the kernel to read them all
+        ahead before reading any, so their reads are queued together */
+    std::vector<boost::optional<std::string>>
+    loadBatch (std::vector<boost::filesystem::path> const& keyFiles)
+        override;
+
+    void
+    store (
+        boost::filesystem::path const& keyFile,
+        std::string const& contents) override;
+
+    bool
+    exists (boost::filesystem::path const& keyFile) override;
+
+    void
+    remove (boost::filesystem::path const& keyFile) override;
+
+    std::vector<boost::filesystem::path>
+    list (boost::filesystem::path const& dir) override;
+
+    /** Device, inode, modification time and size of the key file */
+    boost::optional<std::string>
+    fingerprint (boost::filesystem::path const& keyFile) override;
+
+    void
+    prepare (boost::filesystem::path const& keyFile) override;
+
+    std::unique_ptr<Lock>
+    lock (
+        boost::filesystem::path const& keyFile,
+        KeyFileLock::Mode mode) override;
+};
+
+/** Key files on a RAM backed file system
+
+    Relative key file paths are resolved under a root directory on tmpfs,
+    /dev/shm by default. Files are read and written with a single system
+    call each and the iostream layer is bypassed. Nothing is synced, as
+    there is no disk to sync to.
+
+    Absolute paths are used as they are, so a root can be given by
+    simply passing absolute paths under any tmpfs mount.
+*/
+class TmpfsKeyStore : public FileKeyStore
+{
+public:
+    explicit
+    TmpfsKeyStore (boost::filesystem::path root = defaultRoot ());
+
+    /** Returns /dev/shm if present, otherwise the temp directory */
+    static
+    boost::filesystem::path
+    defaultRoot ();
+
+    /** Returns true if the root is on a tmpfs mount */
+    bool
+    onTmpfs () const;
+
+    boost::filesystem::path const&
+    root () const
+    {
+        return root_;
+    }
+
+    std::string
+    load (boost::filesystem::path const& keyFile) override;
+
+    /** Loads each key file in turn, as there is no disk to read ahead */
+    std::vector<boost::optional<std::string>>
+    loadBatch (std::vector<boost::filesystem::path> const& keyFiles)
+        override;
+
+    void
+    store (
+        boost::filesystem::path const& keyFile,
+        std::string const& contents) override;
+
+    bool
+    exists (boost::filesystem::path const& keyFile) override;
+
+    void
+    remove (boost::filesystem::path const& keyFile) override;
+
+    std::vector<boost::filesystem::path>
+    list (boost::filesystem::path const& dir) override;
+
+    boost::optional<std::string>
+    fingerprint (boost::filesystem::path const& keyFile) override;
+
+    void
+    prepare (boost::filesystem::path const& keyFile) override;
+
+    std::unique_ptr<Lock>
+    lock (
+        boost::filesystem::path const& keyFile,
+        KeyFileLock::Mode mode) override;
+
+private:
+    boost::filesystem::path
+    resolve (boost::filesystem::path const& keyFile) const;
+
+    boost::filesystem::path const root_;
+};
+
+/** Key files held in process memory
+
+    Intended for tests and bulk pipelines that never need keys on disk.
+    Directories are implied by the key files stored beneath them.
+*/
+class MemoryKeyStore : public KeyStore
+{
+public:
+    MemoryKeyStore ();
+
+    std::string
+    load (boost::filesystem::path const& keyFile) override;
+
+    void
+    store (
+        boost::filesystem::path const& keyFile,
+        std::string const& contents) override;
+
+    bool
+    exists (boost::filesystem::path const& keyFile) override;
+
+    void
+    remove (boost::filesystem::path const& keyFile) override;
+
+    std::vector<boost::filesystem::path>
+    list (boost::filesystem::path const& dir) override;
+
+    /** Unique to this store and the number of writes it has seen */
+    boost::optional<std::string>
+    fingerprint (boost::filesystem::path const& keyFile) override;
+
+    void
+    prepare (boost::filesystem::path const&) override
+    {
+    }
+
+    std::unique_ptr<Lock>
+    lock (
+        boost::filesystem::path const& keyFile,
+        KeyFileLock::Mode mode) override;
+
+    /** Returns the number of key files stored */
+    std::size_t
+    size () const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, std::string> files_;
+    std::string const id_;
+
+    // Write count when each key file was last stored
+    std::map<std::string, std::uint64_t> generations_;
+    std::uint64_t writes_ = 0;
+    std::set<std::string> dirs_;
+
+    // Per key file locks, created on first use and never released
+    std::map<std::string,
+        std::unique_ptr<std::shared_timed_mutex>> locks_;
+};
+
+/** Returns the store used when none is given: the local file system */
+KeyStore&
+defaultKeyStore ();
+
+} // ripple
+
+#endif
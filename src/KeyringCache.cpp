@@ -0,0 +1,310 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyringCache.h>
+#include <ripple/protocol/PublicKey.h>
+#include <boost/filesystem/operations.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <mutex>
+
+#ifdef __linux__
+#include <linux/keyctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ripple {
+
+struct KeyringCache::Entries
+{
+    struct Entry
+    {
+        std::string fingerprint;
+        std::chrono::steady_clock::time_point expires;
+        ValidatorKeys keys;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+};
+
+namespace {
+
+std::string
+description (boost::filesystem::path const& keyFile)
+{
+    return "validator-keys:" + boost::filesystem::absolute (keyFile).string ();
+}
+
+} // namespace
+
+#ifdef __linux__
+namespace {
+
+// Key permissions from keyutils.h, which is not always installed
+std::uint32_t constexpr possessorAll = 0x3f000000;
+std::uint32_t constexpr userAll = 0x003f0000;
+
+// Version, fingerprint, revoked flag, sequence, public and secret key,
+// then how tokens were issued
+std::uint8_t constexpr payloadVersion = 2;
+std::size_t constexpr maxFingerprint = 255;
+std::size_t constexpr maxPayload = 4096;
+
+// First and last sequence, key type and source of each token key range
+std::size_t constexpr rangeSize = 10;
+
+std::uint32_t
+read32 (std::uint8_t const* p)
+{
+    return (std::uint32_t (p[0]) << 24) | (std::uint32_t (p[1]) << 16) |
+        (std::uint32_t (p[2]) << 8) | std::uint32_t (p[3]);
+}
+
+void
+append32 (SecureString& s, std::uint32_t v)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        s.push_back (static_cast<char> (v >> shift));
+}
+
+long
+keyringId (KeyringCache::Keyring keyring)
+{
+    return keyring == KeyringCache::Keyring::session ?
+        KEY_SPEC_SESSION_KEYRING : KEY_SPEC_USER_KEYRING;
+}
+
+long
+search (long keyring, std::string const& description)
+{
+    return syscall (SYS_keyctl, KEYCTL_SEARCH, keyring, "user",
+        description.c_str (), 0);
+}
+
+} // namespace
+#endif
+
+KeyringCache::KeyringCache (std::chrono::seconds ttl, Keyring keyring)
+    : ttl_ (ttl)
+    , keyring_ (keyring)
+{
+    if (keyring_ == Keyring::process)
+        entries_ = std::make_shared<Entries> ();
+}
+
+bool
+KeyringCache::available ()
+{
+#ifdef __linux__
+    static bool const result = syscall (SYS_keyctl,
+        KEYCTL_GET_KEYRING_ID, KEY_SPEC_USER_KEYRING, 0) >= 0;
+    return result;
+#else
+    return false;
+#endif
+}
+
+boost::optional<ValidatorKeys>
+KeyringCache::load (
+    boost::filesystem::path const& keyFile,
+    std::string const& fingerprint) const
+{
+    if (entries_)
+    {
+        std::lock_guard<std::mutex> lock (entries_->mutex);
+        auto const iter = entries_->entries.find (description (keyFile));
+        if (iter == entries_->entries.end () ||
+                iter->second.fingerprint != fingerprint ||
+                iter->second.expires <= std::chrono::steady_clock::now ())
+            return boost::none;
+        return iter->second.keys;
+    }
+
+#ifdef __linux__
+    auto const id = search (keyringId (keyring_), description (keyFile));
+    if (id < 0)
+        return boost::none;
+
+    SecureString payload (maxPayload, '\0');
+    auto const size = syscall (SYS_keyctl, KEYCTL_READ, id,
+        &payload[0], payload.size ());
+    if (size < 0 || static_cast<std::size_t> (size) > payload.size ())
+        return boost::none;
+
+    auto p = reinterpret_cast<std::uint8_t const*> (payload.data ());
+    auto const end = p + size;
+    auto const have = [&](std::size_t n)
+    {
+        return static_cast<std::size_t> (end - p) >= n;
+    };
+
+    if (! have (3) || p[0] != payloadVersion)
+        return boost::none;
+    std::size_t const fingerprintSize = (p[1] << 8) | p[2];
+    p += 3;
+
+    // A stale entry is left to expire or be replaced
+    if (! have (fingerprintSize) || fingerprint.size () != fingerprintSize ||
+            ! std::equal (fingerprint.begin (), fingerprint.end (), p))
+        return boost::none;
+    p += fingerprintSize;
+
+    if (! have (6))
+        return boost::none;
+    bool const revoked = p[0] != 0;
+    std::uint32_t const sequence = read32 (p + 1);
+    std::size_t const publicSize = p[5];
+    p += 6;
+
+    if (! have (publicSize + 32 + 2))
+        return boost::none;
+    Slice const publicSlice (p, publicSize);
+    auto const keyType = publicKeyType (publicSlice);
+    if (! keyType)
+        return boost::none;
+    SecretKey const secretKey (Slice (p + publicSize, 32));
+    p += publicSize + 32;
+
+    std::size_t const rangeCount = (p[0] << 8) | p[1];
+    p += 2;
+    if (static_cast<std::size_t> (end - p) != rangeCount * rangeSize)
+        return boost::none;
+
+    std::vector<TokenKeyRange> tokenKeys;
+    tokenKeys.reserve (rangeCount);
+    for (; p != end; p += rangeSize)
+    {
+        TokenKeyRange range;
+        range.first = read32 (p);
+        range.last = read32 (p + 4);
+        if (p[8] > 1 || p[9] > 1)
+            return boost::none;
+        range.keyType = p[8] ? KeyType::ed25519 : KeyType::secp256k1;
+        range.source = p[9] ?
+            TokenKeySource::derived : TokenKeySource::random;
+        tokenKeys.push_back (range);
+    }
+    return ValidatorKeys (*keyType, secretKey, PublicKey (publicSlice),
+        sequence, revoked, std::move (tokenKeys));
+#else
+    return boost::none;
+#endif
+}
+
+void
+KeyringCache::store (
+    boost::filesystem::path const& keyFile,
+    std::string const& fingerprint,
+    ValidatorKeys const& keys) const
+{
+    if (entries_)
+    {
+        using clock_type = std::chrono::steady_clock;
+
+        if (ttl_.count () <= 0)
+            return;
+
+        // A time to live of seconds::max () never expires
+        auto const now = clock_type::now ();
+        auto const expires = ttl_ < std::chrono::duration_cast<
+            std::chrono::seconds> (clock_type::time_point::max () - now) ?
+                now + ttl_ : clock_type::time_point::max ();
+
+        auto const name = description (keyFile);
+        std::lock_guard<std::mutex> lock (entries_->mutex);
+        entries_->entries.erase (name);
+        entries_->entries.emplace (name,
+            Entries::Entry {fingerprint, expires, keys});
+        return;
+    }
+
+#ifdef __linux__
+    auto const& publicKey = keys.publicKey ();
+    auto const& secretKey = keys.secretKey ();
+    auto const ranges = keys.tokenKeyRanges ();
+    if (ttl_.count () <= 0 || fingerprint.size () > maxFingerprint ||
+            secretKey.size () != 32 ||
+            3 + fingerprint.size () + 6 + publicKey.size () + 32 + 2 +
+                ranges.size () * rangeSize > maxPayload)
+        return;
+
+    SecureString payload;
+    payload.reserve (maxPayload);
+    payload.push_back (static_cast<char> (payloadVersion));
+    payload.push_back (static_cast<char> (fingerprint.size () >> 8));
+    payload.push_back (static_cast<char> (fingerprint.size ()));
+    payload.append (fingerprint.data (), fingerprint.size ());
+    payload.push_back (keys.revoked () ? 1 : 0);
+    append32 (payload, keys.tokenSequence ());
+    payload.push_back (static_cast<char> (publicKey.size ()));
+    payload.append (reinterpret_cast<char const*> (publicKey.data ()),
+        publicKey.size ());
+    payload.append (reinterpret_cast<char const*> (secretKey.data ()),
+        secretKey.size ());
+    payload.push_back (static_cast<char> (ranges.size () >> 8));
+    payload.push_back (static_cast<char> (ranges.size ()));
+    for (auto const& range : ranges)
+    {
+        append32 (payload, range.first);
+        append32 (payload, range.last);
+        payload.push_back (range.keyType == KeyType::ed25519 ? 1 : 0);
+        payload.push_back (range.source == TokenKeySource::derived ? 1 : 0);
+    }
+
+    auto const id = syscall (SYS_add_key, "user",
+        description (keyFile).c_str (), payload.data (), payload.size (),
+        keyringId (keyring_));
+    if (id < 0)
+        return;
+
+    auto const timeout = static_cast<unsigned> (std::min<long long> (
+        ttl_.count (), std::numeric_limits<unsigned>::max ()));
+    if (syscall (SYS_keyctl, KEYCTL_SETPERM, id, possessorAll | userAll) < 0 ||
+            syscall (SYS_keyctl, KEYCTL_SET_TIMEOUT, id, timeout) < 0)
+        syscall (SYS_keyctl, KEYCTL_UNLINK, id, keyringId (keyring_));
+#endif
+}
+
+void
+KeyringCache::invalidate (boost::filesystem::path const& keyFile) const
+{
+    if (entries_)
+    {
+        std::lock_guard<std::mutex> lock (entries_->mutex);
+        entries_->entries.erase (description (keyFile));
+        return;
+    }
+
+#ifdef __linux__
+    auto const id = search (keyringId (keyring_), description (keyFile));
+    if (id < 0)
+        return;
+
+    // Kernels before 3.5 cannot invalidate keys
+    if (syscall (SYS_keyctl, KEYCTL_INVALIDATE, id) < 0)
+        syscall (SYS_keyctl, KEYCTL_UNLINK, id, keyringId (keyring_));
+#endif
+}
+
+} // ripple
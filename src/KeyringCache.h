@@ -0,0 +1,99 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_KEYRINGCACHE_H_INCLUDED
+#define VALIDATOR_KEYS_KEYRINGCACHE_H_INCLUDED
+
+#include <ValidatorKeys.h>
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+#include <chrono>
+#include <memory>
+#include <string>
+
+namespace ripple {
+
+/** Cache of decoded key files in the Linux kernel keyring
+
+    Each entry is a "user" key described by the absolute key file path.
+    It holds the key file fingerprint (see KeyStore::fingerprint) with
+    the key type, revoked flag, token sequence and key pair, and expires
+    after a time to live. An entry is only used while the fingerprint of
+    the key file still matches, so reusing it skips reading, parsing and
+    decoding the key file without missing a change to it.
+
+    Entries are readable by processes of the same user, as the key file
+    is. Every operation is best effort: when the keyring is unavailable,
+    entries are simply never found. On other platforms the cache is
+    always empty, except for the process keyring, which is held in the
+    memory of the cache itself.
+*/
+class KeyringCache
+{
+public:
+    /** Keyring holding the entries */
+    enum class Keyring
+    {
+        /// Shared by every session of the user
+        user,
+
+        /// Dropped when the login session ends
+        session,
+
+        /// Held by this object and its copies, for a process that runs
+        /// many commands. Available on every platform.
+        process
+    };
+
+    KeyringCache (std::chrono::seconds ttl, Keyring keyring = Keyring::user);
+
+    /** Returns true if this process can use the kernel keyring */
+    static
+    bool
+    available ();
+
+    /** Returns the keys cached for a key file with a given fingerprint */
+    boost::optional<ValidatorKeys>
+    load (boost::filesystem::path const& keyFile,
+        std::string const& fingerprint) const;
+
+    /** Caches the keys read from a key file with a given fingerprint */
+    void
+    store (boost::filesystem::path const& keyFile,
+        std::string const& fingerprint,
+        ValidatorKeys const& keys) const;
+
+    /** Removes the entry for a key file, if any */
+    void
+    invalidate (boost::filesystem::path const& keyFile) const;
+
+private:
+    struct Entries;
+
+    std::chrono::seconds ttl_;
+    Keyring keyring_;
+
+    // Entries of the process keyring
+    std::shared_ptr<Entries> entries_;
+};
+
+} // ripple
+
+#endif
@@ -0,0 +1,413 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <Manifest.h>
+#include <Parallel.h>
+#include <Sha512HalfBatch.h>
+#include <ripple/protocol/HashPrefix.h>
+#include <ripple/protocol/Sign.h>
+#include <ripple/protocol/STObject.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace ripple {
+
+namespace {
+
+boost::optional<STObject>
+deserialize (std::string const& serialized)
+{
+    try
+    {
+        STObject st (sfGeneric);
+        SerialIter sit (serialized.data (), serialized.size ());
+        st.set (sit);
+        return st;
+    }
+    catch (std::exception const&)
+    {
+        return boost::none;
+    }
+}
+
+// Returns the key in a field, checked first as PublicKey would otherwise
+// reject it with LogicError
+boost::optional<PublicKey>
+publicKeyField (STObject const& st, SF_Blob const& field)
+{
+    if (! st.isFieldPresent (field))
+        return boost::none;
+    auto const blob = st.getFieldVL (field);
+    if (! publicKeyType (makeSlice (blob)))
+        return boost::none;
+    return PublicKey (makeSlice (blob));
+}
+
+boost::optional<Manifest>
+fields (STObject const& st)
+{
+    auto const masterKey = publicKeyField (st, sfPublicKey);
+    auto const sequence = get (st, sfSequence);
+    if (! masterKey || ! sequence || ! st.isFieldPresent (sfMasterSignature))
+        return boost::none;
+
+    Manifest manifest { *masterKey, boost::none, *sequence };
+    if (st.isFieldPresent (sfSigningPubKey))
+    {
+        manifest.signingKey = publicKeyField (st, sfSigningPubKey);
+        if (! manifest.signingKey || ! st.isFieldPresent (sfSignature))
+            return boost::none;
+    }
+    else if (! manifest.revoked ())
+    {
+        return boost::none;
+    }
+
+    return manifest;
+}
+
+// Manifests hashed by one call to sha512HalfBatch
+std::size_t const manifestsPerBatch = 64;
+
+bool
+isSecp256k1 (PublicKey const& publicKey)
+{
+    return publicKeyType (publicKey) == KeyType::secp256k1;
+}
+
+// Field codes, type << 16 | field, of the fields of canonical manifests
+std::uint32_t const sequenceCode = 2 << 16 | 4;
+std::uint32_t const publicKeyCode = 7 << 16 | 1;
+std::uint32_t const signingPubKeyCode = 7 << 16 | 3;
+std::uint32_t const signatureCode = 7 << 16 | 6;
+std::uint32_t const masterSignatureCode = 7 << 16 | 18;
+
+// Reads a field header as SerialIter::getFieldID does
+bool
+readFieldCode (std::uint8_t const*& p, std::uint8_t const* end,
+    std::uint32_t& code)
+{
+    if (p == end)
+        return false;
+    std::uint32_t type = *p >> 4;
+    std::uint32_t field = *p & 0x0f;
+    ++p;
+
+    if (type == 0)
+    {
+        if (p == end || *p < 16)
+            return false;
+        type = *p++;
+    }
+    if (field == 0)
+    {
+        if (p == end || *p < 16)
+            return false;
+        field = *p++;
+    }
+
+    code = type << 16 | field;
+    return true;
+}
+
+// Reads a variable length prefix as SerialIter::getVLDataLength does
+bool
+readLength (std::uint8_t const*& p, std::uint8_t const* end,
+    std::size_t& length)
+{
+    if (p == end)
+        return false;
+    std::size_t const b1 = *p++;
+
+    if (b1 <= 192)
+    {
+        length = b1;
+    }
+    else if (b1 <= 240)
+    {
+        if (p == end)
+            return false;
+        length = 193 + (b1 - 193) * 256 + p[0];
+        p += 1;
+    }
+    else if (b1 <= 254)
+    {
+        if (end - p < 2)
+            return false;
+        length = 12481 + (b1 - 241) * 65536 + p[0] * 256 + p[1];
+        p += 2;
+    }
+    else
+    {
+        return false;
+    }
+
+    return static_cast<std::size_t> (end - p) >= length;
+}
+
+} // namespace
+
+boost::optional<Manifest>
+deserializeManifest (std::string const& serialized)
+{
+    auto const st = deserialize (serialized);
+    if (! st)
+        return boost::none;
+    return fields (*st);
+}
+
+bool
+verifyManifest (std::string const& serialized)
+{
+    auto const st = deserialize (serialized);
+    if (! st)
+        return false;
+
+    auto const manifest = fields (*st);
+    if (! manifest)
+        return false;
+
+    if (! verify (*st, HashPrefix::manifest, manifest->masterKey,
+            sfMasterSignature))
+        return false;
+
+    return ! manifest->signingKey ||
+        verify (*st, HashPrefix::manifest, *manifest->signingKey);
+}
+
+ManifestDecoder::ManifestDecoder (std::string serialized)
+    : serialized_ (std::move (serialized))
+{
+    if (! decodeCanonical ())
+        manifest_ = deserializeManifest (serialized_);
+}
+
+bool
+ManifestDecoder::decodeCanonical ()
+{
+    auto const begin =
+        reinterpret_cast<std::uint8_t const*> (serialized_.data ());
+    auto const end = begin + serialized_.size ();
+
+    std::uint32_t sequence = 0;
+    bool hasSequence = false;
+    Slice masterKey;
+    Slice signingKey;
+    bool hasSigningKey = false;
+    std::size_t signedSize = 0;
+    std::uint32_t last = 0;
+
+    for (auto p = begin; p != end;)
+    {
+        auto const header = p;
+        std::uint32_t code;
+        if (! readFieldCode (p, end, code) || code <= last)
+            return false;
+        last = code;
+
+        if (code == sequenceCode)
+        {
+            if (end - p < 4)
+                return false;
+            sequence = std::uint32_t (p[0]) << 24 |
+                std::uint32_t (p[1]) << 16 | std::uint32_t (p[2]) << 8 |
+                std::uint32_t (p[3]);
+            p += 4;
+            hasSequence = true;
+            continue;
+        }
+
+        std::size_t size;
+        if ((code >> 16) != 7 || ! readLength (p, end, size))
+            return false;
+        Slice const value (p, size);
+        p += size;
+
+        if (code == publicKeyCode)
+        {
+            masterKey = value;
+        }
+        else if (code == signingPubKeyCode)
+        {
+            signingKey = value;
+            hasSigningKey = true;
+        }
+        else if (code == signatureCode || code == masterSignatureCode)
+        {
+            // Field code order puts nothing but signing fields after
+            // the first of them
+            if (signedSize == 0)
+                signedSize = header - begin;
+
+            auto const offset =
+                static_cast<std::size_t> (value.data () - begin);
+            if (code == signatureCode)
+            {
+                signature_ = offset;
+                signatureSize_ = size;
+            }
+            else
+            {
+                masterSignature_ = offset;
+                masterSignatureSize_ = size;
+            }
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (! hasSequence || ! publicKeyType (masterKey) || masterSignature_ == 0)
+        return false;
+
+    Manifest manifest { PublicKey (masterKey), boost::none, sequence };
+    if (hasSigningKey)
+    {
+        if (! publicKeyType (signingKey) || signature_ == 0)
+            return false;
+        manifest.signingKey.emplace (signingKey);
+    }
+    else if (! manifest.revoked ())
+    {
+        return false;
+    }
+
+    manifest_ = manifest;
+    signedSize_ = signedSize;
+    return true;
+}
+
+bool
+ManifestDecoder::verify () const
+{
+    return check (nullptr);
+}
+
+bool
+ManifestDecoder::verify (uint256 const& digest) const
+{
+    return check (&digest);
+}
+
+Slice
+ManifestDecoder::signedFields () const
+{
+    if (! manifest_ || signedSize_ == 0)
+        return Slice ();
+    return Slice (serialized_.data (), signedSize_);
+}
+
+bool
+ManifestDecoder::check (uint256 const* digest) const
+{
+    if (! manifest_)
+        return false;
+
+    if (signedSize_ == 0)
+        return verifyManifest (serialized_);
+
+    // What is signed is the prefix followed by every field that is not a
+    // signing field
+    std::uint32_t const prefix = HashPrefix::manifest;
+    std::vector<std::uint8_t> message (4 + signedSize_);
+    message[0] = static_cast<std::uint8_t> (prefix >> 24);
+    message[1] = static_cast<std::uint8_t> (prefix >> 16);
+    message[2] = static_cast<std::uint8_t> (prefix >> 8);
+    message[3] = static_cast<std::uint8_t> (prefix);
+    std::memcpy (&message[4], serialized_.data (), signedSize_);
+
+    auto const data =
+        reinterpret_cast<std::uint8_t const*> (serialized_.data ());
+
+    // ripple::verify hashes the message for secp256k1 keys, which the
+    // digest saves
+    auto const verifySignature = [&](PublicKey const& publicKey,
+        std::size_t offset, std::size_t size)
+    {
+        Slice const signature (data + offset, size);
+        if (digest && isSecp256k1 (publicKey))
+            return verifyDigest (publicKey, *digest, signature, false);
+        return ripple::verify (publicKey, makeSlice (message), signature,
+            false);
+    };
+
+    if (! verifySignature (manifest_->masterKey,
+            masterSignature_, masterSignatureSize_))
+        return false;
+
+    return ! manifest_->signingKey ||
+        verifySignature (*manifest_->signingKey, signature_, signatureSize_);
+}
+
+std::vector<char>
+verifyManifests (std::vector<ManifestDecoder const*> const& decoders,
+    unsigned threads)
+{
+    std::uint32_t const prefix = HashPrefix::manifest;
+    std::uint8_t const prefixBytes[] = {
+        static_cast<std::uint8_t> (prefix >> 24),
+        static_cast<std::uint8_t> (prefix >> 16),
+        static_cast<std::uint8_t> (prefix >> 8),
+        static_cast<std::uint8_t> (prefix) };
+
+    std::vector<char> valid (decoders.size (), 0);
+    auto const batches =
+        (decoders.size () + manifestsPerBatch - 1) / manifestsPerBatch;
+    parallelFor (batches, threads, 1, [&](std::size_t batch)
+    {
+        auto const first = batch * manifestsPerBatch;
+        auto const last =
+            std::min (first + manifestsPerBatch, decoders.size ());
+
+        // Only manifests with a secp256k1 key need the digest
+        std::array<std::size_t, manifestsPerBatch> hashed;
+        std::array<Slice, manifestsPerBatch> bodies;
+        std::array<uint256, manifestsPerBatch> digests;
+        std::size_t count = 0;
+        for (auto i = first; i < last; ++i)
+        {
+            auto const& manifest = decoders[i]->manifest ();
+            auto const body = decoders[i]->signedFields ();
+            if (body.empty () || (! isSecp256k1 (manifest->masterKey) &&
+                    ! (manifest->signingKey &&
+                        isSecp256k1 (*manifest->signingKey))))
+                continue;
+            hashed[count] = i;
+            bodies[count] = body;
+            ++count;
+        }
+        sha512HalfBatch (Slice (prefixBytes, sizeof (prefixBytes)),
+            bodies.data (), digests.data (), count);
+
+        std::size_t next = 0;
+        for (auto i = first; i < last; ++i)
+        {
+            if (next < count && hashed[next] == i)
+                valid[i] = decoders[i]->verify (digests[next++]);
+            else
+                valid[i] = decoders[i]->verify ();
+        }
+    });
+    return valid;
+}
+
+} // ripple
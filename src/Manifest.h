@@ -0,0 +1,162 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_MANIFEST_H_INCLUDED
+#define VALIDATOR_KEYS_MANIFEST_H_INCLUDED
+
+#include <ripple/basics/base_uint.h>
+#include <ripple/basics/Slice.h>
+#include <ripple/protocol/PublicKey.h>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** Fields of a validator manifest
+
+    A manifest binds an ephemeral signing key to a master key, and is
+    signed by both. A revocation is a manifest with the highest sequence
+    and no signing key, signed only by the master key.
+*/
+struct Manifest
+{
+    PublicKey masterKey;
+    boost::optional<PublicKey> signingKey;
+    std::uint32_t sequence;
+
+    bool
+    revoked () const
+    {
+        return sequence == std::numeric_limits<std::uint32_t>::max ();
+    }
+};
+
+/** Returns the fields of a serialized manifest
+
+    Signatures are not checked.
+
+    @return boost::none if the manifest is malformed
+*/
+boost::optional<Manifest>
+deserializeManifest (std::string const& serialized);
+
+/** Returns true if the signatures of a serialized manifest verify
+
+    The master key must have signed the manifest, and so must the
+    signing key, if there is one.
+*/
+bool
+verifyManifest (std::string const& serialized);
+
+/** A serialized manifest, decoded once and checked on demand
+
+    The result is always that of deserializeManifest and verifyManifest,
+    but a manifest in canonical form is read in place rather than built
+    into an STObject. Canonical form has only the fields rippled and this
+    tool write, in field code order, so the signing fields come last and
+    the signed data is everything before them. Every other manifest is
+    handed to deserializeManifest and verifyManifest.
+*/
+class ManifestDecoder
+{
+public:
+    explicit
+    ManifestDecoder (std::string serialized);
+
+    /** Returns the serialized manifest */
+    std::string const&
+    serialized () const
+    {
+        return serialized_;
+    }
+
+    /** Returns the fields of the manifest
+
+        @return boost::none if the manifest is malformed
+    */
+    boost::optional<Manifest> const&
+    manifest () const
+    {
+        return manifest_;
+    }
+
+    /** Returns true if the signatures of the manifest verify */
+    bool
+    verify () const;
+
+    /** Returns true if the signatures of the manifest verify
+
+        @param digest SHA-512Half of the manifest prefix followed by
+                      signedFields (), which secp256k1 signatures are
+                      checked against instead of hashing again
+    */
+    bool
+    verify (uint256 const& digest) const;
+
+    /** Returns the signed fields, without the manifest prefix
+
+        @return An empty slice if the manifest is malformed or not in
+                canonical form
+    */
+    Slice
+    signedFields () const;
+
+private:
+    std::string serialized_;
+    boost::optional<Manifest> manifest_;
+
+    // Bytes before the signing fields, or zero if not canonical
+    std::size_t signedSize_ = 0;
+
+    // Offsets and sizes of the signatures in serialized_
+    std::size_t signature_ = 0;
+    std::size_t signatureSize_ = 0;
+    std::size_t masterSignature_ = 0;
+    std::size_t masterSignatureSize_ = 0;
+
+    bool
+    decodeCanonical ();
+
+    bool
+    check (uint256 const* digest) const;
+};
+
+/** Checks the signatures of many decoded manifests
+
+    The result for each manifest is that of ManifestDecoder::verify.
+    Both keys sign the same data, so the digest secp256k1 signatures
+    are checked against is computed once for each manifest in canonical
+    form, several manifests at a time with sha512HalfBatch.
+
+    @param threads Threads to check signatures with, or zero for one
+                   per core
+
+    @return Nonzero for each manifest whose signatures verify
+*/
+std::vector<char>
+verifyManifests (std::vector<ManifestDecoder const*> const& decoders,
+    unsigned threads = 0);
+
+} // ripple
+
+#endif
@@ -0,0 +1,213 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <ManifestReducer.h>
+#include <Manifest.h>
+#include <Parallel.h>
+#include <beast/core/detail/base64.hpp>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+namespace ripple {
+
+ManifestReducer::ManifestReducer (unsigned threads)
+    : threads_ (threads)
+    , mask_ (0)
+{
+    rehash (16);
+}
+
+ManifestReducer::Key
+ManifestReducer::keyOf (PublicKey const& publicKey)
+{
+    Key key;
+    std::memcpy (key.data (), publicKey.data (), key.size ());
+    return key;
+}
+
+std::uint64_t
+ManifestReducer::hash (Key const& key)
+{
+    // Past the type prefix, public keys are uniformly distributed, so a
+    // multiplicative mix of eight of their bytes is enough.
+    std::uint64_t h;
+    std::memcpy (&h, key.data () + 1, sizeof (h));
+    h *= 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+void
+ManifestReducer::place (std::uint64_t h, std::size_t position)
+{
+    auto const slot = (h & 0xFFFFFFFF00000000ull) | (position + 1);
+    for (auto i = static_cast<std::size_t> (h) & mask_;; i = (i + 1) & mask_)
+    {
+        if (slots_[i] == 0)
+        {
+            slots_[i] = slot;
+            return;
+        }
+    }
+}
+
+void
+ManifestReducer::rehash (std::size_t slots)
+{
+    slots_.assign (slots, 0);
+    mask_ = slots - 1;
+    for (std::size_t i = 0; i < keys_.size (); ++i)
+        place (hash (keys_[i]), i);
+}
+
+boost::optional<std::size_t>
+ManifestReducer::find (Key const& key) const
+{
+    auto const h = hash (key);
+    auto const tag = h & 0xFFFFFFFF00000000ull;
+
+    for (auto i = static_cast<std::size_t> (h) & mask_;; i = (i + 1) & mask_)
+    {
+        auto const slot = slots_[i];
+        if (slot == 0)
+            return boost::none;
+
+        if ((slot & 0xFFFFFFFF00000000ull) == tag)
+        {
+            auto const position = static_cast<std::size_t> (
+                (slot & 0xFFFFFFFFull) - 1);
+            if (keys_[position] == key)
+                return position;
+        }
+    }
+}
+
+void
+ManifestReducer::add (std::vector<std::string> const& manifests)
+{
+    enum Status : char { invalid, stale, unchecked, valid };
+    std::vector<Status> status (manifests.size (), invalid);
+    std::vector<boost::optional<ManifestDecoder>> decoded (manifests.size ());
+
+    // The table is only read until the batch is merged, so threads can
+    // skip manifests that are already beaten
+    parallelFor (manifests.size (), threads_, 1024, [&](std::size_t i)
+    {
+        decoded[i].emplace (beast::detail::base64_decode (manifests[i]));
+        auto const& manifest = decoded[i]->manifest ();
+        if (! manifest)
+            return;
+
+        auto const position = find (keyOf (manifest->masterKey));
+        if (position && sequences_[*position] >= manifest->sequence)
+        {
+            status[i] = stale;
+            return;
+        }
+
+        status[i] = unchecked;
+    });
+
+    std::vector<ManifestDecoder const*> pending;
+    for (std::size_t i = 0; i < manifests.size (); ++i)
+        if (status[i] == unchecked)
+            pending.push_back (&*decoded[i]);
+
+    auto const verified = verifyManifests (pending, threads_);
+    for (std::size_t i = 0, next = 0; i < manifests.size (); ++i)
+        if (status[i] == unchecked)
+            status[i] = verified[next++] ? valid : invalid;
+
+    added_ += manifests.size ();
+    checked_ += pending.size ();
+
+    for (std::size_t i = 0; i < manifests.size (); ++i)
+    {
+        if (status[i] == invalid)
+            ++invalid_;
+        if (status[i] != valid)
+            continue;
+
+        auto const& manifest = *decoded[i]->manifest ();
+        auto const key = keyOf (manifest.masterKey);
+        if (auto const position = find (key))
+        {
+            if (sequences_[*position] < manifest.sequence)
+            {
+                sequences_[*position] = manifest.sequence;
+                manifests_[*position] = decoded[i]->serialized ();
+            }
+            continue;
+        }
+
+        if (2 * (keys_.size () + 1) > slots_.size ())
+            rehash (2 * slots_.size ());
+
+        place (hash (key), keys_.size ());
+        keys_.push_back (key);
+        sequences_.push_back (manifest.sequence);
+        manifests_.push_back (decoded[i]->serialized ());
+    }
+}
+
+std::vector<std::string>
+ManifestReducer::manifests () const
+{
+    std::vector<std::size_t> order (keys_.size ());
+    std::iota (order.begin (), order.end (), std::size_t (0));
+    std::sort (order.begin (), order.end (),
+        [this](std::size_t a, std::size_t b)
+        {
+            return keys_[a] < keys_[b];
+        });
+
+    std::vector<std::string> result;
+    result.reserve (order.size ());
+    for (auto const position : order)
+    {
+        auto const& serialized = manifests_[position];
+        result.push_back (beast::detail::base64_encode (
+            reinterpret_cast<std::uint8_t const*> (serialized.data ()),
+            serialized.size ()));
+    }
+    return result;
+}
+
+std::size_t
+ManifestReducer::revoked () const
+{
+    return std::count (sequences_.begin (), sequences_.end (),
+        std::numeric_limits<std::uint32_t>::max ());
+}
+
+std::size_t
+ManifestReducer::memoryUsage () const
+{
+    std::size_t bytes = keys_.capacity () * sizeof (Key) +
+        sequences_.capacity () * sizeof (std::uint32_t) +
+        manifests_.capacity () * sizeof (std::string) +
+        slots_.capacity () * sizeof (std::uint64_t);
+    for (auto const& manifest : manifests_)
+        bytes += manifest.capacity ();
+    return bytes;
+}
+
+} // ripple
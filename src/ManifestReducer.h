@@ -0,0 +1,147 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_MANIFESTREDUCER_H_INCLUDED
+#define VALIDATOR_KEYS_MANIFESTREDUCER_H_INCLUDED
+
+#include <ripple/protocol/PublicKey.h>
+#include <boost/optional.hpp>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** Reduces manifests to the current one for each master key
+
+    As in rippled's manifest cache, the manifest with the highest
+    sequence wins, so a revocation beats every other manifest. Of
+    manifests with the same sequence, the first one added is kept.
+
+    Manifests are added in batches. Each batch is decoded with
+    ManifestDecoder and its signatures checked on several threads with
+    verifyManifests, then merged in order. A manifest that cannot replace the current one for
+    its key is skipped without checking its signatures.
+
+    Only the current manifest of each key is kept, so memory grows with
+    the number of validators, not the number of manifests added. As in
+    KeyIndex, keys, sequences and serialized manifests are held in
+    parallel arrays, and an open addressing hash table of packed tags
+    and positions maps master keys to positions.
+*/
+class ManifestReducer
+{
+public:
+    /** @param threads Threads to check signatures with, or zero for one
+                       per core
+    */
+    explicit
+    ManifestReducer (unsigned threads = 0);
+
+    /** Adds base64-encoded manifests
+
+        Malformed manifests and manifests whose signatures do not verify
+        are counted as invalid and skipped.
+    */
+    void
+    add (std::vector<std::string> const& manifests);
+
+    /** Returns the current manifest of each master key
+
+        @return Base64-encoded manifests in master key order
+    */
+    std::vector<std::string>
+    manifests () const;
+
+    /** Returns the number of master keys */
+    std::size_t
+    size () const
+    {
+        return keys_.size ();
+    }
+
+    /** Returns the number of master keys whose manifest is a revocation */
+    std::size_t
+    revoked () const;
+
+    /** Returns the number of manifests added */
+    std::size_t
+    added () const
+    {
+        return added_;
+    }
+
+    /** Returns the number of manifests skipped as invalid */
+    std::size_t
+    invalid () const
+    {
+        return invalid_;
+    }
+
+    /** Returns the number of manifests whose signatures were checked */
+    std::size_t
+    checked () const
+    {
+        return checked_;
+    }
+
+    /** Returns bytes allocated for keys, manifests and the hash table */
+    std::size_t
+    memoryUsage () const;
+
+private:
+    using Key = std::array<std::uint8_t, 33>;
+
+    static
+    Key
+    keyOf (PublicKey const& publicKey);
+
+    static
+    std::uint64_t
+    hash (Key const& key);
+
+    boost::optional<std::size_t>
+    find (Key const& key) const;
+
+    void
+    rehash (std::size_t slots);
+
+    void
+    place (std::uint64_t h, std::size_t position);
+
+    unsigned threads_;
+
+    std::vector<Key> keys_;
+    std::vector<std::uint32_t> sequences_;
+    std::vector<std::string> manifests_;
+
+    // Empty slots are zero, others hold (tag << 32) | (position + 1)
+    std::vector<std::uint64_t> slots_;
+    std::size_t mask_;
+
+    std::size_t added_ = 0;
+    std::size_t invalid_ = 0;
+    std::size_t checked_ = 0;
+};
+
+} // ripple
+
+#endif
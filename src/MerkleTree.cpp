@@ -0,0 +1,261 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <MerkleTree.h>
+#include <Parallel.h>
+#include <Sha512HalfBatch.h>
+#include <ripple/basics/Slice.h>
+#include <ripple/protocol/digest.h>
+#include <beast/core/detail/base64.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace ripple {
+
+namespace {
+
+std::uint8_t const leafPrefix = 0x00;
+std::uint8_t const innerPrefix = 0x01;
+std::uint8_t const proofVersion = 1;
+
+// Below this many hashes per thread, starting threads costs more than
+// it saves
+std::size_t const minHashesPerThread = 4096;
+
+// Messages passed to sha512HalfBatch at a time
+std::size_t const hashesPerBatch = 256;
+
+// Number of sibling hashes on the path from a leaf
+std::size_t
+pathLength (std::uint32_t index, std::uint32_t count)
+{
+    std::size_t length = 0;
+    for (std::uint64_t width = count; width > 1; width = (width + 1) / 2)
+    {
+        if ((index ^ 1) < width)
+            ++length;
+        index /= 2;
+    }
+    return length;
+}
+
+void
+putBigEndian (std::string& out, std::uint32_t v)
+{
+    out.push_back (static_cast<char> (v >> 24));
+    out.push_back (static_cast<char> (v >> 16));
+    out.push_back (static_cast<char> (v >> 8));
+    out.push_back (static_cast<char> (v));
+}
+
+std::uint32_t
+getBigEndian (std::uint8_t const* p)
+{
+    return (std::uint32_t (p[0]) << 24) | (std::uint32_t (p[1]) << 16) |
+        (std::uint32_t (p[2]) << 8) | std::uint32_t (p[3]);
+}
+
+// Hashes prefix || bodies[i] into digests[i] for every body, in batches
+// spread over threads
+void
+hashAll (
+    std::uint8_t prefix,
+    std::vector<Slice> const& bodies,
+    uint256* digests,
+    unsigned threads)
+{
+    auto const batches = (bodies.size () + hashesPerBatch - 1) / hashesPerBatch;
+    parallelFor (batches, threads, minHashesPerThread / hashesPerBatch,
+        [&](std::size_t batch)
+    {
+        auto const first = batch * hashesPerBatch;
+        sha512HalfBatch (Slice (&prefix, sizeof (prefix)),
+            bodies.data () + first, digests + first,
+            std::min (hashesPerBatch, bodies.size () - first));
+    });
+}
+
+} // namespace
+
+MerkleTree::MerkleTree (std::vector<std::string> const& payloads,
+    unsigned threads)
+{
+    if (payloads.empty ())
+        throw std::runtime_error ("No payloads to build a Merkle tree");
+    if (payloads.size () > std::numeric_limits<std::uint32_t>::max ())
+        throw std::runtime_error ("Too many payloads for a Merkle tree");
+
+    static_assert (sizeof (uint256) == 32,
+        "Sibling hashes must be adjacent in memory");
+
+    std::vector<Slice> bodies;
+    bodies.reserve (payloads.size ());
+    for (auto const& payload : payloads)
+        bodies.push_back (makeSlice (payload));
+
+    levels_.emplace_back (payloads.size ());
+    hashAll (leafPrefix, bodies, levels_.back ().data (), threads);
+
+    while (levels_.back ().size () > 1)
+    {
+        auto const& below = levels_.back ();
+        std::vector<uint256> level ((below.size () + 1) / 2);
+
+        // Each pair of siblings is hashed where it lies
+        bodies.resize (below.size () / 2);
+        for (std::size_t i = 0; i < bodies.size (); ++i)
+            bodies[i] = Slice (below[2 * i].data (), 2 * sizeof (uint256));
+        hashAll (innerPrefix, bodies, level.data (), threads);
+
+        if (below.size () % 2)
+            level.back () = below.back ();
+        levels_.push_back (std::move (level));
+    }
+}
+
+MerkleProof
+MerkleTree::proof (std::uint32_t index) const
+{
+    MerkleProof result;
+    result.index = index;
+    result.count = static_cast<std::uint32_t> (size ());
+
+    std::size_t position = index;
+    for (std::size_t level = 0; level + 1 < levels_.size (); ++level)
+    {
+        auto const sibling = position ^ 1;
+        if (sibling < levels_[level].size ())
+            result.path.push_back (levels_[level][sibling]);
+        position /= 2;
+    }
+    return result;
+}
+
+uint256
+MerkleTree::hashLeaf (std::string const& payload)
+{
+    sha512_half_hasher h;
+    h (&leafPrefix, sizeof (leafPrefix));
+    h (payload.data (), payload.size ());
+    return static_cast<uint256> (h);
+}
+
+uint256
+MerkleTree::hashInner (uint256 const& left, uint256 const& right)
+{
+    sha512_half_hasher h;
+    h (&innerPrefix, sizeof (innerPrefix));
+    h (left.data (), left.size ());
+    h (right.data (), right.size ());
+    return static_cast<uint256> (h);
+}
+
+boost::optional<uint256>
+merkleRoot (std::string const& payload, MerkleProof const& proof)
+{
+    if (proof.index >= proof.count ||
+            proof.path.size () != pathLength (proof.index, proof.count))
+        return boost::none;
+
+    auto node = MerkleTree::hashLeaf (payload);
+    auto next = proof.path.begin ();
+    std::uint32_t index = proof.index;
+    for (std::uint64_t width = proof.count; width > 1; width = (width + 1) / 2)
+    {
+        if ((index ^ 1) < width)
+        {
+            node = (index & 1) ?
+                MerkleTree::hashInner (*next, node) :
+                MerkleTree::hashInner (node, *next);
+            ++next;
+        }
+        index /= 2;
+    }
+    return node;
+}
+
+std::string
+encodeMerkleProof (SignedMerkleProof const& signedProof)
+{
+    auto const& proof = signedProof.proof;
+
+    std::string out;
+    out.reserve (9 + 32 * (proof.path.size () + 1) +
+        signedProof.signature.size ());
+    out.push_back (static_cast<char> (proofVersion));
+    putBigEndian (out, proof.count);
+    putBigEndian (out, proof.index);
+    for (auto const& hash : proof.path)
+        out.append (reinterpret_cast<char const*> (hash.data ()), hash.size ());
+    out.append (reinterpret_cast<char const*> (signedProof.root.data ()),
+        signedProof.root.size ());
+    out.append (reinterpret_cast<char const*> (signedProof.signature.data ()),
+        signedProof.signature.size ());
+
+    return beast::detail::base64_encode (out);
+}
+
+boost::optional<SignedMerkleProof>
+decodeMerkleProof (std::string const& encoded)
+{
+    auto const raw = beast::detail::base64_decode (encoded);
+    auto const p = reinterpret_cast<std::uint8_t const*> (raw.data ());
+
+    if (raw.size () < 9 || p[0] != proofVersion)
+        return boost::none;
+
+    SignedMerkleProof result;
+    auto& proof = result.proof;
+    proof.count = getBigEndian (p + 1);
+    proof.index = getBigEndian (p + 5);
+    if (proof.index >= proof.count)
+        return boost::none;
+
+    auto const length = pathLength (proof.index, proof.count);
+    std::size_t offset = 9;
+    if (raw.size () <= offset + 32 * (length + 1))
+        return boost::none;
+
+    for (std::size_t i = 0; i < length; ++i, offset += 32)
+        proof.path.push_back (uint256::fromVoid (p + offset));
+    result.root = uint256::fromVoid (p + offset);
+    offset += 32;
+    result.signature.assign (p + offset, p + raw.size ());
+
+    return result;
+}
+
+bool
+verifyMerkleProof (
+    PublicKey const& publicKey,
+    std::string const& payload,
+    SignedMerkleProof const& signedProof)
+{
+    auto const root = merkleRoot (payload, signedProof.proof);
+    if (! root || *root != signedProof.root)
+        return false;
+
+    return verify (publicKey,
+        Slice (signedProof.root.data (), signedProof.root.size ()),
+        makeSlice (signedProof.signature), true);
+}
+
+} // ripple
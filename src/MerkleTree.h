@@ -0,0 +1,144 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_MERKLETREE_H_INCLUDED
+#define VALIDATOR_KEYS_MERKLETREE_H_INCLUDED
+
+#include <ripple/basics/base_uint.h>
+#include <ripple/basics/Blob.h>
+#include <ripple/protocol/PublicKey.h>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** Path from a leaf of a Merkle tree to its root */
+struct MerkleProof
+{
+    /// Position of the leaf
+    std::uint32_t index;
+
+    /// Number of leaves in the tree
+    std::uint32_t count;
+
+    /// Sibling hashes, from the leaf upwards
+    std::vector<uint256> path;
+};
+
+/** SHA-512Half Merkle tree over a list of payloads
+
+    Leaves are SHA-512Half (0x00 || payload) and inner nodes are
+    SHA-512Half (0x01 || left || right), so a leaf can never be passed
+    off as an inner node. A node without a sibling moves up a level
+    unchanged rather than being paired with itself, so no two distinct
+    lists of payloads share a root.
+
+    Building costs one hash per payload and one per inner node. Nodes
+    are hashed in batches with sha512HalfBatch, and large trees on
+    several threads.
+*/
+class MerkleTree
+{
+public:
+    /** Builds the tree
+
+        @param threads Threads to hash with, or zero for one per core
+
+        @throws std::runtime_error if there are no payloads, or more than
+                2^32 - 1
+    */
+    explicit
+    MerkleTree (std::vector<std::string> const& payloads,
+        unsigned threads = 0);
+
+    uint256 const&
+    root () const
+    {
+        return levels_.back ().front ();
+    }
+
+    std::size_t
+    size () const
+    {
+        return levels_.front ().size ();
+    }
+
+    /** Returns the inclusion proof for the payload at an index */
+    MerkleProof
+    proof (std::uint32_t index) const;
+
+    static
+    uint256
+    hashLeaf (std::string const& payload);
+
+    static
+    uint256
+    hashInner (uint256 const& left, uint256 const& right);
+
+private:
+    // levels_[0] holds the leaves, levels_.back () the root
+    std::vector<std::vector<uint256>> levels_;
+};
+
+/** Returns the root implied by a payload and its proof
+
+    @return boost::none if the proof is malformed
+*/
+boost::optional<uint256>
+merkleRoot (std::string const& payload, MerkleProof const& proof);
+
+/** An inclusion proof bundled with the signed root */
+struct SignedMerkleProof
+{
+    MerkleProof proof;
+    uint256 root;
+    Blob signature;
+};
+
+/** Returns the compact encoding of a signed proof
+
+    The encoding is base64 of: a version byte (1), the leaf count and
+    index as 32 bit big-endian integers, the sibling hashes, the root,
+    and the signature.
+*/
+std::string
+encodeMerkleProof (SignedMerkleProof const& signedProof);
+
+/** Decodes a signed proof
+
+    @return boost::none if the encoding is malformed
+*/
+boost::optional<SignedMerkleProof>
+decodeMerkleProof (std::string const& encoded);
+
+/** Returns true if a signed proof shows that a payload is included in a
+    tree whose root was signed with a public key
+*/
+bool
+verifyMerkleProof (
+    PublicKey const& publicKey,
+    std::string const& payload,
+    SignedMerkleProof const& signedProof);
+
+} // ripple
+
+#endif
@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_PARALLEL_H_INCLUDED
+#define VALIDATOR_KEYS_PARALLEL_H_INCLUDED
+
+#include <ThreadPool.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+namespace ripple {
+
+/** Calls f (i) for every i in [0, count), spreading the calls over a pool
+
+    The calling thread takes part until every chunk is claimed, and then
+    sleeps until the calls running on other threads have returned. No
+    claimed chunk waits on a queued task, so parallelFor may be called
+    from a task of the same pool. The range is split into chunks, which each
+    thread claims in turn, so threads that get quick calls do more of
+    them. Small counts never leave the calling thread.
+
+    If a call throws, calls not yet started are skipped and the first
+    exception is rethrown once the others have returned.
+
+    @param threads Most threads to use, including the calling thread, or
+                   zero for the size of the pool
+
+    @param minPerThread Fewest calls worth another thread
+*/
+template <class F>
+void
+parallelFor (ThreadPool& pool, std::size_t count, unsigned threads,
+    std::size_t minPerThread, F const& f)
+{
+    if (threads == 0)
+        threads = pool.size ();
+    threads = static_cast<unsigned> (std::min<std::size_t> (
+        std::min (threads, pool.size () + 1),
+        std::max<std::size_t> (1, count / std::max<std::size_t> (
+            1, minPerThread))));
+
+    if (threads <= 1)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            f (i);
+        return;
+    }
+
+    // Shared with the tasks, which may start after the last call
+    // returned and then only find that no chunks remain
+    struct State
+    {
+        std::atomic<std::size_t> next {0};
+        std::atomic<std::size_t> done {0};
+        std::atomic<bool> failed {false};
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::exception_ptr error;
+        F const* f;
+    };
+    auto const state = std::make_shared<State> ();
+    state->f = &f;
+
+    auto const chunk = std::max<std::size_t> (1, count / (8 * threads));
+    auto const runChunks = [state, count, chunk]
+    {
+        for (;;)
+        {
+            auto const first = state->next.fetch_add (chunk);
+            if (first >= count)
+                return;
+            auto const last = std::min (count, first + chunk);
+
+            if (! state->failed.load ())
+            {
+                try
+                {
+                    for (auto i = first; i < last; ++i)
+                        (*state->f) (i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock (state->mutex);
+                    if (! state->error)
+                        state->error = std::current_exception ();
+                    state->failed.store (true);
+                }
+            }
+            if ((state->done += last - first) == count)
+            {
+                std::lock_guard<std::mutex> lock (state->mutex);
+                state->finished.notify_all ();
+            }
+        }
+    };
+
+    for (unsigned part = 1; part < threads; ++part)
+        pool.submit (runChunks);
+    runChunks ();
+
+    {
+        std::unique_lock<std::mutex> lock (state->mutex);
+        state->finished.wait (lock,
+            [&] { return state->done.load () == count; });
+    }
+
+    if (state->error)
+        std::rethrow_exception (state->error);
+}
+
+/** Calls f (i) for every i in [0, count) on the default thread pool
+
+    @see parallelFor, defaultThreadPool
+*/
+template <class F>
+void
+parallelFor (std::size_t count, unsigned threads, std::size_t minPerThread,
+    F const& f)
+{
+    // Only start the pool when it will be used
+    if (threads == 1 || count < 2 * std::max<std::size_t> (1, minPerThread))
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            f (i);
+        return;
+    }
+
+    parallelFor (defaultThreadPool (), count, threads, minPerThread, f);
+}
+
+} // ripple
+
+#endif
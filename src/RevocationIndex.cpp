@@ -0,0 +1,123 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <RevocationIndex.h>
+#include <algorithm>
+#include <cstring>
+
+namespace ripple {
+
+namespace {
+
+int const probes = 6;
+std::size_t const bitsPerKey = 16;
+std::size_t const wordsPerBlock = 8;
+std::size_t const bitsPerBlock = wordsPerBlock * 64;
+
+// Public keys are curve points, so the bytes after the type prefix are
+// already well mixed and serve as the hashes. The first picks the block
+// and the other two the bits within it.
+struct Probe
+{
+    std::uint64_t h1;
+    std::uint64_t h2;
+    std::uint64_t h3;
+
+    explicit
+    Probe (std::uint8_t const* key)
+    {
+        std::memcpy (&h1, key + 1, sizeof (h1));
+        std::memcpy (&h2, key + 9, sizeof (h2));
+        std::memcpy (&h3, key + 17, sizeof (h3));
+        h3 |= 1;
+    }
+
+    // Index of the first word of the key's block
+    std::size_t
+    block (std::size_t blocks) const
+    {
+        return (h1 & (blocks - 1)) * wordsPerBlock;
+    }
+
+    std::size_t
+    bit (int i) const
+    {
+        return (h2 + i * h3) & (bitsPerBlock - 1);
+    }
+};
+
+} // namespace
+
+RevocationIndex::RevocationIndex (std::vector<PublicKey> const& keys)
+{
+    keys_.reserve (keys.size ());
+    for (auto const& key : keys)
+    {
+        if (key.size () != std::tuple_size<Key>::value)
+            continue;
+        keys_.emplace_back ();
+        std::copy (key.data (), key.data () + key.size (),
+            keys_.back ().begin ());
+    }
+    std::sort (keys_.begin (), keys_.end ());
+    keys_.erase (std::unique (keys_.begin (), keys_.end ()), keys_.end ());
+
+    if (keys_.empty ())
+        return;
+
+    std::size_t blocks = 1;
+    while (blocks * bitsPerBlock < keys_.size () * bitsPerKey)
+        blocks *= 2;
+    filter_.assign (blocks * wordsPerBlock, 0);
+
+    for (auto const& key : keys_)
+    {
+        Probe const probe (key.data ());
+        auto const words = &filter_[probe.block (blocks)];
+        for (int i = 0; i < probes; ++i)
+        {
+            auto const bit = probe.bit (i);
+            words[bit / 64] |= std::uint64_t (1) << (bit % 64);
+        }
+    }
+}
+
+bool
+RevocationIndex::contains (PublicKey const& key) const
+{
+    if (keys_.empty () || key.size () != std::tuple_size<Key>::value)
+        return false;
+
+    Probe const probe (key.data ());
+    auto const words =
+        &filter_[probe.block (filter_.size () / wordsPerBlock)];
+    for (int i = 0; i < probes; ++i)
+    {
+        auto const bit = probe.bit (i);
+        if (! (words[bit / 64] & (std::uint64_t (1) << (bit % 64))))
+            return false;
+    }
+
+    Key k;
+    std::copy (key.data (), key.data () + key.size (), k.begin ());
+    return std::binary_search (keys_.begin (), keys_.end (), k);
+}
+
+} // ripple
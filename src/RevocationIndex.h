@@ -0,0 +1,76 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_REVOCATIONINDEX_H_INCLUDED
+#define VALIDATOR_KEYS_REVOCATIONINDEX_H_INCLUDED
+
+#include <ripple/protocol/PublicKey.h>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace ripple {
+
+/** Set of revoked master keys
+
+    Keys are held in a sorted array behind a Bloom filter. Nearly every
+    key looked up while checking a validator list is not revoked, and
+    the filter rules those out with a few bit tests, without searching
+    the array. The filter is split into 64-byte blocks and every probe
+    for a key lands in one block, so a lookup touches one cache line,
+    or two where the block straddles a line boundary. The filter has 16
+    or more bits and 6 probes per key, so at most about two lookups
+    in a thousand of a key that is not revoked fall through to the
+    search.
+
+    The index does not change after construction, so lookups may run
+    concurrently.
+*/
+class RevocationIndex
+{
+public:
+    RevocationIndex () = default;
+
+    explicit
+    RevocationIndex (std::vector<PublicKey> const& keys);
+
+    /** Returns true if a key is revoked */
+    bool
+    contains (PublicKey const& key) const;
+
+    std::size_t
+    size () const
+    {
+        return keys_.size ();
+    }
+
+private:
+    using Key = std::array<std::uint8_t, 33>;
+
+    std::vector<Key> keys_;
+
+    // Bloom filter bits in blocks of eight words; the number of blocks
+    // is a power of two
+    std::vector<std::uint64_t> filter_;
+};
+
+} // ripple
+
+#endif
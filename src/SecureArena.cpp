@@ -0,0 +1,261 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <SecureArena.h>
+#include <openssl/crypto.h>
+#include <algorithm>
+#include <new>
+#ifdef _WIN32
+# ifndef WIN32_LEAN_AND_MEAN // VC_EXTRALEAN
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  undef WIN32_LEAN_AND_MEAN
+# else
+#  include <windows.h>
+# endif
+#else
+# include <sys/mman.h>
+# include <unistd.h>
+#endif
+
+namespace ripple {
+
+namespace {
+
+std::size_t
+systemPageSize ()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo (&si);
+    return si.dwPageSize;
+#else
+    return static_cast<std::size_t> (sysconf (_SC_PAGESIZE));
+#endif
+}
+
+std::size_t
+roundUp (std::size_t n, std::size_t to)
+{
+    return (n + to - 1) / to * to;
+}
+
+}
+
+SecureArena&
+SecureArena::instance ()
+{
+    // Never destroyed: secrets held by other static objects may be
+    // released after this function's statics would have been.
+    static SecureArena* const arena = new SecureArena;
+    return *arena;
+}
+
+SecureArena::SecureArena (std::size_t chunkSize)
+    : chunkSize_ (roundUp (chunkSize, systemPageSize ()))
+    , pageSize_ (systemPageSize ())
+    , cursor_ (nullptr)
+    , end_ (nullptr)
+{
+    freeLists_.fill (nullptr);
+}
+
+SecureArena::~SecureArena ()
+{
+    for (auto const& r : regions_)
+        unmap (r);
+}
+
+std::size_t
+SecureArena::sizeClass (std::size_t size)
+{
+    std::size_t c = 0;
+    for (auto s = minClass; s < size; s <<= 1)
+        ++c;
+    return c;
+}
+
+SecureArena::Region
+SecureArena::map (std::size_t size)
+{
+    // [guard page][size bytes][guard page]
+    auto const total = size + 2 * pageSize_;
+
+#ifdef _WIN32
+    auto const base = static_cast<char*> (VirtualAlloc (
+        nullptr, total, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    if (! base)
+        throw std::bad_alloc ();
+
+    DWORD old;
+    VirtualProtect (base, pageSize_, PAGE_NOACCESS, &old);
+    VirtualProtect (base + pageSize_ + size, pageSize_, PAGE_NOACCESS, &old);
+
+    if (! VirtualLock (base + pageSize_, size))
+        stats_.locked = false;
+#else
+    auto const p = mmap (nullptr, total, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        throw std::bad_alloc ();
+
+    auto const base = static_cast<char*> (p);
+    mprotect (base, pageSize_, PROT_NONE);
+    mprotect (base + pageSize_ + size, pageSize_, PROT_NONE);
+
+#ifdef MADV_DONTDUMP
+    madvise (base + pageSize_, size, MADV_DONTDUMP);
+#endif
+
+    // Typically fails when RLIMIT_MEMLOCK is exhausted. The memory is
+    // still guarded and zeroed on release, so keep going.
+    if (mlock (base + pageSize_, size) != 0)
+        stats_.locked = false;
+#endif
+
+    Region const r {base, total};
+    regions_.push_back (r);
+    ++stats_.regions;
+    stats_.bytesMapped += size;
+    return r;
+}
+
+void
+SecureArena::unmap (Region const& r) noexcept
+{
+    auto const data = r.base + pageSize_;
+    auto const size = r.size - 2 * pageSize_;
+    OPENSSL_cleanse (data, size);
+
+#ifdef _WIN32
+    VirtualUnlock (data, size);
+    VirtualFree (r.base, 0, MEM_RELEASE);
+#else
+    munlock (data, size);
+    munmap (r.base, r.size);
+#endif
+}
+
+void*
+SecureArena::allocate (std::size_t size)
+{
+    if (size == 0)
+        size = 1;
+
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    auto const c = sizeClass (size);
+    if (c >= classCount)
+    {
+        auto const r = map (roundUp (size, pageSize_));
+        stats_.bytesInUse += size;
+        ++stats_.allocations;
+        return r.base + pageSize_;
+    }
+
+    auto const blockSize = minClass << c;
+    stats_.bytesInUse += blockSize;
+    ++stats_.allocations;
+
+    if (auto const head = freeLists_[c])
+    {
+        freeLists_[c] = *static_cast<void**> (head);
+        *static_cast<void**> (head) = nullptr;
+        return head;
+    }
+
+    if (static_cast<std::size_t> (end_ - cursor_) < blockSize)
+    {
+        // The tail of the previous chunk is abandoned. It is at most
+        // one block of the largest class.
+        auto const r = map (chunkSize_);
+        cursor_ = r.base + pageSize_;
+        end_ = cursor_ + chunkSize_;
+    }
+
+    auto const p = cursor_;
+    cursor_ += blockSize;
+    return p;
+}
+
+void
+SecureArena::deallocate (void* p, std::size_t size) noexcept
+{
+    if (! p)
+        return;
+
+    if (size == 0)
+        size = 1;
+
+    auto const c = sizeClass (size);
+    if (c >= classCount)
+    {
+        std::lock_guard<std::mutex> lock (mutex_);
+        auto const base = static_cast<char*> (p) - pageSize_;
+        for (auto it = regions_.begin (); it != regions_.end (); ++it)
+        {
+            if (it->base == base)
+            {
+                unmap (*it);
+                stats_.bytesMapped -= it->size - 2 * pageSize_;
+                stats_.bytesInUse -= size;
+                --stats_.allocations;
+                --stats_.regions;
+                regions_.erase (it);
+                break;
+            }
+        }
+        return;
+    }
+
+    auto const blockSize = minClass << c;
+
+    // Erase outside the lock, the block is not reachable by anyone else
+    OPENSSL_cleanse (p, blockSize);
+
+    std::lock_guard<std::mutex> lock (mutex_);
+    *static_cast<void**> (p) = freeLists_[c];
+    freeLists_[c] = p;
+    stats_.bytesInUse -= blockSize;
+    --stats_.allocations;
+}
+
+bool
+SecureArena::owns (void const* p) const
+{
+    auto const c = static_cast<char const*> (p);
+
+    std::lock_guard<std::mutex> lock (mutex_);
+    return std::any_of (regions_.begin (), regions_.end (),
+        [this, c](Region const& r)
+        {
+            return c >= r.base + pageSize_ &&
+                c < r.base + r.size - pageSize_;
+        });
+}
+
+SecureArena::Stats
+SecureArena::stats () const
+{
+    std::lock_guard<std::mutex> lock (mutex_);
+    return stats_;
+}
+
+} // ripple
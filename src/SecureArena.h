@@ -0,0 +1,183 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_SECUREARENA_H_INCLUDED
+#define VALIDATOR_KEYS_SECUREARENA_H_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** Pooled memory for secret key material
+
+    Memory is mapped in chunks with an inaccessible guard page on either
+    side, locked into RAM and excluded from core dumps. Each chunk is
+    locked with a single system call and then carved into small size
+    classes, so allocating a secret costs a mutex and a free list pop
+    rather than a system call. Freed blocks are zeroed before reuse.
+
+    Allocations larger than the biggest size class get a dedicated
+    guarded mapping.
+*/
+class SecureArena
+{
+public:
+    struct Stats
+    {
+        std::size_t regions = 0;
+        std::size_t bytesMapped = 0;
+        std::size_t bytesInUse = 0;
+        std::size_t allocations = 0;
+
+        // False if the OS refused to lock any region into RAM
+        bool locked = true;
+    };
+
+    /** Returns the process wide arena. */
+    static
+    SecureArena&
+    instance ();
+
+    explicit
+    SecureArena (std::size_t chunkSize = 64 * 1024);
+
+    ~SecureArena ();
+
+    SecureArena (SecureArena const&) = delete;
+    SecureArena& operator= (SecureArena const&) = delete;
+
+    /** Returns memory for size bytes aligned to 16 bytes
+
+        @throws std::bad_alloc if the memory cannot be mapped
+    */
+    void*
+    allocate (std::size_t size);
+
+    /** Zeroes and releases memory returned by allocate */
+    void
+    deallocate (void* p, std::size_t size) noexcept;
+
+    /** Returns true if p points into memory mapped by this arena */
+    bool
+    owns (void const* p) const;
+
+    Stats
+    stats () const;
+
+private:
+    struct Region
+    {
+        char* base;
+        std::size_t size;
+    };
+
+    static std::size_t constexpr minClass = 16;
+    static std::size_t constexpr classCount = 9;   // 16 bytes to 4 KiB
+
+    static
+    std::size_t
+    sizeClass (std::size_t size);
+
+    Region
+    map (std::size_t size);
+
+    void
+    unmap (Region const& r) noexcept;
+
+    std::size_t const chunkSize_;
+    std::size_t const pageSize_;
+
+    mutable std::mutex mutex_;
+    std::array<void*, classCount> freeLists_;
+    std::vector<Region> regions_;
+    char* cursor_;
+    char* end_;
+    Stats stats_;
+};
+
+/** Standard allocator backed by the secure arena */
+template <class T>
+class SecureAllocator
+{
+public:
+    using value_type = T;
+
+    SecureAllocator () = default;
+
+    template <class U>
+    SecureAllocator (SecureAllocator<U> const&) noexcept
+    {
+    }
+
+    T*
+    allocate (std::size_t n)
+    {
+        static_assert (alignof (T) <= 16,
+            "SecureAllocator only provides 16 byte alignment");
+        return static_cast<T*> (
+            SecureArena::instance ().allocate (n * sizeof (T)));
+    }
+
+    void
+    deallocate (T* p, std::size_t n) noexcept
+    {
+        SecureArena::instance ().deallocate (p, n * sizeof (T));
+    }
+
+    template <class U>
+    bool
+    operator== (SecureAllocator<U> const&) const noexcept
+    {
+        return true;
+    }
+
+    template <class U>
+    bool
+    operator!= (SecureAllocator<U> const&) const noexcept
+    {
+        return false;
+    }
+};
+
+/** String whose buffer lives in the secure arena */
+using SecureString = std::basic_string<
+    char, std::char_traits<char>, SecureAllocator<char>>;
+
+/** Returns a shared object allocated in the secure arena
+
+    The control block is allocated alongside the object, so the object
+    and its reference counts are zeroed together when released.
+*/
+template <class T, class... Args>
+std::shared_ptr<T>
+make_secure (Args&&... args)
+{
+    return std::allocate_shared<T> (
+        SecureAllocator<T> {}, std::forward<Args> (args)...);
+}
+
+} // ripple
+
+#endif
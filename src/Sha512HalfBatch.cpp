@@ -0,0 +1,391 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <Sha512HalfBatch.h>
+#include <ripple/protocol/digest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+# define VK_SHA512_AVX2 1
+# include <immintrin.h>
+#endif
+
+namespace ripple {
+
+namespace {
+
+void
+hashEach (
+    Slice const& prefix,
+    Slice const* bodies,
+    uint256* digests,
+    std::size_t count)
+{
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        sha512_half_hasher h;
+        h (prefix.data (), prefix.size ());
+        h (bodies[i].data (), bodies[i].size ());
+        digests[i] = static_cast<uint256> (h);
+    }
+}
+
+#ifdef VK_SHA512_AVX2
+
+#define VK_AVX2 __attribute__ ((target ("avx2")))
+
+std::size_t const blockSize = 128;
+std::size_t const lanes = 4;
+
+std::uint64_t const initial[8] =
+{
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+    0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+    0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
+std::uint64_t const roundConstants[80] =
+{
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+    0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+    0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+    0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+    0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+    0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+    0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+    0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+    0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+    0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+    0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+    0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+    0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+    0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+    0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+    0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+    0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+    0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+    0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+    0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+    0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+// Number of blocks in a padded message: the message, a 0x80 byte, and
+// its length in bits as a 128 bit big-endian integer
+std::size_t
+paddedBlocks (std::size_t size)
+{
+    return (size + 17 + blockSize - 1) / blockSize;
+}
+
+// Writes block k of the padded message prefix || body
+void
+padBlock (
+    Slice const& prefix,
+    Slice const& body,
+    std::size_t k,
+    std::uint8_t* out)
+{
+    auto const size = prefix.size () + body.size ();
+    auto const begin = k * blockSize;
+
+    std::memset (out, 0, blockSize);
+
+    auto const copy = [&](Slice const& piece, std::size_t offset)
+    {
+        auto const from = std::max (begin, offset);
+        auto const to = std::min (begin + blockSize, offset + piece.size ());
+        if (from < to)
+            std::memcpy (out + (from - begin),
+                piece.data () + (from - offset), to - from);
+    };
+    copy (prefix, 0);
+    copy (body, prefix.size ());
+
+    if (size >= begin && size < begin + blockSize)
+        out[size - begin] = 0x80;
+
+    if (k + 1 == paddedBlocks (size))
+    {
+        std::uint64_t const bits = static_cast<std::uint64_t> (size) * 8;
+        for (int i = 0; i < 8; ++i)
+            out[blockSize - 1 - i] =
+                static_cast<std::uint8_t> (bits >> (8 * i));
+    }
+}
+
+template <int n>
+VK_AVX2 inline
+__m256i
+rotr (__m256i x)
+{
+    return _mm256_or_si256 (
+        _mm256_srli_epi64 (x, n), _mm256_slli_epi64 (x, 64 - n));
+}
+
+VK_AVX2 inline
+__m256i
+add (__m256i a, __m256i b)
+{
+    return _mm256_add_epi64 (a, b);
+}
+
+VK_AVX2 inline
+__m256i
+bigSigma0 (__m256i x)
+{
+    return _mm256_xor_si256 (_mm256_xor_si256 (
+        rotr<28> (x), rotr<34> (x)), rotr<39> (x));
+}
+
+VK_AVX2 inline
+__m256i
+bigSigma1 (__m256i x)
+{
+    return _mm256_xor_si256 (_mm256_xor_si256 (
+        rotr<14> (x), rotr<18> (x)), rotr<41> (x));
+}
+
+// Rotating by a whole byte is a single shuffle
+VK_AVX2 inline
+__m256i
+rotr8 (__m256i x)
+{
+    auto const order = _mm256_setr_epi8 (
+        1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8,
+        1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8);
+    return _mm256_shuffle_epi8 (x, order);
+}
+
+VK_AVX2 inline
+__m256i
+smallSigma0 (__m256i x)
+{
+    return _mm256_xor_si256 (_mm256_xor_si256 (
+        rotr<1> (x), rotr8 (x)), _mm256_srli_epi64 (x, 7));
+}
+
+VK_AVX2 inline
+__m256i
+smallSigma1 (__m256i x)
+{
+    return _mm256_xor_si256 (_mm256_xor_si256 (
+        rotr<19> (x), rotr<61> (x)), _mm256_srli_epi64 (x, 6));
+}
+
+// One round. The working variables rotate by renaming rather than by
+// moving registers, so rounds are unrolled eight at a time.
+VK_AVX2 inline
+void
+round (
+    __m256i a, __m256i b, __m256i c, __m256i& d,
+    __m256i e, __m256i f, __m256i g, __m256i& h,
+    __m256i w, std::uint64_t k)
+{
+    auto const ch = _mm256_xor_si256 (
+        _mm256_and_si256 (e, f), _mm256_andnot_si256 (e, g));
+    auto const maj = _mm256_or_si256 (_mm256_and_si256 (a, b),
+        _mm256_and_si256 (c, _mm256_or_si256 (a, b)));
+    auto const t1 = add (add (add (h, bigSigma1 (e)), add (ch, w)),
+        _mm256_set1_epi64x (static_cast<long long> (k)));
+    d = add (d, t1);
+    h = add (t1, add (bigSigma0 (a), maj));
+}
+
+// Runs the compression function on one block in each lane. Words are
+// stored word-major, so word i of every lane is one vector.
+VK_AVX2
+void
+compress (
+    std::uint64_t (&state)[8][lanes],
+    std::uint64_t const (&block)[16][lanes])
+{
+    __m256i s[8];
+    for (int i = 0; i < 8; ++i)
+        s[i] = _mm256_loadu_si256 (
+            reinterpret_cast<__m256i const*> (state[i]));
+
+    __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+    __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+    __m256i w[16];
+    for (int t = 0; t < 16; ++t)
+        w[t] = _mm256_loadu_si256 (
+            reinterpret_cast<__m256i const*> (block[t]));
+
+    for (int t = 0; t < 80; t += 8)
+    {
+        if (t >= 16)
+        {
+            for (int i = t; i < t + 8; ++i)
+            {
+                w[i & 15] = add (
+                    add (smallSigma1 (w[(i - 2) & 15]), w[(i - 7) & 15]),
+                    add (smallSigma0 (w[(i - 15) & 15]), w[i & 15]));
+            }
+        }
+
+        round (a, b, c, d, e, f, g, h, w[(t + 0) & 15], roundConstants[t + 0]);
+        round (h, a, b, c, d, e, f, g, w[(t + 1) & 15], roundConstants[t + 1]);
+        round (g, h, a, b, c, d, e, f, w[(t + 2) & 15], roundConstants[t + 2]);
+        round (f, g, h, a, b, c, d, e, w[(t + 3) & 15], roundConstants[t + 3]);
+        round (e, f, g, h, a, b, c, d, w[(t + 4) & 15], roundConstants[t + 4]);
+        round (d, e, f, g, h, a, b, c, w[(t + 5) & 15], roundConstants[t + 5]);
+        round (c, d, e, f, g, h, a, b, w[(t + 6) & 15], roundConstants[t + 6]);
+        round (b, c, d, e, f, g, h, a, w[(t + 7) & 15], roundConstants[t + 7]);
+    }
+
+    __m256i const out[8] = {a, b, c, d, e, f, g, h};
+    for (int i = 0; i < 8; ++i)
+        _mm256_storeu_si256 (reinterpret_cast<__m256i*> (state[i]),
+            add (s[i], out[i]));
+}
+
+VK_AVX2
+void
+hashLanes (
+    Slice const& prefix,
+    Slice const* bodies,
+    uint256* digests,
+    std::size_t count)
+{
+    struct Lane
+    {
+        std::size_t message;
+        std::size_t block;
+        std::size_t blocks;
+        bool busy;
+    };
+
+    std::uint64_t state[8][lanes];
+    std::uint64_t words[16][lanes];
+    Lane lane[lanes];
+    std::size_t next = 0;
+
+    auto const start = [&](std::size_t l)
+    {
+        lane[l].busy = next < count;
+        if (! lane[l].busy)
+            return;
+        lane[l].message = next;
+        lane[l].block = 0;
+        lane[l].blocks = paddedBlocks (prefix.size () + bodies[next].size ());
+        for (int i = 0; i < 8; ++i)
+            state[i][l] = initial[i];
+        ++next;
+    };
+
+    for (std::size_t l = 0; l < lanes; ++l)
+        start (l);
+
+    std::uint8_t buffer[blockSize];
+    while (std::any_of (lane, lane + lanes,
+        [](Lane const& x) { return x.busy; }))
+    {
+        for (std::size_t l = 0; l < lanes; ++l)
+        {
+            if (! lane[l].busy)
+            {
+                // Idle lanes hash zeros, and their state is ignored
+                for (int t = 0; t < 16; ++t)
+                    words[t][l] = 0;
+                continue;
+            }
+
+            padBlock (prefix, bodies[lane[l].message], lane[l].block,
+                buffer);
+            for (int t = 0; t < 16; ++t)
+            {
+                std::uint64_t word;
+                std::memcpy (&word, buffer + 8 * t, sizeof (word));
+                words[t][l] = __builtin_bswap64 (word);
+            }
+        }
+
+        compress (state, words);
+
+        for (std::size_t l = 0; l < lanes; ++l)
+        {
+            if (! lane[l].busy || ++lane[l].block != lane[l].blocks)
+                continue;
+
+            // SHA-512Half is the first four words of the digest
+            auto out = digests[lane[l].message].data ();
+            for (int i = 0; i < 4; ++i)
+            {
+                auto const word = __builtin_bswap64 (state[i][l]);
+                std::memcpy (out + 8 * i, &word, sizeof (word));
+            }
+            start (l);
+        }
+    }
+}
+
+bool
+hasAvx2 ()
+{
+    static bool const avx2 = []
+    {
+        __builtin_cpu_init ();
+        return __builtin_cpu_supports ("avx2") != 0;
+    }();
+    return avx2;
+}
+
+#undef VK_AVX2
+
+#endif
+
+} // namespace
+
+void
+sha512HalfBatch (
+    Slice const& prefix,
+    Slice const* bodies,
+    uint256* digests,
+    std::size_t count)
+{
+#ifdef VK_SHA512_AVX2
+    // A lone message would leave three lanes idle
+    if (count > 1 && hasAvx2 ())
+        return hashLanes (prefix, bodies, digests, count);
+#endif
+    hashEach (prefix, bodies, digests, count);
+}
+
+bool
+sha512HalfBatchVectorized ()
+{
+#ifdef VK_SHA512_AVX2
+    return hasAvx2 ();
+#else
+    return false;
+#endif
+}
+
+} // ripple
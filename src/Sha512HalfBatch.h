@@ -0,0 +1,54 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_SHA512HALFBATCH_H_INCLUDED
+#define VALIDATOR_KEYS_SHA512HALFBATCH_H_INCLUDED
+
+#include <ripple/basics/base_uint.h>
+#include <ripple/basics/Slice.h>
+#include <cstddef>
+
+namespace ripple {
+
+/** Computes SHA-512Half of many independent messages
+
+    Message i is the prefix followed by bodies[i], and its digest is
+    written to digests[i]. The result is the same as hashing each
+    message with sha512_half_hasher.
+
+    On x86-64 CPUs with AVX2, four messages are hashed at once, one in
+    each 64 bit lane of the vector registers. A lane that finishes its
+    message starts the next one, so messages of different lengths keep
+    every lane busy. Elsewhere the messages are hashed one at a time.
+*/
+void
+sha512HalfBatch (
+    Slice const& prefix,
+    Slice const* bodies,
+    uint256* digests,
+    std::size_t count);
+
+/** Returns true if sha512HalfBatch hashes several messages at once */
+bool
+sha512HalfBatchVectorized ();
+
+} // ripple
+
+#endif
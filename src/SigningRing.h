@@ -0,0 +1,435 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_SIGNINGRING_H_INCLUDED
+#define VALIDATOR_KEYS_SIGNINGRING_H_INCLUDED
+
+/*  Client interface to the shared memory signing ring.
+
+    This header depends only on the standard library and POSIX, so
+    co-located services can include it without pulling in the rest of
+    validator-keys.
+
+    A signing server (validator-keys serve_ring <name> <spins>) maps a
+    shared memory object holding two single-producer/single-consumer
+    rings: requests flow from one client to the server, signatures flow
+    back. Each side only ever advances its own cursor, so no locks are
+    taken. A consumer that finds its ring empty optionally spins, then
+    sleeps on a futex until the producer publishes. Producers only make
+    the wake-up system call when the consumer is actually asleep.
+
+    The server records its process id in the mapping, so a client waiting
+    on a server that died without stopping gives up instead of hanging.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#ifndef _WIN32
+# include <cerrno>
+# include <fcntl.h>
+# include <signal.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+# ifdef __linux__
+#  include <climits>
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#  include <time.h>
+# endif
+#endif
+
+namespace ripple {
+namespace signing_ring {
+
+std::uint32_t constexpr magic = 0x564b5232;        // "VKR2"
+std::uint32_t constexpr slotCount = 64;
+std::size_t constexpr maxData = 1024;
+std::size_t constexpr maxSignature = 144;           // hex, DER secp256k1
+
+enum Status : std::uint32_t
+{
+    ok = 0,
+    tooLarge = 1
+};
+
+struct Request
+{
+    std::uint32_t size;
+    char data[maxData];
+};
+
+struct Response
+{
+    std::uint32_t status;
+    std::uint32_t size;
+    char signature[maxSignature];
+};
+
+/** Futex backed sleep on a 32 bit word in shared memory */
+inline
+void
+waitWhileEqual (
+    std::atomic<std::uint32_t>& word,
+    std::uint32_t expected,
+    std::chrono::microseconds timeout)
+{
+#ifdef __linux__
+    static_assert (sizeof (word) == sizeof (std::uint32_t),
+        "futex word must be 32 bits");
+    timespec ts;
+    ts.tv_sec = timeout.count () / 1000000;
+    ts.tv_nsec = (timeout.count () % 1000000) * 1000;
+    syscall (SYS_futex, reinterpret_cast<std::uint32_t*> (&word),
+        FUTEX_WAIT, expected, &ts, nullptr, 0);
+#else
+    if (word.load () == expected)
+        std::this_thread::sleep_for (std::min (timeout,
+            std::chrono::microseconds {50}));
+#endif
+}
+
+inline
+void
+wakeAll (std::atomic<std::uint32_t>& word)
+{
+#ifdef __linux__
+    syscall (SYS_futex, reinterpret_cast<std::uint32_t*> (&word),
+        FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void) word;
+#endif
+}
+
+/** Single-producer/single-consumer ring of fixed size slots */
+template <class Slot>
+struct Ring
+{
+    // Cursors count forever and wrap at 2^32; slotCount divides 2^32.
+    // Each lives on its own cache line so the two sides do not share.
+    alignas (64) std::atomic<std::uint32_t> head {0};  // producer
+    alignas (64) std::atomic<std::uint32_t> tail {0};  // consumer
+    alignas (64) std::atomic<std::uint32_t> sleeping {0};
+    Slot slots[slotCount];
+
+    /** Returns the slot to fill next, or nullptr if the ring is full */
+    Slot*
+    prepare ()
+    {
+        auto const h = head.load (std::memory_order_relaxed);
+        if (h - tail.load (std::memory_order_acquire) == slotCount)
+            return nullptr;
+        return &slots[h % slotCount];
+    }
+
+    /** Publishes the slot returned by prepare */
+    void
+    publish ()
+    {
+        head.fetch_add (1, std::memory_order_seq_cst);
+        if (sleeping.load (std::memory_order_seq_cst))
+            wakeAll (head);
+    }
+
+    /** Returns the next slot to read, or nullptr if the ring is empty */
+    Slot*
+    front ()
+    {
+        auto const t = tail.load (std::memory_order_relaxed);
+        if (head.load (std::memory_order_acquire) == t)
+            return nullptr;
+        return &slots[t % slotCount];
+    }
+
+    /** Releases the slot returned by front */
+    void
+    pop ()
+    {
+        tail.fetch_add (1, std::memory_order_release);
+    }
+
+    /** Waits until the ring is not empty, or the timeout passes
+
+        @param spins Polls before going to sleep, zero to sleep at once
+    */
+    Slot*
+    wait (std::uint32_t spins, std::chrono::microseconds timeout)
+    {
+        for (std::uint32_t i = 0; i <= spins; ++i)
+        {
+            if (auto const s = front ())
+                return s;
+        }
+
+        auto const t = tail.load (std::memory_order_relaxed);
+        sleeping.store (1, std::memory_order_seq_cst);
+        if (head.load (std::memory_order_seq_cst) == t)
+            waitWhileEqual (head, t, timeout);
+        sleeping.store (0, std::memory_order_relaxed);
+
+        return front ();
+    }
+};
+
+struct Layout
+{
+    std::atomic<std::uint32_t> magic {0};
+    std::atomic<std::uint32_t> stop {0};
+    std::atomic<std::int32_t> server {0};               // process id
+    Ring<Request> requests;
+    Ring<Response> responses;
+};
+
+#ifndef _WIN32
+
+/** A named shared memory mapping of the ring layout
+
+    A leading slash is added to names that lack one.
+*/
+class Mapping
+{
+public:
+    Mapping (std::string const& name, bool create)
+        : name_ (name.compare (0, 1, "/") == 0 ? name : "/" + name)
+        , owner_ (create)
+    {
+        int const fd = shm_open (name_.c_str (),
+            create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+        if (fd == -1)
+            throw std::runtime_error (
+                "Cannot open signing ring: " + name_);
+
+        if (create && ftruncate (fd, sizeof (Layout)) != 0)
+        {
+            ::close (fd);
+            shm_unlink (name_.c_str ());
+            throw std::runtime_error (
+                "Cannot size signing ring: " + name_);
+        }
+
+        auto const p = mmap (nullptr, sizeof (Layout),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close (fd);
+
+        if (p == MAP_FAILED)
+        {
+            if (create)
+                shm_unlink (name_.c_str ());
+            throw std::runtime_error (
+                "Cannot map signing ring: " + name_);
+        }
+
+        if (create)
+        {
+            layout_ = new (p) Layout;
+            layout_->server.store (getpid (), std::memory_order_relaxed);
+            layout_->magic.store (magic, std::memory_order_release);
+        }
+        else
+        {
+            layout_ = static_cast<Layout*> (p);
+            if (layout_->magic.load (std::memory_order_acquire) != magic)
+            {
+                munmap (p, sizeof (Layout));
+                throw std::runtime_error (
+                    "Not a signing ring: " + name_);
+            }
+        }
+    }
+
+    ~Mapping ()
+    {
+        munmap (layout_, sizeof (Layout));
+        if (owner_)
+            shm_unlink (name_.c_str ());
+    }
+
+    Mapping (Mapping const&) = delete;
+    Mapping& operator= (Mapping const&) = delete;
+
+    Layout&
+    layout ()
+    {
+        return *layout_;
+    }
+
+private:
+    std::string const name_;
+    bool const owner_;
+    Layout* layout_;
+};
+
+/** Client side of a signing ring
+
+    Only one client may be attached to a ring at a time.
+*/
+class Client
+{
+public:
+    /** Attaches to a ring created by a signing server
+
+        @param spins Polls before sleeping while awaiting a response
+    */
+    explicit
+    Client (std::string const& name, std::uint32_t spins = 0)
+        : mapping_ (name, false)
+        , spins_ (spins)
+    {
+    }
+
+    /** Queues a request without waiting for the signature
+
+        @return false if the data is too large or the ring is full
+    */
+    bool
+    submit (char const* data, std::size_t size)
+    {
+        if (size > maxData)
+            return false;
+
+        auto& ring = mapping_.layout ().requests;
+        auto const slot = ring.prepare ();
+        if (! slot)
+            return false;
+
+        slot->size = static_cast<std::uint32_t> (size);
+        std::memcpy (slot->data, data, size);
+        ring.publish ();
+        return true;
+    }
+
+    bool
+    submit (std::string const& data)
+    {
+        return submit (data.data (), data.size ());
+    }
+
+    /** Waits for the signature of the oldest outstanding request
+
+        @return false if the server stopped or died, or the data was
+                rejected
+    */
+    bool
+    receive (std::string& signature)
+    {
+        return receive (signature, nullptr);
+    }
+
+    /** Waits at most timeout for the signature of the oldest request
+
+        A request that times out still owns the next response, which a
+        later call returns.
+
+        @return false if the server stopped or died, the data was
+                rejected, or the timeout passed
+    */
+    bool
+    receive (std::string& signature, std::chrono::microseconds timeout)
+    {
+        auto const deadline = std::chrono::steady_clock::now () + timeout;
+        return receive (signature, &deadline);
+    }
+
+    /** Returns false if the server has stopped or its process has exited */
+    bool
+    serverRunning ()
+    {
+        auto& layout = mapping_.layout ();
+        if (layout.stop.load ())
+            return false;
+
+        auto const pid = layout.server.load (std::memory_order_relaxed);
+        return pid <= 0 || kill (pid, 0) == 0 || errno != ESRCH;
+    }
+
+    /** Returns the hex-encoded signature of data
+
+        @throws std::runtime_error if the data cannot be signed
+    */
+    std::string
+    sign (std::string const& data)
+    {
+        while (! submit (data))
+        {
+            if (data.size () > maxData)
+                throw std::runtime_error ("Data too large to sign");
+            if (! serverRunning ())
+                throw std::runtime_error ("Signing ring request failed");
+            std::this_thread::yield ();
+        }
+
+        std::string signature;
+        if (! receive (signature))
+            throw std::runtime_error ("Signing ring request failed");
+        return signature;
+    }
+
+private:
+    using time_point = std::chrono::steady_clock::time_point;
+
+    bool
+    receive (std::string& signature, time_point const* deadline)
+    {
+        auto& layout = mapping_.layout ();
+        for (;;)
+        {
+            // Sleep in slices so a dead server is noticed promptly
+            std::chrono::microseconds slice {100000};
+            if (deadline)
+            {
+                auto const left = std::chrono::duration_cast<
+                    std::chrono::microseconds> (
+                        *deadline - std::chrono::steady_clock::now ());
+                slice = std::max (std::chrono::microseconds {0},
+                    std::min (slice, left));
+            }
+
+            if (auto const slot = layout.responses.wait (spins_, slice))
+            {
+                bool const good = slot->status == ok;
+                signature.assign (slot->signature, slot->size);
+                layout.responses.pop ();
+                return good;
+            }
+
+            if (! serverRunning ())
+                return false;
+            if (deadline && std::chrono::steady_clock::now () >= *deadline)
+                return false;
+        }
+    }
+
+    Mapping mapping_;
+    std::uint32_t const spins_;
+};
+
+#endif
+
+} // signing_ring
+} // ripple
+
+#endif
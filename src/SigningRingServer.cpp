@@ -0,0 +1,99 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <SigningRingServer.h>
+#include <ValidatorKeys.h>
+
+namespace ripple {
+
+#ifndef _WIN32
+
+SigningRingServer::SigningRingServer (
+    ValidatorKeys const& keys,
+    std::string const& name,
+    std::uint32_t spins)
+    : keys_ (keys)
+    , mapping_ (name, true)
+    , spins_ (spins)
+{
+}
+
+std::uint64_t
+SigningRingServer::run ()
+{
+    using namespace signing_ring;
+
+    auto& layout = mapping_.layout ();
+    std::uint64_t served = 0;
+
+    while (! layout.stop.load ())
+    {
+        auto const request = layout.requests.wait (
+            spins_, std::chrono::microseconds {100000});
+        if (! request)
+            continue;
+
+        // Responses back up only if the client stops reading them
+        Response* response;
+        while (! (response = layout.responses.prepare ()))
+        {
+            if (layout.stop.load ())
+                return served;
+            std::this_thread::yield ();
+        }
+
+        // The client shares this memory and may change the size at any
+        // time, so it is read once for both the check and the copy
+        std::uint32_t const size = request->size;
+        if (size > maxData)
+        {
+            response->status = tooLarge;
+            response->size = 0;
+        }
+        else
+        {
+            auto const signature = keys_.sign (
+                std::string (request->data, size));
+            response->status = ok;
+            response->size = static_cast<std::uint32_t> (signature.size ());
+            std::memcpy (response->signature, signature.data (),
+                signature.size ());
+        }
+
+        layout.requests.pop ();
+        layout.responses.publish ();
+        ++served;
+    }
+
+    return served;
+}
+
+void
+SigningRingServer::stop ()
+{
+    auto& layout = mapping_.layout ();
+    layout.stop.store (1);
+    signing_ring::wakeAll (layout.requests.head);
+    signing_ring::wakeAll (layout.responses.head);
+}
+
+#endif
+
+} // ripple
@@ -0,0 +1,79 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_SIGNINGRINGSERVER_H_INCLUDED
+#define VALIDATOR_KEYS_SIGNINGRINGSERVER_H_INCLUDED
+
+#include <SigningRing.h>
+#include <cstdint>
+#include <string>
+
+namespace ripple {
+
+class ValidatorKeys;
+
+#ifndef _WIN32
+
+/** Signs requests from a shared memory ring with resident validator keys
+
+    The server creates the ring and removes it when destroyed. A single
+    client attaches with signing_ring::Client.
+*/
+class SigningRingServer
+{
+public:
+    /** Creates the named ring
+
+        @param spins Polls before sleeping on an empty ring. Zero sleeps
+                     at once; a large value busy-polls for lower latency
+                     at the cost of a core.
+
+        @throws std::runtime_error if the ring cannot be created
+    */
+    SigningRingServer (
+        ValidatorKeys const& keys,
+        std::string const& name,
+        std::uint32_t spins = 0);
+
+    /** Serves requests until stop is called
+
+        @return The number of requests served
+    */
+    std::uint64_t
+    run ();
+
+    /** Makes run return and wakes any waiting client
+
+        Safe to call from another thread or a signal handler.
+    */
+    void
+    stop ();
+
+private:
+    ValidatorKeys const& keys_;
+    signing_ring::Mapping mapping_;
+    std::uint32_t const spins_;
+};
+
+#endif
+
+} // ripple
+
+#endif
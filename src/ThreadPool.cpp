@@ -0,0 +1,268 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <ThreadPool.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ripple {
+
+namespace {
+
+// The pool and worker the calling thread belongs to, if any
+thread_local ThreadPool const* currentPool = nullptr;
+thread_local unsigned currentIndex = 0;
+
+#ifdef __linux__
+
+// Returns the CPUs in the affinity mask of the process
+std::vector<int>
+allowedCpus ()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO (&set);
+    if (sched_getaffinity (0, sizeof (set), &set) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET (cpu, &set))
+                cpus.push_back (cpu);
+    }
+    return cpus;
+}
+
+// Returns the CPU limit of the process's cgroup, rounded up, or zero if
+// there is none
+unsigned
+cgroupCpuLimit ()
+{
+    auto const limit = [](double quota, double period) -> unsigned
+    {
+        if (quota <= 0 || period <= 0)
+            return 0;
+        return static_cast<unsigned> (std::ceil (quota / period));
+    };
+
+    // cgroup v2: "<quota> <period>" or "max <period>" in cpu.max of the
+    // group named on the "0::" line of /proc/self/cgroup
+    std::string group;
+    {
+        std::ifstream in ("/proc/self/cgroup");
+        for (std::string line; std::getline (in, line);)
+            if (line.compare (0, 3, "0::") == 0)
+                group = line.substr (3);
+    }
+    for (auto const& dir : {"/sys/fs/cgroup" + group,
+        std::string ("/sys/fs/cgroup")})
+    {
+        std::ifstream in (dir + "/cpu.max");
+        std::string quota;
+        double period = 0;
+        if (in >> quota >> period)
+            return quota == "max" ? 0 : limit (std::stod (quota), period);
+    }
+
+    // cgroup v1, where a quota of -1 means no limit
+    for (auto const dir : {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"})
+    {
+        double quota = 0;
+        double period = 0;
+        std::ifstream q (std::string (dir) + "/cpu.cfs_quota_us");
+        std::ifstream p (std::string (dir) + "/cpu.cfs_period_us");
+        if (q >> quota && p >> period)
+            return limit (quota, period);
+    }
+
+    return 0;
+}
+
+#endif
+
+std::atomic<unsigned> defaultPoolSize {0};
+
+} // namespace
+
+ThreadPool::ThreadPool (unsigned threads, bool pinThreads)
+{
+    if (threads == 0)
+        threads = defaultSize ();
+
+    for (unsigned i = 0; i < threads; ++i)
+        workers_.push_back (std::make_unique<Worker> ());
+    for (unsigned i = 0; i < threads; ++i)
+        threads_.emplace_back ([this, i] { run (i); });
+
+#ifdef __linux__
+    auto const cpus = pinThreads ? allowedCpus () : std::vector<int> ();
+    for (std::size_t i = 0; i < cpus.size () && i < threads_.size (); ++i)
+    {
+        cpu_set_t set;
+        CPU_ZERO (&set);
+        CPU_SET (cpus[i], &set);
+        pthread_setaffinity_np (
+            threads_[i].native_handle (), sizeof (set), &set);
+    }
+#else
+    (void) pinThreads;
+#endif
+}
+
+ThreadPool::~ThreadPool ()
+{
+    {
+        std::lock_guard<std::mutex> lock (sleepMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all ();
+
+    for (auto& thread : threads_)
+        thread.join ();
+}
+
+void
+ThreadPool::submit (std::function<void ()> task)
+{
+    auto const index = currentPool == this ?
+        currentIndex : next_++ % size ();
+
+    // Counted first, so a thief that takes the task at once never
+    // brings the count below zero
+    ++pending_;
+    {
+        auto& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock (worker.mutex);
+        worker.tasks.push_back (std::move (task));
+    }
+
+    // Taking the lock orders this with a worker deciding to sleep, so
+    // the wakeup is not lost
+    {
+        std::lock_guard<std::mutex> lock (sleepMutex_);
+    }
+    wake_.notify_one ();
+}
+
+bool
+ThreadPool::take (unsigned index, std::function<void ()>& task)
+{
+    if (pending_.load () == 0)
+        return false;
+
+    auto const n = size ();
+    if (index < n)
+    {
+        auto& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock (worker.mutex);
+        if (! worker.tasks.empty ())
+        {
+            task = std::move (worker.tasks.back ());
+            worker.tasks.pop_back ();
+            --pending_;
+            return true;
+        }
+    }
+
+    for (unsigned i = 1; i <= n; ++i)
+    {
+        auto& victim = *workers_[(index + i) % n];
+        std::lock_guard<std::mutex> lock (victim.mutex);
+        if (! victim.tasks.empty ())
+        {
+            task = std::move (victim.tasks.front ());
+            victim.tasks.pop_front ();
+            --pending_;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool
+ThreadPool::runPending ()
+{
+    std::function<void ()> task;
+    if (! take (currentPool == this ? currentIndex : size (), task))
+        return false;
+    task ();
+    return true;
+}
+
+void
+ThreadPool::run (unsigned index)
+{
+    currentPool = this;
+    currentIndex = index;
+
+    std::function<void ()> task;
+    for (;;)
+    {
+        if (take (index, task))
+        {
+            task ();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock (sleepMutex_);
+        wake_.wait (lock, [this] { return stop_ || pending_.load () > 0; });
+        if (stop_ && pending_.load () == 0)
+            return;
+    }
+}
+
+unsigned
+ThreadPool::defaultSize ()
+{
+    unsigned cpus = std::thread::hardware_concurrency ();
+
+#ifdef __linux__
+    auto const allowed = allowedCpus ().size ();
+    if (allowed > 0)
+        cpus = static_cast<unsigned> (allowed);
+
+    auto const limit = cgroupCpuLimit ();
+    if (limit > 0 && (cpus == 0 || limit < cpus))
+        cpus = limit;
+#endif
+
+    return std::max (1u, cpus);
+}
+
+ThreadPool&
+defaultThreadPool ()
+{
+    static ThreadPool pool (defaultPoolSize.load ());
+    return pool;
+}
+
+void
+setDefaultThreadPoolSize (unsigned threads)
+{
+    defaultPoolSize.store (threads);
+}
+
+} // ripple
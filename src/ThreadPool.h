@@ -0,0 +1,146 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_THREADPOOL_H_INCLUDED
+#define VALIDATOR_KEYS_THREADPOOL_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ripple {
+
+/** A fixed set of threads that run tasks, stealing work when idle
+
+    Each worker has its own deque of tasks. A task submitted from a
+    worker goes to the back of that worker's deque, and other tasks are
+    dealt out to the workers in turn. A worker runs tasks from the back
+    of its own deque, so related tasks run while their data is in cache,
+    and when that is empty takes the oldest task from the front of
+    another worker's deque. Workers with nothing to do sleep until a
+    task is submitted.
+
+    Threads waiting for tasks to finish should call runPending rather
+    than block, so that tasks which wait for other tasks never leave the
+    pool without a thread to run them.
+*/
+class ThreadPool
+{
+public:
+    /** Starts the threads
+
+        @param threads Number of threads, or zero for defaultSize
+
+        @param pinThreads Bind each thread to one CPU the process may run
+        on (Linux only)
+    */
+    explicit
+    ThreadPool (unsigned threads = 0, bool pinThreads = false);
+
+    /** Runs every queued task, then stops the threads */
+    ~ThreadPool ();
+
+    ThreadPool (ThreadPool const&) = delete;
+    ThreadPool& operator= (ThreadPool const&) = delete;
+
+    /** Returns the number of threads */
+    unsigned
+    size () const
+    {
+        return static_cast<unsigned> (threads_.size ());
+    }
+
+    /** Queues a task
+
+        Tasks must not throw.
+    */
+    void
+    submit (std::function<void ()> task);
+
+    /** Runs one queued task on the calling thread
+
+        @return false if no task was queued
+    */
+    bool
+    runPending ();
+
+    /** Returns the number of CPUs the process may use
+
+        On Linux this is the smallest of the CPUs in the affinity mask of
+        the process and the CPU limit of its cgroup, rounded up, so a
+        container limited to two CPUs of a large host gets two threads.
+    */
+    static
+    unsigned
+    defaultSize ();
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void ()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    // Tasks queued and not yet taken, counted just before they are
+    // queued
+    std::atomic<std::size_t> pending_ {0};
+    std::atomic<unsigned> next_ {0};
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+
+    // Takes a task, from the back of worker index's deque if it has
+    // one, otherwise from the front of another
+    bool
+    take (unsigned index, std::function<void ()>& task);
+
+    void
+    run (unsigned index);
+};
+
+/** Returns the pool shared by the whole process
+
+    The pool is started on first use, with setDefaultThreadPoolSize
+    threads if that was called before, otherwise ThreadPool::defaultSize.
+*/
+ThreadPool&
+defaultThreadPool ();
+
+/** Sets the size of the pool defaultThreadPool starts
+
+    Has no effect once the pool is started.
+
+    @param threads Number of threads, or zero for ThreadPool::defaultSize
+*/
+void
+setDefaultThreadPoolSize (unsigned threads);
+
+} // ripple
+
+#endif
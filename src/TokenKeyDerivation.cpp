@@ -0,0 +1,109 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <TokenKeyDerivation.h>
+#include <openssl/crypto.h>
+#include <openssl/hmac.h>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace ripple {
+
+namespace {
+
+char const label[] = "validator-keys token key";
+
+// Order of the secp256k1 group, big-endian
+std::array<std::uint8_t, 32> const secp256k1Order {{
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B,
+    0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41 }};
+
+bool
+validSecp256k1Secret (std::uint8_t const* secret)
+{
+    return std::any_of (secret, secret + 32,
+            [](std::uint8_t b) { return b != 0; }) &&
+        std::lexicographical_compare (secret, secret + 32,
+            secp256k1Order.begin (), secp256k1Order.end ());
+}
+
+void
+putBigEndian (std::uint8_t* out, std::uint32_t v)
+{
+    out[0] = static_cast<std::uint8_t> (v >> 24);
+    out[1] = static_cast<std::uint8_t> (v >> 16);
+    out[2] = static_cast<std::uint8_t> (v >> 8);
+    out[3] = static_cast<std::uint8_t> (v);
+}
+
+} // namespace
+
+SecretKey
+deriveTokenSecretKey (
+    SecretKey const& masterSecret,
+    std::uint32_t sequence,
+    KeyType keyType)
+{
+    if (keyType != KeyType::secp256k1 && keyType != KeyType::ed25519)
+        throw std::runtime_error ("Invalid key type for token keys");
+
+    std::array<std::uint8_t, sizeof (label) - 1 + 9> message;
+    std::copy (label, label + sizeof (label) - 1, message.begin ());
+    auto const suffix = message.data () + sizeof (label) - 1;
+    suffix[0] = keyType == KeyType::secp256k1 ? 0 : 1;
+    putBigEndian (suffix + 1, sequence);
+
+    std::array<std::uint8_t, 64> digest;
+    for (std::uint32_t counter = 0;; ++counter)
+    {
+        putBigEndian (suffix + 5, counter);
+
+        unsigned int size = 0;
+        if (! HMAC (EVP_sha512 (),
+                masterSecret.data (), static_cast<int> (masterSecret.size ()),
+                message.data (), message.size (),
+                digest.data (), &size) || size != digest.size ())
+            throw std::runtime_error ("Token key derivation failed");
+
+        if (keyType == KeyType::ed25519 ||
+                validSecp256k1Secret (digest.data ()))
+            break;
+    }
+
+    SecretKey const secret (Slice (digest.data (), 32));
+    OPENSSL_cleanse (digest.data (), digest.size ());
+    return secret;
+}
+
+bool
+validSecretKey (KeyType keyType, Slice const& secret)
+{
+    if (secret.size () != 32)
+        return false;
+    if (keyType == KeyType::ed25519)
+        return true;
+    return keyType == KeyType::secp256k1 &&
+        validSecp256k1Secret (secret.data ());
+}
+
+} // ripple
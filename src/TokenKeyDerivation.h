@@ -0,0 +1,66 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_TOKENKEYDERIVATION_H_INCLUDED
+#define VALIDATOR_KEYS_TOKENKEYDERIVATION_H_INCLUDED
+
+#include <ripple/basics/Slice.h>
+#include <ripple/crypto/KeyType.h>
+#include <ripple/protocol/SecretKey.h>
+#include <cstdint>
+
+namespace ripple {
+
+/** Derives the secret key of a token from the validator secret key
+
+    The token secret is the first 32 bytes of
+
+        HMAC-SHA512 (master secret,
+            "validator-keys token key" || type || sequence || counter)
+
+    where type is 0 for secp256k1 and 1 for ed25519, and sequence and
+    counter are 32 bit big-endian integers. The counter starts at zero
+    and only advances if the bytes are not a valid secp256k1 secret,
+    which is vanishingly unlikely.
+
+    The same inputs always give the same key, so a token can be issued
+    again without having stored its secret, and tokens for different
+    sequences may be derived in parallel.
+
+    @throws std::runtime_error if the key type is invalid
+*/
+SecretKey
+deriveTokenSecretKey (
+    SecretKey const& masterSecret,
+    std::uint32_t sequence,
+    KeyType keyType);
+
+/** Returns true if the bytes of a secret key are valid for a key type
+
+    Any 32 bytes are an ed25519 secret. A secp256k1 secret must also be
+    nonzero and less than the group order, or its public key cannot be
+    derived.
+*/
+bool
+validSecretKey (KeyType keyType, Slice const& secret);
+
+} // ripple
+
+#endif
@@ -19,34 +19,141 @@
 //==============================================================================
 
 #include <ValidatorKeys.h>
+#include <CryptoKernels.h>
+#include <KeyStore.h>
+#include <Parallel.h>
+#include <TokenKeyDerivation.h>
 #include <ripple/basics/StringUtilities.h>
 #include <ripple/json/json_reader.h>
 #include <ripple/json/to_string.h>
 #include <ripple/protocol/HashPrefix.h>
 #include <ripple/protocol/Sign.h>
 #include <beast/core/detail/base64.hpp>
-#include <boost/filesystem.hpp>
-#include <fstream>
+#include <boost/filesystem/path.hpp>
+#include <algorithm>
+#include <iterator>
 
 namespace ripple {
 
-std::string
+SecureString
 ValidatorToken::toString () const
 {
-    Json::Value jv;
-    jv["validation_secret_key"] = strHex(secretKey.data(), secretKey.size());
-    jv["manifest"] = manifest;
+    // Build the JSON object by hand so the hex-encoded secret only ever
+    // exists in secure memory. Fields are in the order Json::Value uses.
+    static char const hex[] = "0123456789ABCDEF";
+
+    SecureString s;
+    s.reserve (64 + manifest.size () + 2 * secretKey->size ());
+    s += "{\"manifest\":\"";
+    s.append (manifest.data (), manifest.size ());
+    s += "\",\"validation_secret_key\":\"";
+    for (std::size_t i = 0; i < secretKey->size (); ++i)
+    {
+        auto const c = secretKey->data ()[i];
+        s += hex[c >> 4];
+        s += hex[c & 0x0f];
+    }
+    s += "\"}";
+
+    // Encode into secure memory too; the token carries the secret.
+    static char const alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    SecureString encoded;
+    encoded.reserve (4 * ((s.size () + 2) / 3));
+    for (std::size_t i = 0; i < s.size (); i += 3)
+    {
+        auto const n = std::min<std::size_t> (3, s.size () - i);
+        std::uint32_t v = static_cast<std::uint8_t> (s[i]) << 16;
+        if (n > 1)
+            v |= static_cast<std::uint8_t> (s[i + 1]) << 8;
+        if (n > 2)
+            v |= static_cast<std::uint8_t> (s[i + 2]);
+
+        encoded += alphabet[(v >> 18) & 0x3f];
+        encoded += alphabet[(v >> 12) & 0x3f];
+        encoded += n > 1 ? alphabet[(v >> 6) & 0x3f] : '=';
+        encoded += n > 2 ? alphabet[v & 0x3f] : '=';
+    }
+    return encoded;
+}
+
+namespace {
+
+char const*
+tokenKeySourceName (TokenKeySource source)
+{
+    return source == TokenKeySource::derived ? "derived" : "random";
+}
+
+// Parses the "token_keys" field of a key file
+std::vector<TokenKeyRange>
+parseTokenKeys (Json::Value const& jv, std::uint32_t tokenSequence,
+    boost::filesystem::path const& keyFile)
+{
+    auto const invalid = [&]
+    {
+        return std::runtime_error (
+            "Key file '" + keyFile.string() +
+            "' contains invalid \"token_keys\" field: " +
+            jv.toStyledString());
+    };
+
+    if (! jv.isArray ())
+        throw invalid ();
 
-    return beast::detail::base64_encode(to_string(jv));
+    std::vector<TokenKeyRange> ranges;
+    for (auto const& jRange : jv)
+    {
+        if (! jRange.isObject () ||
+                ! jRange["first"].isIntegral () ||
+                ! jRange["last"].isIntegral () ||
+                ! jRange["key_type"].isString () ||
+                ! jRange["source"].isString ())
+            throw invalid ();
+
+        TokenKeyRange range;
+        try
+        {
+            range.first = jRange["first"].asUInt ();
+            range.last = jRange["last"].asUInt ();
+        }
+        catch (std::runtime_error&)
+        {
+            throw invalid ();
+        }
+
+        range.keyType = keyTypeFromString (jRange["key_type"].asString ());
+        auto const source = jRange["source"].asString ();
+        if (source == tokenKeySourceName (TokenKeySource::derived))
+            range.source = TokenKeySource::derived;
+        else if (source == tokenKeySourceName (TokenKeySource::random))
+            range.source = TokenKeySource::random;
+        else
+            throw invalid ();
+
+        // Ranges are issued sequences, in order and without overlap
+        if (range.keyType == KeyType::invalid || range.first == 0 ||
+                range.first > range.last || range.last > tokenSequence ||
+                (! ranges.empty () && range.first <= ranges.back ().last))
+            throw invalid ();
+
+        ranges.push_back (range);
+    }
+    return ranges;
 }
 
+}
+
+std::uint64_t constexpr ValidatorKeys::revokedBit;
+
 ValidatorKeys::ValidatorKeys (KeyType const& keyType)
     : keyType_ (keyType)
-    , tokenSequence_ (0)
-    , revoked_ (false)
+    , state_ (0)
 {
-    std::tie (publicKey_, secretKey_) = generateKeyPair (
-        keyType_, randomSeed ());
+    auto const kp = generateKeyPair (keyType_, randomSeed ());
+    publicKey_ = kp.first;
+    secretKey_ = make_secure<SecretKey> (kp.second);
 }
 
 ValidatorKeys::ValidatorKeys (
@@ -55,26 +162,80 @@ ValidatorKeys::ValidatorKeys (
     std::uint32_t tokenSequence,
     bool revoked)
     : keyType_ (keyType)
-    , secretKey_ (secretKey)
-    , tokenSequence_ (tokenSequence)
-    , revoked_ (revoked)
+    , secretKey_ (make_secure<SecretKey> (secretKey))
+    , state_ (makeState (tokenSequence, revoked))
+{
+    publicKey_ = CryptoKernels::active ().derivePublicKey (
+        keyType_, *secretKey_);
+}
+
+ValidatorKeys::ValidatorKeys (
+    KeyType const& keyType,
+    SecretKey const& secretKey,
+    PublicKey const& publicKey,
+    std::uint32_t tokenSequence,
+    bool revoked,
+    std::vector<TokenKeyRange> tokenKeys)
+    : keyType_ (keyType)
+    , publicKey_ (publicKey)
+    , secretKey_ (make_secure<SecretKey> (secretKey))
+    , state_ (makeState (tokenSequence, revoked))
+    , tokenKeys_ (std::move (tokenKeys))
 {
-    publicKey_ = derivePublicKey(keyType_, secretKey_);
+}
+
+ValidatorKeys::ValidatorKeys (ValidatorKeys const& other)
+    : keyType_ (other.keyType_)
+    , publicKey_ (other.publicKey_)
+    , secretKey_ (other.secretKey_)
+    , state_ (other.state_.load ())
+{
+    std::lock_guard<std::mutex> lock (other.tokenKeysMutex_);
+    tokenKeys_ = other.tokenKeys_;
+}
+
+ValidatorKeys&
+ValidatorKeys::operator= (ValidatorKeys const& other)
+{
+    if (this != &other)
+    {
+        std::lock (tokenKeysMutex_, other.tokenKeysMutex_);
+        std::lock_guard<std::mutex> lock (tokenKeysMutex_, std::adopt_lock);
+        std::lock_guard<std::mutex> otherLock (
+            other.tokenKeysMutex_, std::adopt_lock);
+
+        keyType_ = other.keyType_;
+        publicKey_ = other.publicKey_;
+        secretKey_ = other.secretKey_;
+        state_.store (other.state_.load ());
+        tokenKeys_ = other.tokenKeys_;
+    }
+    return *this;
 }
 
 ValidatorKeys
 ValidatorKeys::make_ValidatorKeys (
     boost::filesystem::path const& keyFile)
 {
-    std::ifstream ifsKeys (keyFile.c_str (), std::ios::in);
+    return make_ValidatorKeys (keyFile, defaultKeyStore ());
+}
 
-    if (! ifsKeys)
-        throw std::runtime_error (
-            "Failed to open key file: " + keyFile.string());
+ValidatorKeys
+ValidatorKeys::make_ValidatorKeys (
+    boost::filesystem::path const& keyFile,
+    KeyStore& store)
+{
+    return fromJson (store.load (keyFile), keyFile);
+}
 
+ValidatorKeys
+ValidatorKeys::fromJson (
+    std::string const& contents,
+    boost::filesystem::path const& keyFile)
+{
     Json::Reader reader;
     Json::Value jKeys;
-    if (! reader.parse (ifsKeys, jKeys))
+    if (! reader.parse (contents, jKeys))
     {
         throw std::runtime_error (
             "Unable to parse json key file: " + keyFile.string());
@@ -138,63 +299,234 @@ ValidatorKeys::make_ValidatorKeys (
             "' contains invalid \"revoked\" field: " +
             jKeys["revoked"].toStyledString());
 
-    return ValidatorKeys (
+    ValidatorKeys keys (
         keyType, *secret, tokenSequence, jKeys["revoked"].asBool());
+
+    // Key files written before tokens were recorded have no token_keys
+    if (jKeys.isMember ("token_keys"))
+        keys.tokenKeys_ = parseTokenKeys (
+            jKeys["token_keys"], tokenSequence, keyFile);
+
+    return keys;
 }
 
 void
 ValidatorKeys::writeToFile (
     boost::filesystem::path const& keyFile) const
 {
-    using namespace boost::filesystem;
+    writeToFile (keyFile, defaultKeyStore ());
+}
 
+void
+ValidatorKeys::writeToFile (
+    boost::filesystem::path const& keyFile,
+    KeyStore& store) const
+{
+    store.store (keyFile, toJson ());
+}
+
+std::string
+ValidatorKeys::toJson () const
+{
     Json::Value jv;
     jv["key_type"] = to_string(keyType_);
     jv["public_key"] = toBase58(TOKEN_NODE_PUBLIC, publicKey_);
-    jv["secret_key"] = toBase58(TOKEN_NODE_PRIVATE, secretKey_);
-    jv["token_sequence"] = Json::UInt (tokenSequence_);
-    jv["revoked"] = revoked_;
+    jv["secret_key"] = toBase58(TOKEN_NODE_PRIVATE, *secretKey_);
+    jv["token_sequence"] = Json::UInt (tokenSequence ());
+    jv["revoked"] = revoked ();
 
-    if (! keyFile.parent_path().empty())
+    auto const ranges = tokenKeyRanges ();
+    if (! ranges.empty ())
     {
-        boost::system::error_code ec;
-        if (! exists (keyFile.parent_path()))
-            boost::filesystem::create_directories(keyFile.parent_path(), ec);
-
-        if (ec || ! is_directory (keyFile.parent_path()))
-            throw std::runtime_error ("Cannot create directory: " +
-                    keyFile.parent_path().string());
+        Json::Value jRanges (Json::arrayValue);
+        for (auto const& range : ranges)
+        {
+            Json::Value jRange;
+            jRange["first"] = Json::UInt (range.first);
+            jRange["last"] = Json::UInt (range.last);
+            jRange["key_type"] = to_string (range.keyType);
+            jRange["source"] = tokenKeySourceName (range.source);
+            jRanges.append (jRange);
+        }
+        jv["token_keys"] = jRanges;
     }
 
-    std::ofstream o (keyFile.string (), std::ios_base::trunc);
-    if (o.fail())
-        throw std::runtime_error ("Cannot open key file: " +
-            keyFile.string());
+    return jv.toStyledString();
+}
+
+boost::optional<std::uint32_t>
+ValidatorKeys::reserveTokenSequences (std::uint32_t count)
+{
+    if (count == 0)
+        return boost::none;
+
+    // The maximum sequence is reserved for revocations
+    auto const limit = std::numeric_limits<std::uint32_t>::max () - 1;
+
+    // A concurrent revoke changes the state, so the exchange fails and
+    // the revoked bit is seen on the next attempt
+    auto state = state_.load ();
+    std::uint32_t current;
+    do
+    {
+        current = static_cast<std::uint32_t> (state);
+        if ((state & revokedBit) || limit <= current ||
+                limit - current < count)
+            return boost::none;
+    }
+    while (! state_.compare_exchange_weak (state, state + count));
 
-    o << jv.toStyledString();
+    return current + 1;
 }
 
 boost::optional<ValidatorToken>
 ValidatorKeys::createValidatorToken (
-    KeyType const& keyType)
+    KeyType const& keyType,
+    TokenKeySource source)
 {
-    if (revoked () ||
-            std::numeric_limits<std::uint32_t>::max () - 1 <= tokenSequence_)
+    auto const sequence = reserveTokenSequences (1);
+    if (! sequence)
         return boost::none;
 
-    ++tokenSequence_;
+    recordTokenKeys (*sequence, 1, keyType, source);
+    return makeToken (*sequence, keyType, source);
+}
+
+boost::optional<ValidatorToken>
+ValidatorKeys::regenerateValidatorToken (std::uint32_t sequence) const
+{
+    if (revoked () || sequence == 0 || sequence > tokenSequence ())
+        return boost::none;
 
-    auto const tokenSecret = generateSecretKey (keyType, randomSeed ());
-    auto const tokenPublic = derivePublicKey(keyType, tokenSecret);
+    auto const issued = tokenKeys (sequence);
+    if (! issued || issued->source != TokenKeySource::derived)
+        return boost::none;
+
+    return makeToken (sequence, issued->keyType, TokenKeySource::derived);
+}
+
+void
+ValidatorKeys::recordTokenKeys (std::uint32_t first, std::uint32_t count,
+    KeyType const& keyType, TokenKeySource source)
+{
+    TokenKeyRange const range {first, first + (count - 1), keyType, source};
+    auto const same = [&range](TokenKeyRange const& other)
+    {
+        return other.keyType == range.keyType &&
+            other.source == range.source;
+    };
+
+    std::lock_guard<std::mutex> lock (tokenKeysMutex_);
+
+    // Concurrent issuers may record their ranges out of order
+    auto next = std::upper_bound (tokenKeys_.begin (), tokenKeys_.end (),
+        first, [](std::uint32_t sequence, TokenKeyRange const& other)
+        {
+            return sequence < other.first;
+        });
+    bool const joinsNext = next != tokenKeys_.end () && same (*next) &&
+        range.last + 1 == next->first;
+
+    if (next != tokenKeys_.begin ())
+    {
+        auto const prev = std::prev (next);
+        if (same (*prev) && prev->last + 1 == range.first)
+        {
+            prev->last = joinsNext ? next->last : range.last;
+            if (joinsNext)
+                tokenKeys_.erase (next);
+            return;
+        }
+    }
+
+    if (joinsNext)
+        next->first = range.first;
+    else
+        tokenKeys_.insert (next, range);
+}
+
+boost::optional<TokenKeyRange>
+ValidatorKeys::tokenKeys (std::uint32_t sequence) const
+{
+    std::lock_guard<std::mutex> lock (tokenKeysMutex_);
+    auto const next = std::upper_bound (tokenKeys_.begin (),
+        tokenKeys_.end (), sequence,
+        [](std::uint32_t s, TokenKeyRange const& other)
+        {
+            return s < other.first;
+        });
+    if (next == tokenKeys_.begin () || std::prev (next)->last < sequence)
+        return boost::none;
+    return *std::prev (next);
+}
+
+std::vector<TokenKeyRange>
+ValidatorKeys::tokenKeyRanges () const
+{
+    std::lock_guard<std::mutex> lock (tokenKeysMutex_);
+    return tokenKeys_;
+}
+
+std::vector<ValidatorToken>
+ValidatorKeys::createValidatorTokens (
+    std::uint32_t count,
+    KeyType const& keyType,
+    TokenKeySource source)
+{
+    std::vector<ValidatorToken> tokens;
+
+    auto const first = reserveTokenSequences (count);
+    if (! first)
+        return tokens;
+
+    recordTokenKeys (*first, count, keyType, source);
+
+    // Each token costs two signatures, so large batches are split
+    // across threads. Sequences are already reserved, so the threads
+    // share nothing but this object, which is safe to sign with.
+    std::size_t const perPart = 64;
+    auto const partCount = std::max<std::size_t> (1, count / perPart);
+
+    std::vector<std::vector<ValidatorToken>> parts (partCount);
+    parallelFor (partCount, 0, 1, [&](std::size_t part)
+    {
+        auto const begin = count * part / partCount;
+        auto const end = count * (part + 1) / partCount;
+        parts[part].reserve (end - begin);
+        for (auto i = begin; i < end; ++i)
+            parts[part].push_back (makeToken (
+                *first + static_cast<std::uint32_t> (i), keyType, source));
+    });
+
+    tokens.reserve (count);
+    for (auto& part : parts)
+        for (auto& token : part)
+            tokens.push_back (std::move (token));
+
+    return tokens;
+}
+
+ValidatorToken
+ValidatorKeys::makeToken (
+    std::uint32_t sequence,
+    KeyType const& keyType,
+    TokenKeySource source) const
+{
+    auto const tokenSecret = make_secure<SecretKey> (
+        source == TokenKeySource::derived ?
+            deriveTokenSecretKey (*secretKey_, sequence, keyType) :
+            generateSecretKey (keyType, randomSeed ()));
+    auto const& kernels = CryptoKernels::active ();
+    auto const tokenPublic = kernels.derivePublicKey (keyType, *tokenSecret);
 
     STObject st(sfGeneric);
-    st[sfSequence] = tokenSequence_;
+    st[sfSequence] = sequence;
     st[sfPublicKey] = publicKey_;
     st[sfSigningPubKey] = tokenPublic;
 
-    ripple::sign(st, HashPrefix::manifest, keyType, tokenSecret);
+    kernels.sign (st, HashPrefix::manifest, keyType, *tokenSecret);
 
-    ripple::sign(st, HashPrefix::manifest, keyType_, secretKey_,
+    kernels.sign (st, HashPrefix::manifest, keyType_, *secretKey_,
         sfMasterSignature);
 
     Serializer s;
@@ -208,14 +540,14 @@ ValidatorKeys::createValidatorToken (
 std::string
 ValidatorKeys::revoke ()
 {
-    revoked_ = true;
+    state_.fetch_or (revokedBit);
 
     STObject st(sfGeneric);
     st[sfSequence] = std::numeric_limits<std::uint32_t>::max ();
     st[sfPublicKey] = publicKey_;
 
-    ripple::sign(st, HashPrefix::manifest, keyType_, secretKey_,
-        sfMasterSignature);
+    CryptoKernels::active ().sign (st, HashPrefix::manifest, keyType_,
+        *secretKey_, sfMasterSignature);
 
     Serializer s;
     st.add(s);
@@ -225,9 +557,10 @@ ValidatorKeys::revoke ()
 }
 
 std::string
-ValidatorKeys::sign (std::string const& data)
+ValidatorKeys::sign (std::string const& data) const
 {
-    return strHex(ripple::sign (publicKey_, secretKey_, makeSlice (data)));
+    return strHex (CryptoKernels::active ().sign (
+        publicKey_, *secretKey_, makeSlice (data)));
 }
 
 } // ripple
@@ -18,8 +18,15 @@
 */
 //==============================================================================
 
+#ifndef VALIDATOR_KEYS_VALIDATORKEYS_H_INCLUDED
+#define VALIDATOR_KEYS_VALIDATORKEYS_H_INCLUDED
+
+#include <SecureArena.h>
 #include <ripple/crypto/KeyType.h>
 #include <ripple/protocol/SecretKey.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 namespace boost
 {
@@ -31,23 +38,78 @@ class path;
 
 namespace ripple {
 
+class KeyStore;
+
 struct ValidatorToken
 {
     std::string const manifest;
-    SecretKey const secretKey;
 
-    /// Returns base64-encoded JSON object
-    std::string toString () const;
+    /// Token secret key, held in the secure arena
+    std::shared_ptr<SecretKey const> const secretKey;
+
+    /// Returns base64-encoded JSON object, held in secure memory
+    SecureString toString () const;
 };
 
+/** How the secret keys of new tokens are generated */
+enum class TokenKeySource
+{
+    /// From a random seed. The token can never be issued again.
+    random,
+
+    /// From the validator secret key and the token sequence, so the
+    /// token can be issued again on demand. See deriveTokenSecretKey.
+    derived
+};
+
+/** Token sequences that were issued with the same kind of token keys */
+struct TokenKeyRange
+{
+    std::uint32_t first;
+    std::uint32_t last;
+    KeyType keyType;
+    TokenKeySource source;
+};
+
+/** Validator master keys
+
+    Instances may be shared between threads. The key pair is immutable
+    after construction, so signing never contends. Token sequences are
+    reserved with a lock-free compare-and-swap on the current sequence,
+    so concurrent callers never receive the same sequence. The revoked
+    flag shares that atomic word, so no token is issued once revoke has
+    begun. How each sequence was issued is then recorded under a mutex,
+    so that derived tokens can be issued again with the same key type.
+*/
 class ValidatorKeys
 {
 private:
     KeyType keyType_;
     PublicKey publicKey_;
-    SecretKey secretKey_;
-    std::uint32_t tokenSequence_;
-    bool revoked_;
+    std::shared_ptr<SecretKey const> secretKey_;
+    // The last token sequence in the low 32 bits, and revokedBit
+    std::atomic<std::uint64_t> state_;
+
+    static std::uint64_t constexpr revokedBit = std::uint64_t (1) << 32;
+
+    static std::uint64_t
+    makeState (std::uint32_t sequence, bool revoked)
+    {
+        return sequence | (revoked ? revokedBit : 0);
+    }
+
+    // How issued tokens were made, in sequence order. A sequence that is
+    // reserved but not yet recorded is treated as unknown.
+    mutable std::mutex tokenKeysMutex_;
+    std::vector<TokenKeyRange> tokenKeys_;
+
+    void
+    recordTokenKeys (std::uint32_t first, std::uint32_t count,
+        KeyType const& keyType, TokenKeySource source);
+
+    ValidatorToken
+    makeToken (std::uint32_t sequence, KeyType const& keyType,
+        TokenKeySource source) const;
 
 public:
     explicit
@@ -60,6 +122,20 @@ public:
         std::uint32_t sequence,
         bool revoked = false);
 
+    /** Restores keys saved from an earlier instance
+
+        The public key is not derived again, so it must belong to the
+        secret key. The token key ranges must be as tokenKeyRanges
+        returned them.
+    */
+    ValidatorKeys (
+        KeyType const& keyType,
+        SecretKey const& secretKey,
+        PublicKey const& publicKey,
+        std::uint32_t sequence,
+        bool revoked,
+        std::vector<TokenKeyRange> tokenKeys);
+
     /** Returns ValidatorKeys constructed from JSON file
 
         @param keyFile Path to JSON key file
@@ -69,15 +145,44 @@ public:
     static ValidatorKeys make_ValidatorKeys(
         boost::filesystem::path const& keyFile);
 
+    /** Returns ValidatorKeys constructed from JSON key file in a store
+
+        @param keyFile Path to JSON key file
+
+        @param store Storage backend holding the key file
+
+        @throws std::runtime_error if file content is invalid
+    */
+    static ValidatorKeys make_ValidatorKeys(
+        boost::filesystem::path const& keyFile,
+        KeyStore& store);
+
+    /** Returns ValidatorKeys decoded from the contents of a key file
+
+        @param contents JSON key file contents
+
+        @param keyFile Path the contents were read from, used in errors
+
+        @throws std::runtime_error if the contents are invalid
+    */
+    static ValidatorKeys fromJson(
+        std::string const& contents,
+        boost::filesystem::path const& keyFile);
+
+    ValidatorKeys (ValidatorKeys const& other);
+
+    ValidatorKeys&
+    operator= (ValidatorKeys const& other);
+
     ~ValidatorKeys () = default;
 
     inline bool
     operator==(ValidatorKeys const& rhs) const
     {
         // TODO Compare secretKey_
-        return revoked_ == rhs.revoked_ &&
+        return revoked () == rhs.revoked () &&
             keyType_ == rhs.keyType_ &&
-            tokenSequence_ == rhs.tokenSequence_ &&
+            tokenSequence () == rhs.tokenSequence () &&
             publicKey_ == rhs.publicKey_;
     }
 
@@ -92,12 +197,90 @@ public:
     void
     writeToFile (boost::filesystem::path const& keyFile) const;
 
-    /** Returns validator token for current sequence
+    /** Write keys to JSON file in a store
+
+        @param keyFile Path to file to write
+
+        @param store Storage backend to write to
+
+        @note Overwrites existing key file
+
+        @throws std::runtime_error if unable to create parent directory
+    */
+    void
+    writeToFile (
+        boost::filesystem::path const& keyFile,
+        KeyStore& store) const;
+
+    /** Returns the JSON key file contents that writeToFile stores */
+    std::string
+    toJson () const;
+
+    /** Returns validator token for the next sequence
 
         @param keyType Key type for the token keys
+
+        @param source How the token secret key is generated
+
+        @return boost::none if keys are revoked or no sequences remain
+    */
+    boost::optional<ValidatorToken>
+    createValidatorToken (
+        KeyType const& keyType = KeyType::secp256k1,
+        TokenKeySource source = TokenKeySource::random);
+
+    /** Returns the token previously issued for a sequence
+
+        Only tokens recorded as issued with TokenKeySource::derived are
+        reproduced, with the recorded key type; the token sequence is not
+        changed.
+
+        @return boost::none if keys are revoked, or the sequence was not
+        issued with derived token keys
     */
     boost::optional<ValidatorToken>
-    createValidatorToken (KeyType const& keyType = KeyType::secp256k1);
+    regenerateValidatorToken (std::uint32_t sequence) const;
+
+    /** Returns how the token for a sequence was issued, if recorded
+
+        Key files written before tokens were recorded, and sequences
+        reserved without issuing tokens, have no record.
+    */
+    boost::optional<TokenKeyRange>
+    tokenKeys (std::uint32_t sequence) const;
+
+    /** Returns how issued tokens were made, in sequence order */
+    std::vector<TokenKeyRange>
+    tokenKeyRanges () const;
+
+    /** Reserves a contiguous range of token sequences
+
+        @param count Number of sequences to reserve
+
+        @return First sequence of the range [first, first + count), or
+        boost::none if keys are revoked or too few sequences remain
+    */
+    boost::optional<std::uint32_t>
+    reserveTokenSequences (std::uint32_t count);
+
+    /** Returns validator tokens for the next count sequences
+
+        The sequences are reserved in a single step, so the returned
+        tokens are contiguous even when other threads issue tokens.
+
+        @param count Number of tokens to create
+
+        @param keyType Key type for the token keys
+
+        @param source How the token secret keys are generated
+
+        @return Empty vector if the sequences could not be reserved
+    */
+    std::vector<ValidatorToken>
+    createValidatorTokens (
+        std::uint32_t count,
+        KeyType const& keyType = KeyType::secp256k1,
+        TokenKeySource source = TokenKeySource::random);
 
     /** Revokes validator keys
 
@@ -113,7 +296,7 @@ public:
     @return hex-encoded signature
     */
     std::string
-    sign (std::string const& data);
+    sign (std::string const& data) const;
 
     /** Returns the public key. */
     PublicKey const&
@@ -122,12 +305,28 @@ public:
         return publicKey_;
     }
 
+    /** Returns the secret key. */
+    SecretKey const&
+    secretKey () const
+    {
+        return *secretKey_;
+    }
+
     /** Returns true if keys are revoked. */
     bool
     revoked () const
     {
-        return revoked_;
+        return (state_.load () & revokedBit) != 0;
+    }
+
+    /** Returns the last issued token sequence. */
+    std::uint32_t
+    tokenSequence () const
+    {
+        return static_cast<std::uint32_t> (state_.load ());
     }
 };
 
 } // ripple
+
+#endif
@@ -0,0 +1,171 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <validatorkeys.h>
+#include <KeyFileOps.h>
+#include <ripple/protocol/tokens.h>
+#include <cstring>
+
+struct vk_keys
+{
+    ripple::ValidatorKeys keys;
+};
+
+namespace {
+
+std::string&
+lastError ()
+{
+    static thread_local std::string error;
+    return error;
+}
+
+// Tokens are copied straight from secure memory into the caller's buffer
+template <class String>
+vk_status
+copyOut (String const& value, char* out, std::size_t* size)
+{
+    auto const capacity = *size;
+    *size = value.size ();
+    if (! out || capacity <= value.size ())
+        return VK_BUFFER_TOO_SMALL;
+
+    std::memcpy (out, value.data (), value.size ());
+    out[value.size ()] = '\0';
+    return VK_OK;
+}
+
+// Tokens and revocations cannot be taken back once the key file is
+// updated, so refuse buffers that might not hold them.
+bool
+tokenFits (char const* out, std::size_t* size)
+{
+    if (out && *size > VK_MAX_TOKEN_SIZE)
+        return true;
+
+    *size = VK_MAX_TOKEN_SIZE;
+    return false;
+}
+
+// Exceptions must not cross the C interface
+template <class F>
+vk_status
+guard (F&& f)
+{
+    try
+    {
+        return f ();
+    }
+    catch (std::exception const& e)
+    {
+        lastError () = e.what ();
+    }
+    catch (...)
+    {
+        lastError () = "Unknown error";
+    }
+    return VK_ERROR;
+}
+
+} // namespace
+
+char const*
+vk_last_error ()
+{
+    return lastError ().c_str ();
+}
+
+vk_status
+vk_load (char const* key_file, vk_keys** keys)
+{
+    if (! key_file || ! keys)
+        return VK_INVALID_ARGUMENT;
+
+    return guard ([&]
+    {
+        *keys = new vk_keys {ripple::loadKeyFile (key_file)};
+        return VK_OK;
+    });
+}
+
+void
+vk_free (vk_keys* keys)
+{
+    delete keys;
+}
+
+vk_status
+vk_public_key (vk_keys const* keys, char* out, size_t* size)
+{
+    if (! keys || ! size)
+        return VK_INVALID_ARGUMENT;
+
+    return guard ([&]
+    {
+        return copyOut (ripple::toBase58 (ripple::TOKEN_NODE_PUBLIC,
+            keys->keys.publicKey ()), out, size);
+    });
+}
+
+vk_status
+vk_sign (vk_keys const* keys,
+    void const* data, size_t data_size,
+    char* out, size_t* size)
+{
+    if (! keys || ! size || (! data && data_size))
+        return VK_INVALID_ARGUMENT;
+
+    return guard ([&]
+    {
+        return copyOut (keys->keys.sign (std::string (
+            static_cast<char const*> (data), data_size)), out, size);
+    });
+}
+
+vk_status
+vk_create_token (char const* key_file, char* out, size_t* size)
+{
+    if (! key_file || ! size)
+        return VK_INVALID_ARGUMENT;
+
+    if (! tokenFits (out, size))
+        return VK_BUFFER_TOO_SMALL;
+
+    return guard ([&]
+    {
+        return copyOut (ripple::issueValidatorToken (key_file).value,
+            out, size);
+    });
+}
+
+vk_status
+vk_revoke (char const* key_file, char* out, size_t* size)
+{
+    if (! key_file || ! size)
+        return VK_INVALID_ARGUMENT;
+
+    if (! tokenFits (out, size))
+        return VK_BUFFER_TOO_SMALL;
+
+    return guard ([&]
+    {
+        return copyOut (ripple::revokeKeyFile (key_file).value, out, size);
+    });
+}
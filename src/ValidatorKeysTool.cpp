@@ -19,14 +19,42 @@
 //==============================================================================
 
 #include <ValidatorKeysTool.h>
+#include <ConfigStamper.h>
+#include <FleetExport.h>
+#include <KeyFileInspector.h>
+#include <KeyFileOps.h>
+#include <MerkleTree.h>
+#include <SigningRingServer.h>
+#include <ThreadPool.h>
 #include <ValidatorKeys.h>
+#include <Manifest.h>
+#include <ManifestReducer.h>
+#include <ValidatorList.h>
+#include <test/ParallelRunner.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/beast/core/LexicalCast.h>
 #include <ripple/beast/core/PlatformConfig.h>
 #include <ripple/beast/core/SemanticVersion.h>
 #include <ripple/beast/unit_test.h>
+#include <ripple/json/json_reader.h>
+#include <ripple/json/to_string.h>
+#include <beast/core/detail/base64.hpp>
 #include <beast/unit_test/dstream.hpp>
+#include <beast/unit_test/match.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/format.hpp>
 #include <boost/program_options.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
 #ifdef BOOST_MSVC
 # ifndef WIN32_LEAN_AND_MEAN // VC_EXTRALEAN
 #  define WIN32_LEAN_AND_MEAN
@@ -63,97 +91,132 @@ char const* const versionString =
     //--------------------------------------------------------------------------
     ;
 
-static int runUnitTests ()
+static int runUnitTests (
+    std::string const& pattern,
+    std::string const& arg,
+    boost::optional<unsigned> jobs)
 {
-    using namespace beast::unit_test;
     beast::unit_test::dstream dout{std::cout};
-    reporter r{dout};
-    bool const anyFailed = r.run_each(global_suites());
+
+    bool const anyFailed = jobs ?
+        ripple::tests::runSuitesParallel (pattern, arg, *jobs, dout) :
+        ripple::tests::runSuitesSerial (pattern, arg, dout);
+
     if(anyFailed)
         return EXIT_FAILURE;    //LCOV_EXCL_LINE
     return EXIT_SUCCESS;
 }
 
-void createKeyFile (boost::filesystem::path const& keyFile)
+ripple::KeyType
+parseKeyType (std::string const& name)
 {
-    using namespace ripple;
+    auto const keyType = ripple::keyTypeFromString (name);
+    if (keyType == ripple::KeyType::invalid)
+        throw std::runtime_error ("Invalid key type: " + name);
+    return keyType;
+}
 
-    if (exists (keyFile))
-        throw std::runtime_error (
-            "Refusing to overwrite existing key file: " +
-                keyFile.string ());
+ripple::KeyringCache::Keyring
+parseKeyring (std::string const& name)
+{
+    if (name == "user")
+        return ripple::KeyringCache::Keyring::user;
+    if (name == "session")
+        return ripple::KeyringCache::Keyring::session;
+    throw std::runtime_error ("Invalid keyring: " + name);
+}
 
-    ValidatorKeys const keys (KeyType::ed25519);
-    keys.writeToFile (keyFile);
+ripple::CryptoVariant
+parseCryptoVariant (std::string const& name)
+{
+    auto const variant = ripple::cryptoVariantFromString (name);
+    if (! variant)
+        throw std::runtime_error ("Invalid crypto variant: " + name);
+    return *variant;
+}
+
+void createKeyFile (boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    ripple::KeyType keyType)
+{
+    ripple::createValidatorKeyFile (keyFile, store, keyType);
 
     std::cout << "Validator keys stored in " <<
         keyFile.string() <<
         "\n\nThis file should be stored securely and not shared.\n\n";
 }
 
-void createToken (boost::filesystem::path const& keyFile)
+static
+void
+printToken (ripple::KeyFileUpdate const& token)
 {
     using namespace ripple;
 
-    auto keys = ValidatorKeys::make_ValidatorKeys (keyFile);
-
-    if (keys.revoked ())
-        throw std::runtime_error (
-            "Validator keys have been revoked.");
-
-    auto const token = keys.createValidatorToken ();
-
-    if (! token)
-        throw std::runtime_error (
-            "Maximum number of tokens have already been generated.\n"
-            "Revoke validator keys if previous token has been compromised.");
-
-    // Update key file with new token sequence
-    keys.writeToFile (keyFile);
-
     std::cout << "Update rippled.cfg file with these values and restart rippled:\n\n";
     std::cout << "# validator public key: " <<
-        toBase58 (TOKEN_NODE_PUBLIC, keys.publicKey()) << "\n\n";
+        toBase58 (TOKEN_NODE_PUBLIC, token.publicKey) << "\n\n";
     std::cout << "[validator_token]\n";
 
-    auto const tokenStr = token->toString();
     auto const len = 72;
-    for (auto i = 0; i < tokenStr.size(); i += len)
-        std::cout << tokenStr.substr(i, len) << std::endl;
+    for (auto i = 0; i < token.value.size(); i += len)
+        std::cout << token.value.substr(i, len) << std::endl;
 
     std::cout << std::endl;
 }
 
-void createRevocation (boost::filesystem::path const& keyFile)
+void createToken (boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    ripple::KeyType tokenKeyType,
+    ripple::TokenKeySource source,
+    ripple::KeyringCache const* cache)
+{
+    printToken (ripple::issueValidatorToken (
+        keyFile, store, tokenKeyType, source, cache));
+}
+
+void regenerateToken (std::string const& sequence,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    ripple::KeyringCache const* cache)
+{
+    std::uint32_t seq;
+    if (! beast::lexicalCastChecked (seq, sequence))
+        throw std::runtime_error (
+            "Syntax error: Invalid token sequence: " + sequence);
+
+    printToken (ripple::regenerateValidatorToken (
+        keyFile, seq, store, cache));
+}
+
+void createRevocation (boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    ripple::KeyringCache const* cache)
 {
     using namespace ripple;
 
-    auto keys = ValidatorKeys::make_ValidatorKeys (keyFile);
+    auto const revocation = revokeKeyFile (keyFile, store, cache);
 
-    if (keys.revoked())
+    if (revocation.wasRevoked)
         std::cout << "WARNING: Validator keys have already been revoked!\n\n";
     else
         std::cout << "WARNING: This will revoke your validator keys!\n\n";
 
-    auto const revocation = keys.revoke ();
-
-    // Update key file with new token sequence
-    keys.writeToFile (keyFile);
-
     std::cout << "Update rippled.cfg file with these values and restart rippled:\n\n";
     std::cout << "# validator public key: " <<
-        toBase58 (TOKEN_NODE_PUBLIC, keys.publicKey()) << "\n\n";
+        toBase58 (TOKEN_NODE_PUBLIC, revocation.publicKey) << "\n\n";
     std::cout << "[validator_key_revocation]\n";
 
     auto const len = 72;
-    for (auto i = 0; i < revocation.size(); i += len)
-        std::cout << revocation.substr(i, len) << std::endl;
+    for (auto i = 0; i < revocation.value.size(); i += len)
+        std::cout << revocation.value.substr(i, len) << std::endl;
 
     std::cout << std::endl;
 }
 
 void signData (std::string const& data,
-    boost::filesystem::path const& keyFile)
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    ripple::KeyringCache const* cache)
 {
     using namespace ripple;
 
@@ -161,7 +224,7 @@ void signData (std::string const& data,
         throw std::runtime_error (
             "Syntax error: Must specify data string to sign");
 
-    auto keys = ValidatorKeys::make_ValidatorKeys (keyFile);
+    auto const keys = loadKeyFile (keyFile, store, cache);
 
     if (keys.revoked())
         std::cout << "WARNING: Validator keys have been revoked!\n\n";
@@ -170,17 +233,997 @@ void signData (std::string const& data,
     std::cout << std::endl;
 }
 
+void
+signMerkle (std::istream& in, std::ostream& out,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    ripple::KeyringCache const* cache,
+    unsigned jobs)
+{
+    using namespace ripple;
+
+    auto const keys = loadKeyFile (keyFile, store, cache);
+
+    std::vector<std::string> payloads;
+    for (std::string line; std::getline (in, line);)
+        payloads.push_back (std::move (line));
+
+    if (payloads.empty ())
+        throw std::runtime_error (
+            "Syntax error: Must specify payloads to sign on stdin");
+
+    if (keys.revoked())
+        std::cerr << "WARNING: Validator keys have been revoked!\n";
+
+    MerkleTree const tree (payloads, jobs);
+
+    SignedMerkleProof signedProof;
+    signedProof.root = tree.root ();
+    signedProof.signature = strUnHex (keys.sign (std::string (
+        reinterpret_cast<char const*> (tree.root ().data ()),
+        tree.root ().size ()))).first;
+
+    for (std::uint32_t i = 0; i < tree.size (); ++i)
+    {
+        signedProof.proof = tree.proof (i);
+        out << encodeMerkleProof (signedProof) << '\n';
+    }
+    out.flush ();
+
+    std::cerr << "Signed Merkle root " << to_string (tree.root ()) <<
+        " over " << tree.size () << " payloads\n";
+}
+
+void
+verifyProof (std::string const& publicKey,
+    std::string const& data,
+    std::string const& proof)
+{
+    using namespace ripple;
+
+    auto const pk = parseBase58<PublicKey> (
+        TokenType::TOKEN_NODE_PUBLIC, publicKey);
+    if (! pk)
+        throw std::runtime_error (
+            "Syntax error: Invalid public key: " + publicKey);
+
+    auto const signedProof = decodeMerkleProof (proof);
+    if (! signedProof)
+        throw std::runtime_error ("Syntax error: Malformed proof");
+
+    if (! verifyMerkleProof (*pk, data, *signedProof))
+        throw std::runtime_error ("Proof is not valid.");
+
+    std::cout << "Proof is valid for payload " <<
+        signedProof->proof.index << " of " << signedProof->proof.count <<
+        " under root " << to_string (signedProof->root) << std::endl;
+}
+
+// Reads a whole file into a string
+static
+std::string
+readFile (std::string const& file, std::string const& what)
+{
+    std::ifstream in (file);
+    if (! in.is_open ())
+        throw std::runtime_error ("Cannot open " + what + ": " + file);
+    return {std::istreambuf_iterator<char> (in),
+        std::istreambuf_iterator<char> ()};
+}
+
+// Seconds from 1970-01-01 to 2000-01-01, the epoch of ledger times
+static std::int64_t const rippleEpochOffset = 946684800;
+
+// Returns the manifest in a line holding a manifest or validator token
+static
+std::string
+listManifest (std::string const& line)
+{
+    auto const decoded = beast::detail::base64_decode (line);
+    if (decoded.empty () || decoded[0] != '{')
+        return line;
+
+    Json::Value token;
+    if (! Json::Reader ().parse (decoded, token) ||
+            ! token.isObject () || ! token["manifest"].isString ())
+        throw std::runtime_error ("Invalid validator token: " + line);
+    return token["manifest"].asString ();
+}
+
+void
+createValidatorList (std::string const& manifests,
+    std::string const& sequence,
+    std::string const& days,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    std::string const& previousList,
+    unsigned jobs)
+{
+    using namespace ripple;
+
+    std::uint32_t listSequence;
+    if (! beast::lexicalCastChecked (listSequence, sequence))
+        throw std::runtime_error (
+            "Syntax error: Invalid list sequence: " + sequence);
+
+    std::uint32_t expiresIn;
+    std::int64_t const now = std::chrono::duration_cast<std::chrono::seconds> (
+        std::chrono::system_clock::now ().time_since_epoch ()).count ();
+    if (! beast::lexicalCastChecked (expiresIn, days) || expiresIn == 0 ||
+            now - rippleEpochOffset + std::int64_t (expiresIn) * 86400 >
+                std::numeric_limits<std::uint32_t>::max ())
+        throw std::runtime_error (
+            "Syntax error: Invalid expiration: " + days);
+    auto const expiration = static_cast<std::uint32_t> (
+        now - rippleEpochOffset + std::int64_t (expiresIn) * 86400);
+
+    auto const publisherKeys = loadKeyFile (keyFile, store);
+    if (publisherKeys.revoked ())
+        throw std::runtime_error (
+            "Publisher keys have been revoked.");
+
+    // The publisher signs with the token keys recorded in its key file
+    auto const issued = publisherKeys.tokenKeys (
+        publisherKeys.tokenSequence ());
+    auto const publisher = publisherKeys.regenerateValidatorToken (
+        publisherKeys.tokenSequence ());
+    if (! issued || ! publisher)
+        throw std::runtime_error (publisherKeys.tokenSequence () == 0 ?
+            "Publisher has no token. Create one with "
+                "--derive-token-keys create_token." :
+            "Publisher token was not issued with derived token keys. "
+                "Create one with --derive-token-keys create_token.");
+
+    ValidatorListBuilder builder (jobs);
+
+    if (! previousList.empty ())
+    {
+        auto const blob = openValidatorList (
+            readFile (previousList, "validator list"),
+            derivePublicKey (issued->keyType, *publisher->secretKey));
+        if (! blob || ! builder.seed (*blob))
+            std::cerr << "WARNING: Previous list was not signed by this "
+                "publisher; checking every manifest\n";
+    }
+
+    // Manifests are added in batches, which bounds the memory needed
+    // beyond the list itself while still checking them in parallel
+    std::size_t const batchSize = 4096;
+    std::vector<std::string> batch;
+    batch.reserve (batchSize);
+    auto const flush = [&]
+    {
+        builder.add (batch);
+        batch.clear ();
+    };
+
+    auto const files = store.list (manifests);
+    if (! files.empty ())
+    {
+        for (auto const& file : files)
+        {
+            auto keys = loadKeyFile (file, store);
+            if (keys.revoked ())
+                batch.push_back (keys.revoke ());
+            else if (keys.tokenSequence () == 0)
+                std::cerr << "Skipping key file without a token: " <<
+                    file.string () << "\n";
+            else if (auto const token = keys.regenerateValidatorToken (
+                    keys.tokenSequence ()))
+                batch.push_back (token->manifest);
+            else
+            {
+                // Listing any other manifest would hide the deployed one
+                throw std::runtime_error (
+                    "Token was not issued with derived token keys: " +
+                    file.string () + ". List its manifest from a file "
+                    "instead.");
+            }
+
+            if (batch.size () == batchSize)
+                flush ();
+        }
+    }
+    else
+    {
+        std::ifstream file;
+        if (manifests != "-")
+        {
+            file.open (manifests);
+            if (! file.is_open ())
+                throw std::runtime_error (
+                    "Cannot open manifests: " + manifests);
+        }
+        std::istream& in = manifests == "-" ? std::cin : file;
+
+        for (std::string line; std::getline (in, line);)
+        {
+            line.erase (std::remove_if (line.begin (), line.end (),
+                [](unsigned char c) { return std::isspace (c); }),
+                line.end ());
+            if (line.empty ())
+                continue;
+
+            batch.push_back (listManifest (line));
+            if (batch.size () == batchSize)
+                flush ();
+        }
+    }
+    flush ();
+
+    if (builder.size () == 0)
+        throw std::runtime_error (
+            "Syntax error: Must specify manifests for the list");
+
+    std::cout << signValidatorList (
+        builder.blob (listSequence, expiration), *publisher) << std::endl;
+
+    std::cerr << "Signed validator list " << listSequence << " with " <<
+        builder.size () << " validators (" << builder.checked () <<
+        " manifests checked)\n";
+}
+
+void
+verifyValidatorList (std::string const& listFile,
+    std::string const& publisherKey,
+    std::string const& revocationsFile,
+    unsigned jobs)
+{
+    using namespace ripple;
+
+    // rippled configures publisher keys in hex, but accept base58 too
+    boost::optional<PublicKey> publisher;
+    auto const hex = strUnHex (publisherKey);
+    if (hex.second && publicKeyType (makeSlice (hex.first)))
+        publisher.emplace (makeSlice (hex.first));
+    else
+        publisher = parseBase58<PublicKey> (
+            TokenType::TOKEN_NODE_PUBLIC, publisherKey);
+    if (! publisher)
+        throw std::runtime_error (
+            "Syntax error: Invalid public key: " + publisherKey);
+
+    std::vector<PublicKey> revokedKeys;
+    if (! revocationsFile.empty ())
+    {
+        std::istringstream in (readFile (revocationsFile, "revocations"));
+        for (std::string line; std::getline (in, line);)
+        {
+            line.erase (std::remove_if (line.begin (), line.end (),
+                [](unsigned char c) { return std::isspace (c); }),
+                line.end ());
+            if (line.empty ())
+                continue;
+
+            auto const serialized = beast::detail::base64_decode (line);
+            auto const manifest = deserializeManifest (serialized);
+            if (! manifest || ! manifest->revoked () ||
+                    ! verifyManifest (serialized))
+                throw std::runtime_error ("Invalid revocation: " + line);
+            revokedKeys.push_back (manifest->masterKey);
+        }
+    }
+
+    auto const result = ripple::verifyValidatorList (
+        readFile (listFile, "validator list"), *publisher,
+        RevocationIndex (revokedKeys), jobs);
+
+    std::time_t const expiration =
+        std::time_t (result.expiration) + rippleEpochOffset;
+    std::cout << "Validator list " << result.sequence << " signed by " <<
+        toBase58 (TOKEN_NODE_PUBLIC, *publisher) << "\n";
+    std::cout << (expiration < std::time (nullptr) ?
+            "WARNING: Validator list expired " : "Expires ") <<
+        std::put_time (std::gmtime (&expiration), "%Y-%m-%d %H:%M:%S UTC") <<
+        "\n\n";
+
+    std::cout << "Trusted validators: " << result.trusted.size () << "\n";
+    std::cout << "Revoked validators: " << result.revoked.size () << "\n";
+    for (auto const& key : result.revoked)
+        std::cout << "  " << toBase58 (TOKEN_NODE_PUBLIC, key) << "\n";
+
+    if (! result.invalid.empty ())
+    {
+        std::cout << "Invalid manifests: " << result.invalid.size () << "\n";
+        for (auto const position : result.invalid)
+            std::cout << "  entry " << position << "\n";
+    }
+    std::cout << std::endl;
+
+    if (! result.invalid.empty ())
+        throw std::runtime_error (
+            "Validator list contains invalid manifests.");
+}
+
+void
+reduceManifests (std::istream& in, std::ostream& out, unsigned jobs)
+{
+    using namespace ripple;
+
+    ManifestReducer reducer (jobs);
+
+    // Only a batch of input is held at a time, so memory depends on the
+    // number of validators rather than the length of the input
+    std::size_t const batchSize = 16384;
+    std::vector<std::string> batch;
+    batch.reserve (batchSize);
+
+    // Malformed validator tokens never reach the reducer
+    std::size_t invalidTokens = 0;
+
+    for (std::string line; std::getline (in, line);)
+    {
+        line.erase (std::remove_if (line.begin (), line.end (),
+            [](unsigned char c) { return std::isspace (c); }),
+            line.end ());
+        if (line.empty ())
+            continue;
+
+        try
+        {
+            batch.push_back (listManifest (line));
+        }
+        catch (std::exception const&)
+        {
+            ++invalidTokens;
+            continue;
+        }
+        if (batch.size () == batchSize)
+        {
+            reducer.add (batch);
+            batch.clear ();
+        }
+    }
+    reducer.add (batch);
+
+    for (auto const& manifest : reducer.manifests ())
+        out << manifest << "\n";
+    out.flush ();
+
+    std::cerr << "Reduced " << reducer.added () + invalidTokens <<
+        " manifests to " << reducer.size () << " validators, " <<
+        reducer.revoked () << " revoked (" << reducer.checked () <<
+        " manifests checked, " << reducer.invalid () + invalidTokens <<
+        " invalid)\n";
+}
+
+ripple::KeyIndex
+loadKeyIndex (boost::filesystem::path const& keyDir,
+    ripple::KeyStore& store)
+{
+    using namespace ripple;
+
+    auto const files = store.list (keyDir);
+
+    KeyIndex index (files.size ());
+    for (auto const& file : files)
+    {
+        try
+        {
+            auto const keys = loadKeyFile (file, store);
+
+            if (! index.insert (keys))
+                std::cerr << "Skipping duplicate key file: " <<
+                    file.string () << "\n";
+        }
+        catch (std::exception const& e)
+        {
+            std::cerr << "Skipping key file: " << e.what () << "\n";
+        }
+    }
+
+    return index;
+}
+
+std::size_t
+inspectKeyDir (boost::filesystem::path const& keyDir,
+    std::ostream& out,
+    ripple::KeyStore& store,
+    bool json,
+    unsigned jobs)
+{
+    using namespace ripple;
+
+    auto const files = store.list (keyDir);
+    auto reports = inspectKeyFiles (files, store, 1000000, jobs);
+
+    std::uint32_t const problems = KeyFileReport::unreadable |
+        KeyFileReport::malformed | KeyFileReport::badKeyType |
+        KeyFileReport::badSecretKey | KeyFileReport::publicKeyMismatch;
+
+    std::array<std::size_t, KeyFileReport::findingCount> counts {};
+    std::size_t sound = 0;
+    std::size_t failed = 0;
+    for (auto const& report : reports)
+    {
+        for (std::size_t i = 0; i < counts.size (); ++i)
+        {
+            if (report.findings & (1u << i))
+                ++counts[i];
+        }
+        if (report.findings == 0)
+            ++sound;
+        if (report.findings & problems)
+            ++failed;
+    }
+
+    // Most severe finding first, which is the lowest bit
+    reports.erase (std::remove_if (reports.begin (), reports.end (),
+        [](KeyFileReport const& report)
+        {
+            return report.findings == 0;
+        }), reports.end ());
+    std::sort (reports.begin (), reports.end (),
+        [](KeyFileReport const& a, KeyFileReport const& b)
+        {
+            auto const severity = [](std::uint32_t findings)
+            {
+                return findings & (~findings + 1);
+            };
+            if (severity (a.findings) != severity (b.findings))
+                return severity (a.findings) < severity (b.findings);
+            return a.file < b.file;
+        });
+
+    auto const findingNames = [](std::uint32_t findings)
+    {
+        std::vector<std::string> names;
+        for (std::size_t i = 0; i < KeyFileReport::findingCount; ++i)
+        {
+            if (findings & (1u << i))
+                names.push_back (to_string (
+                    static_cast<KeyFileReport::Finding> (1u << i)));
+        }
+        return names;
+    };
+
+    if (json)
+    {
+        Json::Value jv (Json::objectValue);
+        jv["key_dir"] = keyDir.string ();
+        jv["key_files"] = Json::UInt (files.size ());
+
+        auto& jCounts = (jv["counts"] = Json::objectValue);
+        for (std::size_t i = 0; i < counts.size (); ++i)
+        {
+            std::string name = to_string (
+                static_cast<KeyFileReport::Finding> (1u << i));
+            std::replace (name.begin (), name.end (), ' ', '_');
+            jCounts[name] = Json::UInt (counts[i]);
+        }
+        jCounts["none"] = Json::UInt (sound);
+
+        auto& jFindings = (jv["findings"] = Json::arrayValue);
+        for (auto const& report : reports)
+        {
+            Json::Value jReport (Json::objectValue);
+            jReport["file"] = report.file.string ();
+            auto& jNames = (jReport["findings"] = Json::arrayValue);
+            for (auto const& name : findingNames (report.findings))
+                jNames.append (name);
+            if (report.keyType != KeyType::invalid)
+                jReport["key_type"] = to_string (report.keyType);
+            if (! (report.findings & (KeyFileReport::unreadable |
+                    KeyFileReport::malformed)))
+                jReport["token_sequence"] = report.tokenSequence;
+            if (report.publicKey)
+                jReport["public_key"] = toBase58 (
+                    TokenType::TOKEN_NODE_PUBLIC, *report.publicKey);
+            if (! report.error.empty ())
+                jReport["error"] = report.error;
+            jFindings.append (jReport);
+        }
+
+        out << to_string (jv) << std::endl;
+        return failed;
+    }
+
+    out << "Inspected " << files.size () << " key files in " <<
+        keyDir.string () << "\n";
+    for (std::size_t i = 0; i < counts.size (); ++i)
+    {
+        out << "  " << std::left << std::setw (24) << to_string (
+            static_cast<KeyFileReport::Finding> (1u << i)) <<
+            std::right << std::setw (10) << counts[i] << "\n";
+    }
+    out << "  " << std::left << std::setw (24) << "no findings" <<
+        std::right << std::setw (10) << sound << "\n";
+
+    if (! reports.empty ())
+    {
+        out << "\n" << std::left << std::setw (32) << "Findings" <<
+            std::setw (11) << "Key type" << std::setw (12) << "Sequence" <<
+            std::setw (54) << "Public key" << "File\n";
+    }
+    for (auto const& report : reports)
+    {
+        std::string names;
+        for (auto const& name : findingNames (report.findings))
+            names += (names.empty () ? "" : ", ") + name;
+
+        bool const readable = ! (report.findings & (
+            KeyFileReport::unreadable | KeyFileReport::malformed));
+
+        out << std::left << std::setw (32) << names <<
+            std::setw (11) << (report.keyType != KeyType::invalid ?
+                to_string (report.keyType) : "-") <<
+            std::setw (12) << (readable ?
+                std::to_string (report.tokenSequence) : "-") <<
+            std::setw (54) << (report.publicKey ? toBase58 (
+                TokenType::TOKEN_NODE_PUBLIC, *report.publicKey) : "-") <<
+            report.file.string ();
+        if (! report.error.empty ())
+            out << " (" << report.error << ")";
+        out << "\n";
+    }
+    out << std::right;
+    out.flush ();
+
+    return failed;
+}
+
+std::size_t
+exportKeyDir (boost::filesystem::path const& keyDir,
+    boost::filesystem::path const& file,
+    ripple::KeyStore& store,
+    unsigned jobs)
+{
+    using namespace ripple;
+
+    FleetExportWriter writer;
+    auto const failed =
+        addKeyFiles (writer, store.list (keyDir), store, jobs);
+    for (auto const& f : failed)
+        std::cerr << "Skipping key file: " << f.first.string () <<
+            " (" << f.second << ")\n";
+
+    // Readers may have the old export mapped, so it is replaced rather
+    // than rewritten
+    auto const temp = file.parent_path () / boost::filesystem::unique_path (
+        "." + file.filename ().string () + ".%%%%%%%%.tmp");
+    std::ofstream out (temp.string (), std::ios::binary | std::ios::trunc);
+    if (! out)
+        throw std::runtime_error ("Cannot write export: " + file.string ());
+    auto const rows = writer.write (out);
+    out.close ();
+
+    boost::system::error_code ec;
+    if (! out.fail ())
+        boost::filesystem::rename (temp, file, ec);
+    if (out.fail () || ec)
+    {
+        boost::filesystem::remove (temp, ec);
+        throw std::runtime_error ("Cannot write export: " + file.string ());
+    }
+
+    std::cerr << "Exported " << rows << " validators to " <<
+        file.string () << "\n";
+
+    return failed.size ();
+}
+
+std::size_t
+stampConfigFiles (std::istream& mapping, std::ostream& out,
+    ripple::ConfigStampKind kind,
+    ripple::KeyStore& store,
+    CommandOptions const& options)
+{
+    using namespace ripple;
+
+    std::vector<ConfigStamp> stamps;
+    std::string line;
+    while (std::getline (mapping, line))
+    {
+        std::istringstream fields (line);
+        std::string keyFile;
+        std::string configFile;
+        std::string extra;
+        if (! (fields >> keyFile) || keyFile.front () == '#')
+            continue;
+        if (! (fields >> configFile) || (fields >> extra))
+            throw std::runtime_error (
+                "Syntax error: Invalid stamp: " + line);
+        stamps.push_back ({keyFile, configFile});
+    }
+
+    auto const results = stampConfigs (stamps, kind, store,
+        options.tokenKeyType, options.tokenKeySource, options.jobs);
+
+    std::size_t failed = 0;
+    for (std::size_t i = 0; i < stamps.size (); ++i)
+    {
+        auto const& result = results[i];
+        if (! result.error.empty ())
+        {
+            ++failed;
+            std::cerr << "Failed to stamp " <<
+                stamps[i].configFile.string () << ": " << result.error;
+            if (result.publicKey)
+                std::cerr << " (" << (kind == ConfigStampKind::token ?
+                    "token" : "revocation") << " was issued)";
+            std::cerr << "\n";
+            continue;
+        }
+        out << toBase58 (TOKEN_NODE_PUBLIC, *result.publicKey) << " " <<
+            stamps[i].configFile.string () << "\n";
+    }
+    out.flush ();
+
+    std::cerr << "Stamped " << stamps.size () - failed << " configs, " <<
+        failed << " failed\n";
+
+    return failed;
+}
+
+void
+serveSigning (ripple::KeyIndex const& index,
+    std::istream& in, std::ostream& out)
+{
+    using namespace ripple;
+
+    std::string line;
+    while (std::getline (in, line))
+    {
+        auto const space = line.find (' ');
+        if (space == std::string::npos || space + 1 == line.size ())
+        {
+            out << "error: malformed request\n";
+            continue;
+        }
+
+        auto const publicKey = parseBase58<PublicKey> (
+            TokenType::TOKEN_NODE_PUBLIC, line.substr (0, space));
+        if (! publicKey)
+        {
+            out << "error: malformed public key\n";
+            continue;
+        }
+
+        auto const position = index.find (*publicKey);
+        if (! position)
+        {
+            out << "error: unknown public key\n";
+            continue;
+        }
+
+        if (index.revoked (*position))
+        {
+            out << "error: revoked public key\n";
+            continue;
+        }
+
+        auto const signature = index.sign (*publicKey, line.substr (space + 1));
+        if (! signature)
+        {
+            out << "error: unknown public key\n";
+            continue;
+        }
+
+        out << *signature << '\n';
+    }
+    out.flush ();
+}
+
+// Runs one batch request and returns its result
+static
+Json::Value
+runBatchRequest (Json::Value const& request,
+    boost::filesystem::path const& defaultKeyFile,
+    ripple::KeyStore& store,
+    CommandOptions const& options,
+    ripple::KeyringCache const& cache)
+{
+    using namespace ripple;
+
+    static std::map<std::string, std::size_t> const commandArgs = {
+        { "create_keys", 0 },
+        { "create_token", 0 },
+        { "regenerate_token", 1 },
+        { "revoke_keys", 0 },
+        { "sign", 1 }};
+
+    if (! request.isObject () || ! request["command"].isString ())
+        throw std::runtime_error ("Syntax error: Missing command");
+    auto const command = request["command"].asString ();
+
+    auto const iArgs = commandArgs.find (command);
+    if (iArgs == commandArgs.end ())
+        throw std::runtime_error ("Unknown batch command: " + command);
+
+    std::vector<std::string> args;
+    auto const& jArgs = request["args"];
+    if (! jArgs.isNull () && ! jArgs.isArray ())
+        throw std::runtime_error ("Syntax error: args must be an array");
+    for (auto const& arg : jArgs)
+    {
+        if (! arg.isString ())
+            throw std::runtime_error (
+                "Syntax error: args must be strings");
+        args.push_back (arg.asString ());
+    }
+
+    if (args.size () != iArgs->second)
+        throw std::runtime_error ("Syntax error: Wrong number of arguments");
+
+    auto keyFile = defaultKeyFile;
+    if (request.isMember ("keyfile"))
+    {
+        if (! request["keyfile"].isString ())
+            throw std::runtime_error (
+                "Syntax error: keyfile must be a string");
+        keyFile = request["keyfile"].asString ();
+    }
+
+    Json::Value result (Json::objectValue);
+    auto const addUpdate = [&result](KeyFileUpdate const& update,
+        char const* name)
+    {
+        result["public_key"] = toBase58 (
+            TokenType::TOKEN_NODE_PUBLIC, update.publicKey);
+        // The response is plain JSON, so the token leaves secure memory
+        result[name] = update.value.c_str ();
+    };
+
+    if (command == "create_keys")
+    {
+        result["public_key"] = toBase58 (TokenType::TOKEN_NODE_PUBLIC,
+            createValidatorKeyFile (keyFile, store, options.keyType));
+        result["keyfile"] = keyFile.string ();
+    }
+    else if (command == "create_token")
+    {
+        addUpdate (issueValidatorToken (keyFile, store,
+            options.tokenKeyType, options.tokenKeySource, &cache), "token");
+    }
+    else if (command == "regenerate_token")
+    {
+        std::uint32_t seq;
+        if (! beast::lexicalCastChecked (seq, args[0]))
+            throw std::runtime_error (
+                "Syntax error: Invalid token sequence: " + args[0]);
+
+        addUpdate (regenerateValidatorToken (keyFile, seq, store, &cache),
+            "token");
+    }
+    else if (command == "revoke_keys")
+    {
+        auto const revocation = revokeKeyFile (keyFile, store, &cache);
+        addUpdate (revocation, "revocation");
+        result["was_revoked"] = revocation.wasRevoked;
+    }
+    else if (command == "sign")
+    {
+        if (args[0].empty ())
+            throw std::runtime_error (
+                "Syntax error: Must specify data string to sign");
+
+        auto const keys = loadKeyFile (keyFile, store, &cache);
+        result["signature"] = keys.sign (args[0]);
+        result["revoked"] = keys.revoked ();
+    }
+
+    return result;
+}
+
+std::size_t
+runBatch (std::istream& in, std::ostream& out,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    CommandOptions const& options)
+{
+    using namespace ripple;
+
+    // Only this process sees the entries. They are checked against the
+    // key file fingerprint on every use, so they never need to expire.
+    KeyringCache const cache (
+        std::chrono::seconds::max (), KeyringCache::Keyring::process);
+
+    std::size_t requests = 0;
+    std::size_t failed = 0;
+    std::string line;
+    while (std::getline (in, line))
+    {
+        if (line.empty ())
+            continue;
+        ++requests;
+
+        Json::Value request;
+        Json::Value response (Json::objectValue);
+        try
+        {
+            if (! Json::Reader ().parse (line, request))
+                throw std::runtime_error ("Syntax error: Malformed JSON");
+            if (request.isObject ())
+                response["id"] = request["id"];
+
+            response["result"] = runBatchRequest (
+                request, keyFile, store, options, cache);
+        }
+        catch (std::exception const& e)
+        {
+            ++failed;
+            response["error"] = e.what ();
+        }
+
+        // Flush each response, as the caller may wait for it before
+        // sending the next request
+        out << to_string (response) << std::endl;
+    }
+
+    std::cerr << "Ran " << requests << " commands, " << failed <<
+        " failed\n";
+
+    return failed;
+}
+
+#ifndef _WIN32
+static std::atomic<ripple::SigningRingServer*> ringServer {nullptr};
+
+extern "C"
+void
+stopRingServer (int)
+{
+    if (auto const server = ringServer.load ())
+        server->stop ();
+}
+
+// Sends SIGINT and SIGTERM to a server while in scope, and puts the old
+// handlers back however the scope is left
+class RingServerSignals
+{
+public:
+    explicit
+    RingServerSignals (ripple::SigningRingServer& server)
+    {
+        ringServer = &server;
+        oldInt_ = std::signal (SIGINT, stopRingServer);
+        oldTerm_ = std::signal (SIGTERM, stopRingServer);
+    }
+
+    ~RingServerSignals ()
+    {
+        std::signal (SIGINT, oldInt_);
+        std::signal (SIGTERM, oldTerm_);
+        ringServer = nullptr;
+    }
+
+    RingServerSignals (RingServerSignals const&) = delete;
+    RingServerSignals& operator= (RingServerSignals const&) = delete;
+
+private:
+    void (*oldInt_) (int);
+    void (*oldTerm_) (int);
+};
+#endif
+
+void
+serveSigningRing (std::string const& name,
+    std::string const& spins,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store)
+{
+    using namespace ripple;
+
+    std::uint32_t spinCount;
+    if (! beast::lexicalCastChecked (spinCount, spins))
+        throw std::runtime_error (
+            "Syntax error: Invalid spin count: " + spins);
+
+    auto const keys = loadKeyFile (keyFile, store);
+
+#ifdef _WIN32
+    throw std::runtime_error (
+        "Signing rings are not supported on this platform");
+#else
+    if (keys.revoked())
+        std::cerr << "WARNING: Validator keys have been revoked!\n";
+
+    SigningRingServer server (keys, name, spinCount);
+
+    std::uint64_t served;
+    {
+        RingServerSignals const signals (server);
+
+        std::cerr << "Serving signing ring " << name << "\n";
+        served = server.run ();
+    }
+
+    std::cerr << "Signed " << served << " requests\n";
+#endif
+}
+
+void
+benchmarkKeyTypes (std::ostream& out, std::chrono::milliseconds duration)
+{
+    using namespace ripple;
+    using clock_type = std::chrono::steady_clock;
+
+    // Returns how many times per second f ran over the duration
+    auto const rate = [duration](auto&& f)
+    {
+        std::size_t calls = 0;
+        auto const start = clock_type::now ();
+        auto elapsed = clock_type::duration::zero ();
+        do
+        {
+            f ();
+            ++calls;
+            elapsed = clock_type::now () - start;
+        } while (elapsed < duration);
+
+        return calls / std::chrono::duration<double> (elapsed).count ();
+    };
+
+    std::string const data = "data to sign";
+    auto const active = CryptoKernels::active ().variant ();
+
+    out << boost::format ("%-10s %-9s %12s %12s %12s\n") %
+        "Key type" % "Variant" % "keygen/s" % "sign/s" % "verify/s";
+
+    for (auto const keyType : {KeyType::secp256k1, KeyType::ed25519})
+    {
+        auto const kp = generateKeyPair (keyType, randomSeed ());
+        auto const signature = sign (kp.first, kp.second, makeSlice (data));
+
+        // Verification does not depend on the variant
+        auto const verifying = rate ([&]
+        {
+            verify (kp.first, makeSlice (data), signature, true);
+        });
+
+        for (auto const variant : CryptoKernels::supported ())
+        {
+            auto const& kernels = CryptoKernels::get (variant);
+
+            // Keys are generated as they are for tokens
+            auto const keygen = rate ([&]
+            {
+                kernels.derivePublicKey (keyType,
+                    generateSecretKey (keyType, randomSeed ()));
+            });
+            auto const signing = rate ([&]
+            {
+                kernels.sign (kp.first, kp.second, makeSlice (data));
+            });
+
+            out << boost::format ("%-10s %-9s %12.0f %12.0f %12s\n") %
+                to_string (keyType) %
+                (to_string (variant) + (variant == active ? "*" : "")) %
+                keygen % signing %
+                (variant == CryptoVariant::library ?
+                    (boost::format ("%.0f") % verifying).str () : "");
+        }
+    }
+    out.flush ();
+}
+
 int runCommand (std::string const& command,
     std::vector <std::string> const& args,
-    boost::filesystem::path const& keyFile)
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store,
+    CommandOptions const& options)
 {
     using namespace std;
 
     static map<string, vector<string>::size_type> const commandArgs = {
+        { "batch", 0 },
+        { "benchmark_key_types", 0 },
         { "create_keys", 0 },
         { "create_token", 0 },
+        { "create_validator_list", 3 },
+        { "export", 1 },
+        { "inspect", 0 },
+        { "reduce_manifests", 1 },
+        { "regenerate_token", 1 },
         { "revoke_keys", 0 },
-        { "sign", 1 }};
+        { "serve_ring", 2 },
+        { "serve_signing", 1 },
+        { "sign", 1 },
+        { "sign_merkle", 0 },
+        { "stamp_revocations", 1 },
+        { "stamp_tokens", 1 },
+        { "verify_proof", 3 },
+        { "verify_validator_list", 2 }};
 
     auto const iArgs = commandArgs.find (command);
 
@@ -190,14 +1233,104 @@ int runCommand (std::string const& command,
     if (args.size() != iArgs->second)
         throw std::runtime_error ("Syntax error: Wrong number of arguments");
 
-    if (command == "create_keys")
-        createKeyFile (keyFile);
+    boost::optional<ripple::KeyringCache> keyCache;
+    if (options.keyCacheTtl.count () > 0)
+        keyCache.emplace (options.keyCacheTtl, options.keyCacheKeyring);
+    auto const cache = keyCache ? keyCache.get_ptr () : nullptr;
+
+    if (command == "batch")
+    {
+        if (runBatch (std::cin, std::cout, keyFile, store, options) != 0)
+            return EXIT_FAILURE;
+    }
+    else if (command == "create_keys")
+        createKeyFile (keyFile, store, options.keyType);
     else if (command == "create_token")
-        createToken (keyFile);
+        createToken (keyFile, store,
+            options.tokenKeyType, options.tokenKeySource, cache);
+    else if (command == "create_validator_list")
+        createValidatorList (args[0], args[1], args[2], keyFile, store,
+            options.previousList, options.jobs);
+    else if (command == "export")
+    {
+        if (options.keyDir.empty ())
+            throw std::runtime_error (
+                "Syntax error: export requires --keydir");
+        if (exportKeyDir (options.keyDir, args[0], store,
+                options.jobs) != 0)
+            return EXIT_FAILURE;
+    }
+    else if (command == "inspect")
+    {
+        if (options.keyDir.empty ())
+            throw std::runtime_error (
+                "Syntax error: inspect requires --keydir");
+        if (inspectKeyDir (options.keyDir, std::cout, store,
+                options.json, options.jobs) != 0)
+            return EXIT_FAILURE;
+    }
+    else if (command == "reduce_manifests")
+    {
+        if (args[0] == "-")
+        {
+            reduceManifests (std::cin, std::cout, options.jobs);
+        }
+        else
+        {
+            std::ifstream in (args[0]);
+            if (! in.is_open ())
+                throw std::runtime_error (
+                    "Cannot open manifests: " + args[0]);
+            reduceManifests (in, std::cout, options.jobs);
+        }
+    }
+    else if (command == "regenerate_token")
+        regenerateToken (args[0], keyFile, store, cache);
     else if (command == "revoke_keys")
-        createRevocation (keyFile);
+        createRevocation (keyFile, store, cache);
     else if (command == "sign")
-        signData (args[0], keyFile);
+        signData (args[0], keyFile, store, cache);
+    else if (command == "sign_merkle")
+        signMerkle (std::cin, std::cout, keyFile, store, cache,
+            options.jobs);
+    else if (command == "stamp_tokens" || command == "stamp_revocations")
+    {
+        auto const kind = command == "stamp_tokens" ?
+            ripple::ConfigStampKind::token :
+            ripple::ConfigStampKind::revocation;
+        std::size_t failed;
+        if (args[0] == "-")
+        {
+            failed = stampConfigFiles (
+                std::cin, std::cout, kind, store, options);
+        }
+        else
+        {
+            std::ifstream in (args[0]);
+            if (! in.is_open ())
+                throw std::runtime_error (
+                    "Cannot open stamps: " + args[0]);
+            failed = stampConfigFiles (
+                in, std::cout, kind, store, options);
+        }
+        if (failed != 0)
+            return EXIT_FAILURE;
+    }
+    else if (command == "verify_proof")
+        verifyProof (args[0], args[1], args[2]);
+    else if (command == "verify_validator_list")
+        verifyValidatorList (args[0], args[1], options.revocations,
+            options.jobs);
+    else if (command == "serve_signing")
+    {
+        auto const index = loadKeyIndex (args[0], store);
+        std::cerr << "Loaded " << index.size () << " validator keys\n";
+        serveSigning (index, std::cin, std::cout);
+    }
+    else if (command == "serve_ring")
+        serveSigningRing (args[0], args[1], keyFile, store);
+    else if (command == "benchmark_key_types")
+        benchmarkKeyTypes (std::cout);
 
     return 0;
 }
@@ -223,10 +1356,52 @@ void printHelp (const boost::program_options::options_description& desc)
         << "validator-keys [options] <command> [<argument> ...]\n"
         << desc << std::endl
         << "Commands: \n"
+           "     batch              Run commands read from stdin as JSON\n"
+           "                        lines, printing a JSON result for each.\n"
+           "     benchmark_key_types\n"
+           "                        Measure key generation, signing and\n"
+           "                        verification rates for each key type.\n"
            "     create_keys        Generate validator keys.\n"
            "     create_token       Generate validator token.\n"
+           "     create_validator_list <manifests> <sequence> <days>\n"
+           "                        Sign a validator list of the manifests\n"
+           "                        in a file (or - for stdin) or of the key\n"
+           "                        files in a directory, expiring in days.\n"
+           "     export <file>      Write the public keys, sequences and\n"
+           "                        current manifests of the key files in\n"
+           "                        --keydir to a columnar binary file.\n"
+           "     inspect            Check the key files in --keydir and\n"
+           "                        report those that are revoked, near\n"
+           "                        their last token or damaged.\n"
+           "     reduce_manifests <manifests>\n"
+           "                        Print the current manifest of each\n"
+           "                        validator among the manifests in a file\n"
+           "                        (or - for stdin).\n"
+           "     regenerate_token <sequence>\n"
+           "                        Regenerate a token created with\n"
+           "                        --derive-token-keys.\n"
            "     revoke_keys        Revoke validator keys.\n"
-           "     sign <data>        Sign string with validator key.\n";
+           "     sign <data>        Sign string with validator key.\n"
+           "     sign_merkle        Sign a Merkle tree over lines from stdin and\n"
+           "                        print an inclusion proof for each line.\n"
+           "     stamp_revocations <stamps>\n"
+           "                        Revoke the keys of each key file in a\n"
+           "                        file of \"<key file> <rippled.cfg>\" lines\n"
+           "                        (or - for stdin) and write the\n"
+           "                        revocation into its rippled.cfg.\n"
+           "     stamp_tokens <stamps>\n"
+           "                        Likewise create a token for each key\n"
+           "                        file and write it into its rippled.cfg.\n"
+           "     verify_proof <public key> <data> <proof>\n"
+           "                        Verify a proof printed by sign_merkle.\n"
+           "     verify_validator_list <list> <publisher key>\n"
+           "                        Verify a validator list and its manifests.\n"
+           "     serve_ring <name> <spins>\n"
+           "                        Sign requests from shared memory ring name,\n"
+           "                        polling spins times before sleeping.\n"
+           "     serve_signing <keydir>\n"
+           "                        Sign \"<public key> <data>\" lines from stdin\n"
+           "                        with the keys in keydir.\n";
 }
 //LCOV_EXCL_STOP
 
@@ -243,6 +1418,15 @@ getVersionString ()
     return value;
 }
 
+// The unit tests check that the version string parses, so it is printed
+// without paying for that on every run
+static
+void
+printVersion ()
+{
+    std::cout << "validator-keys version " << versionString << std::endl;
+}
+
 int main (int argc, char** argv)
 {
 #if defined(__GNUC__) && !defined(__clang__)
@@ -257,6 +1441,14 @@ int main (int argc, char** argv)
     static_assert (BOOST_VERSION >= 105700,
         "Boost version 1.57 or later is required to compile validator-keys");
 
+    // Scripts ask for the version often, so answer before paying for
+    // option parsing.
+    if (argc == 2 && std::strcmp (argv[1], "--version") == 0)
+    {
+        printVersion ();
+        return 0;
+    }
+
     namespace po = boost::program_options;
 
     po::variables_map vm;
@@ -267,7 +1459,41 @@ int main (int argc, char** argv)
     general.add_options ()
     ("help,h", "Display this message.")
     ("keyfile", po::value<std::string> (), "Specify the key file.")
-    ("unittest,u", "Perform unit tests.")
+    ("keydir", po::value<std::string> (),
+        "Directory of key files to inspect or export.")
+    ("json", "Print the inspect report as JSON.")
+    ("key-type", po::value<std::string> (),
+        "Key type for new validator keys: ed25519 (default) or secp256k1.")
+    ("token-key-type", po::value<std::string> (),
+        "Key type for new token keys: secp256k1 (default) or ed25519.")
+    ("derive-token-keys",
+        "Derive token keys from the validator key and token sequence, so "
+        "tokens can be regenerated.")
+    ("previous-list", po::value<std::string> (),
+        "Validator list last signed by create_validator_list, whose "
+        "manifests need not be checked again.")
+    ("revocations", po::value<std::string> (),
+        "File of revocations, one per line, whose keys "
+        "verify_validator_list reports as revoked.")
+    ("key-cache", po::value<unsigned> (),
+        "Keep decoded keys in the kernel keyring for this many seconds "
+        "(Linux only).")
+    ("key-cache-keyring", po::value<std::string> (),
+        "Keyring for --key-cache: user (default) or session.")
+    ("jobs", po::value<unsigned> (),
+        "Threads for commands that work in parallel. Defaults to the CPUs "
+        "the process may use, within its affinity mask and cgroup limit.")
+    ("crypto-variant", po::value<std::string> (),
+        "Build of the crypto code to sign with: library, sse2, x86_64 or "
+        "avx2. The fastest one this host supports is used by default.")
+    ("unittest,u", po::value <std::string> ()->implicit_value (""),
+        "Perform unit tests. Manual suites, such as benchmarks, only run "
+        "when named explicitly.")
+    ("unittest-arg", po::value <std::string> ()->default_value (""),
+        "Supply an argument to the unit test suites, such as the "
+        "configuration of a benchmark.")
+    ("unittest-jobs", po::value <unsigned> (),
+        "Run unit test suites concurrently in this many processes.")
     ("version", "Display the build version.")
     ;
 
@@ -305,13 +1531,19 @@ int main (int argc, char** argv)
     // Run the unit tests if requested.
     // The unit tests will exit the application with an appropriate return code.
     if (vm.count ("unittest"))
-        return runUnitTests();
+    {
+        boost::optional<unsigned> jobs;
+        if (vm.count ("unittest-jobs"))
+            jobs = std::max (vm["unittest-jobs"].as<unsigned> (), 1u);
+
+        return runUnitTests (vm["unittest"].as<std::string> (),
+            vm["unittest-arg"].as<std::string> (), jobs);
+    }
 
     //LCOV_EXCL_START
     if (vm.count ("version"))
     {
-        std::cout << "validator-keys version " <<
-            getVersionString () << std::endl;
+        printVersion ();
         return 0;
     }
 
@@ -321,23 +1553,59 @@ int main (int argc, char** argv)
         return EXIT_SUCCESS;
     }
 
-    std::string const homeDir = getEnvVar ("HOME");
-    std::string const defaultKeyFile =
-        (homeDir.empty () ?
+    auto const defaultKeyFile = []
+    {
+        std::string const homeDir = getEnvVar ("HOME");
+        return (homeDir.empty () ?
             boost::filesystem::current_path ().string () : homeDir) +
-        "/.ripple/validator-keys.json";
+            "/.ripple/validator-keys.json";
+    };
 
     try
     {
         using namespace boost::filesystem;
         path keyFile = vm.count ("keyfile") ?
             vm["keyfile"].as<std::string> () :
-            defaultKeyFile;
+            defaultKeyFile ();
+
+        CommandOptions options;
+        if (vm.count ("key-type"))
+            options.keyType = parseKeyType (
+                vm["key-type"].as<std::string> ());
+        if (vm.count ("token-key-type"))
+            options.tokenKeyType = parseKeyType (
+                vm["token-key-type"].as<std::string> ());
+        if (vm.count ("derive-token-keys"))
+            options.tokenKeySource = ripple::TokenKeySource::derived;
+        if (vm.count ("keydir"))
+            options.keyDir = vm["keydir"].as<std::string> ();
+        if (vm.count ("json"))
+            options.json = true;
+        if (vm.count ("previous-list"))
+            options.previousList = vm["previous-list"].as<std::string> ();
+        if (vm.count ("revocations"))
+            options.revocations = vm["revocations"].as<std::string> ();
+        if (vm.count ("key-cache"))
+            options.keyCacheTtl = std::chrono::seconds (
+                vm["key-cache"].as<unsigned> ());
+        if (vm.count ("key-cache-keyring"))
+            options.keyCacheKeyring = parseKeyring (
+                vm["key-cache-keyring"].as<std::string> ());
+        if (vm.count ("jobs"))
+        {
+            options.jobs = vm["jobs"].as<unsigned> ();
+            ripple::setDefaultThreadPoolSize (options.jobs);
+        }
+        if (vm.count ("crypto-variant"))
+            ripple::CryptoKernels::activate (parseCryptoVariant (
+                vm["crypto-variant"].as<std::string> ()));
 
         return runCommand (
             vm["command"].as<std::string>(),
             vm["arguments"].as<std::vector<std::string>>(),
-            keyFile);
+            keyFile,
+            ripple::defaultKeyStore (),
+            options);
     }
     catch(std::exception const& e)
     {
@@ -18,7 +18,16 @@
 */
 //==============================================================================
 
+#include <ConfigStamper.h>
+#include <CryptoKernels.h>
+#include <KeyIndex.h>
+#include <KeyStore.h>
+#include <KeyringCache.h>
+#include <ValidatorKeys.h>
+#include <ripple/crypto/KeyType.h>
 #include <boost/optional.hpp>
+#include <chrono>
+#include <iosfwd>
 #include <vector>
 
 namespace boost
@@ -32,20 +41,303 @@ class path;
 std::string const&
 getVersionString ();
 
+/** Options that apply across commands */
+struct CommandOptions
+{
+    /// Key type for new validator keys
+    ripple::KeyType keyType = ripple::KeyType::ed25519;
+
+    /// Key type for the ephemeral keys in new tokens
+    ripple::KeyType tokenKeyType = ripple::KeyType::secp256k1;
+
+    /// How the secret keys of new tokens are generated
+    ripple::TokenKeySource tokenKeySource = ripple::TokenKeySource::random;
+
+    /// Validator list whose manifests create_validator_list need not
+    /// check again
+    std::string previousList;
+
+    /// File of revocations for verify_validator_list, or empty
+    std::string revocations;
+
+    /// How long decoded keys stay in the kernel keyring, or zero to
+    /// always read the key file
+    std::chrono::seconds keyCacheTtl {0};
+
+    /// Keyring holding decoded keys
+    ripple::KeyringCache::Keyring keyCacheKeyring =
+        ripple::KeyringCache::Keyring::user;
+
+    /// Most threads a command may work with, or zero for one per CPU
+    /// the process may use
+    unsigned jobs = 0;
+
+    /// Directory of key files for inspect and export
+    std::string keyDir;
+
+    /// Print reports as JSON rather than as a table
+    bool json = false;
+};
+
+/** Returns the key type named by a string
+
+    @throws std::runtime_error if the name is not a key type
+*/
+ripple::KeyType
+parseKeyType (std::string const& name);
+
+/** Returns the keyring named by a string
+
+    @throws std::runtime_error if the name is not "user" or "session"
+*/
+ripple::KeyringCache::Keyring
+parseKeyring (std::string const& name);
+
+/** Returns the crypto variant named by a string
+
+    @throws std::runtime_error if the name is not a crypto variant
+*/
+ripple::CryptoVariant
+parseCryptoVariant (std::string const& name);
+
+void
+createKeyFile (boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    ripple::KeyType keyType = ripple::KeyType::ed25519);
+
 void
-createKeyFile (boost::filesystem::path const& keyFile);
+createToken (boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    ripple::KeyType tokenKeyType = ripple::KeyType::secp256k1,
+    ripple::TokenKeySource source = ripple::TokenKeySource::random,
+    ripple::KeyringCache const* cache = nullptr);
 
+/** Prints the token previously issued for a sequence with derived keys,
+    using the token key type recorded in the key file */
 void
-createToken (boost::filesystem::path const& keyFile);
+regenerateToken (std::string const& sequence,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    ripple::KeyringCache const* cache = nullptr);
 
 void
-createRevocation (boost::filesystem::path const& keyFile);
+createRevocation (boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    ripple::KeyringCache const* cache = nullptr);
 
 void
 signData (std::string const& data,
-    boost::filesystem::path const& keyFile);
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    ripple::KeyringCache const* cache = nullptr);
+
+/** Signs the root of a Merkle tree over payloads read from a stream
+
+    Each line of input is a payload. For each payload, a line holding
+    its base64-encoded inclusion proof, with the signed root, is written.
+
+    @param jobs Threads to hash with, or zero for one per CPU
+*/
+void
+signMerkle (std::istream& in, std::ostream& out,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    ripple::KeyringCache const* cache = nullptr,
+    unsigned jobs = 0);
+
+/** Checks that a payload is included in a signed Merkle tree
+
+    @throws std::runtime_error if the public key or proof is malformed,
+            or the proof does not hold
+*/
+void
+verifyProof (std::string const& publicKey,
+    std::string const& data,
+    std::string const& proof);
+
+/** Prints a validator list signed with the publisher's current token
+
+    The publisher is the key file, and its current token must have been
+    created with derived token keys, so that it can be regenerated. The
+    token key type recorded in each key file is used.
+
+    @param manifests File with one base64 manifest or validator token
+                     per line, "-" for standard input, or a directory of
+                     key files whose current manifests are listed. Every
+                     current token in the directory must have been
+                     created with derived token keys.
+
+    @param days Days until the list expires
+
+    @param previousList Path of the last list signed by this publisher,
+                        or empty
+
+    @param jobs Threads to check manifests with, or zero for one per CPU
+*/
+void
+createValidatorList (std::string const& manifests,
+    std::string const& sequence,
+    std::string const& days,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    std::string const& previousList = std::string (),
+    unsigned jobs = 0);
+
+/** Prints the validators a validator list trusts and revokes
+
+    @param publisherKey Publisher master key, in hex or base58
+
+    @param revocationsFile File with one base64 revocation per line, or
+                           empty
+
+    @param jobs Threads to check manifests with, or zero for one per CPU
+
+    @throws std::runtime_error if the list or a revocation is not valid,
+            or the list contains invalid manifests
+*/
+void
+verifyValidatorList (std::string const& listFile,
+    std::string const& publisherKey,
+    std::string const& revocationsFile = std::string (),
+    unsigned jobs = 0);
+
+/** Prints the current manifest of each validator among many
+
+    Each line of input holds a base64 manifest or validator token. The
+    manifest with the highest sequence for each master key is printed,
+    base64-encoded, one per line in master key order, so a revocation
+    replaces every other manifest. Malformed validator tokens, and
+    manifests that are malformed or whose signatures do not verify, are
+    counted as invalid and skipped.
+
+    @param jobs Threads to check manifests with, or zero for one per CPU
+*/
+void
+reduceManifests (std::istream& in, std::ostream& out, unsigned jobs = 0);
+
+/** Loads every key file in a directory into an index
+
+    Key files that cannot be loaded are reported on stderr and skipped.
+*/
+ripple::KeyIndex
+loadKeyIndex (boost::filesystem::path const& keyDir,
+    ripple::KeyStore& store = ripple::defaultKeyStore ());
+
+/** Writes a health report of the key files in a directory
+
+    Every key file is read and checked, and its public key derived, on
+    several threads (see inspectKeyFiles). The report counts the key
+    files with each finding, then lists those with any finding, most
+    severe first and then by path, as a table or as a JSON object.
+
+    @param jobs Threads to use, or zero for one per CPU
+
+    @return Number of key files with findings more severe than a
+    sequence near the limit
+
+    @throws std::runtime_error if the directory cannot be read
+*/
+std::size_t
+inspectKeyDir (boost::filesystem::path const& keyDir,
+    std::ostream& out,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    bool json = false,
+    unsigned jobs = 0);
+
+/** Writes the public data of the key files in a directory to a file
+
+    The file is a fleet export (see FleetExport), replacing any file
+    already there, so that readers which have mapped it keep the old
+    contents. Key files that cannot be read are reported on stderr and
+    skipped. Only tokens the key files record as issued with derived
+    token keys are exported with their manifests.
+
+    @param jobs Threads to use, or zero for one per CPU
+
+    @return Number of key files skipped
+
+    @throws std::runtime_error if the directory cannot be read or the
+            file cannot be written
+*/
+std::size_t
+exportKeyDir (boost::filesystem::path const& keyDir,
+    boost::filesystem::path const& file,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    unsigned jobs = 0);
+
+/** Writes tokens or revocations into the rippled configs of many
+    validators
+
+    Each line of the mapping holds a key file and the path of the
+    rippled.cfg of the server it is used on, separated by whitespace.
+    Blank lines and lines starting with '#' are skipped. The configs are
+    stamped together (see stampConfigs), and for each one stamped a line
+    with the validator public key and the config is written. Stamps that
+    fail are reported on stderr.
+
+    @return Number of configs that were not stamped
+
+    @throws std::runtime_error if a line is malformed, or a key file or
+            config is listed twice
+*/
+std::size_t
+stampConfigFiles (std::istream& mapping, std::ostream& out,
+    ripple::ConfigStampKind kind,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    CommandOptions const& options = CommandOptions ());
+
+/** Signs requests read from a stream with keys from an index
+
+    Each request line holds a base58 validator public key, a space, and
+    the data to sign. Each response line holds the hex-encoded signature
+    or a line starting with "error: ". Revoked keys never sign.
+*/
+void
+serveSigning (ripple::KeyIndex const& index,
+    std::istream& in, std::ostream& out);
+
+/** Runs commands read from a stream in this process
+
+    Each request line is a JSON object naming a command, with optional
+    "args" (an array of strings), "keyfile" (overriding keyFile) and
+    "id" (any value, copied into the response). The commands are
+    create_keys, create_token, regenerate_token, revoke_keys and sign.
+    Each response line is a JSON object holding the id and either a
+    "result" object or an "error" string, written as soon as the command
+    finishes. Decoded keys are cached in memory between commands.
+
+    @return Number of requests that failed
+*/
+std::size_t
+runBatch (std::istream& in, std::ostream& out,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    CommandOptions const& options = CommandOptions ());
+
+/** Signs requests from a shared memory ring with a resident key
+
+    Creates the named ring and serves it until interrupted.
+*/
+void
+serveSigningRing (std::string const& name,
+    std::string const& spins,
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore ());
+
+/** Writes key generation, signing and verification rates for each
+    key type and crypto variant on this host
+
+    The active variant is marked with an asterisk.
+
+    @param duration How long to measure each operation
+*/
+void
+benchmarkKeyTypes (std::ostream& out,
+    std::chrono::milliseconds duration = std::chrono::milliseconds {500});
 
 int
 runCommand (std::string const& command,
     std::vector <std::string> const& arg,
-    boost::filesystem::path const& keyFile);
+    boost::filesystem::path const& keyFile,
+    ripple::KeyStore& store = ripple::defaultKeyStore (),
+    CommandOptions const& options = CommandOptions ());
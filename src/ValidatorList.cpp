@@ -0,0 +1,312 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <ValidatorList.h>
+#include <CryptoKernels.h>
+#include <Parallel.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/json/json_reader.h>
+#include <ripple/protocol/Sign.h>
+#include <beast/core/detail/base64.hpp>
+#include <stdexcept>
+
+namespace ripple {
+
+namespace {
+
+void
+appendHex (std::string& s, std::uint8_t const* data, std::size_t size)
+{
+    static char const hex[] = "0123456789ABCDEF";
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        s += hex[data[i] >> 4];
+        s += hex[data[i] & 0x0f];
+    }
+}
+
+boost::optional<std::string>
+openBlob (Json::Value const& list, PublicKey const& signingKey)
+{
+    if (! list.isObject () ||
+            ! list["blob"].isString () || ! list["signature"].isString ())
+        return boost::none;
+
+    auto blob = beast::detail::base64_decode (list["blob"].asString ());
+    auto const signature = strUnHex (list["signature"].asString ());
+    if (! signature.second || ! verify (signingKey,
+            makeSlice (blob), makeSlice (signature.first)))
+        return boost::none;
+
+    return blob;
+}
+
+} // namespace
+
+ValidatorListBuilder::ValidatorListBuilder (unsigned threads)
+    : threads_ (threads)
+{
+}
+
+bool
+ValidatorListBuilder::seed (std::string const& blob)
+{
+    Json::Value jv;
+    if (! Json::Reader ().parse (blob, jv) || ! jv.isObject () ||
+            ! jv["validators"].isArray ())
+        return false;
+
+    std::map<PublicKey, std::string> seeded;
+    for (auto const& validator : jv["validators"])
+    {
+        if (! validator.isObject () ||
+                ! validator["validation_public_key"].isString () ||
+                ! validator["manifest"].isString ())
+            return false;
+
+        auto const key = strUnHex (
+            validator["validation_public_key"].asString ());
+        if (! key.second || ! publicKeyType (makeSlice (key.first)))
+            return false;
+
+        seeded.emplace (PublicKey (makeSlice (key.first)),
+            validator["manifest"].asString ());
+    }
+
+    for (auto& entry : seeded)
+        seeded_[entry.first] = std::move (entry.second);
+    return true;
+}
+
+void
+ValidatorListBuilder::add (std::vector<std::string> const& manifests)
+{
+    enum Status : char { invalid, unchecked, valid };
+    std::vector<Status> status (manifests.size (), invalid);
+    std::vector<boost::optional<ManifestDecoder>> decoded (manifests.size ());
+
+    // Decoding is cheap, but checking signatures is not, so large
+    // batches are spread over threads by verifyManifests
+    parallelFor (manifests.size (), threads_, 1024, [&](std::size_t i)
+    {
+        decoded[i].emplace (beast::detail::base64_decode (manifests[i]));
+        auto const& manifest = decoded[i]->manifest ();
+        if (! manifest)
+            return;
+
+        auto const seeded = seeded_.find (manifest->masterKey);
+        status[i] = seeded != seeded_.end () &&
+            seeded->second == manifests[i] ? valid : unchecked;
+    });
+
+    std::vector<ManifestDecoder const*> pending;
+    for (std::size_t i = 0; i < manifests.size (); ++i)
+        if (status[i] == unchecked)
+            pending.push_back (&*decoded[i]);
+
+    auto const verified = verifyManifests (pending, threads_);
+    for (std::size_t i = 0, next = 0; i < manifests.size (); ++i)
+        if (status[i] == unchecked)
+            status[i] = verified[next++] ? valid : invalid;
+
+    checked_ += pending.size ();
+
+    for (std::size_t i = 0; i < manifests.size (); ++i)
+    {
+        if (status[i] != valid)
+            throw std::runtime_error ("Invalid manifest: " + manifests[i]);
+
+        auto const& manifest = *decoded[i]->manifest ();
+        auto const result = entries_.emplace (manifest.masterKey,
+            Entry { manifest.sequence, manifests[i] });
+        if (! result.second &&
+                result.first->second.sequence < manifest.sequence)
+            result.first->second = Entry {
+                manifest.sequence, manifests[i] };
+    }
+}
+
+std::string
+ValidatorListBuilder::blob (
+    std::uint32_t sequence, std::uint32_t expiration) const
+{
+    static char const entryStart[] = "{\"validation_public_key\":\"";
+    static char const entryMiddle[] = "\",\"manifest\":\"";
+    static char const entryEnd[] = "\"}";
+
+    std::size_t size = 64;
+    for (auto const& entry : entries_)
+        size += sizeof (entryStart) + sizeof (entryMiddle) +
+            sizeof (entryEnd) + 2 * entry.first.size () +
+            entry.second.manifest.size ();
+
+    std::string s;
+    s.reserve (size);
+    s += "{\"sequence\":";
+    s += std::to_string (sequence);
+    s += ",\"expiration\":";
+    s += std::to_string (expiration);
+    s += ",\"validators\":[";
+
+    bool first = true;
+    for (auto const& entry : entries_)
+    {
+        if (! first)
+            s += ',';
+        first = false;
+
+        s += entryStart;
+        appendHex (s, entry.first.data (), entry.first.size ());
+        s += entryMiddle;
+        s += entry.second.manifest;
+        s += entryEnd;
+    }
+
+    s += "]}";
+    return s;
+}
+
+std::string
+signValidatorList (std::string const& blob, ValidatorToken const& publisher)
+{
+    auto const manifest = deserializeManifest (
+        beast::detail::base64_decode (publisher.manifest));
+    if (! manifest || ! manifest->signingKey)
+        throw std::runtime_error ("Invalid publisher manifest");
+
+    auto const signature = CryptoKernels::active ().sign (
+        *manifest->signingKey, *publisher.secretKey, makeSlice (blob));
+    auto const encoded = beast::detail::base64_encode (blob);
+
+    std::string s;
+    s.reserve (128 + encoded.size () + publisher.manifest.size () +
+        2 * (manifest->masterKey.size () + signature.size ()));
+    s += "{\"blob\":\"";
+    s += encoded;
+    s += "\",\"manifest\":\"";
+    s += publisher.manifest;
+    s += "\",\"public_key\":\"";
+    appendHex (s, manifest->masterKey.data (), manifest->masterKey.size ());
+    s += "\",\"signature\":\"";
+    appendHex (s, signature.data (), signature.size ());
+    s += "\",\"version\":1}";
+    return s;
+}
+
+boost::optional<std::string>
+openValidatorList (std::string const& list, PublicKey const& signingKey)
+{
+    Json::Value jv;
+    if (! Json::Reader ().parse (list, jv))
+        return boost::none;
+    return openBlob (jv, signingKey);
+}
+
+VerifiedValidatorList
+verifyValidatorList (std::string const& list,
+    PublicKey const& publisherKey,
+    RevocationIndex const& revocations,
+    unsigned threads)
+{
+    Json::Value jv;
+    if (! Json::Reader ().parse (list, jv) || ! jv.isObject () ||
+            ! jv["manifest"].isString ())
+        throw std::runtime_error ("Malformed validator list");
+
+    auto const serialized =
+        beast::detail::base64_decode (jv["manifest"].asString ());
+    auto const publisher = deserializeManifest (serialized);
+    if (! publisher || ! verifyManifest (serialized))
+        throw std::runtime_error ("Invalid publisher manifest");
+    if (publisher->masterKey != publisherKey)
+        throw std::runtime_error (
+            "Validator list is from another publisher");
+    if (publisher->revoked () || revocations.contains (publisherKey))
+        throw std::runtime_error ("Publisher keys have been revoked");
+
+    auto const blob = openBlob (jv, *publisher->signingKey);
+    if (! blob)
+        throw std::runtime_error ("Invalid validator list signature");
+
+    Json::Value jBlob;
+    if (! Json::Reader ().parse (*blob, jBlob) || ! jBlob.isObject () ||
+            ! jBlob["sequence"].isIntegral () ||
+            ! jBlob["expiration"].isIntegral () ||
+            ! jBlob["validators"].isArray ())
+        throw std::runtime_error ("Malformed validator list");
+
+    VerifiedValidatorList result;
+    result.sequence = jBlob["sequence"].asUInt ();
+    result.expiration = jBlob["expiration"].asUInt ();
+
+    struct Entry
+    {
+        std::string key;
+        std::string manifest;
+    };
+
+    std::vector<Entry> entries;
+    entries.reserve (jBlob["validators"].size ());
+    for (auto const& validator : jBlob["validators"])
+    {
+        if (! validator.isObject () ||
+                ! validator["validation_public_key"].isString () ||
+                ! validator["manifest"].isString ())
+            throw std::runtime_error ("Malformed validator list");
+        entries.push_back ({
+            validator["validation_public_key"].asString (),
+            validator["manifest"].asString () });
+    }
+    jBlob = Json::Value ();
+
+    enum Status : char { invalid, revoked, trusted };
+    std::vector<Status> status (entries.size (), invalid);
+    std::vector<boost::optional<Manifest>> manifests (entries.size ());
+
+    parallelFor (entries.size (), threads, 64, [&](std::size_t i)
+    {
+        auto const key = strUnHex (entries[i].key);
+        auto const serialized =
+            beast::detail::base64_decode (entries[i].manifest);
+        auto& manifest = manifests[i];
+        manifest = deserializeManifest (serialized);
+        if (! key.second || ! manifest ||
+                makeSlice (key.first) != manifest->masterKey.slice () ||
+                ! verifyManifest (serialized))
+            return;
+
+        status[i] = manifest->revoked () ||
+            revocations.contains (manifest->masterKey) ? revoked : trusted;
+    });
+
+    for (std::size_t i = 0; i < entries.size (); ++i)
+    {
+        if (status[i] == trusted)
+            result.trusted.push_back (manifests[i]->masterKey);
+        else if (status[i] == revoked)
+            result.revoked.push_back (manifests[i]->masterKey);
+        else
+            result.invalid.push_back (i);
+    }
+
+    return result;
+}
+
+} // ripple
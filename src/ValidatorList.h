@@ -0,0 +1,182 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_VALIDATORLIST_H_INCLUDED
+#define VALIDATOR_KEYS_VALIDATORLIST_H_INCLUDED
+
+#include <Manifest.h>
+#include <RevocationIndex.h>
+#include <ValidatorKeys.h>
+#include <ripple/protocol/PublicKey.h>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace ripple {
+
+/** Builds the blob of a validator list
+
+    The blob is the JSON object
+
+        {"sequence":<n>,"expiration":<seconds since 2000-01-01>,
+         "validators":[{"validation_public_key":"<hex master key>",
+                        "manifest":"<base64 manifest>"}, ...]}
+
+    with one entry per master key, in master key order. It is written
+    straight into a string sized in advance rather than built as a
+    Json::Value tree, so building a list takes little more memory than
+    the manifests themselves.
+
+    Checking manifest signatures is most of the cost of a large list.
+    Manifests that appear in a previously signed list (see seed) are not
+    checked again, so re-signing a list in which a few entries changed
+    only checks those entries.
+*/
+class ValidatorListBuilder
+{
+public:
+    /** @param threads Threads to check signatures with, or zero for one
+                       per core
+    */
+    explicit
+    ValidatorListBuilder (unsigned threads = 0);
+
+    /** Accepts the manifests in a blob as already checked
+
+        Only pass the blob of a list whose signature was verified.
+
+        @return false if the blob is malformed
+    */
+    bool
+    seed (std::string const& blob);
+
+    /** Adds base64-encoded manifests
+
+        Of several manifests for one master key, the one with the
+        highest sequence is kept.
+
+        @throws std::runtime_error if a manifest is malformed or its
+                signatures do not verify
+    */
+    void
+    add (std::vector<std::string> const& manifests);
+
+    /** Returns the number of entries */
+    std::size_t
+    size () const
+    {
+        return entries_.size ();
+    }
+
+    /** Returns the number of manifests whose signatures were checked */
+    std::size_t
+    checked () const
+    {
+        return checked_;
+    }
+
+    /** Returns the blob for the entries added so far */
+    std::string
+    blob (std::uint32_t sequence, std::uint32_t expiration) const;
+
+private:
+    struct Entry
+    {
+        std::uint32_t sequence;
+        std::string manifest;
+    };
+
+    unsigned threads_;
+    std::map<PublicKey, Entry> entries_;
+
+    // Manifests known to be valid, by master key
+    std::map<PublicKey, std::string> seeded_;
+
+    std::size_t checked_ = 0;
+};
+
+/** Returns a validator list signed by a publisher
+
+    The list is the JSON object rippled fetches from a publisher site:
+
+        {"blob":"<base64 blob>","manifest":"<publisher manifest>",
+         "public_key":"<hex publisher master key>",
+         "signature":"<hex signature of the blob>","version":1}
+
+    @param publisher Publisher token, whose key signs the blob
+
+    @throws std::runtime_error if the token manifest is malformed
+*/
+std::string
+signValidatorList (std::string const& blob, ValidatorToken const& publisher);
+
+/** Returns the blob of a validator list signed with a given key
+
+    @return boost::none if the list is malformed or its signature does
+            not verify with the key
+*/
+boost::optional<std::string>
+openValidatorList (std::string const& list, PublicKey const& signingKey);
+
+/** Contents of a verified validator list */
+struct VerifiedValidatorList
+{
+    std::uint32_t sequence;
+
+    /// Seconds since 2000-01-01
+    std::uint32_t expiration;
+
+    /// Master keys of the validators to trust
+    std::vector<PublicKey> trusted;
+
+    /// Master keys that are listed but revoked
+    std::vector<PublicKey> revoked;
+
+    /// Positions of entries whose manifest is malformed, does not verify,
+    /// or is not for the listed key
+    std::vector<std::size_t> invalid;
+};
+
+/** Verifies a validator list and every manifest in it
+
+    Entry manifests are checked on several threads. An entry is revoked
+    if its manifest is a revocation or its key is in the index.
+
+    @param publisherKey Master key of the expected publisher
+
+    @param revocations Master keys known to be revoked
+
+    @param threads Threads to check manifests with, or zero for one per
+                   core
+
+    @throws std::runtime_error if the list is malformed, was not signed
+            by the publisher's current key, or the publisher is revoked
+*/
+VerifiedValidatorList
+verifyValidatorList (std::string const& list,
+    PublicKey const& publisherKey,
+    RevocationIndex const& revocations = RevocationIndex (),
+    unsigned threads = 0);
+
+} // ripple
+
+#endif
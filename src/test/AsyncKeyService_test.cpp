@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <AsyncKeyService.h>
+#include <test/KeyFileGuard.h>
+#include <ripple/beast/unit_test.h>
+#include <set>
+
+namespace ripple {
+
+namespace tests {
+
+class AsyncKeyService_test : public beast::unit_test::suite
+{
+private:
+    void
+    testFutures ()
+    {
+        testcase ("Futures");
+
+        using namespace boost::filesystem;
+
+        std::string const subdir = "test_key_file";
+        path const keyFile = subdir / "validator_keys.json";
+        KeyFileGuard const g (*this, subdir);
+
+        AsyncKeyService service (2, 1);
+        auto const keys = std::make_shared<ValidatorKeys> (KeyType::ed25519);
+
+        std::string const data = "data to sign";
+        BEAST_EXPECT (service.sign (keys, data).get () == keys->sign (data));
+
+        // Concurrent token creation never repeats a sequence
+        std::vector<std::future<boost::optional<ValidatorToken>>> tokens;
+        for (int i = 0; i < 100; ++i)
+            tokens.push_back (service.createToken (keys, KeyType::ed25519));
+        std::set<std::string> manifests;
+        for (auto& token : tokens)
+        {
+            auto const t = token.get ();
+            if (BEAST_EXPECT (t))
+                manifests.insert (t->manifest);
+        }
+        BEAST_EXPECT (manifests.size () == tokens.size ());
+        BEAST_EXPECT (keys->tokenSequence () == tokens.size ());
+
+        service.store (keys, keyFile).get ();
+        auto const loaded = service.load (keyFile).get ();
+        if (BEAST_EXPECT (loaded))
+            BEAST_EXPECT (*loaded == *keys);
+
+        // Keys are encoded when stored, not when written
+        auto const stored = service.store (keys, keyFile);
+        keys->createValidatorToken (KeyType::ed25519);
+        stored.wait ();
+        BEAST_EXPECT (ValidatorKeys::make_ValidatorKeys (
+            keyFile).tokenSequence () == tokens.size ());
+
+        // Errors are those of the synchronous calls
+        path const missing = subdir / "missing.json";
+        try
+        {
+            service.load (missing).get ();
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                "Failed to open key file: " + missing.string ());
+        }
+
+        path const badFile = subdir / "bad.json";
+        defaultKeyStore ().store (badFile, "{");
+        try
+        {
+            service.load (badFile).get ();
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                "Unable to parse json key file: " + badFile.string ());
+        }
+
+        path const badKeyFile = subdir / ".";
+        try
+        {
+            service.store (keys, badKeyFile).get ();
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                "Cannot open key file: " + badKeyFile.string ());
+        }
+
+        // Revoked keys issue no tokens
+        keys->revoke ();
+        BEAST_EXPECT (! service.createToken (keys).get ());
+    }
+
+    void
+    testIssue ()
+    {
+        testcase ("Issue");
+
+        using namespace boost::filesystem;
+
+        std::string const subdir = "test_key_file";
+        path const keyFile = subdir / "validator_keys.json";
+        KeyFileGuard const g (*this, subdir);
+
+        ValidatorKeys const keys (KeyType::ed25519);
+        keys.writeToFile (keyFile);
+
+        // Each update holds the key file lock from read to write, so
+        // concurrent updates never issue the same sequence
+        AsyncKeyService service (1, 4);
+        std::vector<std::future<SecureString>> tokens;
+        for (int i = 0; i < 20; ++i)
+            tokens.push_back (service.issueToken (keyFile, KeyType::ed25519));
+        std::set<SecureString> issued;
+        for (auto& token : tokens)
+            issued.insert (token.get ());
+        BEAST_EXPECT (issued.size () == tokens.size ());
+        BEAST_EXPECT (ValidatorKeys::make_ValidatorKeys (
+            keyFile).tokenSequence () == tokens.size ());
+
+        // Loads during an update see the key file before or after it
+        auto const loaded = service.load (keyFile);
+        auto const token = service.issueToken (keyFile);
+        auto const reloaded = service.load (keyFile);
+        BEAST_EXPECT (! token.get ().empty ());
+        auto const before = loaded.get ()->tokenSequence ();
+        auto const after = reloaded.get ()->tokenSequence ();
+        BEAST_EXPECT (before == tokens.size () ||
+            before == tokens.size () + 1);
+        BEAST_EXPECT (after == tokens.size () ||
+            after == tokens.size () + 1);
+
+        // Errors are those of issueValidatorToken
+        path const missing = subdir / "missing.json";
+        try
+        {
+            service.issueToken (missing).get ();
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                "Failed to open key file: " + missing.string ());
+        }
+
+        auto revoked = keys;
+        revoked.revoke ();
+        revoked.writeToFile (keyFile);
+        try
+        {
+            service.issueToken (keyFile).get ();
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                std::string ("Validator keys have been revoked."));
+        }
+    }
+
+    void
+    testHandlers ()
+    {
+        testcase ("Handlers");
+
+        using namespace boost::filesystem;
+
+        std::string const subdir = "test_key_file";
+        path const keyFile = subdir / "validator_keys.json";
+        KeyFileGuard const g (*this, subdir);
+
+        AsyncKeyService service (2, 1);
+        auto const keys = std::make_shared<ValidatorKeys> (KeyType::ed25519);
+        std::string const data = "data to sign";
+
+        boost::asio::io_service ios;
+        auto const caller = std::this_thread::get_id ();
+        int calls = 0;
+
+        // Handlers run on the threads that run the io_service, which
+        // has work until every handler has run
+        service.sign (keys, data, ios,
+            [&](std::exception_ptr error, std::string const& signature)
+            {
+                ++calls;
+                BEAST_EXPECT (std::this_thread::get_id () == caller);
+                BEAST_EXPECT (! error);
+                BEAST_EXPECT (signature == keys->sign (data));
+            });
+        service.createToken (keys, KeyType::secp256k1,
+            TokenKeySource::derived, ios,
+            [&](std::exception_ptr error,
+                boost::optional<ValidatorToken> const& token)
+            {
+                ++calls;
+                BEAST_EXPECT (! error);
+                BEAST_EXPECT (token);
+            });
+        service.store (keys, keyFile, ios,
+            [&](std::exception_ptr error)
+            {
+                ++calls;
+                BEAST_EXPECT (! error);
+
+                service.load (keyFile, ios,
+                    [&](std::exception_ptr loadError,
+                        std::shared_ptr<ValidatorKeys> const& loaded)
+                    {
+                        ++calls;
+                        BEAST_EXPECT (! loadError);
+                        if (BEAST_EXPECT (loaded))
+                            BEAST_EXPECT (loaded->publicKey () ==
+                                keys->publicKey ());
+                    });
+            });
+        service.issueToken (keyFile, KeyType::ed25519,
+            TokenKeySource::random, ios,
+            [&](std::exception_ptr error, SecureString const& token)
+            {
+                ++calls;
+                BEAST_EXPECT (std::this_thread::get_id () == caller);
+                BEAST_EXPECT (error || ! token.empty ());
+            });
+        service.load (subdir / "missing.json", ios,
+            [&](std::exception_ptr error,
+                std::shared_ptr<ValidatorKeys> const& loaded)
+            {
+                ++calls;
+                BEAST_EXPECT (error != nullptr);
+                BEAST_EXPECT (! loaded);
+            });
+
+        ios.run ();
+        BEAST_EXPECT (calls == 6);
+    }
+
+public:
+    void
+    run() override
+    {
+        testFutures ();
+        testIssue ();
+        testHandlers ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(AsyncKeyService, keys, ripple);
+
+} // tests
+
+} // ripple
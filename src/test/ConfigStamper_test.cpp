@@ -0,0 +1,373 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <ConfigStamper.h>
+#include <KeyFileOps.h>
+#include <ThreadPool.h>
+#include <ripple/beast/unit_test.h>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace ripple {
+
+namespace tests {
+
+namespace {
+
+std::string
+readConfig (boost::filesystem::path const& file)
+{
+    std::ifstream in (file.string ());
+    return {std::istreambuf_iterator<char> (in),
+        std::istreambuf_iterator<char> ()};
+}
+
+void
+writeConfig (boost::filesystem::path const& file, std::string const& text)
+{
+    std::ofstream (file.string ()) << text;
+}
+
+// Returns the joined values of a section of a config
+std::string
+sectionValue (std::string const& config, std::string const& section)
+{
+    std::istringstream in (config);
+    std::string value;
+    std::string line;
+    bool inSection = false;
+    while (std::getline (in, line))
+    {
+        if (! line.empty () && line.front () == '[')
+            inSection = line == "[" + section + "]";
+        else if (inSection && ! line.empty () && line.front () != '#')
+            value += line;
+    }
+    return value;
+}
+
+// A rippled.cfg of the usual size, without a token
+std::string
+sampleConfig ()
+{
+    std::string config = "[server]\nport_rpc_admin_local\nport_peer\n\n";
+    for (int i = 0; i < 40; ++i)
+    {
+        config += "[section_" + std::to_string (i) + "]\n";
+        config += "# Settings of section " + std::to_string (i) + "\n";
+        config += "name=value_" + std::to_string (i) + "\n\n";
+    }
+    return config;
+}
+
+} // namespace
+
+class ConfigStamper_test : public beast::unit_test::suite
+{
+private:
+    void
+    testStampSection ()
+    {
+        testcase ("Stamp Section");
+
+        auto const stamp = [](std::string const& config, bool found)
+        {
+            std::istringstream in (config);
+            std::ostringstream out;
+            bool const present = stampConfigSection (
+                in, out, "validator_token", {"new1", "new2"});
+            return present == found ? out.str () : "";
+        };
+
+        // Comments and blank lines in the section are kept
+        BEAST_EXPECT (stamp (
+            "[server]\nport\n\n[validator_token]\nold1\nold2\n# note\n\n"
+                "[ips]\nhost 51235\n", true) ==
+            "[server]\nport\n\n[validator_token]\nnew1\nnew2\n# note\n\n"
+                "[ips]\nhost 51235\n");
+
+        // Other sections are copied as they are
+        BEAST_EXPECT (stamp (
+            "a\r\n  [validator_token] \r\nold\r\n[validators_file]\nx", true) ==
+            "a\r\n  [validator_token] \r\nnew1\nnew2\n[validators_file]\nx");
+
+        // rippled accepts only one token
+        BEAST_EXPECT (stamp (
+            "[validator_token]\nold\n[ips]\nhost\n[validator_token]\nolder\n",
+                true) ==
+            "[validator_token]\nnew1\nnew2\n[ips]\nhost\n");
+
+        // A missing section is added at the end
+        BEAST_EXPECT (stamp ("[server]\nport", false) ==
+            "[server]\nport\n\n[validator_token]\nnew1\nnew2\n");
+        BEAST_EXPECT (stamp ("[server]\nport\n", false) ==
+            "[server]\nport\n\n[validator_token]\nnew1\nnew2\n");
+        BEAST_EXPECT (stamp ("", false) == "[validator_token]\nnew1\nnew2\n");
+        BEAST_EXPECT (stamp ("[validator_token_x]\nx\n", false) ==
+            "[validator_token_x]\nx\n\n[validator_token]\nnew1\nnew2\n");
+    }
+
+    void
+    testWrap ()
+    {
+        testcase ("Wrap");
+
+        auto const lines = wrapConfigValue (SecureString (150, 'x'));
+        BEAST_EXPECT (lines.size () == 3);
+        BEAST_EXPECT (lines[0] == SecureString (72, 'x'));
+        BEAST_EXPECT (lines[1] == SecureString (72, 'x'));
+        BEAST_EXPECT (lines[2] == SecureString (6, 'x'));
+
+        BEAST_EXPECT (wrapConfigValue (SecureString (4, 'x'), 2).size () == 2);
+        BEAST_EXPECT (wrapConfigValue ("").empty ());
+    }
+
+    void
+    testStampConfigs ()
+    {
+        testcase ("Stamp Configs");
+
+        using namespace boost::filesystem;
+
+        path const dir = temp_directory_path () /
+            unique_path ("validator-keys-test-%%%%-%%%%-%%%%");
+        create_directories (dir);
+
+        MemoryKeyStore store;
+        std::vector<ConfigStamp> stamps;
+        std::vector<PublicKey> publicKeys;
+        for (int i = 0; i < 20; ++i)
+        {
+            stamps.push_back ({
+                "keys/" + std::to_string (i) + ".json",
+                dir / (std::to_string (i) + ".cfg")});
+            publicKeys.push_back (
+                createValidatorKeyFile (stamps.back ().keyFile, store));
+            writeConfig (stamps.back ().configFile, i % 2 ?
+                sampleConfig () :
+                "[server]\nport\n\n[validator_token]\nold\n\n[ips]\nhost\n");
+        }
+
+        // A config missing, a key file missing, and a config that only
+        // its owner may read
+        stamps.push_back ({"keys/unused.json", dir / "missing.cfg"});
+        createValidatorKeyFile ("keys/unused.json", store);
+        stamps.push_back ({"keys/missing.json", dir / "orphan.cfg"});
+        writeConfig (dir / "orphan.cfg", "[server]\nport\n");
+        permissions (stamps[3].configFile, owner_read | owner_write);
+        permissions (stamps[5].configFile,
+            owner_read | owner_write | group_read);
+
+        auto const results = stampConfigs (
+            stamps, ConfigStampKind::token, store, KeyType::secp256k1,
+            TokenKeySource::random, 4);
+        if (! BEAST_EXPECT (results.size () == stamps.size ()))
+            return;
+
+        for (int i = 0; i < 20; ++i)
+        {
+            auto const config = readConfig (stamps[i].configFile);
+            auto const keys = loadKeyFile (stamps[i].keyFile, store);
+            BEAST_EXPECT (results[i].error.empty ());
+            BEAST_EXPECT (results[i].publicKey == publicKeys[i]);
+            BEAST_EXPECT (keys.tokenSequence () == 1);
+
+            auto const token = sectionValue (config, "validator_token");
+            BEAST_EXPECT (token.size () > 72 && token != "old");
+            BEAST_EXPECT (config.find ("[validator_token]\n" +
+                token.substr (0, 72) + "\n") != std::string::npos);
+            if (i % 2)
+                BEAST_EXPECT (config.find (sampleConfig ()) == 0);
+            else
+                BEAST_EXPECT (config.find ("\n\n[ips]\nhost\n") !=
+                    std::string::npos);
+        }
+        BEAST_EXPECT (status (stamps[3].configFile).permissions () ==
+            (owner_read | owner_write));
+        BEAST_EXPECT (status (stamps[5].configFile).permissions () ==
+            (owner_read | owner_write | group_read));
+
+        // The key file is not touched when the config cannot be read
+        BEAST_EXPECT (results[20].error ==
+            "Cannot open config: " + (dir / "missing.cfg").string ());
+        BEAST_EXPECT (! results[20].publicKey);
+        BEAST_EXPECT (loadKeyFile ("keys/unused.json", store)
+            .tokenSequence () == 0);
+        BEAST_EXPECT (! exists (dir / "missing.cfg"));
+
+        BEAST_EXPECT (! results[21].error.empty ());
+        BEAST_EXPECT (readConfig (dir / "orphan.cfg") == "[server]\nport\n");
+
+        // No copies are left behind
+        std::size_t files = 0;
+        for (auto const& entry : directory_iterator (dir))
+            files += entry.path ().extension () == ".cfg";
+        BEAST_EXPECT (files == 21);
+        BEAST_EXPECT (std::distance (directory_iterator (dir),
+            directory_iterator ()) == 21);
+
+        // A revocation goes beside the token
+        {
+            auto const revoked = stampConfigs ({stamps[0]},
+                ConfigStampKind::revocation, store);
+            BEAST_EXPECT (revoked.size () == 1 && revoked[0].error.empty ());
+            BEAST_EXPECT (loadKeyFile (stamps[0].keyFile, store).revoked ());
+
+            auto const config = readConfig (stamps[0].configFile);
+            BEAST_EXPECT (! sectionValue (
+                config, "validator_key_revocation").empty ());
+            BEAST_EXPECT (! sectionValue (config, "validator_token").empty ());
+
+            // Revoked keys issue no more tokens
+            auto const again = stampConfigs ({stamps[0]},
+                ConfigStampKind::token, store);
+            BEAST_EXPECT (again.size () == 1 && ! again[0].error.empty ());
+            BEAST_EXPECT (readConfig (stamps[0].configFile) == config);
+        }
+
+        auto const error = [&](std::vector<ConfigStamp> const& listed)
+        {
+            try
+            {
+                stampConfigs (listed, ConfigStampKind::token, store);
+            }
+            catch (std::runtime_error const& e)
+            {
+                return std::string (e.what ());
+            }
+            return std::string ();
+        };
+        BEAST_EXPECT (error ({stamps[1], {stamps[1].keyFile, "other.cfg"}}) ==
+            "Key file listed twice: keys/1.json");
+        BEAST_EXPECT (error ({stamps[1], {"keys/2.json",
+            stamps[1].configFile}}) ==
+            "Config listed twice: " + stamps[1].configFile.string ());
+        BEAST_EXPECT (loadKeyFile (stamps[1].keyFile, store)
+            .tokenSequence () == 1);
+
+#ifndef _WIN32
+        // A config named by a link is replaced, and the link kept
+        {
+            path const linked = dir / "linked" / "rippled.cfg";
+            create_directories (linked.parent_path ());
+            writeConfig (linked, "[server]\nport\n");
+            path const link = dir / "link.cfg";
+            create_symlink (linked, link);
+
+            ConfigStamp const stamp {"keys/linked.json", link};
+            createValidatorKeyFile (stamp.keyFile, store);
+            auto const linkResults = stampConfigs (
+                {stamp}, ConfigStampKind::token, store);
+            BEAST_EXPECT (linkResults.size () == 1 &&
+                linkResults[0].error.empty ());
+            BEAST_EXPECT (is_symlink (link));
+            BEAST_EXPECT (read_symlink (link) == linked);
+            BEAST_EXPECT (! sectionValue (
+                readConfig (linked), "validator_token").empty ());
+            BEAST_EXPECT (std::distance (directory_iterator (
+                linked.parent_path ()), directory_iterator ()) == 1);
+
+            // The link and its target are the same config
+            BEAST_EXPECT (error ({stamp, {"keys/2.json", linked}}) ==
+                "Config listed twice: " + linked.string ());
+        }
+#endif
+
+        BEAST_EXPECT (stampConfigs ({}, ConfigStampKind::token, store)
+            .empty ());
+
+        remove_all (dir);
+    }
+
+public:
+    void
+    run() override
+    {
+        testStampSection ();
+        testWrap ();
+        testStampConfigs ();
+    }
+};
+
+/** Stamps new tokens into configs on disk
+
+    The argument is the number of configs, 500 by default. The key files
+    are on disk beside the configs, so the syncs cover both.
+*/
+class ConfigStamperBench : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace boost::filesystem;
+        using namespace std::chrono;
+
+        testcase ("Stamp");
+
+        std::size_t const count = arg ().empty () ?
+            500 : std::stoul (arg ());
+
+        path const dir = temp_directory_path () /
+            unique_path ("validator_keys_configs_%%%%%%%%");
+        create_directories (dir);
+        FileKeyStore store;
+
+        std::vector<ConfigStamp> stamps;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            stamps.push_back ({
+                dir / (std::to_string (i) + ".json"),
+                dir / (std::to_string (i) + ".cfg")});
+            createValidatorKeyFile (stamps.back ().keyFile, store);
+            writeConfig (stamps.back ().configFile, sampleConfig ());
+        }
+
+        for (unsigned threads : {1u, 0u})
+        {
+            auto const start = steady_clock::now ();
+            auto const results = stampConfigs (stamps,
+                ConfigStampKind::token, store, KeyType::secp256k1,
+                TokenKeySource::random, threads);
+            auto const elapsed = duration_cast<milliseconds> (
+                steady_clock::now () - start);
+
+            bool stamped = true;
+            for (auto const& result : results)
+                stamped = stamped && result.error.empty ();
+            BEAST_EXPECT (stamped);
+
+            log << count << " configs on " << (threads ? threads :
+                defaultThreadPool ().size ()) << " threads: " <<
+                elapsed.count () << " ms" << std::endl;
+        }
+
+        remove_all (dir);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(ConfigStamper, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(ConfigStamperBench, keys, ripple);
+
+} // tests
+
+} // ripple
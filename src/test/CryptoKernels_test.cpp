@@ -0,0 +1,172 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <CryptoKernels.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/Sign.h>
+#include <ripple/protocol/STObject.h>
+#include <algorithm>
+#include <cstring>
+
+namespace ripple {
+
+namespace tests {
+
+class CryptoKernels_test : public beast::unit_test::suite
+{
+private:
+    static
+    bool
+    equal (Buffer const& a, Buffer const& b)
+    {
+        return a.size () == b.size () &&
+            std::memcmp (a.data (), b.data (), a.size ()) == 0;
+    }
+
+    static
+    std::string
+    serialize (STObject const& st)
+    {
+        Serializer s;
+        st.add (s);
+        return std::string (static_cast<char const*> (s.data ()), s.size ());
+    }
+
+    void
+    testNames ()
+    {
+        testcase ("Names");
+
+        for (auto const variant : {CryptoVariant::library,
+            CryptoVariant::sse2, CryptoVariant::x86_64, CryptoVariant::avx2})
+        {
+            BEAST_EXPECT (cryptoVariantFromString (
+                to_string (variant)) == variant);
+        }
+        BEAST_EXPECT (! cryptoVariantFromString ("avx512"));
+        BEAST_EXPECT (! cryptoVariantFromString (""));
+    }
+
+    void
+    testVariants ()
+    {
+        testcase ("Variants");
+
+        auto const variants = CryptoKernels::supported ();
+        if (! BEAST_EXPECT (! variants.empty ()))
+            return;
+        BEAST_EXPECT (variants.front () == CryptoVariant::library);
+
+        std::string const message = "data to sign";
+
+        for (auto const variant : variants)
+        {
+            auto const& kernels = CryptoKernels::get (variant);
+            BEAST_EXPECT (kernels.variant () == variant);
+            BEAST_EXPECT (kernels.selfTest ());
+
+            for (auto const type : {KeyType::secp256k1, KeyType::ed25519})
+            {
+                for (int i = 0; i < 20; ++i)
+                {
+                    auto const sk = generateSecretKey (type, randomSeed ());
+                    auto const pk = derivePublicKey (type, sk);
+                    BEAST_EXPECT (kernels.derivePublicKey (type, sk) == pk);
+
+                    auto const signature = kernels.sign (
+                        pk, sk, makeSlice (message));
+                    BEAST_EXPECT (equal (signature,
+                        sign (pk, sk, makeSlice (message))));
+                    BEAST_EXPECT (verify (pk, makeSlice (message),
+                        Slice (signature.data (), signature.size ()), true));
+                }
+
+                auto const sk = generateSecretKey (type, randomSeed ());
+                STObject expected (sfGeneric);
+                expected[sfSequence] = 1;
+                expected[sfPublicKey] = derivePublicKey (type, sk);
+                STObject st (expected);
+
+                sign (expected, HashPrefix::manifest, type, sk,
+                    sfMasterSignature);
+                kernels.sign (st, HashPrefix::manifest, type, sk,
+                    sfMasterSignature);
+                BEAST_EXPECT (serialize (st) == serialize (expected));
+            }
+        }
+
+        // Variants the host lacks cannot be used
+        for (auto const variant : {CryptoVariant::sse2,
+            CryptoVariant::x86_64, CryptoVariant::avx2})
+        {
+            if (std::find (variants.begin (), variants.end (), variant) !=
+                variants.end ())
+            {
+                continue;
+            }
+
+            try
+            {
+                CryptoKernels::get (variant);
+                fail ();
+            }
+            catch (std::runtime_error const& e)
+            {
+                BEAST_EXPECT (e.what () == std::string (
+                    "Crypto variant is not supported on this host: ") +
+                    to_string (variant));
+            }
+        }
+    }
+
+    void
+    testActivate ()
+    {
+        testcase ("Activate");
+
+        // The fastest variant is chosen, as every variant passes
+        auto const chosen = CryptoKernels::active ().variant ();
+        BEAST_EXPECT (chosen == CryptoKernels::supported ().back ());
+
+        for (auto const variant : CryptoKernels::supported ())
+        {
+            CryptoKernels::activate (variant);
+            BEAST_EXPECT (CryptoKernels::active ().variant () == variant);
+        }
+
+        CryptoKernels::activate (chosen);
+        BEAST_EXPECT (CryptoKernels::active ().variant () == chosen);
+    }
+
+public:
+    void
+    run() override
+    {
+        testNames ();
+        testVariants ();
+        testActivate ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(CryptoKernels, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,444 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <FleetExport.h>
+#include <Manifest.h>
+#include <ThreadPool.h>
+#include <ValidatorKeys.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/SecretKey.h>
+#include <beast/core/detail/base64.hpp>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+namespace ripple {
+
+namespace tests {
+
+namespace {
+
+std::string
+toString (Slice const& slice)
+{
+    return std::string (
+        reinterpret_cast<char const*> (slice.data ()), slice.size ());
+}
+
+} // namespace
+
+class FleetExport_test : public beast::unit_test::suite
+{
+private:
+    template <class F>
+    std::string
+    error (F&& f)
+    {
+        try
+        {
+            f ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            return e.what ();
+        }
+        return "";
+    }
+
+    void
+    testRoundTrip ()
+    {
+        testcase ("Round Trip");
+
+        std::vector<PublicKey> masterKeys;
+        std::vector<PublicKey> signingKeys;
+        FleetExportWriter writer;
+        for (int i = 0; i < 100; ++i)
+        {
+            masterKeys.push_back (randomKeyPair (i % 2 ?
+                KeyType::secp256k1 : KeyType::ed25519).first);
+            signingKeys.push_back (
+                randomKeyPair (KeyType::secp256k1).first);
+            writer.add (masterKeys.back (), i % 3 ?
+                    boost::optional<PublicKey> (signingKeys.back ()) :
+                    boost::none,
+                i, i % 10 == 0, std::string (i % 3 ? i : 0, 'm'));
+        }
+
+        // Only the current row of a master key is kept
+        writer.add (masterKeys[5], signingKeys[0], 4, false, "older");
+        writer.add (masterKeys[7], signingKeys[0], 70, false, "newer");
+        writer.add (masterKeys[8], boost::none, 8, true, "revoked");
+        BEAST_EXPECT (writer.size () == 103);
+
+        std::ostringstream out;
+        BEAST_EXPECT (writer.write (out) == 100);
+        auto const data = out.str ();
+
+        FleetExport const fleet (data.data (), data.size ());
+        if (! BEAST_EXPECT (fleet.size () == 100))
+            return;
+
+        bool found = true;
+        bool sorted = true;
+        for (std::size_t i = 0; i < masterKeys.size (); ++i)
+        {
+            auto const row = fleet.find (masterKeys[i]);
+            if (! row)
+            {
+                found = false;
+                continue;
+            }
+            if (*row > 0)
+                sorted = sorted && fleet.masterKey (*row - 1) < masterKeys[i];
+
+            found = found && fleet.masterKey (*row) == masterKeys[i];
+            if (i == 7 || i == 8)
+                continue;
+
+            found = found && fleet.tokenSequence (*row) == i &&
+                fleet.revoked (*row) == (i % 10 == 0) &&
+                fleet.manifest (*row).size () == (i % 3 ? i : 0);
+            if (i % 3)
+                found = found && fleet.signingKey (*row) == signingKeys[i];
+            else
+                found = found && ! fleet.signingKey (*row);
+        }
+        BEAST_EXPECT (found);
+        BEAST_EXPECT (sorted);
+
+        auto const newer = *fleet.find (masterKeys[7]);
+        BEAST_EXPECT (fleet.tokenSequence (newer) == 70);
+        BEAST_EXPECT (toString (fleet.manifest (newer)) == "newer");
+        BEAST_EXPECT (fleet.signingKey (newer) == signingKeys[0]);
+
+        auto const revoked = *fleet.find (masterKeys[8]);
+        BEAST_EXPECT (fleet.revoked (revoked));
+        BEAST_EXPECT (toString (fleet.manifest (revoked)) == "revoked");
+        BEAST_EXPECT (! fleet.signingKey (revoked));
+
+        BEAST_EXPECT (! fleet.find (signingKeys[1]));
+
+        std::ostringstream empty;
+        BEAST_EXPECT (FleetExportWriter ().write (empty) == 0);
+        auto const none = empty.str ();
+        BEAST_EXPECT (none.size () == fleet_export::headerSize);
+        FleetExport const nothing (none.data (), none.size ());
+        BEAST_EXPECT (nothing.size () == 0);
+        BEAST_EXPECT (! nothing.find (masterKeys[0]));
+    }
+
+    void
+    testCorrupt ()
+    {
+        testcase ("Corrupt");
+
+        FleetExportWriter writer;
+        writer.add (randomKeyPair (KeyType::ed25519).first,
+            boost::none, 1, false, "manifest");
+        std::ostringstream out;
+        writer.write (out);
+        auto const data = out.str ();
+
+        auto const open = [](std::string const& d, bool verify)
+        {
+            FleetExport const fleet (d.data (), d.size (), verify);
+        };
+
+        auto changed = data;
+        changed.back () ^= 1;
+        BEAST_EXPECT (error ([&]{ open (changed, true); }) ==
+            "Fleet export checksum mismatch");
+        BEAST_EXPECT (error ([&]{ open (changed, false); }).empty ());
+
+        BEAST_EXPECT (error ([&]{ open (data.substr (0, 100), true); }) ==
+            "Not a fleet export");
+        BEAST_EXPECT (error ([&]{
+            open (data.substr (0, data.size () - 1), false); }) ==
+            "Corrupt fleet export");
+
+        changed = data;
+        changed[4] = 2;
+        BEAST_EXPECT (error ([&]{ open (changed, false); }) ==
+            "Unsupported fleet export version: 2");
+
+        // A row count too large for the file
+        changed = data;
+        changed[15] = '\x01';
+        BEAST_EXPECT (error ([&]{ open (changed, false); }) ==
+            "Corrupt fleet export");
+
+        // Manifest ends past the manifests are caught when read
+        changed = data;
+        auto const ends = changed.size () - 16;
+        changed[ends] = '\x7f';
+        FleetExport const fleet (changed.data (), changed.size (), false);
+        BEAST_EXPECT (error ([&]{ fleet.manifest (0); }) ==
+            "Corrupt fleet export");
+
+        // Keys that are not keys are caught when read, as a checksum
+        // only shows that the export was not damaged in transit
+        auto const columnOffset = [&](std::size_t column)
+        {
+            std::size_t offset = 0;
+            for (int i = 7; i >= 0; --i)
+                offset = offset << 8 |
+                    static_cast<std::uint8_t> (data[64 + 16 * column + i]);
+            return offset;
+        };
+        for (std::size_t column : {0, 1})
+        {
+            changed = data;
+            changed[columnOffset (column)] = '\x05';
+            FleetExport const bad (changed.data (), changed.size (), false);
+            BEAST_EXPECT (error ([&]{
+                if (column == 0)
+                    bad.masterKey (0);
+                else
+                    bad.signingKey (0);
+            }) == "Corrupt fleet export");
+        }
+    }
+
+    void
+    testKeyFiles ()
+    {
+        testcase ("Key Files");
+
+        using namespace boost::filesystem;
+
+        MemoryKeyStore store;
+
+        ValidatorKeys derived (KeyType::ed25519);
+        derived.createValidatorToken (
+            KeyType::secp256k1, TokenKeySource::derived);
+        derived.createValidatorToken (
+            KeyType::ed25519, TokenKeySource::derived);
+        derived.writeToFile ("fleet/derived.json", store);
+
+        // The current token has random keys, though an earlier one did not
+        ValidatorKeys random (KeyType::ed25519);
+        random.createValidatorToken (
+            KeyType::secp256k1, TokenKeySource::derived);
+        random.createValidatorToken ();
+        random.writeToFile ("fleet/random.json", store);
+
+        ValidatorKeys revoked (KeyType::secp256k1);
+        revoked.createValidatorToken ();
+        revoked.revoke ();
+        revoked.writeToFile ("fleet/revoked.json", store);
+
+        ValidatorKeys const fresh (KeyType::ed25519);
+        fresh.writeToFile ("fleet/fresh.json", store);
+
+        store.store ("fleet/bad.json", "not json");
+
+        std::vector<path> const files = {"fleet/bad.json",
+            "fleet/derived.json", "fleet/fresh.json", "fleet/missing.json",
+            "fleet/random.json", "fleet/revoked.json"};
+
+        FleetExportWriter writer;
+        auto const failed = addKeyFiles (writer, files, store, 2);
+        if (! BEAST_EXPECT (failed.size () == 2))
+            return;
+        BEAST_EXPECT (failed[0].first == "fleet/bad.json");
+        BEAST_EXPECT (failed[0].second ==
+            "Unable to parse json key file: fleet/bad.json");
+        BEAST_EXPECT (failed[1].first == "fleet/missing.json");
+        BEAST_EXPECT (failed[1].second ==
+            "Failed to open key file: fleet/missing.json");
+
+        std::ostringstream out;
+        BEAST_EXPECT (writer.write (out) == 4);
+        auto const data = out.str ();
+        FleetExport const fleet (data.data (), data.size ());
+
+        // The manifest of the current token, whose keys are derived with
+        // the key type recorded when it was issued
+        auto row = fleet.find (derived.publicKey ());
+        if (BEAST_EXPECT (row))
+        {
+            BEAST_EXPECT (fleet.tokenSequence (*row) == 2);
+            BEAST_EXPECT (! fleet.revoked (*row));
+            auto const token = derived.regenerateValidatorToken (2);
+            auto const manifest = toString (fleet.manifest (*row));
+            BEAST_EXPECT (manifest == beast::detail::base64_decode (
+                token->manifest));
+            BEAST_EXPECT (verifyManifest (manifest));
+            BEAST_EXPECT (fleet.signingKey (*row) == derivePublicKey (
+                KeyType::ed25519, *token->secretKey));
+        }
+
+        row = fleet.find (random.publicKey ());
+        if (BEAST_EXPECT (row))
+        {
+            BEAST_EXPECT (fleet.tokenSequence (*row) == 2);
+            BEAST_EXPECT (fleet.manifest (*row).empty ());
+            BEAST_EXPECT (! fleet.signingKey (*row));
+        }
+
+        row = fleet.find (revoked.publicKey ());
+        if (BEAST_EXPECT (row))
+        {
+            auto const manifest = deserializeManifest (
+                toString (fleet.manifest (*row)));
+            BEAST_EXPECT (fleet.revoked (*row));
+            BEAST_EXPECT (fleet.tokenSequence (*row) == 1);
+            BEAST_EXPECT (manifest && manifest->revoked () &&
+                manifest->masterKey == revoked.publicKey ());
+            BEAST_EXPECT (! fleet.signingKey (*row));
+        }
+
+        row = fleet.find (fresh.publicKey ());
+        if (BEAST_EXPECT (row))
+        {
+            BEAST_EXPECT (fleet.tokenSequence (*row) == 0);
+            BEAST_EXPECT (fleet.manifest (*row).empty ());
+            BEAST_EXPECT (! fleet.signingKey (*row));
+        }
+    }
+
+    void
+    testFile ()
+    {
+        testcase ("File");
+
+        using namespace boost::filesystem;
+
+        path const file = temp_directory_path () /
+            unique_path ("validator-keys-test-%%%%-%%%%-%%%%");
+
+        auto const masterKey = randomKeyPair (KeyType::ed25519).first;
+        FleetExportWriter writer;
+        writer.add (masterKey, boost::none, 3, false, {});
+        {
+            std::ofstream out (file.string (), std::ios::binary);
+            writer.write (out);
+        }
+
+        {
+            FleetExport const fleet (file);
+            BEAST_EXPECT (fleet.size () == 1);
+            BEAST_EXPECT (fleet.masterKey (0) == masterKey);
+            BEAST_EXPECT (fleet.tokenSequence (0) == 3);
+        }
+
+        std::ofstream (file.string (), std::ios::trunc);
+        BEAST_EXPECT (error ([&]{ FleetExport const fleet (file); }) ==
+            "Not a fleet export");
+        remove (file);
+        BEAST_EXPECT (error ([&]{ FleetExport const fleet (file); }) ==
+            "Cannot open fleet export: " + file.string ());
+    }
+
+public:
+    void
+    run() override
+    {
+        testRoundTrip ();
+        testCorrupt ();
+        testKeyFiles ();
+        testFile ();
+    }
+};
+
+/** Writes and reads an export of many validators
+
+    The argument is the number of rows, 1000000 by default. Keys and
+    manifests are synthetic, so only the file format is measured.
+*/
+class FleetExportBench : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace boost::filesystem;
+        using namespace std::chrono;
+
+        testcase ("Export");
+
+        std::size_t const count = arg ().empty () ?
+            1000000 : std::stoul (arg ());
+
+        // Keys need only be well formed to be exported
+        std::vector<PublicKey> keys;
+        keys.reserve (count);
+        std::uint8_t raw[33] = {0xED};
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            for (std::size_t b = 0; b < 8; ++b)
+                raw[1 + b] = static_cast<std::uint8_t> (
+                    (i * 0x9E3779B97F4A7C15ull) >> (8 * b));
+            keys.emplace_back (Slice (raw, sizeof (raw)));
+        }
+        std::string const manifest (150, 'm');
+
+        path const file = temp_directory_path () /
+            unique_path ("validator_keys_export_%%%%%%%%");
+
+        auto start = steady_clock::now ();
+        {
+            FleetExportWriter writer;
+            for (std::size_t i = 0; i < count; ++i)
+                writer.add (keys[i], keys[count - 1 - i],
+                    std::uint32_t (i), false, manifest);
+            std::ofstream out (file.string (), std::ios::binary);
+            writer.write (out);
+        }
+        log << "Write " << count << " rows: " << duration_cast<
+            milliseconds> (steady_clock::now () - start).count () <<
+            " ms, " << file_size (file) / (1024 * 1024) << " MB" <<
+            std::endl;
+
+        for (bool verify : {false, true})
+        {
+            start = steady_clock::now ();
+            FleetExport const fleet (file, verify);
+            log << "Open" << (verify ? " and verify: " : ": ") <<
+                duration_cast<microseconds> (
+                    steady_clock::now () - start).count () << " us" <<
+                std::endl;
+            BEAST_EXPECT (fleet.size () == count);
+        }
+
+        FleetExport const fleet (file, false);
+        start = steady_clock::now ();
+        std::size_t found = 0;
+        for (auto const& key : keys)
+            found += fleet.find (key) &&
+                fleet.manifest (*fleet.find (key)).size () == manifest.size ();
+        auto const elapsed = duration_cast<nanoseconds> (
+            steady_clock::now () - start);
+        BEAST_EXPECT (found == count);
+        log << "Find each row: " << elapsed.count () / std::max<std::size_t> (
+            1, count) << " ns per row" << std::endl;
+
+        remove (file);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(FleetExport, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(FleetExportBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,300 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyFileInspector.h>
+#include <ThreadPool.h>
+#include <ValidatorKeys.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/json/json_reader.h>
+#include <ripple/json/to_string.h>
+#include <boost/filesystem.hpp>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <limits>
+
+namespace ripple {
+
+namespace tests {
+
+namespace {
+
+// Returns the key file of keys after an edit to its JSON
+std::string
+editKeyFile (ValidatorKeys const& keys,
+    std::function<void (Json::Value&)> const& edit)
+{
+    Json::Value jv;
+    Json::Reader ().parse (keys.toJson (), jv);
+    edit (jv);
+    return to_string (jv);
+}
+
+} // namespace
+
+class KeyFileInspector_test : public beast::unit_test::suite
+{
+private:
+    void
+    testInspectKeyFile ()
+    {
+        testcase ("Inspect Key File");
+
+        std::uint32_t const limit =
+            std::numeric_limits<std::uint32_t>::max () - 1;
+
+        ValidatorKeys keys (KeyType::ed25519);
+        keys.createValidatorToken ();
+        ValidatorKeys const other (KeyType::secp256k1);
+
+        auto const inspect = [](std::string const& contents)
+        {
+            return inspectKeyFile ("keys.json", contents, 100);
+        };
+
+        {
+            auto const report = inspect (keys.toJson ());
+            BEAST_EXPECT (report.file == "keys.json");
+            BEAST_EXPECT (report.findings == 0);
+            BEAST_EXPECT (report.keyType == KeyType::ed25519);
+            BEAST_EXPECT (report.publicKey == keys.publicKey ());
+            BEAST_EXPECT (report.tokenSequence == 1);
+            BEAST_EXPECT (report.error.empty ());
+        }
+        {
+            // The public key need not be stored
+            auto const report = inspect (editKeyFile (other,
+                [](Json::Value& jv) { jv.removeMember ("public_key"); }));
+            BEAST_EXPECT (report.findings == 0);
+            BEAST_EXPECT (report.publicKey == other.publicKey ());
+        }
+        {
+            auto const report = inspect (editKeyFile (keys,
+                [&](Json::Value& jv)
+                {
+                    jv["public_key"] = toBase58 (
+                        TokenType::TOKEN_NODE_PUBLIC, other.publicKey ());
+                }));
+            BEAST_EXPECT (
+                report.findings == KeyFileReport::publicKeyMismatch);
+            BEAST_EXPECT (report.publicKey == keys.publicKey ());
+        }
+        {
+            auto const report = inspect (editKeyFile (keys,
+                [](Json::Value& jv) { jv["public_key"] = "garbage"; }));
+            BEAST_EXPECT (
+                report.findings == KeyFileReport::publicKeyMismatch);
+        }
+        {
+            // Within the margin of the last sequence
+            auto const report = inspect (editKeyFile (keys,
+                [&](Json::Value& jv) { jv["token_sequence"] = limit - 99; }));
+            BEAST_EXPECT (
+                report.findings == KeyFileReport::sequenceNearLimit);
+            BEAST_EXPECT (report.tokenSequence == limit - 99);
+
+            BEAST_EXPECT (inspect (editKeyFile (keys,
+                [&](Json::Value& jv)
+                {
+                    jv["token_sequence"] = limit - 100;
+                })).findings == 0);
+        }
+        {
+            auto copy = keys;
+            copy.revoke ();
+            BEAST_EXPECT (inspect (copy.toJson ()).findings ==
+                KeyFileReport::revoked);
+        }
+        {
+            auto const report = inspect (editKeyFile (keys,
+                [](Json::Value& jv) { jv["key_type"] = "rsa"; }));
+            BEAST_EXPECT (report.findings == KeyFileReport::badKeyType);
+            BEAST_EXPECT (! report.publicKey);
+        }
+        {
+            auto const report = inspect (editKeyFile (keys,
+                [](Json::Value& jv) { jv["secret_key"] = "garbage"; }));
+            BEAST_EXPECT (report.findings == KeyFileReport::badSecretKey);
+            BEAST_EXPECT (! report.publicKey);
+        }
+
+        // A secp256k1 secret that is zero or not below the group order
+        // decodes, but has no public key
+        for (std::uint8_t const fill : {0x00, 0xFF})
+        {
+            std::array<std::uint8_t, 32> bytes;
+            bytes.fill (fill);
+            auto const secret = toBase58 (TokenType::TOKEN_NODE_PRIVATE,
+                SecretKey (Slice (bytes.data (), bytes.size ())));
+            auto const report = inspect (editKeyFile (keys,
+                [&](Json::Value& jv)
+                {
+                    jv["key_type"] = "secp256k1";
+                    jv["secret_key"] = secret;
+                }));
+            BEAST_EXPECT (report.findings == KeyFileReport::badSecretKey);
+            BEAST_EXPECT (! report.publicKey);
+        }
+        {
+            auto const report = inspect ("not json");
+            BEAST_EXPECT (report.findings == KeyFileReport::malformed);
+            BEAST_EXPECT (report.error == "Unable to parse json key file");
+        }
+        {
+            // Other fields are still checked
+            auto const report = inspect (editKeyFile (keys,
+                [](Json::Value& jv)
+                {
+                    jv.removeMember ("revoked");
+                    jv["token_sequence"] = "one";
+                    jv["key_type"] = 5;
+                }));
+            BEAST_EXPECT (report.findings == (KeyFileReport::malformed |
+                KeyFileReport::badKeyType));
+            BEAST_EXPECT (report.error == "Missing \"revoked\" field");
+        }
+        {
+            auto const report = inspect (editKeyFile (keys,
+                [](Json::Value& jv) { jv["token_sequence"] = -1; }));
+            BEAST_EXPECT (report.findings == KeyFileReport::malformed);
+            BEAST_EXPECT (
+                report.error == "Invalid \"token_sequence\" field");
+        }
+
+        BEAST_EXPECT (to_string (KeyFileReport::publicKeyMismatch) ==
+            std::string ("public key mismatch"));
+    }
+
+    void
+    testInspectKeyFiles ()
+    {
+        testcase ("Inspect Key Files");
+
+        MemoryKeyStore store;
+
+        // Several batches, with every other key file revoked
+        std::vector<ValidatorKeys> keys;
+        keys.emplace_back (KeyType::ed25519);
+        keys.back ().revoke ();
+        keys.emplace_back (KeyType::secp256k1);
+
+        std::vector<boost::filesystem::path> files;
+        for (int i = 0; i < 600; ++i)
+        {
+            files.push_back ("fleet/" + std::to_string (i) + ".json");
+            keys[i % 2].writeToFile (files.back (), store);
+        }
+        files.insert (files.begin () + 300, "fleet/missing.json");
+
+        auto const reports = inspectKeyFiles (files, store, 100, 4);
+        if (! BEAST_EXPECT (reports.size () == files.size ()))
+            return;
+
+        bool ordered = true;
+        bool found = true;
+        for (std::size_t i = 0; i < reports.size (); ++i)
+        {
+            ordered = ordered && reports[i].file == files[i];
+            if (i == 300)
+                continue;
+            auto const& expected = keys[(i < 300 ? i : i - 1) % 2];
+            found = found && reports[i].publicKey == expected.publicKey () &&
+                reports[i].findings == (expected.revoked () ?
+                    KeyFileReport::revoked : 0u);
+        }
+        BEAST_EXPECT (ordered);
+        BEAST_EXPECT (found);
+        BEAST_EXPECT (reports[300].findings == KeyFileReport::unreadable);
+        BEAST_EXPECT (reports[300].error ==
+            "Failed to open key file: fleet/missing.json");
+
+        BEAST_EXPECT (inspectKeyFiles ({}, store).empty ());
+    }
+
+public:
+    void
+    run() override
+    {
+        testInspectKeyFile ();
+        testInspectKeyFiles ();
+    }
+};
+
+/** Inspects a directory of key files on disk
+
+    The argument is the number of key files, 100000 by default. They are
+    written once and then read from the page cache.
+*/
+class KeyFileInspectorBench : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace boost::filesystem;
+        using namespace std::chrono;
+
+        testcase ("Inspect");
+
+        std::size_t const count = arg ().empty () ?
+            100000 : std::stoul (arg ());
+
+        path const dir = temp_directory_path () /
+            unique_path ("validator_keys_fleet_%%%%%%%%");
+        FileKeyStore store;
+
+        // Deriving a public key costs the same for any secret key
+        std::vector<std::string> contents;
+        for (int i = 0; i < 1000; ++i)
+            contents.push_back (ValidatorKeys (i % 2 ?
+                KeyType::secp256k1 : KeyType::ed25519).toJson ());
+        for (std::size_t i = 0; i < count; ++i)
+            store.store (dir / (std::to_string (i) + ".json"),
+                contents[i % contents.size ()]);
+
+        auto const files = store.list (dir);
+        for (unsigned threads : {1u, 0u})
+        {
+            auto const start = steady_clock::now ();
+            auto const reports = inspectKeyFiles (files, store, 1000000,
+                threads);
+            auto const elapsed = duration_cast<milliseconds> (
+                steady_clock::now () - start);
+
+            bool sound = true;
+            for (auto const& report : reports)
+                sound = sound && report.findings == 0;
+            BEAST_EXPECT (sound);
+
+            log << count << " key files on " << (threads ? threads :
+                defaultThreadPool ().size ()) << " threads: " <<
+                elapsed.count () << " ms" << std::endl;
+        }
+
+        remove_all (dir);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(KeyFileInspector, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(KeyFileInspectorBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,224 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyFileLock.h>
+#include <KeyFileOps.h>
+#include <ValidatorKeys.h>
+#include <ValidatorKeysTool.h>
+#include <test/KeyFileGuard.h>
+#include <functional>
+#include <sstream>
+#ifndef _WIN32
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+namespace ripple {
+
+namespace tests {
+
+class KeyFileLock_test : public beast::unit_test::suite
+{
+private:
+    using Mode = KeyFileLock::Mode;
+
+    std::string
+    tryLock (
+        boost::filesystem::path const& keyFile,
+        Mode mode,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds {0})
+    {
+        try
+        {
+            KeyFileLock const lock (keyFile, mode, timeout);
+            BEAST_EXPECT (lock.locked ());
+        }
+        catch (std::runtime_error const& e)
+        {
+            return e.what ();
+        }
+        return "";
+    }
+
+    void
+    testLockModes ()
+    {
+        testcase ("Lock Modes");
+
+        using namespace boost::filesystem;
+
+        std::string const subdir = "test_key_file";
+        KeyFileGuard const g (*this, subdir);
+        path const keyFile = subdir / "validator_keys.json";
+
+        std::string const timeoutError =
+            "Timed out waiting for lock on key file: " + keyFile.string ();
+
+        {
+            KeyFileLock const lock (keyFile, Mode::exclusive);
+            BEAST_EXPECT (lock.locked ());
+            BEAST_EXPECT (exists (KeyFileLock::lockPath (keyFile)));
+            BEAST_EXPECT (! exists (keyFile));
+
+            BEAST_EXPECT (tryLock (keyFile, Mode::exclusive) == timeoutError);
+            BEAST_EXPECT (tryLock (keyFile, Mode::shared) == timeoutError);
+            BEAST_EXPECT (tryLock (keyFile, Mode::shared,
+                std::chrono::milliseconds {20}) == timeoutError);
+        }
+        {
+            KeyFileLock const lock (keyFile, Mode::shared);
+            BEAST_EXPECT (lock.locked ());
+
+            BEAST_EXPECT (tryLock (keyFile, Mode::shared).empty ());
+            BEAST_EXPECT (tryLock (keyFile, Mode::exclusive) == timeoutError);
+        }
+
+        BEAST_EXPECT (tryLock (keyFile, Mode::exclusive).empty ());
+
+        {
+            // No lock is needed if the key file directory does not exist
+            path const missing = subdir / "missing" / "validator_keys.json";
+            KeyFileLock const shared (missing, Mode::shared);
+            BEAST_EXPECT (! shared.locked ());
+            KeyFileLock const exclusive (missing, Mode::exclusive);
+            BEAST_EXPECT (! exclusive.locked ());
+            BEAST_EXPECT (! exists (missing.parent_path ()));
+        }
+    }
+
+    void
+    testConcurrentProcesses ()
+    {
+        testcase ("Concurrent Processes");
+
+#ifndef _WIN32
+        using namespace boost::filesystem;
+
+        std::string const subdir = "test_key_file";
+        KeyFileGuard const g (*this, subdir);
+        path const keyFile = subdir / "validator_keys.json";
+
+        {
+            std::stringstream coutCapture;
+            auto const old = std::cout.rdbuf (coutCapture.rdbuf ());
+            createKeyFile (keyFile);
+            std::cout.rdbuf (old);
+        }
+
+        int const processes = 16;
+        int const tokensPerProcess = 10;
+
+        std::vector<pid_t> children;
+        for (int i = 0; i < processes; ++i)
+        {
+            auto const pid = fork ();
+            if (pid == 0)
+            {
+                // Child: issue tokens, alternating with signing, and
+                // never return into the test framework.
+                std::stringstream coutCapture;
+                std::cout.rdbuf (coutCapture.rdbuf ());
+
+                int status = 0;
+                try
+                {
+                    for (int j = 0; j < tokensPerProcess; ++j)
+                    {
+                        createToken (keyFile);
+                        signData ("data to sign", keyFile);
+                    }
+                }
+                catch (std::exception const&)
+                {
+                    status = 1;
+                }
+                _exit (status);
+            }
+
+            if (! BEAST_EXPECT (pid > 0))
+                break;
+            children.push_back (pid);
+        }
+
+        for (auto const pid : children)
+        {
+            int status = 0;
+            BEAST_EXPECT (waitpid (pid, &status, 0) == pid);
+            BEAST_EXPECT (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+        }
+
+        // Lost updates would have handed out duplicate sequences and
+        // left the stored sequence short of the number of tokens.
+        auto const keys = ValidatorKeys::make_ValidatorKeys (keyFile);
+        BEAST_EXPECT (keys.tokenSequence () ==
+            children.size () * tokensPerProcess);
+#endif
+    }
+
+    void
+    testMissingKeyFile ()
+    {
+        testcase ("Missing Key File");
+
+        using namespace boost::filesystem;
+
+        std::string const subdir = "test_key_file";
+        KeyFileGuard const g (*this, subdir);
+        path const keyFile = subdir / "validator_keys.json";
+        std::string const expectedError =
+            "Failed to open key file: " + keyFile.string ();
+
+        // No lock file is left for a key file that never existed
+        auto const error = [](std::function<void ()> const& f)
+        {
+            try
+            {
+                f ();
+            }
+            catch (std::runtime_error const& e)
+            {
+                return std::string (e.what ());
+            }
+            return std::string ();
+        };
+        BEAST_EXPECT (error ([&]{ issueValidatorToken (keyFile); }) ==
+            expectedError);
+        BEAST_EXPECT (error ([&]{ revokeKeyFile (keyFile); }) ==
+            expectedError);
+        BEAST_EXPECT (error ([&]{ loadKeyFile (keyFile); }) ==
+            expectedError);
+        BEAST_EXPECT (! exists (KeyFileLock::lockPath (keyFile)));
+    }
+
+public:
+    void
+    run() override
+    {
+        testLockModes ();
+        testMissingKeyFile ();
+        testConcurrentProcesses ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(KeyFileLock, keys, ripple);
+
+} // tests
+
+} // ripple
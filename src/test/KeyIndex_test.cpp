@@ -0,0 +1,158 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyIndex.h>
+#include <ValidatorKeys.h>
+#include <ripple/beast/unit_test.h>
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+namespace ripple {
+
+namespace tests {
+
+class KeyIndex_test : public beast::unit_test::suite
+{
+private:
+    void
+    testLookup ()
+    {
+        testcase ("Lookup");
+
+        std::string const data = "data to sign";
+
+        // Start small so the table grows several times
+        KeyIndex index;
+        std::vector<ValidatorKeys> keys;
+        for (int i = 0; i < 200; ++i)
+        {
+            keys.emplace_back (i % 2 ? KeyType::ed25519 : KeyType::secp256k1);
+            if (i % 7 == 0)
+                keys.back ().revoke ();
+            BEAST_EXPECT (index.insert (keys.back ()));
+        }
+        BEAST_EXPECT (index.size () == keys.size ());
+
+        for (std::size_t i = 0; i < keys.size (); ++i)
+        {
+            auto const position = index.find (keys[i].publicKey ());
+            if (! BEAST_EXPECT (position && *position == i))
+                continue;
+            BEAST_EXPECT (index.revoked (i) == keys[i].revoked ());
+
+            auto const signature = index.sign (keys[i].publicKey (), data);
+            if (keys[i].revoked ())
+                BEAST_EXPECT (! signature);
+            else
+                BEAST_EXPECT (signature && *signature == keys[i].sign (data));
+        }
+
+        // Duplicates are rejected
+        BEAST_EXPECT (! index.insert (keys.front ()));
+        BEAST_EXPECT (index.size () == keys.size ());
+
+        // Unknown keys are not found
+        ValidatorKeys const other (KeyType::ed25519);
+        BEAST_EXPECT (! index.find (other.publicKey ()));
+        BEAST_EXPECT (! index.sign (other.publicKey (), data));
+
+        BEAST_EXPECT (index.memoryUsage () > 0);
+    }
+
+    void
+    testEmpty ()
+    {
+        testcase ("Empty");
+
+        KeyIndex const index;
+        ValidatorKeys const keys (KeyType::ed25519);
+        BEAST_EXPECT (index.size () == 0);
+        BEAST_EXPECT (! index.find (keys.publicKey ()));
+    }
+
+public:
+    void
+    run() override
+    {
+        testLookup ();
+        testEmpty ();
+    }
+};
+
+class KeyIndexBench_test : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace std::chrono;
+
+        std::string const data = "data to sign";
+        std::mt19937 rng;
+
+        for (std::size_t const count : {10000, 100000})
+        {
+            testcase ("Keys: " + std::to_string (count));
+
+            KeyIndex index (count);
+            std::vector<PublicKey> publicKeys;
+            publicKeys.reserve (count);
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                ValidatorKeys const keys (KeyType::ed25519);
+                index.insert (keys);
+                publicKeys.push_back (keys.publicKey ());
+            }
+
+            std::vector<PublicKey> requests;
+            std::uniform_int_distribution<std::size_t> pick (0, count - 1);
+            for (int i = 0; i < 100000; ++i)
+                requests.push_back (publicKeys[pick (rng)]);
+
+            std::size_t found = 0;
+            auto start = steady_clock::now ();
+            for (auto const& pk : requests)
+                found += index.find (pk) ? 1 : 0;
+            auto const lookup = duration_cast<nanoseconds> (
+                steady_clock::now () - start) / requests.size ();
+            BEAST_EXPECT (found == requests.size ());
+
+            std::size_t const signs = 10000;
+            start = steady_clock::now ();
+            for (std::size_t i = 0; i < signs; ++i)
+                BEAST_EXPECT (index.sign (requests[i], data));
+            auto const sign = duration_cast<nanoseconds> (
+                steady_clock::now () - start) / signs;
+
+            log << std::setw (7) << count << " keys: " <<
+                index.memoryUsage () / count << " bytes/key, lookup " <<
+                lookup.count () << " ns, lookup + sign " <<
+                sign.count () << " ns" << std::endl;
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(KeyIndex, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(KeyIndexBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyStore.h>
+#include <ValidatorKeys.h>
+#include <test/KeyFileGuard.h>
+#include <boost/filesystem.hpp>
+
+namespace ripple {
+
+namespace tests {
+
+class KeyStore_test : public beast::unit_test::suite
+{
+private:
+    template <class F>
+    std::string
+    error (F&& f)
+    {
+        try
+        {
+            f ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            return e.what ();
+        }
+        return "";
+    }
+
+    // Checks a backend against the behavior of the file backend.
+    // shown maps a key file to the path used in error messages.
+    template <class Shown>
+    void
+    testBackend (
+        KeyStore& store,
+        boost::filesystem::path const& subdir,
+        Shown&& shown)
+    {
+        using namespace boost::filesystem;
+
+        path const keyFile = subdir / "validator_keys.json";
+
+        BEAST_EXPECT (! store.exists (keyFile));
+        BEAST_EXPECT (error ([&]{ store.load (keyFile); }) ==
+            "Failed to open key file: " + shown (keyFile).string ());
+
+        BEAST_EXPECT (! store.fingerprint (keyFile));
+
+        store.store (keyFile, "contents");
+        BEAST_EXPECT (store.exists (keyFile));
+        BEAST_EXPECT (store.load (keyFile) == "contents");
+        auto const fingerprint = store.fingerprint (keyFile);
+        BEAST_EXPECT (fingerprint && ! fingerprint->empty ());
+        BEAST_EXPECT (store.fingerprint (keyFile) == fingerprint);
+
+        // Overwrite
+        store.store (keyFile, "more");
+        BEAST_EXPECT (store.load (keyFile) == "more");
+        BEAST_EXPECT (store.fingerprint (keyFile) != fingerprint);
+
+        // Directories are created as needed
+        path const nested = subdir / "directories/to/create/keys.json";
+        store.store (nested, "nested");
+        BEAST_EXPECT (store.load (nested) == "nested");
+
+        // Only JSON files directly in the directory are listed
+        store.store (subdir / "notes.txt", "notes");
+        store.store (subdir / "a.json", "a");
+        {
+            auto const files = store.list (subdir);
+            BEAST_EXPECT (files.size () == 2);
+            BEAST_EXPECT (files[0] == subdir / "a.json");
+            BEAST_EXPECT (files[1] == keyFile);
+        }
+        {
+            // Files that cannot be read are left empty
+            std::vector<path> files {
+                keyFile, subdir / "missing.json", subdir / "a.json"};
+            for (int i = 0; i < 100; ++i)
+                files.push_back (subdir / "a.json");
+
+            auto const contents = store.loadBatch (files);
+            BEAST_EXPECT (contents.size () == files.size ());
+            BEAST_EXPECT (contents[0] && *contents[0] == "more");
+            BEAST_EXPECT (! contents[1]);
+            bool same = true;
+            for (std::size_t i = 2; i < contents.size (); ++i)
+                same = same && contents[i] && *contents[i] == "a";
+            BEAST_EXPECT (same);
+            BEAST_EXPECT (store.loadBatch ({}).empty ());
+        }
+        store.remove (subdir / "notes.txt");
+        store.remove (subdir / "a.json");
+        BEAST_EXPECT (error ([&]{ store.list (subdir / "missing"); }) ==
+            "Cannot read key directory: " +
+                shown (subdir / "missing").string ());
+
+        path const badKeyFile = subdir / ".";
+        BEAST_EXPECT (error ([&]{ store.store (badKeyFile, "x"); }) ==
+            "Cannot open key file: " + shown (badKeyFile).string ());
+
+        path const conflictingPath = keyFile / "validators_keys.json";
+        BEAST_EXPECT (error ([&]{ store.store (conflictingPath, "x"); }) ==
+            "Cannot create directory: " +
+                shown (conflictingPath).parent_path ().string ());
+
+        store.remove (keyFile);
+        BEAST_EXPECT (! store.exists (keyFile));
+        store.remove (keyFile);
+
+        {
+            auto const shared1 = store.lock (keyFile, KeyFileLock::Mode::shared);
+            auto const shared2 = store.lock (keyFile, KeyFileLock::Mode::shared);
+        }
+        {
+            auto const exclusive =
+                store.lock (keyFile, KeyFileLock::Mode::exclusive);
+        }
+
+        // Keys round trip
+        ValidatorKeys keys (KeyType::ed25519);
+        keys.createValidatorToken ();
+        keys.writeToFile (keyFile, store);
+        BEAST_EXPECT (
+            keys == ValidatorKeys::make_ValidatorKeys (keyFile, store));
+    }
+
+    void
+    testMemory ()
+    {
+        testcase ("Memory");
+
+        MemoryKeyStore store;
+        testBackend (store, "test_key_file",
+            [](boost::filesystem::path const& p) { return p; });
+        BEAST_EXPECT (store.size () == 2);
+
+        // Fingerprints differ between stores holding the same file
+        MemoryKeyStore other;
+        store.store ("keys.json", "same");
+        other.store ("keys.json", "same");
+        BEAST_EXPECT (store.fingerprint ("keys.json") !=
+            other.fingerprint ("keys.json"));
+
+        // Nothing touched the disk
+        BEAST_EXPECT (! boost::filesystem::exists ("test_key_file"));
+    }
+
+    void
+    testFile ()
+    {
+        testcase ("File");
+
+        std::string const subdir = "test_key_file";
+        KeyFileGuard const g (*this, subdir);
+
+        FileKeyStore store;
+        testBackend (store, subdir,
+            [](boost::filesystem::path const& p) { return p; });
+    }
+
+    void
+    testTmpfs ()
+    {
+        testcase ("Tmpfs");
+
+        using namespace boost::filesystem;
+
+        auto const root = TmpfsKeyStore::defaultRoot () /
+            unique_path ("validator-keys-test-%%%%-%%%%-%%%%");
+        create_directories (root);
+
+        {
+            TmpfsKeyStore store (root);
+            BEAST_EXPECT (store.root () == root);
+            if (! store.onTmpfs ())
+                log << "Note: " << root.string () <<
+                    " is not on tmpfs" << std::endl;
+
+            testBackend (store, "test_key_file",
+                [&root](path const& p) { return root / p; });
+
+            BEAST_EXPECT (exists (root / "test_key_file/validator_keys.json"));
+            BEAST_EXPECT (! exists ("test_key_file"));
+        }
+
+        remove_all (root);
+    }
+
+public:
+    void
+    run() override
+    {
+        testMemory ();
+        testFile ();
+        testTmpfs ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(KeyStore, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,184 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyFileOps.h>
+#include <KeyringCache.h>
+#include <ripple/beast/unit_test.h>
+#include <boost/filesystem/operations.hpp>
+
+namespace ripple {
+
+namespace tests {
+
+class KeyringCache_test : public beast::unit_test::suite
+{
+private:
+    // Keyring entries are shared by every process of the user, so each
+    // run uses its own key file name.
+    static
+    boost::filesystem::path
+    uniqueKeyFile ()
+    {
+        return boost::filesystem::unique_path (
+            "keyring_cache_test/%%%%-%%%%-%%%%-%%%%.json");
+    }
+
+    void
+    testCache (KeyringCache::Keyring keyring)
+    {
+        testcase (keyring == KeyringCache::Keyring::user ? "User Keyring" :
+            keyring == KeyringCache::Keyring::session ? "Session Keyring" :
+                "Process Keyring");
+
+        auto const keyFile = uniqueKeyFile ();
+        KeyringCache const cache (std::chrono::seconds (60), keyring);
+
+        ValidatorKeys keys (KeyType::ed25519);
+        keys.createValidatorToken ();
+        auto const derived = keys.createValidatorToken (
+            KeyType::ed25519, TokenKeySource::derived);
+
+        BEAST_EXPECT (! cache.load (keyFile, "fingerprint"));
+
+        cache.store (keyFile, "fingerprint", keys);
+        auto const cached = cache.load (keyFile, "fingerprint");
+        BEAST_EXPECT (cached && *cached == keys);
+        if (cached)
+        {
+            BEAST_EXPECT (cached->sign ("data") == keys.sign ("data"));
+
+            // How tokens were issued is cached too
+            BEAST_EXPECT (cached->tokenKeyRanges ().size () == 2);
+            BEAST_EXPECT (! cached->regenerateValidatorToken (1));
+            auto const again = cached->regenerateValidatorToken (2);
+            BEAST_EXPECT (derived && again &&
+                again->toString () == derived->toString ());
+        }
+
+        // Entries for another fingerprint or file are not used
+        BEAST_EXPECT (! cache.load (keyFile, "changed"));
+        BEAST_EXPECT (! cache.load (uniqueKeyFile (), "fingerprint"));
+
+        // Newer entries replace older ones
+        keys.revoke ();
+        cache.store (keyFile, "changed", keys);
+        auto const replaced = cache.load (keyFile, "changed");
+        BEAST_EXPECT (replaced && *replaced == keys);
+        BEAST_EXPECT (! cache.load (keyFile, "fingerprint"));
+
+        cache.invalidate (keyFile);
+        BEAST_EXPECT (! cache.load (keyFile, "changed"));
+        cache.invalidate (keyFile);
+
+        // A cache without a time to live stores nothing
+        KeyringCache const disabled (std::chrono::seconds (0), keyring);
+        disabled.store (keyFile, "fingerprint", keys);
+        BEAST_EXPECT (! disabled.load (keyFile, "fingerprint"));
+    }
+
+    void
+    testProcessKeyring ()
+    {
+        testcase ("Process Keyring Copies");
+
+        auto const keyFile = uniqueKeyFile ();
+        ValidatorKeys const keys (KeyType::ed25519);
+
+        // Copies share entries, other caches do not
+        KeyringCache const cache (
+            std::chrono::seconds::max (), KeyringCache::Keyring::process);
+        KeyringCache const copy (cache);
+        KeyringCache const other (
+            std::chrono::seconds::max (), KeyringCache::Keyring::process);
+
+        cache.store (keyFile, "fingerprint", keys);
+        auto const cached = copy.load (keyFile, "fingerprint");
+        BEAST_EXPECT (cached && *cached == keys);
+        BEAST_EXPECT (! other.load (keyFile, "fingerprint"));
+
+        copy.invalidate (keyFile);
+        BEAST_EXPECT (! cache.load (keyFile, "fingerprint"));
+    }
+
+    void
+    testLoadKeyFile (KeyringCache::Keyring keyring)
+    {
+        testcase (keyring == KeyringCache::Keyring::process ?
+            "Load Key File, Process Keyring" : "Load Key File");
+
+        auto const keyFile = uniqueKeyFile ();
+        KeyringCache const cache (std::chrono::seconds (60), keyring);
+        MemoryKeyStore store;
+
+        ValidatorKeys const keys (KeyType::secp256k1);
+        keys.writeToFile (keyFile, store);
+        auto const fingerprint = store.fingerprint (keyFile);
+
+        // The first load reads the key file and fills the cache
+        BEAST_EXPECT (loadKeyFile (keyFile, store, &cache) == keys);
+        BEAST_EXPECT (fingerprint && cache.load (keyFile, *fingerprint));
+        BEAST_EXPECT (loadKeyFile (keyFile, store, &cache) == keys);
+
+        // Issuing a token removes the entry
+        issueValidatorToken (keyFile, store,
+            KeyType::secp256k1, TokenKeySource::random, &cache);
+        BEAST_EXPECT (! cache.load (keyFile, *fingerprint));
+        BEAST_EXPECT (
+            loadKeyFile (keyFile, store, &cache).tokenSequence () == 1);
+
+        // Rewriting the key file by other means is noticed
+        auto updated = loadKeyFile (keyFile, store);
+        updated.createValidatorToken ();
+        updated.writeToFile (keyFile, store);
+        BEAST_EXPECT (
+            loadKeyFile (keyFile, store, &cache).tokenSequence () == 2);
+
+        revokeKeyFile (keyFile, store, &cache);
+        BEAST_EXPECT (loadKeyFile (keyFile, store, &cache).revoked ());
+
+        cache.invalidate (keyFile);
+    }
+
+public:
+    void
+    run() override
+    {
+        testCache (KeyringCache::Keyring::process);
+        testProcessKeyring ();
+        testLoadKeyFile (KeyringCache::Keyring::process);
+
+        if (! KeyringCache::available ())
+        {
+            log << "Note: the kernel keyring is not available" << std::endl;
+            pass ();
+            return;
+        }
+
+        testCache (KeyringCache::Keyring::user);
+        testCache (KeyringCache::Keyring::session);
+        testLoadKeyFile (KeyringCache::Keyring::user);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(KeyringCache, keys, ripple);
+
+} // tests
+
+} // ripple
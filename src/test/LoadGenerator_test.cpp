@@ -0,0 +1,503 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <KeyStore.h>
+#include <ValidatorKeys.h>
+#include <ValidatorKeysTool.h>
+#include <ripple/beast/unit_test.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/wait.h>
+# include <unistd.h>
+
+namespace ripple {
+
+namespace tests {
+
+/** Simulates many validators rotating their keys at once
+
+    Key files for a fleet of validators are created in a temporary
+    directory, then worker processes run create_token, revoke_keys and
+    sign through runCommand, as separate invocations of the tool would.
+    Requests arrive at random at a fixed mean rate for each command
+    and are handed to whichever worker is free, so latency is measured
+    from when a request was due rather than from when a worker took it,
+    and includes any time spent queued behind slower requests.
+
+    The configuration is a comma separated list given with
+    --unittest-arg, for example
+
+        keys=500,seconds=10,workers=16,create_token=200,sign=2000
+
+    keys        Number of key files (100)
+    seconds     How long requests arrive for (5)
+    workers     Number of worker processes (8)
+    create_token, revoke_keys, sign
+                Requests per second for each command (50, 5, 500)
+    key_cache   Seconds to keep decoded keys cached, as --key-cache (0)
+    dir         Directory for the key files, which are otherwise kept
+                on tmpfs
+    seed        Seed for the request schedule (1)
+
+    Storage writes are read from each worker's /proc/self/io, so they
+    are zero for key files on tmpfs. To count fsync calls as well, run
+    the suite under strace -f -c -e trace=fsync,fdatasync.
+
+    Each revoke_keys request revokes a different validator, and other
+    requests only go to validators that are never revoked, so no
+    request fails. At most half the fleet is revoked.
+*/
+class LoadGenerator_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+
+    enum Command : std::uint8_t
+    {
+        createToken,
+        revokeKeys,
+        sign,
+        commandCount
+    };
+
+    struct Config
+    {
+        std::size_t keys = 100;
+        double seconds = 5;
+        unsigned workers = 8;
+        std::array<double, commandCount> rates {{50, 5, 500}};
+        unsigned keyCache = 0;
+        std::string dir;
+        std::uint32_t seed = 1;
+    };
+
+    struct Request
+    {
+        std::int64_t due;       // Nanoseconds after the start
+        Command command;
+        std::uint32_t keyFile;
+    };
+
+    // Written by the workers, in memory shared with them
+    struct Result
+    {
+        std::int64_t latency;   // Nanoseconds, or -1 if not run
+        bool failed;
+    };
+
+    struct Shared
+    {
+        std::atomic<std::size_t> next;
+        std::atomic<std::uint64_t> writeBytes;
+        std::atomic<std::uint64_t> writeCalls;
+        Result* results;        // One for each request, after this
+    };
+
+    // Counters the kernel keeps for this process
+    struct IoCounters
+    {
+        std::uint64_t writeBytes = 0;   // Sent to storage
+        std::uint64_t writeCalls = 0;   // write system calls
+    };
+
+    static
+    IoCounters
+    readIoCounters ()
+    {
+        IoCounters io;
+        std::ifstream in ("/proc/self/io");
+        std::string field;
+        std::uint64_t value;
+        while (in >> field >> value)
+        {
+            if (field == "write_bytes:")
+                io.writeBytes = value;
+            else if (field == "syscw:")
+                io.writeCalls = value;
+        }
+        return io;
+    }
+
+    static
+    char const*
+    name (Command command)
+    {
+        static char const* const names[] =
+            {"create_token", "revoke_keys", "sign"};
+        return names[command];
+    }
+
+    Config
+    parse (std::string const& arg)
+    {
+        Config config;
+
+        std::istringstream ss (arg);
+        std::string item;
+        while (std::getline (ss, item, ','))
+        {
+            auto const eq = item.find ('=');
+            if (eq == std::string::npos)
+            {
+                if (! item.empty ())
+                    fail ("Ignoring malformed setting: " + item);
+                continue;
+            }
+
+            auto const key = item.substr (0, eq);
+            auto const value = item.substr (eq + 1);
+            try
+            {
+                if (key == "keys")
+                    config.keys = std::stoul (value);
+                else if (key == "seconds")
+                    config.seconds = std::stod (value);
+                else if (key == "workers")
+                    config.workers = std::max (1ul, std::stoul (value));
+                else if (key == "create_token")
+                    config.rates[createToken] = std::stod (value);
+                else if (key == "revoke_keys")
+                    config.rates[revokeKeys] = std::stod (value);
+                else if (key == "sign")
+                    config.rates[sign] = std::stod (value);
+                else if (key == "key_cache")
+                    config.keyCache = std::stoul (value);
+                else if (key == "dir")
+                    config.dir = value;
+                else if (key == "seed")
+                    config.seed = std::stoul (value);
+                else
+                    fail ("Ignoring unknown setting: " + key);
+            }
+            catch (std::exception const&)
+            {
+                fail ("Ignoring malformed setting: " + item);
+            }
+        }
+
+        return config;
+    }
+
+    // Returns requests arriving as a Poisson process for each command,
+    // ordered by when they are due
+    std::vector<Request>
+    schedule (Config const& config)
+    {
+        using namespace std::chrono;
+
+        std::mt19937 rng (config.seed);
+        std::vector<Request> requests;
+
+        auto const revocable = static_cast<std::uint32_t> (config.keys / 2);
+        auto const horizon = duration_cast<nanoseconds> (
+            duration<double> (config.seconds)).count ();
+
+        for (std::uint8_t c = 0; c < commandCount; ++c)
+        {
+            auto const command = static_cast<Command> (c);
+            if (config.rates[command] <= 0)
+                continue;
+
+            std::exponential_distribution<double> gap (
+                config.rates[command] / 1e9);
+            std::uniform_int_distribution<std::uint32_t> pick (
+                revocable, static_cast<std::uint32_t> (config.keys) - 1);
+
+            std::uint32_t revoked = 0;
+            for (double due = gap (rng); due < horizon; due += gap (rng))
+            {
+                std::uint32_t keyFile;
+                if (command != revokeKeys)
+                    keyFile = pick (rng);
+                else if (revoked < revocable)
+                    keyFile = revoked++;
+                else
+                    break;
+
+                requests.push_back ({static_cast<std::int64_t> (due),
+                    command, keyFile});
+            }
+        }
+
+        std::sort (requests.begin (), requests.end (),
+            [](Request const& a, Request const& b)
+            {
+                return a.due < b.due;
+            });
+        return requests;
+    }
+
+    // Takes requests until none are left, running each when it is due
+    static
+    void
+    work (
+        Shared& shared,
+        std::vector<Request> const& requests,
+        std::vector<boost::filesystem::path> const& keyFiles,
+        KeyStore& store,
+        CommandOptions const& options,
+        clock_type::time_point start)
+    {
+        auto const io = readIoCounters ();
+
+        for (auto i = shared.next++; i < requests.size (); i = shared.next++)
+        {
+            auto const& request = requests[i];
+            auto const due = start + std::chrono::nanoseconds (request.due);
+            std::this_thread::sleep_until (due);
+
+            bool failed = false;
+            try
+            {
+                std::vector<std::string> args;
+                if (request.command == sign)
+                    args.push_back ("data to sign");
+                runCommand (name (request.command), args,
+                    keyFiles[request.keyFile], store, options);
+            }
+            catch (std::exception const&)
+            {
+                failed = true;
+            }
+
+            shared.results[i].latency =
+                std::chrono::duration_cast<std::chrono::nanoseconds> (
+                    clock_type::now () - due).count ();
+            shared.results[i].failed = failed;
+        }
+
+        auto const after = readIoCounters ();
+        shared.writeBytes += after.writeBytes - io.writeBytes;
+        shared.writeCalls += after.writeCalls - io.writeCalls;
+    }
+
+    void
+    report (
+        std::string const& label,
+        std::vector<std::int64_t> latencies,
+        std::size_t failures,
+        double seconds)
+    {
+        if (latencies.empty ())
+            return;
+
+        std::sort (latencies.begin (), latencies.end ());
+        auto const n = latencies.size ();
+        auto const ms = [&](double q)
+        {
+            auto const i = std::min (n - 1, static_cast<std::size_t> (q * n));
+            return latencies[i] / 1e6;
+        };
+
+        log << std::left << std::setw (13) << label << std::right <<
+            std::fixed << std::setprecision (2) <<
+            std::setw (8) << n <<
+            std::setw (10) << n / seconds <<
+            std::setw (10) << ms (0.5) <<
+            std::setw (10) << ms (0.99) <<
+            std::setw (10) << ms (0.999) <<
+            std::setw (10) << latencies.back () / 1e6 <<
+            std::setw (8) << failures << std::endl;
+    }
+
+public:
+    void
+    run() override
+    {
+        using namespace boost::filesystem;
+
+        auto const config = parse (arg ());
+
+        if (config.keys < 2)
+        {
+            fail ("At least two key files are needed");
+            return;
+        }
+
+        std::unique_ptr<KeyStore> tmpfs;
+        path root;
+        if (config.dir.empty ())
+        {
+            tmpfs = std::make_unique<TmpfsKeyStore> ();
+            root = static_cast<TmpfsKeyStore&> (*tmpfs).root ();
+        }
+        else
+        {
+            root = config.dir;
+        }
+        KeyStore& store = tmpfs ? *tmpfs : defaultKeyStore ();
+
+        path const dir = root / unique_path ("validator-keys-load-%%%%%%%%");
+
+        testcase ("Load: " + std::to_string (config.keys) + " validators, " +
+            std::to_string (config.workers) + " workers");
+
+        // Creating the fleet is not part of the load
+        std::vector<path> keyFiles;
+        keyFiles.reserve (config.keys);
+        for (std::size_t i = 0; i < config.keys; ++i)
+        {
+            keyFiles.push_back (dir / ("validator-" + std::to_string (i) +
+                ".json"));
+            ValidatorKeys (KeyType::ed25519).writeToFile (
+                keyFiles.back (), store);
+        }
+
+        auto const requests = schedule (config);
+
+        auto const bytes = sizeof (Shared) +
+            requests.size () * sizeof (Result);
+        auto const memory = mmap (nullptr, bytes, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (! BEAST_EXPECT (memory != MAP_FAILED))
+            return;
+
+        auto& shared = *new (memory) Shared;
+        shared.next = 0;
+        shared.writeBytes = 0;
+        shared.writeCalls = 0;
+        shared.results = reinterpret_cast<Result*> (
+            static_cast<char*> (memory) + sizeof (Shared));
+        for (std::size_t i = 0; i < requests.size (); ++i)
+            shared.results[i] = {-1, false};
+
+        CommandOptions options;
+        options.keyCacheTtl = std::chrono::seconds (config.keyCache);
+
+        // Children must not write out what the parent has buffered
+        std::cout.flush ();
+        std::cerr.flush ();
+
+        auto const start = clock_type::now ();
+
+        std::vector<pid_t> workers;
+        for (unsigned w = 0; w < config.workers; ++w)
+        {
+            auto const pid = fork ();
+            if (pid == 0)
+            {
+                // The tool's output is not of interest
+                auto const null = ::open ("/dev/null", O_WRONLY);
+                dup2 (null, STDOUT_FILENO);
+                dup2 (null, STDERR_FILENO);
+
+                int status = 0;
+                try
+                {
+                    work (shared, requests, keyFiles, store, options, start);
+                }
+                catch (...)
+                {
+                    status = 1;
+                }
+                _exit (status);
+            }
+            if (BEAST_EXPECT (pid > 0))
+                workers.push_back (pid);
+        }
+
+        for (auto const pid : workers)
+        {
+            int status = 0;
+            waitpid (pid, &status, 0);
+            BEAST_EXPECT (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+        }
+
+        auto const elapsed = std::chrono::duration<double> (
+            clock_type::now () - start).count ();
+
+        std::array<std::vector<std::int64_t>, commandCount> latencies;
+        std::array<std::size_t, commandCount> failures {};
+        std::vector<std::int64_t> all;
+        std::size_t totalFailures = 0;
+        std::size_t unfinished = 0;
+        for (std::size_t i = 0; i < requests.size (); ++i)
+        {
+            auto const& result = shared.results[i];
+            if (result.latency < 0)
+            {
+                ++unfinished;
+                continue;
+            }
+            auto const command = requests[i].command;
+            latencies[command].push_back (result.latency);
+            all.push_back (result.latency);
+            if (result.failed)
+            {
+                ++failures[command];
+                ++totalFailures;
+            }
+        }
+        auto const writeBytes = shared.writeBytes.load ();
+        auto const writeCalls = shared.writeCalls.load ();
+        auto const perRequest = [&](std::uint64_t n)
+        {
+            return all.empty () ? 0.0 : double (n) / all.size ();
+        };
+
+        log << "Key files in " << dir.string () <<
+            (tmpfs ? " (tmpfs store)" : "") << "\n";
+        log << std::left << std::setw (13) << "command" << std::right <<
+            std::setw (8) << "count" << std::setw (10) << "per sec" <<
+            std::setw (10) << "p50 ms" << std::setw (10) << "p99 ms" <<
+            std::setw (10) << "p999 ms" << std::setw (10) << "max ms" <<
+            std::setw (8) << "errors" << std::endl;
+        for (std::uint8_t c = 0; c < commandCount; ++c)
+            report (name (static_cast<Command> (c)), latencies[c],
+                failures[c], elapsed);
+        report ("all", all, totalFailures, elapsed);
+        log << std::fixed << std::setprecision (1) <<
+            "storage writes: " << writeBytes << " bytes (" <<
+            perRequest (writeBytes) << " per request), write calls: " <<
+            writeCalls << " (" << perRequest (writeCalls) <<
+            " per request)" << std::endl;
+
+        BEAST_EXPECT (unfinished == 0);
+        BEAST_EXPECT (totalFailures == 0);
+
+        munmap (memory, bytes);
+
+        boost::system::error_code ec;
+        remove_all (dir, ec);
+    }
+};
+
+BEAST_DEFINE_TESTSUITE_MANUAL(LoadGenerator, keys, ripple);
+
+} // tests
+
+} // ripple
+
+#endif
@@ -0,0 +1,206 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <ManifestReducer.h>
+#include <Manifest.h>
+#include <ValidatorKeys.h>
+#include <ripple/beast/unit_test.h>
+#include <beast/core/detail/base64.hpp>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace ripple {
+
+namespace tests {
+
+namespace {
+
+PublicKey
+masterKeyOf (std::string const& manifest)
+{
+    return deserializeManifest (
+        beast::detail::base64_decode (manifest))->masterKey;
+}
+
+} // namespace
+
+class ManifestReducer_test : public beast::unit_test::suite
+{
+private:
+    void
+    testReduce ()
+    {
+        testcase ("Reduce");
+
+        ValidatorKeys first (KeyType::ed25519);
+        ValidatorKeys second (KeyType::secp256k1);
+        ValidatorKeys third (KeyType::ed25519);
+
+        std::vector<std::string> tokens;
+        for (int i = 0; i < 3; ++i)
+            tokens.push_back (first.createValidatorToken ()->manifest);
+        auto const secondToken = second.createValidatorToken ()->manifest;
+        auto const thirdToken = third.createValidatorToken ()->manifest;
+        auto const revocation = third.revoke ();
+
+        ManifestReducer reducer (2);
+
+        // Older manifests that arrive later do not win
+        reducer.add ({tokens[1], secondToken, thirdToken});
+        reducer.add ({tokens[0], tokens[2], revocation});
+        reducer.add ({tokens[1], thirdToken});
+
+        BEAST_EXPECT (reducer.size () == 3);
+        BEAST_EXPECT (reducer.revoked () == 1);
+        BEAST_EXPECT (reducer.added () == 8);
+        BEAST_EXPECT (reducer.invalid () == 0);
+
+        // Manifests older than the current one are not checked
+        BEAST_EXPECT (reducer.checked () == 5);
+
+        std::vector<std::string> expected {
+            tokens[2], secondToken, revocation};
+        std::sort (expected.begin (), expected.end (),
+            [](std::string const& a, std::string const& b)
+            {
+                return masterKeyOf (a) < masterKeyOf (b);
+            });
+        BEAST_EXPECT (reducer.manifests () == expected);
+    }
+
+    void
+    testInvalid ()
+    {
+        testcase ("Invalid");
+
+        ValidatorKeys keys (KeyType::ed25519);
+        auto const token = keys.createValidatorToken ()->manifest;
+        auto const newer = keys.createValidatorToken ()->manifest;
+
+        auto serialized = beast::detail::base64_decode (newer);
+        serialized[serialized.size () - 1] ^= 1;
+        auto const tampered = beast::detail::base64_encode (serialized);
+
+        ManifestReducer reducer;
+        reducer.add ({token, tampered, "not a manifest", ""});
+
+        BEAST_EXPECT (reducer.size () == 1);
+        BEAST_EXPECT (reducer.invalid () == 3);
+        BEAST_EXPECT (reducer.manifests () ==
+            std::vector<std::string> {token});
+
+        ManifestReducer empty;
+        empty.add ({});
+        BEAST_EXPECT (empty.size () == 0);
+        BEAST_EXPECT (empty.manifests ().empty ());
+    }
+
+    void
+    testMany ()
+    {
+        testcase ("Many");
+
+        // Enough keys for the table to grow several times
+        std::size_t const count = 1000;
+        std::vector<ValidatorKeys> keys;
+        std::vector<std::string> latest;
+        std::vector<std::string> batch;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            keys.emplace_back (KeyType::ed25519);
+            batch.push_back (keys.back ().createValidatorToken (
+                KeyType::ed25519)->manifest);
+            latest.push_back (keys.back ().createValidatorToken (
+                KeyType::ed25519)->manifest);
+        }
+
+        ManifestReducer reducer;
+        reducer.add (latest);
+        reducer.add (batch);
+
+        BEAST_EXPECT (reducer.size () == count);
+        BEAST_EXPECT (reducer.checked () == count);
+
+        auto const manifests = reducer.manifests ();
+        std::sort (latest.begin (), latest.end ());
+        auto sorted = manifests;
+        std::sort (sorted.begin (), sorted.end ());
+        BEAST_EXPECT (sorted == latest);
+    }
+
+public:
+    void
+    run() override
+    {
+        testReduce ();
+        testInvalid ();
+        testMany ();
+    }
+};
+
+class ManifestReducerBench : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace std::chrono;
+
+        testcase ("Reduce");
+
+        // Several generations of tokens for each validator, shuffled,
+        // as when dumps from many peers are combined
+        std::size_t const validators = 2000;
+        std::size_t const generations = 25;
+        std::vector<std::string> manifests;
+        for (std::size_t i = 0; i < validators; ++i)
+        {
+            ValidatorKeys keys (KeyType::ed25519);
+            for (std::size_t g = 0; g < generations; ++g)
+                manifests.push_back (keys.createValidatorToken (
+                    KeyType::ed25519)->manifest);
+        }
+        std::shuffle (manifests.begin (), manifests.end (), std::mt19937 ());
+
+        auto const start = steady_clock::now ();
+        ManifestReducer reducer;
+        for (std::size_t i = 0; i < manifests.size (); i += 16384)
+            reducer.add (std::vector<std::string> (
+                manifests.begin () + i, manifests.begin () +
+                    std::min (i + 16384, manifests.size ())));
+        auto const elapsed = duration_cast<milliseconds> (
+            steady_clock::now () - start);
+
+        BEAST_EXPECT (reducer.size () == validators);
+        log << manifests.size () << " manifests for " << validators <<
+            " validators: " << elapsed.count () << " ms, " <<
+            reducer.checked () << " checked, " <<
+            reducer.memoryUsage () / validators << " bytes/validator" <<
+            std::endl;
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(ManifestReducer, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(ManifestReducerBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,273 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <Manifest.h>
+#include <ValidatorKeys.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/STObject.h>
+#include <beast/core/detail/base64.hpp>
+
+namespace ripple {
+
+namespace tests {
+
+class Manifest_test : public beast::unit_test::suite
+{
+private:
+    void
+    testToken ()
+    {
+        testcase ("Token");
+
+        for (auto const keyType : {KeyType::ed25519, KeyType::secp256k1})
+        {
+            ValidatorKeys keys (keyType);
+            auto const token = keys.createValidatorToken (keyType);
+            if (! BEAST_EXPECT (token))
+                continue;
+
+            auto const serialized =
+                beast::detail::base64_decode (token->manifest);
+            auto const manifest = deserializeManifest (serialized);
+            if (! BEAST_EXPECT (manifest))
+                continue;
+
+            BEAST_EXPECT (manifest->masterKey == keys.publicKey ());
+            BEAST_EXPECT (manifest->signingKey &&
+                *manifest->signingKey ==
+                    derivePublicKey (keyType, *token->secretKey));
+            BEAST_EXPECT (manifest->sequence == 1);
+            BEAST_EXPECT (! manifest->revoked ());
+            BEAST_EXPECT (verifyManifest (serialized));
+
+            // Any change to the signed fields breaks a signature
+            auto tampered = serialized;
+            tampered[tampered.size () - 1] ^= 1;
+            BEAST_EXPECT (! verifyManifest (tampered));
+
+            // A manifest from other keys is not confused with this one
+            ValidatorKeys other (keyType);
+            auto const otherToken = other.createValidatorToken (keyType);
+            BEAST_EXPECT (otherToken && deserializeManifest (
+                beast::detail::base64_decode (otherToken->manifest))->
+                    masterKey != keys.publicKey ());
+        }
+    }
+
+    void
+    testRevocation ()
+    {
+        testcase ("Revocation");
+
+        ValidatorKeys keys (KeyType::ed25519);
+        auto const serialized = beast::detail::base64_decode (keys.revoke ());
+        auto const manifest = deserializeManifest (serialized);
+        if (! BEAST_EXPECT (manifest))
+            return;
+
+        BEAST_EXPECT (manifest->masterKey == keys.publicKey ());
+        BEAST_EXPECT (! manifest->signingKey);
+        BEAST_EXPECT (manifest->revoked ());
+        BEAST_EXPECT (verifyManifest (serialized));
+    }
+
+    void
+    testMalformed ()
+    {
+        testcase ("Malformed");
+
+        BEAST_EXPECT (! deserializeManifest (""));
+        BEAST_EXPECT (! deserializeManifest ("not a manifest"));
+        BEAST_EXPECT (! verifyManifest ("not a manifest"));
+
+        // Truncated
+        ValidatorKeys keys (KeyType::ed25519);
+        auto const token = keys.createValidatorToken ();
+        if (! BEAST_EXPECT (token))
+            return;
+        auto const serialized = beast::detail::base64_decode (token->manifest);
+        BEAST_EXPECT (! deserializeManifest (
+            serialized.substr (0, serialized.size () / 2)));
+    }
+
+    // The decoder agrees with deserializeManifest and verifyManifest
+    void
+    checkDecoder (std::string const& serialized)
+    {
+        ManifestDecoder const decoder (serialized);
+        auto const expected = deserializeManifest (serialized);
+        auto const& manifest = decoder.manifest ();
+
+        BEAST_EXPECT (decoder.serialized () == serialized);
+        if (BEAST_EXPECT (bool (manifest) == bool (expected)) && expected)
+        {
+            BEAST_EXPECT (manifest->masterKey == expected->masterKey);
+            BEAST_EXPECT (manifest->signingKey == expected->signingKey);
+            BEAST_EXPECT (manifest->sequence == expected->sequence);
+        }
+        BEAST_EXPECT (decoder.verify () == verifyManifest (serialized));
+    }
+
+    void
+    testDecoder ()
+    {
+        testcase ("Decoder");
+
+        std::vector<std::string> manifests;
+        for (auto const keyType : {KeyType::ed25519, KeyType::secp256k1})
+        {
+            ValidatorKeys keys (keyType);
+            auto const token = keys.createValidatorToken (keyType);
+            if (BEAST_EXPECT (token))
+                manifests.push_back (
+                    beast::detail::base64_decode (token->manifest));
+            manifests.push_back (beast::detail::base64_decode (
+                keys.revoke ()));
+        }
+
+        for (auto const& serialized : manifests)
+        {
+            ManifestDecoder const decoder (serialized);
+            BEAST_EXPECT (decoder.manifest ());
+            BEAST_EXPECT (decoder.verify ());
+            checkDecoder (serialized);
+
+            // Every byte is either signed or part of a signature
+            for (std::size_t i = 0; i < serialized.size (); ++i)
+            {
+                auto tampered = serialized;
+                tampered[i] ^= 1;
+                checkDecoder (tampered);
+            }
+
+            for (std::size_t size = 0; size < serialized.size (); ++size)
+                checkDecoder (serialized.substr (0, size));
+        }
+
+        // A field rippled does not write is decoded the slow way
+        {
+            STObject st (sfGeneric);
+            SerialIter sit (manifests[0].data (), manifests[0].size ());
+            st.set (sit);
+            st[sfFlags] = std::uint32_t (1);
+
+            Serializer s;
+            st.add (s);
+            auto const extended = std::string (
+                static_cast<char const*> (s.data ()), s.size ());
+            BEAST_EXPECT (ManifestDecoder (extended).manifest ());
+            checkDecoder (extended);
+
+            // Keys with an unknown type are rejected, not trusted
+            for (auto const field : {&sfPublicKey, &sfSigningPubKey})
+            {
+                STObject bad (st);
+                auto key = bad.getFieldVL (*field);
+                key[0] = 0xEC;
+                bad.setFieldVL (*field, key);
+
+                Serializer sb;
+                bad.add (sb);
+                auto const serialized = std::string (
+                    static_cast<char const*> (sb.data ()), sb.size ());
+                BEAST_EXPECT (! deserializeManifest (serialized));
+                BEAST_EXPECT (! verifyManifest (serialized));
+                BEAST_EXPECT (! ManifestDecoder (serialized).manifest ());
+                checkDecoder (serialized);
+            }
+        }
+    }
+
+    void
+    testBulk ()
+    {
+        testcase ("Bulk");
+
+        std::vector<std::string> manifests;
+        for (auto const masterType : {KeyType::ed25519, KeyType::secp256k1})
+        {
+            for (auto const tokenType :
+                {KeyType::ed25519, KeyType::secp256k1})
+            {
+                ValidatorKeys keys (masterType);
+                auto const token = keys.createValidatorToken (tokenType);
+                if (! BEAST_EXPECT (token))
+                    continue;
+                auto const serialized =
+                    beast::detail::base64_decode (token->manifest);
+                manifests.push_back (serialized);
+
+                auto tampered = serialized;
+                tampered[tampered.size () / 2] ^= 1;
+                manifests.push_back (tampered);
+
+                // A digest of other data fails secp256k1 signatures
+                ManifestDecoder const decoder (serialized);
+                BEAST_EXPECT (! decoder.signedFields ().empty ());
+                BEAST_EXPECT (decoder.verify (uint256 ()) ==
+                    (masterType == KeyType::ed25519 &&
+                        tokenType == KeyType::ed25519));
+            }
+            manifests.push_back (beast::detail::base64_decode (
+                ValidatorKeys (masterType).revoke ()));
+        }
+        manifests.push_back ("not a manifest");
+        BEAST_EXPECT (ManifestDecoder ("").signedFields ().empty ());
+
+        // Enough manifests for several batches
+        while (manifests.size () < 200)
+            manifests.push_back (manifests[manifests.size () % 11]);
+
+        std::vector<ManifestDecoder> decoders;
+        std::vector<ManifestDecoder const*> pointers;
+        for (auto const& serialized : manifests)
+            decoders.emplace_back (serialized);
+        for (auto const& decoder : decoders)
+            pointers.push_back (&decoder);
+
+        for (auto const threads : {1u, 0u})
+        {
+            auto const valid = verifyManifests (pointers, threads);
+            if (! BEAST_EXPECT (valid.size () == manifests.size ()))
+                continue;
+            for (std::size_t i = 0; i < manifests.size (); ++i)
+                BEAST_EXPECT (bool (valid[i]) ==
+                    verifyManifest (manifests[i]));
+        }
+        BEAST_EXPECT (verifyManifests ({}).empty ());
+    }
+
+public:
+    void
+    run() override
+    {
+        testToken ();
+        testRevocation ();
+        testMalformed ();
+        testDecoder ();
+        testBulk ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(Manifest, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,212 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <MerkleTree.h>
+#include <ValidatorKeys.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/digest.h>
+
+namespace ripple {
+
+namespace tests {
+
+class MerkleTree_test : public beast::unit_test::suite
+{
+private:
+    static
+    std::vector<std::string>
+    makePayloads (std::size_t count)
+    {
+        std::vector<std::string> payloads;
+        for (std::size_t i = 0; i < count; ++i)
+            payloads.push_back ("payload " + std::to_string (i));
+        return payloads;
+    }
+
+    // Straightforward recursive definition of the root
+    static
+    uint256
+    referenceRoot (std::vector<uint256> level)
+    {
+        while (level.size () > 1)
+        {
+            std::vector<uint256> next;
+            for (std::size_t i = 0; i < level.size (); i += 2)
+                next.push_back (i + 1 < level.size () ?
+                    MerkleTree::hashInner (level[i], level[i + 1]) :
+                    level[i]);
+            level = std::move (next);
+        }
+        return level.front ();
+    }
+
+    void
+    testTree ()
+    {
+        testcase ("Tree");
+
+        try
+        {
+            MerkleTree const tree ({});
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                std::string ("No payloads to build a Merkle tree"));
+        }
+
+        // Leaves and inner nodes are hashed differently
+        {
+            sha512_half_hasher h;
+            h ("a", 1);
+            BEAST_EXPECT (MerkleTree::hashLeaf ("a") !=
+                static_cast<uint256> (h));
+        }
+
+        for (std::size_t count = 1; count <= 33; ++count)
+        {
+            auto const payloads = makePayloads (count);
+            MerkleTree const tree (payloads, 1);
+            BEAST_EXPECT (tree.size () == count);
+
+            std::vector<uint256> leaves;
+            for (auto const& payload : payloads)
+                leaves.push_back (MerkleTree::hashLeaf (payload));
+            BEAST_EXPECT (tree.root () == referenceRoot (leaves));
+
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                auto const proof = tree.proof (i);
+                BEAST_EXPECT (merkleRoot (payloads[i], proof) == tree.root ());
+                BEAST_EXPECT (merkleRoot (payloads[i] + "x", proof) !=
+                    tree.root ());
+            }
+        }
+
+        // A lone last node is not paired with itself
+        BEAST_EXPECT (MerkleTree (makePayloads (3)).root () !=
+            MerkleTree ({"payload 0", "payload 1", "payload 2",
+                "payload 2"}).root ());
+
+        // Threads do not change the result
+        auto const payloads = makePayloads (50000);
+        BEAST_EXPECT (MerkleTree (payloads, 1).root () ==
+            MerkleTree (payloads, 8).root ());
+    }
+
+    void
+    testProof ()
+    {
+        testcase ("Proof");
+
+        auto const payloads = makePayloads (11);
+        MerkleTree const tree (payloads);
+
+        auto proof = tree.proof (6);
+        BEAST_EXPECT (proof.index == 6 && proof.count == 11);
+        BEAST_EXPECT (proof.path.size () == 4);
+
+        // Paths of the wrong length, or indexes out of range, are rejected
+        auto shorter = proof;
+        shorter.path.pop_back ();
+        BEAST_EXPECT (! merkleRoot (payloads[6], shorter));
+        auto outside = proof;
+        outside.index = 11;
+        BEAST_EXPECT (! merkleRoot (payloads[6], outside));
+
+        // Swapping the order of payloads changes the root
+        auto moved = proof;
+        moved.index = 7;
+        BEAST_EXPECT (merkleRoot (payloads[6], moved) != tree.root ());
+
+        // The last payload skips levels where it has no sibling
+        BEAST_EXPECT (tree.proof (10).path.size () == 2);
+    }
+
+    void
+    testSignedProof ()
+    {
+        testcase ("Signed Proof");
+
+        for (auto const keyType : {KeyType::secp256k1, KeyType::ed25519})
+        {
+            ValidatorKeys const keys (keyType);
+            ValidatorKeys const other (keyType);
+
+            auto const payloads = makePayloads (5);
+            MerkleTree const tree (payloads);
+
+            SignedMerkleProof signedProof;
+            signedProof.root = tree.root ();
+            signedProof.signature = strUnHex (keys.sign (std::string (
+                reinterpret_cast<char const*> (tree.root ().data ()),
+                tree.root ().size ()))).first;
+
+            for (std::uint32_t i = 0; i < tree.size (); ++i)
+            {
+                signedProof.proof = tree.proof (i);
+                auto const encoded = encodeMerkleProof (signedProof);
+
+                auto const decoded = decodeMerkleProof (encoded);
+                if (! BEAST_EXPECT (decoded))
+                    continue;
+                BEAST_EXPECT (decoded->proof.index == i);
+                BEAST_EXPECT (decoded->proof.count == tree.size ());
+                BEAST_EXPECT (decoded->proof.path == signedProof.proof.path);
+                BEAST_EXPECT (decoded->root == tree.root ());
+                BEAST_EXPECT (decoded->signature == signedProof.signature);
+
+                BEAST_EXPECT (verifyMerkleProof (
+                    keys.publicKey (), payloads[i], *decoded));
+                BEAST_EXPECT (! verifyMerkleProof (
+                    other.publicKey (), payloads[i], *decoded));
+                BEAST_EXPECT (! verifyMerkleProof (
+                    keys.publicKey (), payloads[(i + 1) % 5], *decoded));
+            }
+
+            // A root that was not signed is rejected
+            auto forged = signedProof;
+            forged.root = MerkleTree (makePayloads (6)).root ();
+            forged.proof = MerkleTree (makePayloads (6)).proof (0);
+            BEAST_EXPECT (! verifyMerkleProof (
+                keys.publicKey (), payloads[0], forged));
+        }
+
+        BEAST_EXPECT (! decodeMerkleProof (""));
+        BEAST_EXPECT (! decodeMerkleProof ("AAAA"));
+    }
+
+public:
+    void
+    run() override
+    {
+        testTree ();
+        testProof ();
+        testSignedProof ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(MerkleTree, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,406 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <test/ParallelRunner.h>
+#include <ripple/beast/unit_test.h>
+#include <beast/unit_test/match.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#ifndef _WIN32
+# include <cerrno>
+# include <poll.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+namespace ripple {
+namespace tests {
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct SuiteResult
+{
+    std::string name;
+    std::string output;
+    std::size_t cases = 0;
+    std::size_t tests = 0;
+    std::size_t failures = 0;
+    clock_type::duration elapsed {};
+};
+
+// Records one suite's results and output in the format of the beast
+// reporter, so it can be printed later.
+class SuiteRecorder : public beast::unit_test::runner
+{
+public:
+    SuiteResult result;
+
+private:
+    std::ostringstream out_;
+    clock_type::time_point start_;
+
+    void
+    on_suite_begin (beast::unit_test::suite_info const& info) override
+    {
+        result.name = info.full_name ();
+        start_ = clock_type::now ();
+    }
+
+    void
+    on_suite_end () override
+    {
+        result.elapsed = clock_type::now () - start_;
+        result.output = out_.str ();
+    }
+
+    void
+    on_case_begin (std::string const& name) override
+    {
+        ++result.cases;
+        out_ << result.name << (name.empty () ? "" : " " + name) << '\n';
+    }
+
+    void
+    on_pass () override
+    {
+        ++result.tests;
+    }
+
+    void
+    on_fail (std::string const& reason) override
+    {
+        ++result.tests;
+        ++result.failures;
+        out_ << "#" << result.tests << " failed" <<
+            (reason.empty () ? "" : ": ") << reason << '\n';
+    }
+
+    void
+    on_log (std::string const& s) override
+    {
+        out_ << s;
+    }
+};
+
+// Runs a suite in a fresh temporary working directory
+SuiteResult
+runIsolated (
+    beast::unit_test::suite_info const& info,
+    std::string const& arg)
+{
+    using namespace boost::filesystem;
+
+    auto const cwd = current_path ();
+    auto const dir = temp_directory_path () /
+        unique_path ("validator-keys-unittest-%%%%-%%%%-%%%%");
+    create_directories (dir);
+    current_path (dir);
+
+    SuiteRecorder r;
+    r.arg (arg);
+    r.run (info);
+
+    current_path (cwd);
+    boost::system::error_code ec;
+    remove_all (dir, ec);
+
+    return r.result;
+}
+
+std::string
+formatSeconds (clock_type::duration d)
+{
+    using namespace std::chrono;
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision (3) <<
+        duration_cast<duration<double>> (d).count () << "s";
+    return ss.str ();
+}
+
+#ifndef _WIN32
+
+// Child to parent: "<cases> <tests> <failures> <elapsed ns>\n" + output
+std::string
+serialize (SuiteResult const& r)
+{
+    std::ostringstream ss;
+    ss << r.cases << ' ' << r.tests << ' ' << r.failures << ' ' <<
+        std::chrono::duration_cast<std::chrono::nanoseconds> (
+            r.elapsed).count () << '\n' << r.output;
+    return ss.str ();
+}
+
+bool
+deserialize (std::string const& s, SuiteResult& r)
+{
+    auto const eol = s.find ('\n');
+    if (eol == std::string::npos)
+        return false;
+
+    std::istringstream header (s.substr (0, eol));
+    std::int64_t ns;
+    if (! (header >> r.cases >> r.tests >> r.failures >> ns))
+        return false;
+
+    r.elapsed = std::chrono::duration_cast<clock_type::duration> (
+        std::chrono::nanoseconds (ns));
+    r.output = s.substr (eol + 1);
+    return true;
+}
+
+struct Child
+{
+    pid_t pid;
+    int fd;
+    std::size_t index;
+    std::string data;
+};
+
+void
+runForked (
+    std::vector<beast::unit_test::suite_info const*> const& suites,
+    std::vector<SuiteResult>& results,
+    std::string const& arg,
+    unsigned jobs)
+{
+    std::vector<Child> running;
+    std::size_t next = 0;
+
+    // Output already written to cout must not be written again by
+    // each child when it exits.
+    std::cout.flush ();
+
+    while (next < suites.size () || ! running.empty ())
+    {
+        while (running.size () < jobs && next < suites.size ())
+        {
+            auto const index = next++;
+            results[index].name = suites[index]->full_name ();
+
+            int fds[2];
+            if (pipe (fds) != 0)
+            {
+                results[index] = runIsolated (*suites[index], arg);
+                continue;
+            }
+
+            auto const pid = fork ();
+            if (pid == 0)
+            {
+                ::close (fds[0]);
+                int status = 0;
+                try
+                {
+                    auto const data = serialize (
+                        runIsolated (*suites[index], arg));
+                    std::size_t done = 0;
+                    while (done < data.size ())
+                    {
+                        auto const n = ::write (fds[1],
+                            data.data () + done, data.size () - done);
+                        if (n > 0)
+                            done += n;
+                        else if (errno != EINTR)
+                            break;
+                    }
+                }
+                catch (...)
+                {
+                    status = 1;
+                }
+                ::close (fds[1]);
+                _exit (status);
+            }
+
+            ::close (fds[1]);
+            if (pid < 0)
+            {
+                ::close (fds[0]);
+                results[index] = runIsolated (*suites[index], arg);
+                continue;
+            }
+
+            running.push_back ({pid, fds[0], index, {}});
+        }
+
+        // Drain every child's pipe so none blocks on a full buffer
+        std::vector<pollfd> pfds;
+        for (auto const& c : running)
+            pfds.push_back ({c.fd, POLLIN, 0});
+
+        if (poll (pfds.data (), pfds.size (), -1) < 0 && errno != EINTR)
+            break;
+
+        for (std::size_t i = pfds.size (); i-- > 0;)
+        {
+            if (! pfds[i].revents)
+                continue;
+
+            auto& c = running[i];
+            char buf[4096];
+            auto const n = ::read (c.fd, buf, sizeof (buf));
+            if (n > 0)
+            {
+                c.data.append (buf, n);
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            ::close (c.fd);
+            int status = 0;
+            waitpid (c.pid, &status, 0);
+
+            auto& r = results[c.index];
+            if (! deserialize (c.data, r) ||
+                ! WIFEXITED (status) || WEXITSTATUS (status) != 0)
+            {
+                std::ostringstream ss;
+                ss << r.name << '\n' << "#" << (r.tests + 1) <<
+                    " failed: suite did not complete";
+                if (WIFSIGNALED (status))
+                    ss << " (signal " << WTERMSIG (status) << ")";
+                ss << '\n';
+                r.output = ss.str ();
+                ++r.tests;
+                ++r.failures;
+            }
+
+            running.erase (running.begin () + i);
+        }
+    }
+}
+
+#endif
+
+std::vector<beast::unit_test::suite_info const*>
+selectSuites (std::string const& pattern)
+{
+    using namespace beast::unit_test;
+
+    std::vector<suite_info const*> suites;
+    auto const selected = match_auto (pattern);
+    for (auto const& s : global_suites ())
+        if (selected (s))
+            suites.push_back (&s);
+    return suites;
+}
+
+// Prints the time taken by every suite, slowest first, and the totals
+// without ending the line. Returns the number of failures.
+std::size_t
+printTimes (
+    std::vector<SuiteResult> const& results,
+    clock_type::time_point start,
+    std::ostream& os)
+{
+    SuiteResult total;
+    for (auto const& r : results)
+    {
+        total.cases += r.cases;
+        total.tests += r.tests;
+        total.failures += r.failures;
+    }
+
+    std::vector<SuiteResult const*> byTime;
+    for (auto const& r : results)
+        byTime.push_back (&r);
+    std::stable_sort (byTime.begin (), byTime.end (),
+        [](SuiteResult const* a, SuiteResult const* b)
+        {
+            return a->elapsed > b->elapsed;
+        });
+
+    os << "Suite times:\n";
+    for (auto const r : byTime)
+        os << std::setw (10) << formatSeconds (r->elapsed) << " " <<
+            r->name << '\n';
+
+    os << formatSeconds (clock_type::now () - start) << ", " <<
+        results.size () << " suites, " <<
+        total.cases << " cases, " <<
+        total.tests << " tests total, " <<
+        total.failures << " failures";
+    return total.failures;
+}
+
+}
+
+bool
+runSuitesSerial (
+    std::string const& pattern,
+    std::string const& arg,
+    std::ostream& os)
+{
+    auto const start = clock_type::now ();
+    auto const suites = selectSuites (pattern);
+
+    // Suites run in the current working directory, as they always have
+    std::vector<SuiteResult> results;
+    for (auto const suite : suites)
+    {
+        SuiteRecorder r;
+        r.arg (arg);
+        r.run (*suite);
+        os << r.result.output << std::flush;
+        results.push_back (std::move (r.result));
+    }
+
+    auto const failures = printTimes (results, start, os);
+    os << std::endl;
+    return failures != 0;
+}
+
+bool
+runSuitesParallel (
+    std::string const& pattern,
+    std::string const& arg,
+    unsigned jobs,
+    std::ostream& os)
+{
+    auto const start = clock_type::now ();
+    auto const suites = selectSuites (pattern);
+
+    std::vector<SuiteResult> results (suites.size ());
+
+#ifndef _WIN32
+    runForked (suites, results, arg, std::max (jobs, 1u));
+#else
+    for (std::size_t i = 0; i < suites.size (); ++i)
+        results[i] = runIsolated (*suites[i], arg);
+#endif
+
+    for (auto const& r : results)
+        os << r.output;
+
+    auto const failures = printTimes (results, start, os);
+    os << ", " << jobs << " jobs" << std::endl;
+    return failures != 0;
+}
+
+} // tests
+} // ripple
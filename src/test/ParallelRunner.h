@@ -0,0 +1,81 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_TEST_PARALLELRUNNER_H_INCLUDED
+#define VALIDATOR_KEYS_TEST_PARALLELRUNNER_H_INCLUDED
+
+#include <ostream>
+#include <string>
+
+namespace ripple {
+namespace tests {
+
+/** Runs unit test suites one at a time
+
+    Suites run in the current working directory, and the output of each
+    is printed as it finishes. The report ends with the time taken by
+    every suite, slowest first, as for runSuitesParallel.
+
+    @param pattern Selects suites as for --unittest
+
+    @param arg Argument passed to every suite, as for --unittest-arg
+
+    @param os Stream to write the report to
+
+    @return true if any test failed
+*/
+bool
+runSuitesSerial (
+    std::string const& pattern,
+    std::string const& arg,
+    std::ostream& os);
+
+/** Runs unit test suites concurrently
+
+    Each suite runs in its own child process, started in a fresh
+    temporary working directory, so suites that create key files with
+    the same relative paths do not collide. Output of each suite is
+    buffered and printed in suite order once all suites have finished,
+    so the report is the same whatever order the suites complete in.
+    The report ends with the time taken by every suite, slowest first.
+
+    Where processes cannot be forked, suites run one at a time.
+
+    @param pattern Selects suites as for --unittest
+
+    @param arg Argument passed to every suite, as for --unittest-arg
+
+    @param jobs Maximum number of suites to run at once
+
+    @param os Stream to write the report to
+
+    @return true if any test failed
+*/
+bool
+runSuitesParallel (
+    std::string const& pattern,
+    std::string const& arg,
+    unsigned jobs,
+    std::ostream& os);
+
+} // tests
+} // ripple
+
+#endif
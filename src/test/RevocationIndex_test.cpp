@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <RevocationIndex.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/SecretKey.h>
+#include <ripple/protocol/Seed.h>
+
+namespace ripple {
+
+namespace tests {
+
+class RevocationIndex_test : public beast::unit_test::suite
+{
+private:
+    static
+    std::vector<PublicKey>
+    randomKeys (std::size_t count)
+    {
+        std::vector<PublicKey> keys;
+        keys.reserve (count);
+        for (std::size_t i = 0; i < count; ++i)
+            keys.push_back (generateKeyPair (
+                i % 2 ? KeyType::ed25519 : KeyType::secp256k1,
+                randomSeed ()).first);
+        return keys;
+    }
+
+    void
+    testEmpty ()
+    {
+        testcase ("Empty");
+
+        RevocationIndex const index;
+        BEAST_EXPECT (index.size () == 0);
+        BEAST_EXPECT (! index.contains (randomKeys (1)[0]));
+
+        RevocationIndex const fromNothing (std::vector<PublicKey> {});
+        BEAST_EXPECT (! fromNothing.contains (randomKeys (1)[0]));
+    }
+
+    void
+    testContains ()
+    {
+        testcase ("Contains");
+
+        for (std::size_t const count : {1, 2, 63, 64, 1000})
+        {
+            auto const revoked = randomKeys (count);
+            RevocationIndex const index (revoked);
+            BEAST_EXPECT (index.size () == count);
+
+            bool all = true;
+            for (auto const& key : revoked)
+                all = all && index.contains (key);
+            BEAST_EXPECT (all);
+
+            // The filter lets some keys through, but the search does not
+            bool none = true;
+            for (auto const& key : randomKeys (1000))
+                none = none && ! index.contains (key);
+            BEAST_EXPECT (none);
+        }
+
+        // Duplicates are stored once
+        auto keys = randomKeys (10);
+        keys.insert (keys.end (), keys.begin (), keys.end ());
+        RevocationIndex const index (keys);
+        BEAST_EXPECT (index.size () == 10);
+        BEAST_EXPECT (index.contains (keys[3]));
+    }
+
+public:
+    void
+    run() override
+    {
+        testEmpty ();
+        testContains ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(RevocationIndex, keys, ripple);
+
+} // tests
+
+} // ripple
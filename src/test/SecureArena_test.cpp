@@ -0,0 +1,205 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <SecureArena.h>
+#include <ValidatorKeys.h>
+#include <ripple/beast/unit_test.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#ifndef _WIN32
+# include <sys/mman.h>
+#endif
+
+namespace ripple {
+
+namespace tests {
+
+class SecureArena_test : public beast::unit_test::suite
+{
+private:
+    void
+    testAllocate ()
+    {
+        testcase ("Allocate");
+
+        SecureArena arena (4096);
+
+        auto const p = static_cast<char*> (arena.allocate (32));
+        BEAST_EXPECT (p);
+        BEAST_EXPECT (reinterpret_cast<std::uintptr_t> (p) % 16 == 0);
+        std::memset (p, 0xAB, 32);
+
+        auto stats = arena.stats ();
+        BEAST_EXPECT (stats.regions == 1);
+        BEAST_EXPECT (stats.allocations == 1);
+        BEAST_EXPECT (stats.bytesInUse == 32);
+
+        // Freed blocks are zeroed and reused
+        arena.deallocate (p, 32);
+        stats = arena.stats ();
+        BEAST_EXPECT (stats.allocations == 0);
+        BEAST_EXPECT (stats.bytesInUse == 0);
+
+        auto const q = static_cast<char*> (arena.allocate (20));
+        BEAST_EXPECT (q == p);
+        BEAST_EXPECT (std::all_of (q, q + 32,
+            [](char c) { return c == 0; }));
+        arena.deallocate (q, 20);
+
+        // Many small blocks share a chunk
+        std::vector<void*> blocks;
+        for (int i = 0; i < 63; ++i)
+            blocks.push_back (arena.allocate (64));
+        BEAST_EXPECT (arena.stats ().regions == 1);
+        blocks.push_back (arena.allocate (64));
+        BEAST_EXPECT (arena.stats ().regions == 2);
+        for (auto b : blocks)
+            arena.deallocate (b, 64);
+
+        // Large blocks get their own region, released on free
+        auto const big = arena.allocate (10000);
+        BEAST_EXPECT (arena.stats ().regions == 3);
+        std::memset (big, 0xCD, 10000);
+        arena.deallocate (big, 10000);
+        BEAST_EXPECT (arena.stats ().regions == 2);
+        BEAST_EXPECT (arena.stats ().bytesInUse == 0);
+    }
+
+    void
+    testSecretKeys ()
+    {
+        testcase ("Secret Keys");
+
+        auto& arena = SecureArena::instance ();
+
+        SecureString s (100, 'x');
+        BEAST_EXPECT (arena.owns (s.data ()));
+
+        std::string const plain (100, 'x');
+        BEAST_EXPECT (! arena.owns (plain.data ()));
+
+        auto const sk = make_secure<SecretKey> (
+            generateSecretKey (KeyType::ed25519, randomSeed ()));
+        BEAST_EXPECT (arena.owns (sk.get ()));
+
+        ValidatorKeys keys (KeyType::ed25519);
+        auto const token = keys.createValidatorToken ();
+        if (BEAST_EXPECT (token))
+            BEAST_EXPECT (arena.owns (token->secretKey.get ()));
+
+        for (auto const& t : keys.createValidatorTokens (10))
+            BEAST_EXPECT (arena.owns (t.secretKey.get ()));
+    }
+
+public:
+    void
+    run() override
+    {
+        testAllocate ();
+        testSecretKeys ();
+    }
+};
+
+class SecureArenaBench_test : public beast::unit_test::suite
+{
+private:
+    template <class F>
+    void
+    measure (std::string const& name, std::size_t count, F&& f)
+    {
+        using namespace std::chrono;
+        auto const start = steady_clock::now ();
+        f ();
+        auto const elapsed = duration_cast<nanoseconds> (
+            steady_clock::now () - start);
+        log << std::left << std::setw (28) << name << std::right <<
+            std::setw (10) << elapsed.count () / count << " ns/key" <<
+            std::endl;
+    }
+
+public:
+    void
+    run() override
+    {
+        testcase ("Secret key allocation");
+
+        std::size_t const count = 100000;
+        auto const sk = generateSecretKey (KeyType::ed25519, randomSeed ());
+
+        std::vector<std::shared_ptr<SecretKey const>> keys;
+        keys.reserve (count);
+
+        measure ("heap (previous path)", count, [&]
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                keys.push_back (std::make_shared<SecretKey> (sk));
+            keys.clear ();
+        });
+
+        measure ("secure arena", count, [&]
+        {
+            for (std::size_t i = 0; i < count; ++i)
+                keys.push_back (make_secure<SecretKey> (sk));
+            keys.clear ();
+        });
+
+#ifndef _WIN32
+        // What locking each key individually would cost
+        std::size_t const lockCount = count / 10;
+        measure ("mlock per key", lockCount, [&]
+        {
+            for (std::size_t i = 0; i < lockCount; ++i)
+            {
+                auto const p = std::make_shared<SecretKey> (sk);
+                mlock (p.get (), sizeof (SecretKey));
+                munlock (p.get (), sizeof (SecretKey));
+            }
+        });
+#endif
+
+        testcase ("Token issuance");
+
+        // Key generation and signing dominate, so the arena's share of
+        // the per token cost is the secure arena figure above.
+        std::uint32_t const tokens = 1000;
+        ValidatorKeys keys (KeyType::ed25519);
+        measure ("createValidatorTokens", tokens, [&]
+        {
+            auto const t = keys.createValidatorTokens (tokens);
+            BEAST_EXPECT (t.size () == tokens);
+        });
+
+        auto const stats = SecureArena::instance ().stats ();
+        log << "arena regions: " << stats.regions <<
+            ", mapped: " << stats.bytesMapped <<
+            ", locked: " << (stats.locked ? "yes" : "no") << std::endl;
+
+        pass ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SecureArena, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(SecureArenaBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,177 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <Sha512HalfBatch.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/digest.h>
+#include <chrono>
+#include <iomanip>
+#include <random>
+
+namespace ripple {
+
+namespace tests {
+
+namespace {
+
+std::vector<std::string>
+makeMessages (std::size_t count, std::size_t minSize, std::size_t maxSize)
+{
+    std::mt19937 rng;
+    std::uniform_int_distribution<std::size_t> size (minSize, maxSize);
+    std::uniform_int_distribution<int> byte (0, 255);
+    std::vector<std::string> messages (count);
+    for (auto& message : messages)
+    {
+        message.resize (size (rng));
+        for (auto& c : message)
+            c = static_cast<char> (byte (rng));
+    }
+    return messages;
+}
+
+std::vector<Slice>
+makeSlices (std::vector<std::string> const& messages)
+{
+    std::vector<Slice> slices;
+    for (auto const& message : messages)
+        slices.push_back (makeSlice (message));
+    return slices;
+}
+
+uint256
+reference (Slice const& prefix, Slice const& body)
+{
+    sha512_half_hasher h;
+    h (prefix.data (), prefix.size ());
+    h (body.data (), body.size ());
+    return static_cast<typename sha512_half_hasher::result_type> (h);
+}
+
+} // namespace
+
+class Sha512HalfBatch_test : public beast::unit_test::suite
+{
+private:
+    void
+    check (
+        Slice const& prefix,
+        std::vector<std::string> const& messages)
+    {
+        auto const bodies = makeSlices (messages);
+        std::vector<uint256> digests (bodies.size ());
+        sha512HalfBatch (prefix, bodies.data (), digests.data (),
+            bodies.size ());
+
+        std::size_t bad = 0;
+        for (std::size_t i = 0; i < bodies.size (); ++i)
+            if (digests[i] != reference (prefix, bodies[i]))
+                ++bad;
+        BEAST_EXPECT (bad == 0);
+    }
+
+public:
+    void
+    run() override
+    {
+        std::uint8_t const prefix = 0x4C;
+
+        testcase ("Padding boundaries");
+        {
+            // With a one byte prefix, padding spills into a second block
+            // from 111 bytes and fills a block exactly at 127 bytes
+            for (std::size_t const size : {0, 1, 63, 110, 111, 112, 126,
+                127, 128, 239, 240, 255, 256, 1000})
+            {
+                check (Slice (&prefix, 1), makeMessages (5, size, size));
+                check (Slice (), makeMessages (5, size, size));
+            }
+        }
+
+        testcase ("Counts");
+        {
+            for (std::size_t const count : {0, 1, 3, 4, 5, 8, 1000})
+                check (Slice (&prefix, 1), makeMessages (count, 0, 300));
+        }
+
+        testcase ("Mixed lengths");
+        {
+            // Lanes finish at different times and are refilled
+            auto messages = makeMessages (100, 0, 40);
+            auto const longer = makeMessages (7, 2000, 5000);
+            messages.insert (messages.begin () + 2,
+                longer.begin (), longer.end ());
+            check (Slice (&prefix, 1), messages);
+        }
+    }
+};
+
+class Sha512HalfBatchBench : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace std::chrono;
+
+        std::uint8_t const prefix = 0x4C;
+        Slice const prefixSlice (&prefix, 1);
+        std::size_t const count = 100000;
+
+        log << "Vectorized: " <<
+            (sha512HalfBatchVectorized () ? "yes" : "no") << std::endl;
+
+        // Leaf payloads, inner nodes of a Merkle tree and manifests
+        for (std::size_t const size : {65, 200, 1000})
+        {
+            testcase ("Message size: " + std::to_string (size));
+
+            auto const messages = makeMessages (count, size, size);
+            auto const bodies = makeSlices (messages);
+            std::vector<uint256> single (count);
+            std::vector<uint256> batch (count);
+
+            auto start = steady_clock::now ();
+            for (std::size_t i = 0; i < count; ++i)
+                single[i] = reference (prefixSlice, bodies[i]);
+            auto const one = duration_cast<nanoseconds> (
+                steady_clock::now () - start) / count;
+
+            start = steady_clock::now ();
+            sha512HalfBatch (prefixSlice, bodies.data (), batch.data (),
+                count);
+            auto const many = duration_cast<nanoseconds> (
+                steady_clock::now () - start) / count;
+
+            BEAST_EXPECT (single == batch);
+
+            log << std::setw (5) << size << " bytes: one at a time " <<
+                one.count () << " ns, batched " << many.count () <<
+                " ns per message" << std::endl;
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(Sha512HalfBatch, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(Sha512HalfBatchBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,347 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <SigningRing.h>
+#include <SigningRingServer.h>
+#include <ValidatorKeys.h>
+#include <ValidatorKeysTool.h>
+#include <ripple/beast/unit_test.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <thread>
+
+#ifndef _WIN32
+# include <sys/wait.h>
+
+namespace ripple {
+
+namespace tests {
+
+static
+std::string
+ringName (std::string const& suffix)
+{
+    return "/validator_keys_test_" + std::to_string (getpid ()) + "_" + suffix;
+}
+
+class SigningRing_test : public beast::unit_test::suite
+{
+private:
+    void
+    testRing ()
+    {
+        testcase ("Ring");
+
+        using namespace signing_ring;
+
+        auto ring = std::make_unique<Ring<Request>> ();
+        BEAST_EXPECT (! ring->front ());
+        BEAST_EXPECT (! ring->wait (10, std::chrono::microseconds {1000}));
+
+        // Start near the wrap so cursors overflow while the ring is in use
+        ring->head = ring->tail = std::numeric_limits<std::uint32_t>::max () - 5;
+
+        for (std::uint32_t i = 0; i < slotCount; ++i)
+        {
+            auto const slot = ring->prepare ();
+            if (! BEAST_EXPECT (slot))
+                return;
+            slot->size = i;
+            ring->publish ();
+        }
+        BEAST_EXPECT (! ring->prepare ());
+
+        for (std::uint32_t i = 0; i < slotCount; ++i)
+        {
+            auto const slot = ring->wait (0, std::chrono::microseconds {1000});
+            if (! BEAST_EXPECT (slot))
+                return;
+            BEAST_EXPECT (slot->size == i);
+            ring->pop ();
+        }
+        BEAST_EXPECT (! ring->front ());
+        BEAST_EXPECT (ring->prepare ());
+    }
+
+    void
+    testSign (std::uint32_t spins)
+    {
+        testcase ("Sign, spins: " + std::to_string (spins));
+
+        using namespace signing_ring;
+
+        auto const name = ringName ("sign");
+        ValidatorKeys const keys (KeyType::secp256k1);
+        SigningRingServer server (keys, name, spins);
+        std::thread thread ([&server] { server.run (); });
+
+        {
+            Client client (name, spins);
+
+            for (std::size_t size : {1, 12, 100, 1023, 1024})
+            {
+                std::string const data (size, 'x');
+                BEAST_EXPECT (client.sign (data) == keys.sign (data));
+            }
+
+            // Pipeline requests; responses arrive in order
+            for (int i = 0; i < 20; ++i)
+                BEAST_EXPECT (client.submit ("data" + std::to_string (i)));
+            for (int i = 0; i < 20; ++i)
+            {
+                std::string signature;
+                BEAST_EXPECT (client.receive (signature));
+                BEAST_EXPECT (signature ==
+                    keys.sign ("data" + std::to_string (i)));
+            }
+
+            std::string const tooLarge (maxData + 1, 'x');
+            BEAST_EXPECT (! client.submit (tooLarge.data (), tooLarge.size ()));
+            try
+            {
+                client.sign (tooLarge);
+                fail ();
+            }
+            catch (std::runtime_error const& e)
+            {
+                BEAST_EXPECT (e.what () == std::string (
+                    "Data too large to sign"));
+            }
+        }
+
+        server.stop ();
+        thread.join ();
+    }
+
+    void
+    testStop ()
+    {
+        testcase ("Stop");
+
+        using namespace signing_ring;
+
+        auto const name = ringName ("stop");
+        ValidatorKeys const keys (KeyType::ed25519);
+
+        {
+            SigningRingServer server (keys, name);
+
+            // Another server cannot claim a ring that is in use
+            try
+            {
+                SigningRingServer other (keys, name);
+                fail ();
+            }
+            catch (std::runtime_error const& e)
+            {
+                BEAST_EXPECT (e.what () ==
+                    "Cannot open signing ring: " + name);
+            }
+
+            Client client (name);
+            std::uint64_t served = 0;
+            std::thread thread ([&] { served = server.run (); });
+
+            BEAST_EXPECT (client.sign ("data") == keys.sign ("data"));
+            server.stop ();
+            thread.join ();
+            BEAST_EXPECT (served == 1);
+
+            // A stopped server fails outstanding requests
+            std::string signature;
+            BEAST_EXPECT (client.submit (std::string ("data")));
+            BEAST_EXPECT (! client.receive (signature));
+        }
+
+        // The ring is removed with its server
+        try
+        {
+            Client client (name);
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == "Cannot open signing ring: " + name);
+        }
+
+        // Names get a leading slash
+        SigningRingServer server (keys, name.substr (1));
+        Client client (name);
+        pass ();
+    }
+
+    void
+    testDeadServer ()
+    {
+        testcase ("Dead Server");
+
+        using namespace signing_ring;
+
+        auto const name = ringName ("dead");
+        Mapping mapping (name, true);
+        Client client (name);
+        BEAST_EXPECT (client.serverRunning ());
+
+        // A server that does not answer times out
+        std::string signature;
+        BEAST_EXPECT (client.submit (std::string ("data")));
+        BEAST_EXPECT (! client.receive (
+            signature, std::chrono::milliseconds {10}));
+
+        // A server that exits without stopping is noticed
+        auto const pid = fork ();
+        if (pid == 0)
+            _exit (0);
+        if (! BEAST_EXPECT (pid > 0))
+            return;
+        waitpid (pid, nullptr, 0);
+        mapping.layout ().server.store (pid);
+        BEAST_EXPECT (! client.serverRunning ());
+
+        auto const start = std::chrono::steady_clock::now ();
+        BEAST_EXPECT (! client.receive (signature));
+        try
+        {
+            client.sign ("data");
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == std::string (
+                "Signing ring request failed"));
+        }
+        BEAST_EXPECT (std::chrono::steady_clock::now () - start <
+            std::chrono::seconds {5});
+    }
+
+public:
+    void
+    run() override
+    {
+        testRing ();
+        testSign (0);
+        testSign (1000);
+        testStop ();
+        testDeadServer ();
+    }
+};
+
+class SigningRingBench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+
+    template <class F>
+    void
+    measure (std::string const& label, std::size_t count, F&& f)
+    {
+        using namespace std::chrono;
+
+        std::vector<nanoseconds> samples;
+        samples.reserve (count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto const start = clock_type::now ();
+            f ();
+            samples.push_back (clock_type::now () - start);
+        }
+        std::sort (samples.begin (), samples.end ());
+
+        auto const us = [](nanoseconds d)
+        {
+            return duration_cast<duration<double, std::micro>> (d).count ();
+        };
+
+        log << std::left << std::setw (28) << label << std::right <<
+            std::fixed << std::setprecision (1) <<
+            " p50 " << std::setw (8) << us (samples[count / 2]) << " us" <<
+            " p99 " << std::setw (8) << us (samples[count * 99 / 100]) <<
+            " us" << std::endl;
+    }
+
+public:
+    void
+    run() override
+    {
+        using namespace boost::filesystem;
+
+        std::string const data = "data to sign";
+
+        for (auto const keyType : {KeyType::ed25519, KeyType::secp256k1})
+        {
+            testcase (to_string (keyType));
+
+            ValidatorKeys const keys (keyType);
+
+            measure ("in-process sign", 10000,
+                [&] { keys.sign (data); });
+
+            for (std::uint32_t const spins : {0u, 1000000u})
+            {
+                // Busy-polling needs a core for each side
+                if (spins && std::thread::hardware_concurrency () < 2)
+                    continue;
+
+                auto const name = ringName ("bench");
+                SigningRingServer server (keys, name, spins);
+                std::thread thread ([&server] { server.run (); });
+                {
+                    signing_ring::Client client (name, spins);
+                    measure (spins ? "ring, busy-poll" : "ring, futex",
+                        10000, [&] { client.sign (data); });
+                }
+                server.stop ();
+                thread.join ();
+            }
+
+            // The sign command also pays for process start up, which
+            // this does not measure.
+            path const keyFile = temp_directory_path () /
+                unique_path ("validator_keys_bench_%%%%%%%%.json");
+            keys.writeToFile (keyFile);
+
+            std::stringstream coutCapture;
+            auto const oldCout = std::cout.rdbuf (coutCapture.rdbuf ());
+            measure ("one-shot sign (no exec)", 1000, [&]
+            {
+                signData (data, keyFile);
+                coutCapture.str ("");
+            });
+            std::cout.rdbuf (oldCout);
+
+            remove (keyFile);
+            remove (keyFile.string () + ".lock");
+        }
+
+        pass ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(SigningRing, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(SigningRingBench, keys, ripple);
+
+} // tests
+
+} // ripple
+
+#endif
@@ -0,0 +1,338 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <Parallel.h>
+#include <ThreadPool.h>
+#include <ripple/beast/unit_test.h>
+#include <chrono>
+#include <iomanip>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ripple {
+
+namespace tests {
+
+namespace {
+
+// A little work that the optimizer cannot drop
+std::uint64_t
+spin (std::uint64_t seed, unsigned rounds)
+{
+    for (unsigned i = 0; i < rounds; ++i)
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    return seed;
+}
+
+} // namespace
+
+class ThreadPool_test : public beast::unit_test::suite
+{
+private:
+    void
+    testParallelFor ()
+    {
+        testcase ("Parallel for");
+
+        ThreadPool pool (3);
+        BEAST_EXPECT (pool.size () == 3);
+
+        for (std::size_t const count : {0, 1, 7, 1000, 100000})
+        {
+            std::vector<std::atomic<int>> calls (count);
+            for (auto& c : calls)
+                c = 0;
+            parallelFor (pool, count, 0, 1,
+                [&](std::size_t i)
+                {
+                    ++calls[i];
+                });
+
+            bool once = true;
+            for (auto const& c : calls)
+                once = once && c.load () == 1;
+            BEAST_EXPECT (once);
+        }
+
+        // Calls made with one thread stay on the calling thread
+        std::set<std::thread::id> ids;
+        parallelFor (pool, 1000, 1, 1,
+            [&](std::size_t)
+            {
+                ids.insert (std::this_thread::get_id ());
+            });
+        BEAST_EXPECT (ids.size () == 1);
+        BEAST_EXPECT (*ids.begin () == std::this_thread::get_id ());
+    }
+
+    void
+    testNested ()
+    {
+        testcase ("Nested");
+
+        // More waiting callers than threads must not deadlock
+        ThreadPool pool (2);
+        std::atomic<std::size_t> total {0};
+        parallelFor (pool, 16, 0, 1,
+            [&](std::size_t)
+            {
+                parallelFor (pool, 100, 0, 1,
+                    [&](std::size_t)
+                    {
+                        ++total;
+                    });
+            });
+        BEAST_EXPECT (total == 1600);
+    }
+
+    void
+    testExceptions ()
+    {
+        testcase ("Exceptions");
+
+        ThreadPool pool (2);
+        std::atomic<std::size_t> calls {0};
+        try
+        {
+            parallelFor (pool, 10000, 0, 1,
+                [&](std::size_t i)
+                {
+                    ++calls;
+                    if (i == 10)
+                        throw std::runtime_error ("call 10");
+                });
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == std::string ("call 10"));
+        }
+        BEAST_EXPECT (calls < 10000);
+
+        // The pool is still usable
+        std::atomic<std::size_t> after {0};
+        parallelFor (pool, 1000, 0, 1,
+            [&](std::size_t)
+            {
+                ++after;
+            });
+        BEAST_EXPECT (after == 1000);
+    }
+
+    void
+    testSubmit ()
+    {
+        testcase ("Submit");
+
+        std::atomic<std::size_t> ran {0};
+        {
+            ThreadPool pool (2);
+            for (int i = 0; i < 1000; ++i)
+                pool.submit ([&ran] { ++ran; });
+
+            while (pool.runPending ())
+                ;
+        }
+        // Queued tasks run before the pool stops
+        BEAST_EXPECT (ran == 1000);
+
+        // Tasks may submit tasks
+        ran = 0;
+        {
+            ThreadPool pool (2);
+            for (int i = 0; i < 100; ++i)
+            {
+                pool.submit ([&ran, &pool]
+                {
+                    for (int j = 0; j < 10; ++j)
+                        pool.submit ([&ran] { ++ran; });
+                });
+            }
+            while (ran < 1000)
+            {
+                if (! pool.runPending ())
+                    std::this_thread::yield ();
+            }
+        }
+        BEAST_EXPECT (ran == 1000);
+    }
+
+    void
+    testPinned ()
+    {
+        testcase ("Pinned");
+
+        ThreadPool pool (2, true);
+        std::atomic<std::size_t> total {0};
+        parallelFor (pool, 1000, 0, 1,
+            [&](std::size_t)
+            {
+                ++total;
+            });
+        BEAST_EXPECT (total == 1000);
+    }
+
+    void
+    testDefaultSize ()
+    {
+        testcase ("Default size");
+
+        BEAST_EXPECT (ThreadPool::defaultSize () >= 1);
+        BEAST_EXPECT (ThreadPool::defaultSize () <=
+            std::max (1u, std::thread::hardware_concurrency ()));
+
+        ThreadPool pool;
+        BEAST_EXPECT (pool.size () == ThreadPool::defaultSize ());
+    }
+
+public:
+    void
+    run() override
+    {
+        testParallelFor ();
+        testNested ();
+        testExceptions ();
+        testSubmit ();
+        testPinned ();
+        testDefaultSize ();
+    }
+};
+
+/** Measures the scheduler
+
+    Reports the cost of a task submitted to the pool, of a parallelFor
+    against starting threads for each loop, and how CPU-bound work
+    scales with the number of threads.
+*/
+class ThreadPoolBench : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace std::chrono;
+
+        unsigned const cpus = ThreadPool::defaultSize ();
+        log << "CPUs available: " << cpus << std::endl;
+
+        {
+            testcase ("Task overhead");
+
+            ThreadPool pool (cpus);
+            std::size_t const count = 200000;
+            std::atomic<std::size_t> ran {0};
+
+            auto const start = steady_clock::now ();
+            for (std::size_t i = 0; i < count; ++i)
+                pool.submit ([&ran] { ++ran; });
+            while (ran < count)
+            {
+                if (! pool.runPending ())
+                    std::this_thread::yield ();
+            }
+            auto const each = duration_cast<nanoseconds> (
+                steady_clock::now () - start) / count;
+
+            BEAST_EXPECT (ran == count);
+            log << "submit and run: " << each.count () <<
+                " ns per task" << std::endl;
+        }
+
+        {
+            testcase ("Loop overhead");
+
+            ThreadPool pool (cpus);
+            std::size_t const loops = 2000;
+            std::atomic<std::size_t> total {0};
+            auto const body = [&total](std::size_t)
+            {
+                ++total;
+            };
+
+            auto start = steady_clock::now ();
+            for (std::size_t i = 0; i < loops; ++i)
+                parallelFor (pool, 64, cpus + 1, 1, body);
+            auto const pooled = duration_cast<nanoseconds> (
+                steady_clock::now () - start) / loops;
+
+            start = steady_clock::now ();
+            for (std::size_t i = 0; i < loops; ++i)
+            {
+                std::vector<std::thread> threads;
+                for (unsigned t = 0; t < cpus; ++t)
+                {
+                    threads.emplace_back ([&body, t, cpus]
+                    {
+                        for (std::size_t j = t; j < 64; j += cpus)
+                            body (j);
+                    });
+                }
+                for (auto& t : threads)
+                    t.join ();
+            }
+            auto const spawned = duration_cast<nanoseconds> (
+                steady_clock::now () - start) / loops;
+
+            BEAST_EXPECT (total == 2 * loops * 64);
+            log << "parallelFor: " << pooled.count () <<
+                " ns, new threads: " << spawned.count () <<
+                " ns per loop of 64" << std::endl;
+        }
+
+        {
+            testcase ("Scaling");
+
+            std::size_t const count = 4096;
+            unsigned const rounds = 20000;
+            std::vector<std::uint64_t> results (count);
+            double base = 0;
+
+            for (unsigned threads = 1; threads <= cpus; threads *= 2)
+            {
+                ThreadPool pool (threads);
+                auto const start = steady_clock::now ();
+                parallelFor (pool, count, threads, 1,
+                    [&](std::size_t i)
+                    {
+                        results[i] = spin (i, rounds);
+                    });
+                auto const elapsed = duration_cast<microseconds> (
+                    steady_clock::now () - start).count ();
+                if (threads == 1)
+                    base = static_cast<double> (elapsed);
+
+                log << std::setw (3) << threads << " threads: " <<
+                    elapsed << " us, speedup " << std::fixed <<
+                    std::setprecision (2) << base / std::max<double> (
+                        1, static_cast<double> (elapsed)) << std::endl;
+            }
+            pass ();
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(ThreadPool, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(ThreadPoolBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,135 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <TokenKeyDerivation.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/beast/unit_test.h>
+#include <array>
+
+namespace ripple {
+
+namespace tests {
+
+class TokenKeyDerivation_test : public beast::unit_test::suite
+{
+private:
+    static
+    SecretKey
+    masterSecret ()
+    {
+        std::array<std::uint8_t, 32> bytes;
+        for (std::size_t i = 0; i < bytes.size (); ++i)
+            bytes[i] = static_cast<std::uint8_t> (i + 1);
+        return SecretKey (Slice (bytes.data (), bytes.size ()));
+    }
+
+    void
+    testKnownAnswers ()
+    {
+        testcase ("Known Answers");
+
+        struct Vector
+        {
+            KeyType keyType;
+            std::uint32_t sequence;
+            char const* secret;
+        };
+
+        // Master secret is the bytes 0x01 to 0x20
+        Vector const vectors[] = {
+            { KeyType::secp256k1, 1,
+                "478F9B42BAC20962B425FA097B8B670A"
+                "4C8FBEA5F95E9FDABB8DD8852309A90E" },
+            { KeyType::secp256k1, 2,
+                "3E5D6D521230FD3A585082A90A3C3A0E"
+                "555C906BD59138BB57FEFC1488385C1E" },
+            { KeyType::secp256k1, 4294967294,
+                "77DE2FAC9690713018490DA494530758"
+                "EA0942CF02F1DB5714294C0FDE986F1C" },
+            { KeyType::ed25519, 1,
+                "7135D30CB14A0C343D5CDACC9FDEBFCD"
+                "4C234822E4B3FA9FF522424A170B0E08" },
+            { KeyType::ed25519, 2,
+                "ADFA5DF80ACB83E6CAA1633AB72B4BC7"
+                "483F63CBB59F02E22380370B1D140E18" },
+            { KeyType::ed25519, 4294967294,
+                "B6C4A1AA011E2C74DAF0B90BC467DC4A"
+                "C2E3865F1160276DD88909158ABB77E0" }};
+
+        auto const master = masterSecret ();
+        for (auto const& v : vectors)
+        {
+            auto const secret = deriveTokenSecretKey (
+                master, v.sequence, v.keyType);
+            BEAST_EXPECT (strHex (secret) == v.secret);
+        }
+    }
+
+    void
+    testDerivation ()
+    {
+        testcase ("Derivation");
+
+        auto const master = masterSecret ();
+        auto const other = randomSecretKey ();
+
+        for (auto const keyType : {KeyType::secp256k1, KeyType::ed25519})
+        {
+            auto const secret = deriveTokenSecretKey (master, 7, keyType);
+            BEAST_EXPECT (secret == deriveTokenSecretKey (master, 7, keyType));
+            BEAST_EXPECT (secret != deriveTokenSecretKey (master, 8, keyType));
+            BEAST_EXPECT (secret != deriveTokenSecretKey (other, 7, keyType));
+
+            // Derived secrets make usable keys
+            auto const pk = derivePublicKey (keyType, secret);
+            auto const sig = sign (pk, secret, makeSlice (std::string ("data")));
+            BEAST_EXPECT (verify (pk, makeSlice (std::string ("data")), sig));
+        }
+
+        // Key types are kept apart
+        BEAST_EXPECT (deriveTokenSecretKey (master, 1, KeyType::secp256k1) !=
+            deriveTokenSecretKey (master, 1, KeyType::ed25519));
+
+        try
+        {
+            deriveTokenSecretKey (master, 1, KeyType::invalid);
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                std::string ("Invalid key type for token keys"));
+        }
+    }
+
+public:
+    void
+    run() override
+    {
+        testKnownAnswers ();
+        testDerivation ();
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(TokenKeyDerivation, keys, ripple);
+
+} // tests
+
+} // ripple
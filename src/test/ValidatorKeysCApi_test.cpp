@@ -0,0 +1,318 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <validatorkeys.h>
+#include <KeyFileOps.h>
+#include <ValidatorKeys.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/protocol/tokens.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#ifdef __linux__
+# include <fcntl.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
+
+namespace ripple {
+
+namespace tests {
+
+class ValidatorKeysCApi_test : public beast::unit_test::suite
+{
+private:
+    boost::filesystem::path
+    makeKeyFile (KeyType keyType)
+    {
+        using namespace boost::filesystem;
+
+        path const keyFile = temp_directory_path () /
+            unique_path ("validator_keys_capi_%%%%%%%%.json");
+        ValidatorKeys (keyType).writeToFile (keyFile);
+        return keyFile;
+    }
+
+    void
+    removeKeyFile (boost::filesystem::path const& keyFile)
+    {
+        boost::filesystem::remove (keyFile);
+        boost::filesystem::remove (keyFile.string () + ".lock");
+    }
+
+    void
+    testLoad ()
+    {
+        testcase ("Load");
+
+        vk_keys* keys = nullptr;
+        BEAST_EXPECT (vk_load (nullptr, &keys) == VK_INVALID_ARGUMENT);
+        BEAST_EXPECT (vk_load ("missing.json", nullptr) == VK_INVALID_ARGUMENT);
+
+        BEAST_EXPECT (vk_load ("missing.json", &keys) == VK_ERROR);
+        BEAST_EXPECT (! keys);
+        BEAST_EXPECT (vk_last_error () ==
+            std::string ("Failed to open key file: missing.json"));
+
+        auto const keyFile = makeKeyFile (KeyType::secp256k1);
+        BEAST_EXPECT (vk_load (keyFile.string ().c_str (), &keys) == VK_OK);
+        if (BEAST_EXPECT (keys))
+        {
+            auto const expected = toBase58 (TOKEN_NODE_PUBLIC,
+                loadKeyFile (keyFile).publicKey ());
+
+            // Ask for the size first, then fill an exact buffer
+            std::size_t size = 0;
+            BEAST_EXPECT (vk_public_key (keys, nullptr, &size) ==
+                VK_BUFFER_TOO_SMALL);
+            BEAST_EXPECT (size == expected.size ());
+
+            std::string out (size, '\0');
+            BEAST_EXPECT (vk_public_key (keys, &out[0], &size) ==
+                VK_BUFFER_TOO_SMALL);
+            ++size;
+            std::vector<char> buffer (size);
+            BEAST_EXPECT (vk_public_key (keys, buffer.data (), &size) == VK_OK);
+            BEAST_EXPECT (size == expected.size ());
+            BEAST_EXPECT (buffer.data () == expected);
+        }
+        vk_free (keys);
+        vk_free (nullptr);
+
+        removeKeyFile (keyFile);
+    }
+
+    void
+    testSign ()
+    {
+        testcase ("Sign");
+
+        auto const keyFile = makeKeyFile (KeyType::ed25519);
+        auto const expected = loadKeyFile (keyFile);
+
+        vk_keys* keys = nullptr;
+        if (! BEAST_EXPECT (vk_load (keyFile.string ().c_str (), &keys) == VK_OK))
+            return;
+
+        std::string const data = "data to sign";
+        char buffer[256];
+        std::size_t size = sizeof (buffer);
+        BEAST_EXPECT (vk_sign (keys, data.data (), data.size (),
+            buffer, &size) == VK_OK);
+        BEAST_EXPECT (std::string (buffer, size) == expected.sign (data));
+
+        // Data may hold any bytes
+        std::string const binary ("\0\1\2", 3);
+        size = sizeof (buffer);
+        BEAST_EXPECT (vk_sign (keys, binary.data (), binary.size (),
+            buffer, &size) == VK_OK);
+        BEAST_EXPECT (std::string (buffer, size) == expected.sign (binary));
+
+        size = sizeof (buffer);
+        BEAST_EXPECT (vk_sign (nullptr, data.data (), data.size (),
+            buffer, &size) == VK_INVALID_ARGUMENT);
+        BEAST_EXPECT (vk_sign (keys, nullptr, 1,
+            buffer, &size) == VK_INVALID_ARGUMENT);
+        BEAST_EXPECT (vk_sign (keys, data.data (), data.size (),
+            buffer, nullptr) == VK_INVALID_ARGUMENT);
+
+        vk_free (keys);
+        removeKeyFile (keyFile);
+    }
+
+    void
+    testTokenAndRevoke ()
+    {
+        testcase ("Token and Revoke");
+
+        auto const keyFile = makeKeyFile (KeyType::ed25519);
+        auto const path = keyFile.string ();
+
+        std::vector<char> buffer (VK_MAX_TOKEN_SIZE + 1);
+
+        // Buffers that might not hold a token are refused before the
+        // key file is touched
+        std::size_t size = VK_MAX_TOKEN_SIZE;
+        BEAST_EXPECT (vk_create_token (path.c_str (),
+            buffer.data (), &size) == VK_BUFFER_TOO_SMALL);
+        BEAST_EXPECT (size == VK_MAX_TOKEN_SIZE);
+        BEAST_EXPECT (loadKeyFile (keyFile).tokenSequence () == 0);
+
+        for (std::uint32_t i = 1; i <= 3; ++i)
+        {
+            size = buffer.size ();
+            BEAST_EXPECT (vk_create_token (path.c_str (),
+                buffer.data (), &size) == VK_OK);
+            BEAST_EXPECT (size > 0 && size == std::strlen (buffer.data ()));
+            BEAST_EXPECT (loadKeyFile (keyFile).tokenSequence () == i);
+        }
+
+        size = buffer.size ();
+        BEAST_EXPECT (vk_revoke (path.c_str (),
+            buffer.data (), &size) == VK_OK);
+        BEAST_EXPECT (size > 0 && size == std::strlen (buffer.data ()));
+        BEAST_EXPECT (loadKeyFile (keyFile).revoked ());
+
+        size = buffer.size ();
+        BEAST_EXPECT (vk_create_token (path.c_str (),
+            buffer.data (), &size) == VK_ERROR);
+        BEAST_EXPECT (vk_last_error () ==
+            std::string ("Validator keys have been revoked."));
+
+        size = buffer.size ();
+        BEAST_EXPECT (vk_revoke ("missing.json",
+            buffer.data (), &size) == VK_ERROR);
+        BEAST_EXPECT (vk_last_error () ==
+            std::string ("Failed to open key file: missing.json"));
+
+        removeKeyFile (keyFile);
+    }
+
+public:
+    void
+    run() override
+    {
+        testLoad ();
+        testSign ();
+        testTokenAndRevoke ();
+    }
+};
+
+#ifdef __linux__
+class ValidatorKeysCApiBench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+
+    template <class F>
+    void
+    measure (std::string const& label, std::size_t count, F&& f)
+    {
+        using namespace std::chrono;
+
+        std::vector<clock_type::duration> samples;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            auto const start = clock_type::now ();
+            f ();
+            samples.push_back (clock_type::now () - start);
+        }
+        std::sort (samples.begin (), samples.end ());
+
+        auto const us = [](clock_type::duration d)
+        {
+            return duration_cast<duration<double, std::micro>> (d).count ();
+        };
+
+        log << std::left << std::setw (16) << label << std::right <<
+            std::fixed << std::setprecision (1) <<
+            " p50 " << std::setw (9) << us (samples[count / 2]) << " us" <<
+            " p99 " << std::setw (9) << us (samples[count * 99 / 100]) <<
+            " us" << std::endl;
+    }
+
+    // Runs this executable to completion, discarding its output
+    void
+    exec (std::vector<std::string> args)
+    {
+        args.insert (args.begin (), "validator-keys");
+        std::vector<char*> argv;
+        for (auto& arg : args)
+            argv.push_back (&arg[0]);
+        argv.push_back (nullptr);
+
+        auto const pid = fork ();
+        if (pid == 0)
+        {
+            int const null = open ("/dev/null", O_WRONLY);
+            dup2 (null, STDOUT_FILENO);
+            execv ("/proc/self/exe", argv.data ());
+            _exit (127);
+        }
+
+        int status = 0;
+        waitpid (pid, &status, 0);
+        BEAST_EXPECT (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+    }
+
+public:
+    void
+    run() override
+    {
+        using namespace boost::filesystem;
+
+        testcase ("In-process calls against exec");
+
+        path const keyFile = temp_directory_path () /
+            unique_path ("validator_keys_bench_%%%%%%%%.json");
+        ValidatorKeys (KeyType::ed25519).writeToFile (keyFile);
+        auto const path = keyFile.string ();
+        std::string const data = "data to sign";
+
+        vk_keys* keys = nullptr;
+        if (! BEAST_EXPECT (vk_load (path.c_str (), &keys) == VK_OK))
+            return;
+
+        char buffer[256];
+        measure ("vk_sign", 10000, [&]
+        {
+            std::size_t size = sizeof (buffer);
+            vk_sign (keys, data.data (), data.size (), buffer, &size);
+        });
+        measure ("vk_load+vk_sign", 1000, [&]
+        {
+            vk_keys* k = nullptr;
+            vk_load (path.c_str (), &k);
+            std::size_t size = sizeof (buffer);
+            vk_sign (k, data.data (), data.size (), buffer, &size);
+            vk_free (k);
+        });
+        measure ("exec sign", 200, [&]
+        {
+            exec ({"--keyfile", path, "sign", data});
+        });
+
+        std::vector<char> token (VK_MAX_TOKEN_SIZE + 1);
+        measure ("vk_create_token", 200, [&]
+        {
+            std::size_t size = token.size ();
+            vk_create_token (path.c_str (), token.data (), &size);
+        });
+        measure ("exec create_token", 200, [&]
+        {
+            exec ({"--keyfile", path, "create_token"});
+        });
+
+        vk_free (keys);
+        remove (keyFile);
+        remove (path + ".lock");
+    }
+};
+#endif
+
+BEAST_DEFINE_TESTSUITE(ValidatorKeysCApi, keys, ripple);
+#ifdef __linux__
+BEAST_DEFINE_TESTSUITE_MANUAL(ValidatorKeysCApiBench, keys, ripple);
+#endif
+
+} // tests
+
+} // ripple
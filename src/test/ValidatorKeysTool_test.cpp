@@ -18,9 +18,30 @@
 //==============================================================================
 
 #include <ValidatorKeysTool.h>
+#include <CryptoKernels.h>
+#include <FleetExport.h>
+#include <KeyFileOps.h>
+#include <Manifest.h>
 #include <ValidatorKeys.h>
+#include <ValidatorList.h>
 #include <test/KeyFileGuard.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/json/json_reader.h>
 #include <ripple/protocol/SecretKey.h>
+#include <ripple/protocol/STObject.h>
+#include <beast/core/detail/base64.hpp>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#ifdef __linux__
+# include <fcntl.h>
+# include <poll.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
 
 namespace ripple {
 
@@ -58,18 +79,18 @@ private:
         using namespace boost::filesystem;
 
         std::string const subdir = "test_key_file";
-        KeyFileGuard const g (*this, subdir);
+        MemoryKeyStore store;
         path const keyFile = subdir / "validator_keys.json";
 
-        createKeyFile (keyFile);
-        BEAST_EXPECT(exists(keyFile));
+        createKeyFile (keyFile, store);
+        BEAST_EXPECT(store.exists(keyFile));
 
         std::string const expectedError = "Refusing to overwrite existing key file: " +
             keyFile.string();
         std::string error;
         try
         {
-            createKeyFile (keyFile);
+            createKeyFile (keyFile, store);
         }
         catch (std::exception const& e)
         {
@@ -89,16 +110,16 @@ private:
         using namespace boost::filesystem;
 
         std::string const subdir = "test_key_file";
-        KeyFileGuard const g (*this, subdir);
+        MemoryKeyStore store;
         path const keyFile = subdir / "validator_keys.json";
 
-        auto testToken = [this](
+        auto testToken = [this, &store](
             path const& keyFile,
             std::string const& expectedError)
         {
             try
             {
-                createToken (keyFile);
+                createToken (keyFile, store);
                 BEAST_EXPECT(expectedError.empty());
             }
             catch (std::exception const& e)
@@ -113,7 +134,7 @@ private:
             testToken (keyFile, expectedError);
         }
 
-        createKeyFile (keyFile);
+        createKeyFile (keyFile, store);
 
         {
             std::string const expectedError = "";
@@ -128,20 +149,81 @@ private:
                 kp.second,
                 std::numeric_limits<std::uint32_t>::max () - 1);
 
-            keys.writeToFile (keyFile);
+            keys.writeToFile (keyFile, store);
             std::string const expectedError =
                 "Maximum number of tokens have already been generated.\n"
                 "Revoke validator keys if previous token has been compromised.";
             testToken (keyFile, expectedError);
         }
         {
-            createRevocation (keyFile);
+            createRevocation (keyFile, store);
             std::string const expectedError =
                 "Validator keys have been revoked.";
             testToken (keyFile, expectedError);
         }
     }
 
+    void
+    testRegenerateToken ()
+    {
+        testcase ("Regenerate Token");
+
+        using namespace boost::filesystem;
+
+        MemoryKeyStore store;
+        path const keyFile = "test_key_file/validator_keys.json";
+
+        auto const output = [&](std::function<void ()> const& f)
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            f ();
+            return coutCapture.str ();
+        };
+
+        output ([&] { createKeyFile (keyFile, store); });
+
+        std::vector<std::string> issued;
+        for (int i = 0; i < 2; ++i)
+            issued.push_back (output ([&]
+            {
+                createToken (keyFile, store, KeyType::ed25519,
+                    TokenKeySource::derived);
+            }));
+        BEAST_EXPECT (issued[0] != issued[1]);
+
+        // The token key type is read from the key file
+        BEAST_EXPECT (output ([&]
+            { regenerateToken ("2", keyFile, store); }) == issued[1]);
+        BEAST_EXPECT (output ([&]
+            { regenerateToken ("1", keyFile, store); }) == issued[0]);
+
+        output ([&] { createToken (keyFile, store); });
+
+        auto testError = [&](std::string const& sequence,
+            std::string const& expectedError)
+        {
+            try
+            {
+                output ([&] { regenerateToken (sequence, keyFile, store); });
+                fail ();
+            }
+            catch (std::exception const& e)
+            {
+                BEAST_EXPECT (e.what () == expectedError);
+            }
+        };
+
+        testError ("3", "Token sequence 3 was not issued with derived "
+            "token keys.");
+        testError ("4", "Token sequence 4 has not been issued.");
+        testError ("0", "Token sequence 0 has not been issued.");
+        testError ("one", "Syntax error: Invalid token sequence: one");
+
+        output ([&] { createRevocation (keyFile, store); });
+        testError ("1", "Validator keys have been revoked.");
+    }
+
     void
     testCreateRevocation ()
     {
@@ -153,24 +235,24 @@ private:
         using namespace boost::filesystem;
 
         std::string const subdir = "test_key_file";
-        KeyFileGuard const g (*this, subdir);
+        MemoryKeyStore store;
         path const keyFile = subdir / "validator_keys.json";
 
         auto expectedError =
             "Failed to open key file: " + keyFile.string();
         std::string error;
         try {
-            createRevocation (keyFile);
+            createRevocation (keyFile, store);
         } catch (std::runtime_error& e) {
             error = e.what();
         }
         BEAST_EXPECT(error == expectedError);
 
-        createKeyFile (keyFile);
-        BEAST_EXPECT(exists(keyFile));
+        createKeyFile (keyFile, store);
+        BEAST_EXPECT(store.exists(keyFile));
 
-        createRevocation (keyFile);
-        createRevocation (keyFile);
+        createRevocation (keyFile, store);
+        createRevocation (keyFile, store);
     }
 
     void
@@ -183,14 +265,16 @@ private:
 
         using namespace boost::filesystem;
 
-        auto testSign = [this](
+        MemoryKeyStore store;
+
+        auto testSign = [this, &store](
             std::string const& data,
             path const& keyFile,
             std::string const& expectedError)
         {
             try
             {
-                signData (data, keyFile);
+                signData (data, keyFile, store);
                 BEAST_EXPECT(expectedError.empty());
             }
             catch (std::exception const& e)
@@ -202,7 +286,6 @@ private:
         std::string const data = "data to sign";
 
         std::string const subdir = "test_key_file";
-        KeyFileGuard const g (*this, subdir);
         path const keyFile = subdir / "validator_keys.json";
 
         {
@@ -211,8 +294,8 @@ private:
             testSign (data, keyFile, expectedError);
         }
 
-        createKeyFile (keyFile);
-        BEAST_EXPECT(exists(keyFile));
+        createKeyFile (keyFile, store);
+        BEAST_EXPECT(store.exists(keyFile));
 
         {
             std::string const emptyData = "";
@@ -226,6 +309,940 @@ private:
         }
     }
 
+    void
+    testMerkle ()
+    {
+        testcase ("Merkle");
+
+        using namespace boost::filesystem;
+
+        MemoryKeyStore store;
+        path const keyFile = "test_key_file/validator_keys.json";
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            createKeyFile (keyFile, store);
+        }
+        auto const publicKey = toBase58 (TOKEN_NODE_PUBLIC,
+            loadKeyFile (keyFile, store).publicKey ());
+
+        std::vector<std::string> const payloads = {
+            "first payload", "second payload", "", "fourth payload" };
+
+        std::stringstream in;
+        for (auto const& payload : payloads)
+            in << payload << '\n';
+
+        std::stringstream out;
+        std::stringstream cerrCapture;
+        auto const oldCerr = std::cerr.rdbuf (cerrCapture.rdbuf ());
+        signMerkle (in, out, keyFile, store);
+        std::cerr.rdbuf (oldCerr);
+        BEAST_EXPECT (cerrCapture.str ().find ("Signed Merkle root ") == 0);
+
+        std::vector<std::string> proofs;
+        for (std::string line; std::getline (out, line);)
+            proofs.push_back (line);
+        if (! BEAST_EXPECT (proofs.size () == payloads.size ()))
+            return;
+
+        auto testVerify = [&](std::string const& pk,
+            std::string const& data, std::string const& proof,
+            std::string const& expectedError)
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            try
+            {
+                verifyProof (pk, data, proof);
+                BEAST_EXPECT (expectedError.empty ());
+                BEAST_EXPECT (coutCapture.str ().find (
+                    "Proof is valid for payload ") == 0);
+            }
+            catch (std::exception const& e)
+            {
+                BEAST_EXPECT (e.what () == expectedError);
+            }
+        };
+
+        for (std::size_t i = 0; i < payloads.size (); ++i)
+            testVerify (publicKey, payloads[i], proofs[i], "");
+
+        testVerify (publicKey, payloads[1], proofs[0], "Proof is not valid.");
+        testVerify (toBase58 (TOKEN_NODE_PUBLIC,
+            ValidatorKeys (KeyType::ed25519).publicKey ()),
+            payloads[0], proofs[0], "Proof is not valid.");
+        testVerify ("notakey", payloads[0], proofs[0],
+            "Syntax error: Invalid public key: notakey");
+        testVerify (publicKey, payloads[0], "AAAA",
+            "Syntax error: Malformed proof");
+
+        std::stringstream empty;
+        try
+        {
+            signMerkle (empty, out, keyFile, store);
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == std::string (
+                "Syntax error: Must specify payloads to sign on stdin"));
+        }
+    }
+
+    void
+    testServeSigning ()
+    {
+        testcase ("Serve Signing");
+
+        using namespace boost::filesystem;
+
+        MemoryKeyStore store;
+        path const keyDir = "test_key_dir";
+
+        std::vector<ValidatorKeys> keys;
+        for (int i = 0; i < 3; ++i)
+        {
+            keys.emplace_back (KeyType::ed25519);
+            if (i == 2)
+                keys.back ().revoke ();
+            keys.back ().writeToFile (
+                keyDir / ("key" + std::to_string (i) + ".json"), store);
+        }
+        store.store (keyDir / "bad.json", "{}");
+
+        std::stringstream cerrCapture;
+        auto const oldCerr = std::cerr.rdbuf (cerrCapture.rdbuf ());
+        auto const index = loadKeyIndex (keyDir, store);
+        std::cerr.rdbuf (oldCerr);
+
+        BEAST_EXPECT (index.size () == keys.size ());
+        BEAST_EXPECT (cerrCapture.str ().find (
+            "Skipping key file: Key file '" +
+                (keyDir / "bad.json").string ()) == 0);
+
+        ValidatorKeys const unknown (KeyType::ed25519);
+        auto const pk = [](ValidatorKeys const& k)
+        {
+            return toBase58 (TOKEN_NODE_PUBLIC, k.publicKey ());
+        };
+
+        std::stringstream in;
+        in << pk (keys[1]) << " some data\n" <<
+            pk (keys[0]) << " more data with spaces\n" <<
+            pk (unknown) << " data\n" <<
+            pk (keys[2]) << " data\n" <<
+            "notakey data\n" <<
+            "nospace\n";
+
+        std::stringstream out;
+        serveSigning (index, in, out);
+
+        std::vector<std::string> lines;
+        for (std::string line; std::getline (out, line);)
+            lines.push_back (line);
+
+        if (BEAST_EXPECT (lines.size () == 6))
+        {
+            BEAST_EXPECT (lines[0] == keys[1].sign ("some data"));
+            BEAST_EXPECT (lines[1] == keys[0].sign ("more data with spaces"));
+            BEAST_EXPECT (lines[2] == "error: unknown public key");
+            BEAST_EXPECT (lines[3] == "error: revoked public key");
+            BEAST_EXPECT (lines[4] == "error: malformed public key");
+            BEAST_EXPECT (lines[5] == "error: malformed request");
+        }
+    }
+
+    // Returns the type of the ephemeral key in a token
+    static
+    boost::optional<KeyType>
+    tokenKeyType (std::string const& token)
+    {
+        Json::Value jv;
+        if (! Json::Reader ().parse (
+                beast::detail::base64_decode (token), jv))
+            return boost::none;
+
+        auto const manifest = beast::detail::base64_decode (
+            jv["manifest"].asString ());
+        STObject st (sfGeneric);
+        SerialIter sit (manifest.data (), manifest.size ());
+        st.set (sit);
+
+        auto const signingKey = st.getFieldVL (sfSigningPubKey);
+        return publicKeyType (makeSlice (signingKey));
+    }
+
+    void
+    testKeyTypes ()
+    {
+        testcase ("Key Types");
+
+        std::stringstream coutCapture;
+        CoutRedirect coutRedirect {coutCapture};
+
+        using namespace boost::filesystem;
+
+        BEAST_EXPECT (parseKeyType ("ed25519") == KeyType::ed25519);
+        BEAST_EXPECT (parseKeyType ("secp256k1") == KeyType::secp256k1);
+        try
+        {
+            parseKeyType ("rsa");
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == std::string ("Invalid key type: rsa"));
+        }
+
+        for (auto const keyType : {KeyType::ed25519, KeyType::secp256k1})
+        {
+            MemoryKeyStore store;
+            path const keyFile = "test_key_file/validator_keys.json";
+
+            CommandOptions options;
+            options.keyType = keyType;
+            options.tokenKeyType = keyType;
+
+            runCommand ("create_keys", {}, keyFile, store, options);
+            BEAST_EXPECT (publicKeyType (
+                loadKeyFile (keyFile, store).publicKey ()) == keyType);
+
+            runCommand ("create_token", {}, keyFile, store, options);
+            BEAST_EXPECT (loadKeyFile (keyFile, store).tokenSequence () == 1);
+
+            auto const token = issueValidatorToken (keyFile, store, keyType);
+            BEAST_EXPECT (tokenKeyType (token.value.c_str ()) == keyType);
+        }
+
+        {
+            // Defaults are unchanged
+            MemoryKeyStore store;
+            path const keyFile = "test_key_file/validator_keys.json";
+            createKeyFile (keyFile, store);
+            BEAST_EXPECT (publicKeyType (
+                loadKeyFile (keyFile, store).publicKey ()) == KeyType::ed25519);
+            auto const token = issueValidatorToken (keyFile, store);
+            BEAST_EXPECT (tokenKeyType (token.value.c_str ()) == KeyType::secp256k1);
+        }
+
+        std::stringstream out;
+        benchmarkKeyTypes (out, std::chrono::milliseconds {1});
+
+        std::vector<std::string> lines;
+        for (std::string line; std::getline (out, line);)
+            lines.push_back (line);
+        auto const variants = CryptoKernels::supported ().size ();
+        if (BEAST_EXPECT (lines.size () == 1 + 2 * variants))
+        {
+            BEAST_EXPECT (lines[0].find ("Key type") == 0);
+            BEAST_EXPECT (lines[1].find ("secp256k1  library") == 0);
+            BEAST_EXPECT (lines[variants].find ("secp256k1") == 0);
+            BEAST_EXPECT (lines[1 + variants].find ("ed25519    library") == 0);
+            BEAST_EXPECT (lines[2 * variants].find ("ed25519") == 0);
+            BEAST_EXPECT (std::count_if (lines.begin (), lines.end (),
+                [](std::string const& line)
+                {
+                    return line.find ('*') != std::string::npos;
+                }) == 2);
+        }
+
+        BEAST_EXPECT (parseCryptoVariant ("library") == CryptoVariant::library);
+        try
+        {
+            parseCryptoVariant ("avx512");
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () ==
+                std::string ("Invalid crypto variant: avx512"));
+        }
+    }
+
+    void
+    testCreateValidatorList ()
+    {
+        testcase ("Create Validator List");
+
+        using namespace boost::filesystem;
+
+        std::string const subdir = "test_key_file";
+        KeyFileGuard const g (*this, subdir);
+
+        MemoryKeyStore store;
+        path const publisherFile = "publisher/validator_keys.json";
+
+        CommandOptions derived;
+        derived.tokenKeySource = TokenKeySource::derived;
+
+        // Token keys are regenerated with the type they were issued with,
+        // whatever --token-key-type says when the list is created
+        CommandOptions derivedEd25519 = derived;
+        derivedEd25519.tokenKeyType = KeyType::ed25519;
+
+        std::stringstream cerrCapture;
+        auto const createList = [&](
+            std::vector<std::string> const& args,
+            CommandOptions const& options,
+            std::string const& expectedError)
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            cerrCapture.str ("");
+            auto const oldCerr = std::cerr.rdbuf (cerrCapture.rdbuf ());
+            try
+            {
+                runCommand ("create_validator_list", args,
+                    publisherFile, store, options);
+                BEAST_EXPECT (expectedError.empty ());
+            }
+            catch (std::runtime_error const& e)
+            {
+                BEAST_EXPECT (e.what () == expectedError);
+            }
+            std::cerr.rdbuf (oldCerr);
+            return coutCapture.str ();
+        };
+
+        // Returns the blob of a list, checking it was signed by the
+        // publisher's current token
+        auto const openList = [&](std::string const& list)
+        {
+            Json::Value jv;
+            if (! BEAST_EXPECT (Json::Reader ().parse (list, jv)))
+                return Json::Value ();
+            auto const publisher = deserializeManifest (
+                beast::detail::base64_decode (jv["manifest"].asString ()));
+            if (! BEAST_EXPECT (publisher && publisher->signingKey))
+                return Json::Value ();
+            BEAST_EXPECT (publisher->masterKey ==
+                loadKeyFile (publisherFile, store).publicKey ());
+
+            auto const blob = openValidatorList (list, *publisher->signingKey);
+            Json::Value jBlob;
+            BEAST_EXPECT (blob && Json::Reader ().parse (*blob, jBlob));
+            return jBlob;
+        };
+
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            createKeyFile (publisherFile, store);
+        }
+        createList ({"validators", "1", "30"}, CommandOptions (),
+            "Publisher has no token. Create one with "
+            "--derive-token-keys create_token.");
+
+        std::vector<ValidatorKeys> validators;
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            runCommand ("create_token", {}, publisherFile, store,
+                derivedEd25519);
+
+            for (int i = 0; i < 3; ++i)
+            {
+                auto const file = "validators/" + std::to_string (i) + ".json";
+                createKeyFile (file, store);
+                runCommand ("create_token", {}, file, store,
+                    i == 1 ? derivedEd25519 : derived);
+                if (i == 2)
+                    createRevocation (file, store);
+                validators.push_back (loadKeyFile (file, store));
+            }
+        }
+
+        // From a directory of key files
+        auto const list = createList (
+            {"validators", "1", "30"}, CommandOptions (), "");
+        auto const blob = openList (list);
+        BEAST_EXPECT (blob["sequence"].asUInt () == 1);
+        auto const now = std::chrono::duration_cast<std::chrono::seconds> (
+            std::chrono::system_clock::now ().time_since_epoch ()).count () -
+            946684800;
+        std::int64_t const expiration = blob["expiration"].asUInt ();
+        BEAST_EXPECT (expiration > now + 29 * 86400);
+        BEAST_EXPECT (expiration <= now + 30 * 86400 + 60);
+
+        if (BEAST_EXPECT (blob["validators"].size () == 3))
+        {
+            std::size_t revoked = 0;
+            for (auto const& v : blob["validators"])
+            {
+                auto const manifest = deserializeManifest (
+                    beast::detail::base64_decode (v["manifest"].asString ()));
+                BEAST_EXPECT (manifest && std::any_of (
+                    validators.begin (), validators.end (),
+                    [&](ValidatorKeys const& keys) {
+                        return keys.publicKey () == manifest->masterKey; }));
+                revoked += manifest && manifest->revoked ();
+            }
+            BEAST_EXPECT (revoked == 1);
+        }
+        BEAST_EXPECT (cerrCapture.str ().find (
+            "with 3 validators (3 manifests checked)") != std::string::npos);
+
+        // Lists signed earlier spare checking unchanged manifests
+        std::string const previous = subdir + "/list.json";
+        std::ofstream (previous) << list;
+        CommandOptions incremental;
+        incremental.previousList = previous;
+        auto const again = createList (
+            {"validators", "2", "30"}, incremental, "");
+        BEAST_EXPECT (openList (again)["validators"] == blob["validators"]);
+        BEAST_EXPECT (cerrCapture.str ().find (
+            "(0 manifests checked)") != std::string::npos);
+
+        // The list verifies, with the publisher key in hex or base58
+        {
+            auto const publisherKey =
+                loadKeyFile (publisherFile, store).publicKey ();
+            std::ostringstream hex;
+            for (std::size_t i = 0; i < publisherKey.size (); ++i)
+                hex << std::hex << std::uppercase << std::setw (2) <<
+                    std::setfill ('0') << int (publisherKey.data ()[i]);
+
+            std::string const revocations = subdir + "/revocations.txt";
+            std::ofstream (revocations) <<
+                ValidatorKeys (validators[0]).revoke () << "\n";
+
+            for (auto const& key : {hex.str (),
+                toBase58 (TOKEN_NODE_PUBLIC, publisherKey)})
+            {
+                std::stringstream coutCapture;
+                CoutRedirect coutRedirect {coutCapture};
+                runCommand ("verify_validator_list", {previous, key},
+                    publisherFile, store);
+                BEAST_EXPECT (coutCapture.str ().find (
+                    "Validator list 1 signed by") == 0);
+                BEAST_EXPECT (coutCapture.str ().find (
+                    "Trusted validators: 2\nRevoked validators: 1\n") !=
+                        std::string::npos);
+
+                CommandOptions options;
+                options.revocations = revocations;
+                runCommand ("verify_validator_list", {previous, key},
+                    publisherFile, store, options);
+                BEAST_EXPECT (coutCapture.str ().find (
+                    "Trusted validators: 1\nRevoked validators: 2\n") !=
+                        std::string::npos);
+            }
+
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            try
+            {
+                runCommand ("verify_validator_list", {previous, "nHU"},
+                    publisherFile, store);
+                fail ();
+            }
+            catch (std::runtime_error const& e)
+            {
+                BEAST_EXPECT (e.what () ==
+                    std::string ("Syntax error: Invalid public key: nHU"));
+            }
+        }
+
+        // From a file of manifests and tokens
+        std::string const manifestsFile = subdir + "/manifests.txt";
+        {
+            auto const token =
+                issueValidatorToken ("validators/0.json", store);
+            std::ofstream out (manifestsFile);
+            out << validators[1].revoke () << "\n\n" << token.value << "\n";
+        }
+        auto const fromFile = openList (createList (
+            {manifestsFile, "3", "1"}, incremental, ""));
+        BEAST_EXPECT (fromFile["validators"].size () == 2);
+        BEAST_EXPECT (cerrCapture.str ().find (
+            "(2 manifests checked)") != std::string::npos);
+
+        // A token with random keys cannot be listed from its key file
+        createList ({"validators", "4", "30"}, CommandOptions (),
+            "Token was not issued with derived token keys: "
+            "validators/0.json. List its manifest from a file instead.");
+
+        createList ({"validators", "x", "30"}, CommandOptions (),
+            "Syntax error: Invalid list sequence: x");
+        createList ({"validators", "1", "0"}, CommandOptions (),
+            "Syntax error: Invalid expiration: 0");
+        createList ({subdir + "/missing.txt", "1", "30"}, CommandOptions (),
+            "Cannot open manifests: " + subdir + "/missing.txt");
+        std::ofstream (subdir + "/empty.txt");
+        createList ({subdir + "/empty.txt", "1", "30"}, CommandOptions (),
+            "Syntax error: Must specify manifests for the list");
+
+        issueValidatorToken (publisherFile, store);
+        createList ({manifestsFile, "4", "30"}, CommandOptions (),
+            "Publisher token was not issued with derived token keys. "
+            "Create one with --derive-token-keys create_token.");
+
+        revokeKeyFile (publisherFile, store);
+        createList ({"validators", "1", "30"}, CommandOptions (),
+            "Publisher keys have been revoked.");
+    }
+
+    void
+    testReduceManifests ()
+    {
+        testcase ("Reduce Manifests");
+
+        using namespace ripple;
+
+        ValidatorKeys first (KeyType::ed25519);
+        ValidatorKeys second (KeyType::ed25519);
+        auto const oldToken = first.createValidatorToken ();
+        auto const newToken = first.createValidatorToken ();
+        auto const secondToken = second.createValidatorToken ();
+        if (! BEAST_EXPECT (oldToken && newToken && secondToken))
+            return;
+        auto const revocation = second.revoke ();
+
+        // Tokens and manifests may be mixed, and blank lines are skipped
+        std::stringstream in;
+        in << newToken->toString () << "\n\n" << oldToken->manifest <<
+            "\n" << revocation << "\n  " << secondToken->manifest <<
+            "\r\nnot a manifest\n";
+
+        std::stringstream out;
+        std::stringstream cerrCapture;
+        auto const oldCerr = std::cerr.rdbuf (cerrCapture.rdbuf ());
+        reduceManifests (in, out);
+        std::cerr.rdbuf (oldCerr);
+
+        std::vector<std::string> lines;
+        for (std::string line; std::getline (out, line);)
+            lines.push_back (line);
+
+        std::vector<std::string> expected {newToken->manifest, revocation};
+        if (second.publicKey () < first.publicKey ())
+            std::swap (expected[0], expected[1]);
+        BEAST_EXPECT (lines == expected);
+        BEAST_EXPECT (cerrCapture.str () ==
+            "Reduced 5 manifests to 2 validators, 1 revoked "
+            "(4 manifests checked, 1 invalid)\n");
+
+        // A malformed token is counted as invalid, and the lines after
+        // it are still reduced
+        std::stringstream badToken;
+        badToken << beast::detail::base64_encode ("{}") << "\n" <<
+            beast::detail::base64_encode ("{\"manifest\": 1}") << "\n" <<
+            secondToken->manifest << "\n";
+        std::stringstream reduced;
+        cerrCapture.str ("");
+        std::cerr.rdbuf (cerrCapture.rdbuf ());
+        reduceManifests (badToken, reduced);
+        std::cerr.rdbuf (oldCerr);
+        BEAST_EXPECT (reduced.str () == secondToken->manifest + "\n");
+        BEAST_EXPECT (cerrCapture.str () ==
+            "Reduced 3 manifests to 1 validators, 0 revoked "
+            "(1 manifests checked, 2 invalid)\n");
+    }
+
+    void
+    testKeyCache ()
+    {
+        testcase ("Key Cache");
+
+        using namespace boost::filesystem;
+
+        BEAST_EXPECT (parseKeyring ("user") == KeyringCache::Keyring::user);
+        BEAST_EXPECT (
+            parseKeyring ("session") == KeyringCache::Keyring::session);
+        try
+        {
+            parseKeyring ("thread");
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == std::string ("Invalid keyring: thread"));
+        }
+
+        MemoryKeyStore store;
+        path const keyFile = unique_path (
+            "test_key_file/%%%%-%%%%-%%%%-%%%%.json");
+        createKeyFile (keyFile, store);
+
+        CommandOptions options;
+        options.keyCacheTtl = std::chrono::seconds (60);
+
+        auto const sign = [&](CommandOptions const& commandOptions)
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            runCommand ("sign", {"data"}, keyFile, store, commandOptions);
+            return coutCapture.str ();
+        };
+
+        // Signatures are the same whether or not keys come from the cache
+        auto const expected = sign (CommandOptions ());
+        BEAST_EXPECT (sign (options) == expected);
+        BEAST_EXPECT (sign (options) == expected);
+
+        {
+            std::stringstream coutCapture;
+            CoutRedirect coutRedirect {coutCapture};
+            runCommand ("create_token", {}, keyFile, store, options);
+        }
+        BEAST_EXPECT (sign (options) == expected);
+
+        KeyringCache (options.keyCacheTtl).invalidate (keyFile);
+    }
+
+    void
+    testInspect ()
+    {
+        testcase ("Inspect");
+
+        using namespace boost::filesystem;
+
+        MemoryKeyStore store;
+        path const keyDir = "test_key_file/fleet";
+
+        ValidatorKeys const keys (KeyType::ed25519);
+        keys.writeToFile (keyDir / "a.json", store);
+        ValidatorKeys revoked (KeyType::secp256k1);
+        revoked.revoke ();
+        revoked.writeToFile (keyDir / "b.json", store);
+        store.store (keyDir / "c.json", "not json");
+
+        auto const revokedKey = toBase58 (
+            TokenType::TOKEN_NODE_PUBLIC, revoked.publicKey ());
+
+        {
+            std::stringstream out;
+            BEAST_EXPECT (inspectKeyDir (keyDir, out, store) == 1);
+
+            std::vector<std::string> lines;
+            for (std::string line; std::getline (out, line);)
+                lines.push_back (line + "\n");
+            if (! BEAST_EXPECT (lines.size () == 13))
+                return;
+
+            std::string summary;
+            for (std::size_t i = 0; i < 9; ++i)
+                summary += lines[i];
+            BEAST_EXPECT (summary ==
+                "Inspected 3 key files in test_key_file/fleet\n"
+                "  unreadable                       0\n"
+                "  malformed                        1\n"
+                "  bad key type                     0\n"
+                "  bad secret key                   0\n"
+                "  public key mismatch              0\n"
+                "  sequence near limit              0\n"
+                "  revoked                          1\n"
+                "  no findings                      1\n");
+
+            BEAST_EXPECT (lines[9] == "\n");
+            BEAST_EXPECT (lines[10].find ("Findings") == 0);
+
+            // The most severe finding comes first
+            BEAST_EXPECT (lines[11].find ("malformed ") == 0);
+            BEAST_EXPECT (lines[11].find ("test_key_file/fleet/c.json "
+                "(Unable to parse json key file)\n") != std::string::npos);
+            BEAST_EXPECT (lines[12].find ("revoked ") == 0);
+            BEAST_EXPECT (lines[12].find (" secp256k1 ") != std::string::npos);
+            BEAST_EXPECT (lines[12].find (revokedKey) != std::string::npos);
+            BEAST_EXPECT (lines[12].find ("test_key_file/fleet/b.json\n") !=
+                std::string::npos);
+        }
+        {
+            std::stringstream out;
+            BEAST_EXPECT (inspectKeyDir (keyDir, out, store, true) == 1);
+
+            Json::Value jv;
+            BEAST_EXPECT (Json::Reader ().parse (out.str (), jv));
+            BEAST_EXPECT (jv["key_dir"] == keyDir.string ());
+            BEAST_EXPECT (jv["key_files"].asUInt () == 3);
+            BEAST_EXPECT (jv["counts"]["malformed"].asUInt () == 1);
+            BEAST_EXPECT (jv["counts"]["public_key_mismatch"].asUInt () == 0);
+            BEAST_EXPECT (jv["counts"]["revoked"].asUInt () == 1);
+            BEAST_EXPECT (jv["counts"]["none"].asUInt () == 1);
+
+            auto& findings = jv["findings"];
+            if (BEAST_EXPECT (findings.size () == 2))
+            {
+                BEAST_EXPECT (findings[0u]["file"] ==
+                    (keyDir / "c.json").string ());
+                BEAST_EXPECT (findings[0u]["findings"][0u] == "malformed");
+                BEAST_EXPECT (findings[0u]["error"] ==
+                    "Unable to parse json key file");
+                BEAST_EXPECT (! findings[0u].isMember ("public_key"));
+                BEAST_EXPECT (findings[1u]["findings"][0u] == "revoked");
+                BEAST_EXPECT (findings[1u]["key_type"] == "secp256k1");
+                BEAST_EXPECT (findings[1u]["public_key"] == revokedKey);
+            }
+        }
+
+        // Revoked keys alone are not a failure
+        store.remove (keyDir / "c.json");
+        std::stringstream out;
+        BEAST_EXPECT (inspectKeyDir (keyDir, out, store) == 0);
+
+        try
+        {
+            inspectKeyDir ("test_key_file/missing", out, store);
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == std::string (
+                "Cannot read key directory: test_key_file/missing"));
+        }
+    }
+
+    void
+    testExport ()
+    {
+        testcase ("Export");
+
+        using namespace boost::filesystem;
+
+        MemoryKeyStore store;
+        path const keyDir = "test_key_file/fleet";
+
+        ValidatorKeys keys (KeyType::ed25519);
+        keys.createValidatorToken (KeyType::secp256k1, TokenKeySource::derived);
+        keys.writeToFile (keyDir / "a.json", store);
+        ValidatorKeys revoked (KeyType::secp256k1);
+        revoked.revoke ();
+        revoked.writeToFile (keyDir / "b.json", store);
+        store.store (keyDir / "c.json", "not json");
+
+        path const file = temp_directory_path () /
+            unique_path ("validator-keys-test-%%%%-%%%%-%%%%");
+
+        std::stringstream cerrCapture;
+        auto const oldCerr = std::cerr.rdbuf (cerrCapture.rdbuf ());
+        auto const skipped = exportKeyDir (keyDir, file, store);
+        std::cerr.rdbuf (oldCerr);
+
+        BEAST_EXPECT (skipped == 1);
+        BEAST_EXPECT (cerrCapture.str () ==
+            "Skipping key file: test_key_file/fleet/c.json (Unable to "
+                "parse json key file: test_key_file/fleet/c.json)\n"
+            "Exported 2 validators to " + file.string () + "\n");
+
+        {
+            FleetExport const fleet (file);
+            BEAST_EXPECT (fleet.size () == 2);
+
+            auto const row = fleet.find (keys.publicKey ());
+            if (BEAST_EXPECT (row))
+            {
+                BEAST_EXPECT (fleet.tokenSequence (*row) == 1);
+                BEAST_EXPECT (fleet.signingKey (*row));
+                BEAST_EXPECT (! fleet.manifest (*row).empty ());
+            }
+            auto const other = fleet.find (revoked.publicKey ());
+            BEAST_EXPECT (other && fleet.revoked (*other));
+        }
+
+        // An export is replaced, not rewritten, as readers may map it
+        store.store ("test_key_file/empty/notes.txt", "");
+        {
+            FleetExport const old (file);
+            cerrCapture.str ("");
+            std::cerr.rdbuf (cerrCapture.rdbuf ());
+            BEAST_EXPECT (exportKeyDir ("test_key_file/empty", file, store)
+                == 0);
+            std::cerr.rdbuf (oldCerr);
+            BEAST_EXPECT (old.size () == 2);
+            BEAST_EXPECT (old.find (keys.publicKey ()));
+        }
+        BEAST_EXPECT (FleetExport (file).size () == 0);
+
+        remove (file);
+    }
+
+    void
+    testStampConfigs ()
+    {
+        testcase ("Stamp Configs");
+
+        using namespace boost::filesystem;
+
+        path const dir = temp_directory_path () /
+            unique_path ("validator-keys-test-%%%%-%%%%-%%%%");
+        create_directories (dir);
+
+        MemoryKeyStore store;
+        std::vector<std::string> publicKeys;
+        for (auto const name : {"a", "b"})
+        {
+            publicKeys.push_back (toBase58 (TokenType::TOKEN_NODE_PUBLIC,
+                createValidatorKeyFile (
+                    "test_key_file/" + std::string (name) + ".json",
+                    store)));
+            std::ofstream ((dir / (std::string (name) + ".cfg")).string ())
+                << "[server]\nport\n";
+        }
+
+        std::stringstream mapping;
+        mapping <<
+            "# key file config\n"
+            "\n"
+            "test_key_file/a.json " << (dir / "a.cfg").string () << "\n"
+            "  test_key_file/b.json\t" << (dir / "b.cfg").string () << "\n"
+            "test_key_file/c.json " << (dir / "c.cfg").string () << "\n";
+
+        std::stringstream out;
+        std::stringstream cerrCapture;
+        auto const oldCerr = std::cerr.rdbuf (cerrCapture.rdbuf ());
+        auto const failed = stampConfigFiles (
+            mapping, out, ConfigStampKind::token, store);
+        std::cerr.rdbuf (oldCerr);
+
+        BEAST_EXPECT (failed == 1);
+        BEAST_EXPECT (out.str () ==
+            publicKeys[0] + " " + (dir / "a.cfg").string () + "\n" +
+            publicKeys[1] + " " + (dir / "b.cfg").string () + "\n");
+        BEAST_EXPECT (cerrCapture.str () ==
+            "Failed to stamp " + (dir / "c.cfg").string () +
+            ": Cannot open config: " + (dir / "c.cfg").string () + "\n"
+            "Stamped 2 configs, 1 failed\n");
+
+        for (auto const name : {"a", "b"})
+        {
+            std::ifstream in ((dir / (std::string (name) + ".cfg")).string ());
+            std::string config {std::istreambuf_iterator<char> (in),
+                std::istreambuf_iterator<char> ()};
+            BEAST_EXPECT (config.find ("[server]\nport\n\n"
+                "[validator_token]\n") == 0);
+            BEAST_EXPECT (loadKeyFile ("test_key_file/" +
+                std::string (name) + ".json", store).tokenSequence () == 1);
+        }
+
+        try
+        {
+            std::stringstream malformed ("test_key_file/a.json\n");
+            stampConfigFiles (
+                malformed, out, ConfigStampKind::revocation, store);
+            fail ();
+        }
+        catch (std::runtime_error const& e)
+        {
+            BEAST_EXPECT (e.what () == std::string (
+                "Syntax error: Invalid stamp: test_key_file/a.json"));
+        }
+        BEAST_EXPECT (! loadKeyFile ("test_key_file/a.json", store)
+            .revoked ());
+
+        remove_all (dir);
+    }
+
+    void
+    testBatch ()
+    {
+        testcase ("Batch");
+
+        using namespace boost::filesystem;
+
+        MemoryKeyStore store;
+        path const keyFile = "test_key_file/batch.json";
+
+        std::stringstream in;
+        in <<
+            R"({"id":1,"command":"create_keys"})" "\n"
+            R"({"id":"token","command":"create_token"})" "\n"
+            "\n"
+            R"({"id":3,"command":"sign","args":["data"]})" "\n"
+            R"({"id":4,"command":"sign","args":["data"]})" "\n"
+            R"({"id":5,"command":"sign","args":["data"],)"
+                R"("keyfile":"test_key_file/missing.json"})" "\n"
+            "not json\n"
+            R"({"id":7,"command":"serve_ring","args":["ring","0"]})" "\n"
+            R"({"id":8,"command":"sign"})" "\n"
+            R"({"id":9,"command":"sign","args":"data"})" "\n"
+            R"({"command":"revoke_keys"})" "\n"
+            R"({"id":11,"command":"create_token"})" "\n";
+
+        std::stringstream out;
+        std::stringstream cerrCapture;
+        auto const oldCerr = std::cerr.rdbuf (cerrCapture.rdbuf ());
+        auto const failed = runBatch (in, out, keyFile, store);
+        std::cerr.rdbuf (oldCerr);
+
+        BEAST_EXPECT (failed == 6);
+        BEAST_EXPECT (cerrCapture.str () == "Ran 11 commands, 6 failed\n");
+
+        std::vector<Json::Value> responses;
+        for (std::string line; std::getline (out, line);)
+        {
+            Json::Value jv;
+            BEAST_EXPECT (Json::Reader ().parse (line, jv));
+            responses.push_back (jv);
+        }
+        if (! BEAST_EXPECT (responses.size () == 11))
+            return;
+
+        auto const error = [&](std::size_t i)
+        {
+            return responses[i]["error"].asString ();
+        };
+
+        auto const keys = loadKeyFile (keyFile, store);
+        auto const publicKey = toBase58 (
+            TokenType::TOKEN_NODE_PUBLIC, keys.publicKey ());
+        BEAST_EXPECT (keys.revoked ());
+
+        BEAST_EXPECT (responses[0]["id"].asInt () == 1);
+        BEAST_EXPECT (responses[0]["result"]["public_key"] == publicKey);
+        BEAST_EXPECT (responses[0]["result"]["keyfile"] == keyFile.string ());
+
+        BEAST_EXPECT (responses[1]["id"] == "token");
+        BEAST_EXPECT (responses[1]["result"]["public_key"] == publicKey);
+        BEAST_EXPECT (responses[1]["result"]["token"].isString ());
+
+        // The second signature uses the cached keys
+        for (std::size_t i : {2, 3})
+        {
+            BEAST_EXPECT (
+                responses[i]["id"].asInt () == static_cast<int> (i + 1));
+            BEAST_EXPECT (responses[i]["result"]["signature"] ==
+                keys.sign ("data"));
+            BEAST_EXPECT (responses[i]["result"]["revoked"] == false);
+        }
+
+        BEAST_EXPECT (responses[4]["id"].asInt () == 5);
+        BEAST_EXPECT (! error (4).empty ());
+        BEAST_EXPECT (! responses[4].isMember ("result"));
+
+        BEAST_EXPECT (! responses[5].isMember ("id"));
+        BEAST_EXPECT (error (5) == "Syntax error: Malformed JSON");
+
+        BEAST_EXPECT (error (6) == "Unknown batch command: serve_ring");
+        BEAST_EXPECT (error (7) == "Syntax error: Wrong number of arguments");
+        BEAST_EXPECT (error (8) == "Syntax error: args must be an array");
+
+        BEAST_EXPECT (responses[9]["id"].isNull ());
+        BEAST_EXPECT (responses[9]["result"]["public_key"] == publicKey);
+        BEAST_EXPECT (responses[9]["result"]["revocation"].isString ());
+        BEAST_EXPECT (responses[9]["result"]["was_revoked"] == false);
+
+        BEAST_EXPECT (error (10) == "Validator keys have been revoked.");
+
+        // The command fails if any request does
+        std::stringstream coutCapture;
+        CoutRedirect coutRedirect {coutCapture};
+        std::stringstream empty;
+        auto const oldCin = std::cin.rdbuf (empty.rdbuf ());
+        std::cerr.rdbuf (cerrCapture.rdbuf ());
+        BEAST_EXPECT (runCommand ("batch", {}, keyFile, store) == 0);
+        std::stringstream failing (R"({"command":"create_keys"})" "\n");
+        std::cin.rdbuf (failing.rdbuf ());
+        BEAST_EXPECT (runCommand ("batch", {}, keyFile, store) ==
+            EXIT_FAILURE);
+        std::cin.rdbuf (oldCin);
+        std::cerr.rdbuf (oldCerr);
+        Json::Value response;
+        BEAST_EXPECT (Json::Reader ().parse (coutCapture.str (), response));
+        BEAST_EXPECT (response["error"] ==
+            "Refusing to overwrite existing key file: " + keyFile.string ());
+    }
+
     void
     testRunCommand ()
     {
@@ -237,10 +1254,10 @@ private:
         using namespace boost::filesystem;
 
         std::string const subdir = "test_key_file";
-        KeyFileGuard g (*this, subdir);
+        MemoryKeyStore store;
         path const keyFile = subdir / "validator_keys.json";
 
-        auto testCommand = [this](
+        auto testCommand = [this, &store](
             std::string const& command,
             std::vector <std::string> const& args,
             path const& keyFile,
@@ -248,7 +1265,7 @@ private:
         {
             try
             {
-                runCommand (command, args, keyFile);
+                runCommand (command, args, keyFile, store);
                 BEAST_EXPECT(expectedError.empty());
             }
             catch (std::exception const& e)
@@ -269,6 +1286,51 @@ private:
             testCommand (command, oneArg, keyFile, expectedError);
             testCommand (command, twoArgs, keyFile, expectedError);
         }
+        {
+            std::string const command = "export";
+            testCommand (command, noArgs, keyFile, argError);
+            testCommand (command, oneArg, keyFile,
+                "Syntax error: export requires --keydir");
+            testCommand (command, twoArgs, keyFile, argError);
+        }
+        {
+            std::string const command = "inspect";
+            testCommand (command, noArgs, keyFile,
+                "Syntax error: inspect requires --keydir");
+            testCommand (command, oneArg, keyFile, argError);
+        }
+        for (std::string const command :
+            {"stamp_tokens", "stamp_revocations"})
+        {
+            testCommand (command, noArgs, keyFile, argError);
+            testCommand (command, oneArg, keyFile,
+                "Cannot open stamps: some data");
+            testCommand (command, twoArgs, keyFile, argError);
+        }
+        {
+            // A valid batch command reads stdin until closed
+            std::string const command = "batch";
+            testCommand (command, oneArg, keyFile, argError);
+            testCommand (command, twoArgs, keyFile, argError);
+        }
+        {
+            // Measuring takes a few seconds, so only check arguments
+            std::string const command = "benchmark_key_types";
+            testCommand (command, oneArg, keyFile, argError);
+            testCommand (command, twoArgs, keyFile, argError);
+        }
+        {
+            // A valid sign_merkle command reads stdin until closed
+            std::string const command = "sign_merkle";
+            testCommand (command, oneArg, keyFile, argError);
+            testCommand (command, twoArgs, keyFile, argError);
+        }
+        {
+            std::string const command = "verify_proof";
+            testCommand (command, noArgs, keyFile, argError);
+            testCommand (command, oneArg, keyFile, argError);
+            testCommand (command, twoArgs, keyFile, argError);
+        }
         {
             std::string const command = "create_keys";
             testCommand (command, noArgs, keyFile, noError);
@@ -281,6 +1343,20 @@ private:
             testCommand (command, oneArg, keyFile, argError);
             testCommand (command, twoArgs, keyFile, argError);
         }
+        {
+            std::string const command = "reduce_manifests";
+            testCommand (command, noArgs, keyFile, argError);
+            testCommand (command, oneArg, keyFile,
+                "Cannot open manifests: some data");
+            testCommand (command, twoArgs, keyFile, argError);
+        }
+        {
+            std::string const command = "regenerate_token";
+            testCommand (command, noArgs, keyFile, argError);
+            testCommand (command, oneArg, keyFile,
+                "Syntax error: Invalid token sequence: some data");
+            testCommand (command, twoArgs, keyFile, argError);
+        }
         {
             std::string const command = "revoke_keys";
             testCommand (command, noArgs, keyFile, noError);
@@ -293,6 +1369,20 @@ private:
             testCommand (command, oneArg, keyFile, noError);
             testCommand (command, twoArgs, keyFile, argError);
         }
+        {
+            // A valid serve_signing command reads stdin until closed
+            std::string const command = "serve_signing";
+            testCommand (command, noArgs, keyFile, argError);
+            testCommand (command, twoArgs, keyFile, argError);
+        }
+        {
+            // A valid serve_ring command serves until interrupted
+            std::string const command = "serve_ring";
+            testCommand (command, noArgs, keyFile, argError);
+            testCommand (command, oneArg, keyFile, argError);
+            testCommand (command, twoArgs, keyFile,
+                "Syntax error: Invalid spin count: more data");
+        }
     }
 
 public:
@@ -303,13 +1393,225 @@ public:
 
         testCreateKeyFile ();
         testCreateToken ();
+        testRegenerateToken ();
         testCreateRevocation ();
         testSign ();
+        testMerkle ();
+        testServeSigning ();
+        testKeyTypes ();
+        testCreateValidatorList ();
+        testReduceManifests ();
+        testKeyCache ();
+        testBatch ();
+        testInspect ();
+        testExport ();
+        testStampConfigs ();
         testRunCommand ();
     }
 };
 
+#ifdef __linux__
+class ValidatorKeysToolBench_test : public beast::unit_test::suite
+{
+    using clock_type = std::chrono::steady_clock;
+
+    // Runs this executable and returns the time until it first writes
+    // to stdout
+    clock_type::duration
+    timeToFirstOutput (std::vector<std::string> args)
+    {
+        args.insert (args.begin (), "validator-keys");
+        std::vector<char*> argv;
+        for (auto& arg : args)
+            argv.push_back (&arg[0]);
+        argv.push_back (nullptr);
+
+        int fds[2];
+        if (pipe (fds) != 0)
+            return clock_type::duration::max ();
+
+        auto const start = clock_type::now ();
+        auto const pid = fork ();
+        if (pid == 0)
+        {
+            dup2 (fds[1], STDOUT_FILENO);
+            ::close (fds[0]);
+            ::close (fds[1]);
+            execv ("/proc/self/exe", argv.data ());
+            _exit (127);
+        }
+        ::close (fds[1]);
+
+        pollfd pfd {fds[0], POLLIN, 0};
+        poll (&pfd, 1, -1);
+        auto const elapsed = clock_type::now () - start;
+
+        char buffer[256];
+        while (read (fds[0], buffer, sizeof (buffer)) > 0)
+            ;
+        ::close (fds[0]);
+
+        int status = 0;
+        waitpid (pid, &status, 0);
+        BEAST_EXPECT (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+        return elapsed;
+    }
+
+    void
+    measure (std::string const& label, std::vector<std::string> const& args)
+    {
+        using namespace std::chrono;
+
+        std::size_t const runs = 200;
+        std::vector<clock_type::duration> samples;
+        for (std::size_t i = 0; i < runs; ++i)
+            samples.push_back (timeToFirstOutput (args));
+        std::sort (samples.begin (), samples.end ());
+
+        auto const us = [](clock_type::duration d)
+        {
+            return duration_cast<microseconds> (d).count ();
+        };
+
+        log << std::left << std::setw (10) << label << std::right <<
+            " p50 " << std::setw (6) << us (samples[runs / 2]) << " us" <<
+            " p99 " << std::setw (6) << us (samples[runs * 99 / 100]) <<
+            " us" << std::endl;
+    }
+
+    // Runs this executable with input on stdin and returns the time
+    // until it exits
+    clock_type::duration
+    timeToExit (std::vector<std::string> args, std::string const& input)
+    {
+        args.insert (args.begin (), "validator-keys");
+        std::vector<char*> argv;
+        for (auto& arg : args)
+            argv.push_back (&arg[0]);
+        argv.push_back (nullptr);
+
+        int fds[2];
+        if (pipe (fds) != 0)
+            return clock_type::duration::max ();
+
+        auto const start = clock_type::now ();
+        auto const pid = fork ();
+        if (pid == 0)
+        {
+            dup2 (fds[0], STDIN_FILENO);
+            auto const devNull = ::open ("/dev/null", O_WRONLY);
+            dup2 (devNull, STDOUT_FILENO);
+            dup2 (devNull, STDERR_FILENO);
+            ::close (fds[0]);
+            ::close (fds[1]);
+            execv ("/proc/self/exe", argv.data ());
+            _exit (127);
+        }
+        ::close (fds[0]);
+
+        for (std::size_t written = 0; written < input.size ();)
+        {
+            auto const n = ::write (fds[1], input.data () + written,
+                input.size () - written);
+            if (n <= 0)
+                break;
+            written += n;
+        }
+        ::close (fds[1]);
+
+        int status = 0;
+        waitpid (pid, &status, 0);
+        auto const elapsed = clock_type::now () - start;
+        BEAST_EXPECT (WIFEXITED (status) && WEXITSTATUS (status) == 0);
+        return elapsed;
+    }
+
+    // Provisions hosts with one process per command, as a shell loop
+    // does, and then with a single batch
+    void
+    compareBatch ()
+    {
+        using namespace boost::filesystem;
+        using namespace std::chrono;
+
+        testcase ("Batch against a process per command");
+
+        std::size_t const hosts = 20;
+        std::size_t const signatures = 3;
+        auto const commands = hosts * (2 + signatures);
+
+        path const dir = temp_directory_path () /
+            unique_path ("validator_keys_batch_%%%%%%%%");
+        auto const keyFile = [&](char const* run, std::size_t host)
+        {
+            return (dir / run / (std::to_string (host) + ".json")).string ();
+        };
+
+        clock_type::duration loop {};
+        for (std::size_t host = 0; host < hosts; ++host)
+        {
+            auto const file = keyFile ("loop", host);
+            loop += timeToExit ({"--keyfile", file, "create_keys"}, "");
+            loop += timeToExit ({"--keyfile", file, "create_token"}, "");
+            for (std::size_t i = 0; i < signatures; ++i)
+                loop += timeToExit (
+                    {"--keyfile", file, "sign", "data to sign"}, "");
+        }
+
+        std::string requests;
+        for (std::size_t host = 0; host < hosts; ++host)
+        {
+            auto const file = "\"keyfile\":\"" + keyFile ("batch", host) +
+                "\"}\n";
+            requests += R"({"command":"create_keys",)" + file;
+            requests += R"({"command":"create_token",)" + file;
+            for (std::size_t i = 0; i < signatures; ++i)
+                requests += R"({"command":"sign","args":["data to sign"],)" +
+                    file;
+        }
+        auto const batch = timeToExit ({"batch"}, requests);
+
+        auto const us = [commands](clock_type::duration d)
+        {
+            return duration_cast<microseconds> (d).count () /
+                static_cast<long long> (commands);
+        };
+
+        log << commands << " commands: process per command " <<
+            us (loop) << " us, batch " << us (batch) <<
+            " us per command" << std::endl;
+
+        remove_all (dir);
+    }
+
+public:
+    void
+    run() override
+    {
+        using namespace boost::filesystem;
+
+        testcase ("Time to first output");
+
+        path const keyFile = temp_directory_path () /
+            unique_path ("validator_keys_bench_%%%%%%%%.json");
+        ValidatorKeys (KeyType::ed25519).writeToFile (keyFile);
+
+        measure ("--version", {"--version"});
+        measure ("sign", {"--keyfile", keyFile.string (),
+            "sign", "data to sign"});
+
+        remove (keyFile);
+        remove (keyFile.string () + ".lock");
+
+        compareBatch ();
+    }
+};
+#endif
+
 BEAST_DEFINE_TESTSUITE(ValidatorKeysTool, keys, ripple);
+#ifdef __linux__
+BEAST_DEFINE_TESTSUITE_MANUAL(ValidatorKeysToolBench, keys, ripple);
+#endif
 
 } // tests
 
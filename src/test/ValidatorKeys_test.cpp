@@ -18,11 +18,15 @@
 //==============================================================================
 
 #include <ValidatorKeys.h>
+#include <KeyStore.h>
+#include <TokenKeyDerivation.h>
 #include <test/KeyFileGuard.h>
 #include <ripple/basics/StringUtilities.h>
 #include <ripple/protocol/HashPrefix.h>
 #include <ripple/protocol/Sign.h>
 #include <beast/core/detail/base64.hpp>
+#include <algorithm>
+#include <thread>
 
 namespace ripple {
 
@@ -33,23 +37,31 @@ class ValidatorKeys_test : public beast::unit_test::suite
 private:
 
     void
-    testKeyFile (boost::filesystem::path const& keyFile,
+    testKeyFile (KeyStore& store, boost::filesystem::path const& keyFile,
         Json::Value const& jv, std::string const& expectedError)
     {
-        {
-            std::ofstream o (keyFile.string (), std::ios_base::trunc);
-            o << jv.toStyledString();
-            o.close();
-        }
+        store.store (keyFile, jv.toStyledString());
 
         try {
-            ValidatorKeys::make_ValidatorKeys (keyFile);
+            ValidatorKeys::make_ValidatorKeys (keyFile, store);
             BEAST_EXPECT(expectedError.empty());
         } catch (std::runtime_error& e) {
             BEAST_EXPECT(e.what() == expectedError);
         }
     }
 
+    static
+    boost::optional<std::uint32_t>
+    manifestSequence (ValidatorToken const& token)
+    {
+        STObject st (sfGeneric);
+        auto const manifest = beast::detail::base64_decode(token.manifest);
+        SerialIter sit (manifest.data (), manifest.size ());
+        st.set (sit);
+
+        return get (st, sfSequence);
+    }
+
     std::array<KeyType, 2> const keyTypes {{
         KeyType::ed25519,
         KeyType::secp256k1 }};
@@ -68,23 +80,24 @@ private:
         {
             ValidatorKeys const keys (keyType);
 
-            KeyFileGuard const g (*this, subdir);
+            MemoryKeyStore store;
 
-            keys.writeToFile (keyFile);
-            BEAST_EXPECT (exists (keyFile));
+            keys.writeToFile (keyFile, store);
+            BEAST_EXPECT (store.exists (keyFile));
 
-            auto const keys2 = ValidatorKeys::make_ValidatorKeys (keyFile);
+            auto const keys2 =
+                ValidatorKeys::make_ValidatorKeys (keyFile, store);
             BEAST_EXPECT (keys == keys2);
         }
         {
             // Require expected fields
-            KeyFileGuard g (*this, subdir);
+            MemoryKeyStore store;
 
             auto expectedError =
                 "Failed to open key file: " + keyFile.string();
             std::string error;
             try {
-                ValidatorKeys::make_ValidatorKeys (keyFile);
+                ValidatorKeys::make_ValidatorKeys (keyFile, store);
             } catch (std::runtime_error& e) {
                 error = e.what();
             }
@@ -93,14 +106,10 @@ private:
             expectedError =
                 "Unable to parse json key file: " + keyFile.string();
 
-            {
-                std::ofstream o (keyFile.string (), std::ios_base::trunc);
-                o << "{{}";
-                o.close();
-            }
+            store.store (keyFile, "{{}");
 
             try {
-                ValidatorKeys::make_ValidatorKeys (keyFile);
+                ValidatorKeys::make_ValidatorKeys (keyFile, store);
             } catch (std::runtime_error& e) {
                 error = e.what();
             }
@@ -110,35 +119,35 @@ private:
             jv["dummy"] = "field";
             expectedError = "Key file '" + keyFile.string() +
                 "' is missing \"key_type\" field";
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["key_type"] = "dummy keytype";
             expectedError = "Key file '" + keyFile.string() +
                 "' is missing \"secret_key\" field";
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["secret_key"] = "dummy secret";
             expectedError = "Key file '" + keyFile.string() +
                 "' is missing \"token_sequence\" field";
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["token_sequence"] = "dummy sequence";
             expectedError = "Key file '" + keyFile.string() +
                 "' is missing \"revoked\" field";
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["revoked"] = "dummy revoked";
             expectedError = "Key file '" + keyFile.string() +
                 "' contains invalid \"key_type\" field: " +
                 jv["key_type"].toStyledString();
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             auto const keyType = KeyType::ed25519;
             jv["key_type"] = to_string(keyType);
             expectedError = "Key file '" + keyFile.string() +
                 "' contains invalid \"secret_key\" field: " +
                 jv["secret_key"].toStyledString();
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             ValidatorKeys const keys (keyType);
             {
@@ -149,27 +158,77 @@ private:
             expectedError = "Key file '" + keyFile.string() +
                 "' contains invalid \"token_sequence\" field: " +
                 jv["token_sequence"].toStyledString();
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["token_sequence"] = -1;
             expectedError = "Key file '" + keyFile.string() +
                 "' contains invalid \"token_sequence\" field: " +
                 jv["token_sequence"].toStyledString();
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["token_sequence"] =
                 Json::UInt(std::numeric_limits<std::uint32_t>::max ());
             expectedError = "Key file '" + keyFile.string() +
                 "' contains invalid \"revoked\" field: " +
                 jv["revoked"].toStyledString();
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["revoked"] = false;
             expectedError = "";
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
 
             jv["revoked"] = true;
-            testKeyFile (keyFile, jv, expectedError);
+            testKeyFile (store, keyFile, jv, expectedError);
+
+            // The record of issued tokens is optional, but must be valid
+            Json::Value range;
+            range["first"] = 1;
+            range["last"] = 2;
+            range["key_type"] = "ed25519";
+            range["source"] = "derived";
+            auto const testTokenKeys = [&](Json::Value const& ranges,
+                bool valid)
+            {
+                jv["token_keys"] = ranges;
+                testKeyFile (store, keyFile, jv, valid ? "" :
+                    "Key file '" + keyFile.string() +
+                    "' contains invalid \"token_keys\" field: " +
+                    ranges.toStyledString());
+            };
+            auto const rangesOf = [](std::vector<Json::Value> const& v)
+            {
+                Json::Value ranges (Json::arrayValue);
+                for (auto const& r : v)
+                    ranges.append (r);
+                return ranges;
+            };
+            auto const with = [&](char const* field, Json::Value value)
+            {
+                auto r = range;
+                r[field] = value;
+                return r;
+            };
+
+            auto later = with ("source", "random");
+            later["first"] = 3;
+            later["last"] = 4;
+            auto overlapping = later;
+            overlapping["first"] = 2;
+
+            testTokenKeys (rangesOf ({range}), true);
+            testTokenKeys (rangesOf ({range, later}), true);
+            testTokenKeys (rangesOf ({later, range}), false);
+            testTokenKeys (rangesOf ({range, overlapping}), false);
+            testTokenKeys (rangesOf ({with ("first", 0)}), false);
+            testTokenKeys (rangesOf ({with ("first", 3)}), false);
+            testTokenKeys (rangesOf ({with ("last", -1)}), false);
+            testTokenKeys (rangesOf ({with ("key_type", "dummy")}), false);
+            testTokenKeys (rangesOf ({with ("source", "dummy")}), false);
+            testTokenKeys ("dummy", false);
+
+            // Ranges may not pass the last issued sequence
+            jv["token_sequence"] = 1;
+            testTokenKeys (rangesOf ({range}), false);
         }
     }
 
@@ -191,7 +250,7 @@ private:
                     continue;
 
                 auto const tokenPublicKey =
-                    derivePublicKey(tokenKeyType, token->secretKey);
+                    derivePublicKey(tokenKeyType, *token->secretKey);
 
                 STObject st (sfGeneric);
                 auto const manifest = beast::detail::base64_decode(token->manifest);
@@ -230,6 +289,265 @@ private:
         BEAST_EXPECT (! keys.createValidatorToken (keyType));
     }
 
+    void
+    testDerivedTokens ()
+    {
+        testcase ("Derived Tokens");
+
+        for (auto const keyType : keyTypes)
+        {
+            for (auto const tokenKeyType : keyTypes)
+            {
+                auto const kp = generateKeyPair (keyType, randomSeed ());
+                ValidatorKeys keys (keyType, kp.second, 0);
+
+                auto const random = keys.createValidatorToken (tokenKeyType);
+                auto const derived = keys.createValidatorToken (
+                    tokenKeyType, TokenKeySource::derived);
+                if (! BEAST_EXPECT (random && derived))
+                    continue;
+
+                BEAST_EXPECT (*derived->secretKey == deriveTokenSecretKey (
+                    kp.second, 2, tokenKeyType));
+
+                // Derived tokens are reproduced exactly with the recorded
+                // key type; random ones are refused
+                auto const again = keys.regenerateValidatorToken (2);
+                BEAST_EXPECT (again &&
+                    again->toString () == derived->toString ());
+                BEAST_EXPECT (! keys.regenerateValidatorToken (1));
+
+                // Only issued sequences can be regenerated
+                BEAST_EXPECT (! keys.regenerateValidatorToken (0));
+                BEAST_EXPECT (! keys.regenerateValidatorToken (3));
+                BEAST_EXPECT (keys.tokenSequence () == 2);
+
+                // Reserved sequences have no recorded tokens
+                auto const reserved = keys.reserveTokenSequences (1);
+                BEAST_EXPECT (reserved && *reserved == 3);
+                BEAST_EXPECT (! keys.tokenKeys (3));
+                BEAST_EXPECT (! keys.regenerateValidatorToken (3));
+
+                // Bulk issuance matches issuing one at a time
+                auto const tokens = keys.createValidatorTokens (
+                    200, tokenKeyType, TokenKeySource::derived);
+                if (BEAST_EXPECT (tokens.size () == 200))
+                {
+                    for (std::uint32_t i = 0; i < tokens.size (); i += 37)
+                    {
+                        auto const token = keys.regenerateValidatorToken (
+                            4 + i);
+                        BEAST_EXPECT (token && token->toString () ==
+                            tokens[i].toString ());
+                    }
+                    BEAST_EXPECT (manifestSequence (tokens.back ()) == 203u);
+                }
+
+                // The record survives the key file
+                MemoryKeyStore store;
+                keys.writeToFile ("keys.json", store);
+                auto const loaded =
+                    ValidatorKeys::make_ValidatorKeys ("keys.json", store);
+                auto const ranges = loaded.tokenKeyRanges ();
+                if (BEAST_EXPECT (ranges.size () == 3))
+                {
+                    BEAST_EXPECT (ranges[0].first == 1 &&
+                        ranges[0].last == 1 &&
+                        ranges[0].keyType == tokenKeyType &&
+                        ranges[0].source == TokenKeySource::random);
+                    BEAST_EXPECT (ranges[1].first == 2 &&
+                        ranges[1].last == 2 &&
+                        ranges[1].source == TokenKeySource::derived);
+                    BEAST_EXPECT (ranges[2].first == 4 &&
+                        ranges[2].last == 203 &&
+                        ranges[2].keyType == tokenKeyType &&
+                        ranges[2].source == TokenKeySource::derived);
+                }
+                auto const reloaded = loaded.regenerateValidatorToken (2);
+                BEAST_EXPECT (reloaded &&
+                    reloaded->toString () == derived->toString ());
+
+                keys.revoke ();
+                BEAST_EXPECT (! keys.regenerateValidatorToken (2));
+            }
+        }
+    }
+
+    void
+    testReserveTokenSequences ()
+    {
+        testcase ("Reserve Token Sequences");
+
+        auto const keyType = KeyType::ed25519;
+        auto const kp = generateKeyPair (keyType, randomSeed ());
+        auto const max = std::numeric_limits<std::uint32_t>::max ();
+
+        {
+            ValidatorKeys keys (keyType, kp.second, 0);
+            BEAST_EXPECT (! keys.reserveTokenSequences (0));
+
+            auto const first = keys.reserveTokenSequences (10);
+            BEAST_EXPECT (first && *first == 1);
+            BEAST_EXPECT (keys.tokenSequence () == 10);
+
+            auto const tokens = keys.createValidatorTokens (3, keyType);
+            BEAST_EXPECT (tokens.size () == 3);
+            BEAST_EXPECT (keys.tokenSequence () == 13);
+
+            std::uint32_t expected = 11;
+            for (auto const& token : tokens)
+            {
+                auto const seq = manifestSequence (token);
+                BEAST_EXPECT (seq && *seq == expected++);
+            }
+        }
+        {
+            // Ranges may not reach the revocation sequence
+            ValidatorKeys keys (keyType, kp.second, max - 3);
+            BEAST_EXPECT (! keys.reserveTokenSequences (3));
+            BEAST_EXPECT (keys.createValidatorTokens (3, keyType).empty ());
+            BEAST_EXPECT (keys.tokenSequence () == max - 3);
+
+            auto const first = keys.reserveTokenSequences (2);
+            BEAST_EXPECT (first && *first == max - 2);
+            BEAST_EXPECT (! keys.reserveTokenSequences (1));
+        }
+        {
+            ValidatorKeys keys (keyType, kp.second, 0, true);
+            BEAST_EXPECT (! keys.reserveTokenSequences (1));
+        }
+    }
+
+    void
+    testConcurrency ()
+    {
+        testcase ("Concurrency");
+
+        // Intended to be run under ThreadSanitizer as well
+        auto const keyType = KeyType::ed25519;
+        auto const threadCount = std::max (
+            4u, std::thread::hardware_concurrency ());
+        std::uint32_t const iterations = 50;
+        std::uint32_t const batch = 4;
+        std::string const data = "data to sign";
+
+        ValidatorKeys keys (keyType);
+
+        std::vector<std::vector<std::uint32_t>> sequences (threadCount);
+        // Sequences of tokens issued with derived keys
+        std::vector<std::vector<std::uint32_t>> derived (threadCount);
+        std::vector<std::thread> threads;
+        std::atomic<bool> go {false};
+        std::atomic<int> badSignatures {0};
+
+        for (unsigned t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back ([&, t]
+            {
+                while (! go.load ())
+                    std::this_thread::yield ();
+
+                for (std::uint32_t i = 0; i < iterations; ++i)
+                {
+                    if (i % 2)
+                    {
+                        auto const first = keys.reserveTokenSequences (batch);
+                        if (first)
+                            for (std::uint32_t j = 0; j < batch; ++j)
+                                sequences[t].push_back (*first + j);
+                    }
+                    else if (auto const token = keys.createValidatorToken (
+                        keyType, t % 2 ? TokenKeySource::derived :
+                            TokenKeySource::random))
+                    {
+                        if (auto const seq = manifestSequence (*token))
+                        {
+                            sequences[t].push_back (*seq);
+                            if (t % 2)
+                                derived[t].push_back (*seq);
+                        }
+                    }
+
+                    auto const sig = strUnHex (keys.sign (data));
+                    if (! sig.second || ! verify (keys.publicKey (),
+                            makeSlice (data), makeSlice (sig.first)))
+                        ++badSignatures;
+                }
+            });
+        }
+
+        go.store (true);
+        for (auto& thread : threads)
+            thread.join ();
+
+        BEAST_EXPECT (badSignatures.load () == 0);
+
+        // Every sequence was handed out exactly once
+        std::vector<std::uint32_t> issued;
+        for (auto const& s : sequences)
+            issued.insert (issued.end (), s.begin (), s.end ());
+        std::sort (issued.begin (), issued.end ());
+
+        std::uint32_t const expected =
+            threadCount * (iterations / 2) * (batch + 1);
+        BEAST_EXPECT (keys.tokenSequence () == expected);
+        if (BEAST_EXPECT (issued.size () == expected))
+        {
+            for (std::uint32_t i = 0; i < expected; ++i)
+            {
+                if (! BEAST_EXPECT (issued[i] == i + 1))
+                    break;
+            }
+        }
+
+        // Every token was recorded with its source, whatever order the
+        // threads recorded them in
+        std::vector<std::uint32_t> derivedIssued;
+        for (auto const& s : derived)
+            derivedIssued.insert (derivedIssued.end (), s.begin (), s.end ());
+        std::sort (derivedIssued.begin (), derivedIssued.end ());
+
+        std::size_t recorded = 0;
+        for (std::uint32_t seq = 1; seq <= expected; ++seq)
+        {
+            auto const issuedKeys = keys.tokenKeys (seq);
+            if (! issuedKeys)
+                continue;
+            ++recorded;
+            BEAST_EXPECT ((issuedKeys->source == TokenKeySource::derived) ==
+                std::binary_search (
+                    derivedIssued.begin (), derivedIssued.end (), seq));
+        }
+        BEAST_EXPECT (recorded == threadCount * (iterations / 2));
+
+        // Revoking while tokens are issued stops all further issuance
+        threads.clear ();
+        go.store (false);
+        for (unsigned t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back ([&]
+            {
+                while (! go.load ())
+                    std::this_thread::yield ();
+
+                for (std::uint32_t i = 0; i < iterations; ++i)
+                    keys.createValidatorToken (keyType);
+            });
+        }
+        go.store (true);
+        keys.revoke ();
+
+        // No sequence is reserved once revoke has returned
+        auto const last = keys.tokenSequence ();
+        for (auto& thread : threads)
+            thread.join ();
+
+        BEAST_EXPECT (keys.tokenSequence () == last);
+        BEAST_EXPECT (keys.revoked ());
+        BEAST_EXPECT (! keys.createValidatorToken (keyType));
+        BEAST_EXPECT (keys.tokenSequence () == last);
+    }
+
     void
     testRevoke ()
     {
@@ -387,6 +705,9 @@ public:
     {
         testMakeValidatorKeys ();
         testCreateValidatorToken ();
+        testDerivedTokens ();
+        testReserveTokenSequences ();
+        testConcurrency ();
         testRevoke ();
         testSign ();
         testWriteToFile ();
@@ -0,0 +1,402 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#include <ValidatorList.h>
+#include <ripple/basics/StringUtilities.h>
+#include <ripple/beast/unit_test.h>
+#include <ripple/json/json_reader.h>
+#include <ripple/json/json_writer.h>
+#include <beast/core/detail/base64.hpp>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace ripple {
+
+namespace tests {
+
+class ValidatorList_test : public beast::unit_test::suite
+{
+private:
+    static
+    std::vector<std::string>
+    manifests (std::vector<ValidatorKeys>& keys)
+    {
+        std::vector<std::string> result;
+        for (auto& k : keys)
+            result.push_back (k.createValidatorToken ()->manifest);
+        return result;
+    }
+
+    static
+    PublicKey
+    fromHex (Json::Value const& hex)
+    {
+        return PublicKey (makeSlice (strUnHex (hex.asString ()).first));
+    }
+
+    void
+    testBuild ()
+    {
+        testcase ("Build");
+
+        std::vector<ValidatorKeys> keys;
+        for (int i = 0; i < 3; ++i)
+            keys.emplace_back (KeyType::ed25519);
+        auto const initial = manifests (keys);
+
+        ValidatorListBuilder builder;
+        builder.add (initial);
+        BEAST_EXPECT (builder.size () == 3);
+        BEAST_EXPECT (builder.checked () == 3);
+
+        // The newest manifest for a key is kept, in any order
+        auto const newer = keys[0].createValidatorToken ()->manifest;
+        auto const revocation = keys[1].revoke ();
+        builder.add ({newer, initial[0], revocation, initial[1]});
+        BEAST_EXPECT (builder.size () == 3);
+
+        Json::Value jv;
+        if (! BEAST_EXPECT (Json::Reader ().parse (builder.blob (7, 1000), jv)))
+            return;
+        BEAST_EXPECT (jv["sequence"].asUInt () == 7);
+        BEAST_EXPECT (jv["expiration"].asUInt () == 1000);
+
+        auto const& validators = jv["validators"];
+        if (! BEAST_EXPECT (validators.size () == 3))
+            return;
+
+        for (Json::UInt i = 0; i < validators.size (); ++i)
+        {
+            auto const key = fromHex (validators[i]["validation_public_key"]);
+            if (i > 0)
+                BEAST_EXPECT (fromHex (
+                    validators[i - 1]["validation_public_key"]) < key);
+
+            auto const manifest = validators[i]["manifest"].asString ();
+            if (key == keys[0].publicKey ())
+                BEAST_EXPECT (manifest == newer);
+            else if (key == keys[1].publicKey ())
+                BEAST_EXPECT (manifest == revocation);
+            else
+                BEAST_EXPECT (key == keys[2].publicKey () &&
+                    manifest == initial[2]);
+        }
+
+        // An empty list is still well formed
+        BEAST_EXPECT (ValidatorListBuilder ().blob (1, 2) ==
+            "{\"sequence\":1,\"expiration\":2,\"validators\":[]}");
+    }
+
+    void
+    testInvalid ()
+    {
+        testcase ("Invalid Manifests");
+
+        ValidatorKeys keys (KeyType::secp256k1);
+        auto const manifest = keys.createValidatorToken ()->manifest;
+        auto tampered = beast::detail::base64_decode (manifest);
+        tampered[tampered.size () - 1] ^= 1;
+
+        for (auto const& bad : {std::string ("garbage"),
+            beast::detail::base64_encode (tampered)})
+        {
+            ValidatorListBuilder builder;
+            try
+            {
+                builder.add ({manifest, bad});
+                fail ();
+            }
+            catch (std::runtime_error const& e)
+            {
+                BEAST_EXPECT (e.what () == "Invalid manifest: " + bad);
+            }
+        }
+    }
+
+    void
+    testIncremental ()
+    {
+        testcase ("Incremental");
+
+        std::vector<ValidatorKeys> keys;
+        for (int i = 0; i < 200; ++i)
+            keys.emplace_back (KeyType::ed25519);
+        auto current = manifests (keys);
+
+        // Enough manifests to check on several threads
+        ValidatorListBuilder first (4);
+        first.add (current);
+        BEAST_EXPECT (first.checked () == keys.size ());
+        auto const blob = first.blob (1, 1000);
+
+        current[5] = keys[5].createValidatorToken ()->manifest;
+        ValidatorKeys added (KeyType::ed25519);
+        current.push_back (added.createValidatorToken ()->manifest);
+
+        ValidatorListBuilder second (4);
+        BEAST_EXPECT (second.seed (blob));
+        second.add (current);
+        BEAST_EXPECT (second.checked () == 2);
+        BEAST_EXPECT (second.size () == keys.size () + 1);
+
+        // The result does not depend on what was seeded
+        ValidatorListBuilder full;
+        full.add (current);
+        BEAST_EXPECT (second.blob (2, 1000) == full.blob (2, 1000));
+
+        // Entries that are only seeded are not listed
+        ValidatorListBuilder seededOnly;
+        BEAST_EXPECT (seededOnly.seed (blob));
+        BEAST_EXPECT (seededOnly.size () == 0);
+
+        BEAST_EXPECT (! seededOnly.seed ("not json"));
+        BEAST_EXPECT (! seededOnly.seed ("{\"validators\":[{}]}"));
+    }
+
+    void
+    testSign ()
+    {
+        testcase ("Sign");
+
+        for (auto const keyType : {KeyType::ed25519, KeyType::secp256k1})
+        {
+            ValidatorKeys publisher (KeyType::ed25519);
+            auto const token = publisher.createValidatorToken (keyType);
+            auto const signingKey = derivePublicKey (
+                keyType, *token->secretKey);
+
+            std::vector<ValidatorKeys> keys;
+            keys.emplace_back (KeyType::ed25519);
+            ValidatorListBuilder builder;
+            builder.add (manifests (keys));
+            auto const blob = builder.blob (1, 1000);
+
+            auto const list = signValidatorList (blob, *token);
+
+            Json::Value jv;
+            if (! BEAST_EXPECT (Json::Reader ().parse (list, jv)))
+                continue;
+            BEAST_EXPECT (jv["version"].asUInt () == 1);
+            BEAST_EXPECT (jv["manifest"].asString () == token->manifest);
+            BEAST_EXPECT (
+                fromHex (jv["public_key"]) == publisher.publicKey ());
+            BEAST_EXPECT (beast::detail::base64_decode (
+                jv["blob"].asString ()) == blob);
+
+            auto const opened = openValidatorList (list, signingKey);
+            BEAST_EXPECT (opened && *opened == blob);
+
+            // Only the publisher's signing key opens the list
+            BEAST_EXPECT (! openValidatorList (list, publisher.publicKey ()));
+
+            jv["blob"] = beast::detail::base64_encode (
+                builder.blob (2, 1000));
+            BEAST_EXPECT (! openValidatorList (
+                Json::FastWriter ().write (jv), signingKey));
+            BEAST_EXPECT (! openValidatorList ("{}", signingKey));
+        }
+    }
+
+    void
+    testVerify ()
+    {
+        testcase ("Verify");
+
+        ValidatorKeys publisher (KeyType::ed25519);
+        auto const token = publisher.createValidatorToken ();
+
+        std::vector<ValidatorKeys> keys;
+        for (int i = 0; i < 200; ++i)
+            keys.emplace_back (i % 2 ? KeyType::ed25519 : KeyType::secp256k1);
+        auto current = manifests (keys);
+        current[0] = keys[0].revoke ();
+
+        ValidatorListBuilder builder;
+        builder.add (current);
+        auto const blob = builder.blob (3, 1000);
+        auto const list = signValidatorList (blob, *token);
+
+        auto const expectError = [&](std::string const& signedList,
+            PublicKey const& publisherKey,
+            RevocationIndex const& revocations,
+            std::string const& expected)
+        {
+            try
+            {
+                verifyValidatorList (signedList, publisherKey, revocations);
+                fail ();
+            }
+            catch (std::runtime_error const& e)
+            {
+                BEAST_EXPECT (e.what () == expected);
+            }
+        };
+
+        {
+            auto const result = verifyValidatorList (
+                list, publisher.publicKey (), RevocationIndex (), 4);
+            BEAST_EXPECT (result.sequence == 3);
+            BEAST_EXPECT (result.expiration == 1000);
+            BEAST_EXPECT (result.trusted.size () == keys.size () - 1);
+            BEAST_EXPECT (result.revoked.size () == 1 &&
+                result.revoked[0] == keys[0].publicKey ());
+            BEAST_EXPECT (result.invalid.empty ());
+        }
+
+        // Keys in the index are revoked, whatever their manifest says
+        {
+            RevocationIndex const index ({
+                keys[1].publicKey (), keys[2].publicKey () });
+            auto const result = verifyValidatorList (
+                list, publisher.publicKey (), index);
+            BEAST_EXPECT (result.trusted.size () == keys.size () - 3);
+            BEAST_EXPECT (result.revoked.size () == 3);
+
+            expectError (list, publisher.publicKey (),
+                RevocationIndex ({ publisher.publicKey () }),
+                "Publisher keys have been revoked");
+        }
+
+        // Entries are checked against their manifests
+        {
+            Json::Value jv;
+            Json::Reader ().parse (blob, jv);
+            jv["validators"][1u]["validation_public_key"] =
+                jv["validators"][2u]["validation_public_key"];
+            jv["validators"][3u]["manifest"] = "garbage";
+
+            auto const result = verifyValidatorList (
+                signValidatorList (Json::FastWriter ().write (jv), *token),
+                publisher.publicKey ());
+            BEAST_EXPECT (result.trusted.size () == keys.size () - 3);
+            BEAST_EXPECT ((result.invalid == std::vector<std::size_t> {1, 3}));
+        }
+
+        ValidatorKeys other (KeyType::ed25519);
+        expectError (list, other.publicKey (), RevocationIndex (),
+            "Validator list is from another publisher");
+
+        Json::Value jv;
+        Json::Reader ().parse (list, jv);
+        jv["blob"] = beast::detail::base64_encode (builder.blob (4, 1000));
+        expectError (Json::FastWriter ().write (jv), publisher.publicKey (),
+            RevocationIndex (), "Invalid validator list signature");
+
+        jv["manifest"] = "garbage";
+        expectError (Json::FastWriter ().write (jv), publisher.publicKey (),
+            RevocationIndex (), "Invalid publisher manifest");
+
+        expectError ("[]", publisher.publicKey (), RevocationIndex (),
+            "Malformed validator list");
+        expectError (signValidatorList ("{}", *token), publisher.publicKey (),
+            RevocationIndex (), "Malformed validator list");
+    }
+
+public:
+    void
+    run() override
+    {
+        testBuild ();
+        testInvalid ();
+        testIncremental ();
+        testSign ();
+        testVerify ();
+    }
+};
+
+class ValidatorListBench_test : public beast::unit_test::suite
+{
+public:
+    void
+    run() override
+    {
+        using namespace std::chrono;
+
+        std::size_t const count = 50000;
+        testcase ("Validators: " + std::to_string (count));
+
+        std::vector<std::string> manifests;
+        std::vector<PublicKey> revoked;
+        manifests.reserve (count);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            ValidatorKeys keys (KeyType::ed25519);
+            manifests.push_back (keys.createValidatorToken (
+                KeyType::ed25519)->manifest);
+            if (i % 100 == 0)
+                revoked.push_back (keys.publicKey ());
+        }
+
+        ValidatorKeys publisher (KeyType::ed25519);
+        auto const token = publisher.createValidatorToken ();
+
+        auto const elapsed = [](steady_clock::time_point start)
+        {
+            return duration_cast<milliseconds> (
+                steady_clock::now () - start).count ();
+        };
+
+        auto start = steady_clock::now ();
+        ValidatorListBuilder full;
+        full.add (manifests);
+        auto const list = signValidatorList (full.blob (1, 1000), *token);
+        auto const build = elapsed (start);
+
+        // Re-sign after one percent of the validators rotate
+        for (std::size_t i = 0; i < count; i += 100)
+        {
+            ValidatorKeys keys (KeyType::ed25519);
+            manifests[i] = keys.createValidatorToken (
+                KeyType::ed25519)->manifest;
+        }
+        start = steady_clock::now ();
+        ValidatorListBuilder incremental;
+        incremental.seed (full.blob (1, 1000));
+        incremental.add (manifests);
+        signValidatorList (incremental.blob (2, 1000), *token);
+        auto const resign = elapsed (start);
+        BEAST_EXPECT (incremental.checked () == count / 100);
+
+        log << count << " validators: build and sign " << build <<
+            " ms, re-sign after 1% change " << resign << " ms" << std::endl;
+
+        RevocationIndex const index (revoked);
+        for (unsigned const threads :
+            {1u, std::max (1u, std::thread::hardware_concurrency ())})
+        {
+            start = steady_clock::now ();
+            auto const result = verifyValidatorList (
+                list, publisher.publicKey (), index, threads);
+            auto const verify = elapsed (start);
+            BEAST_EXPECT (result.revoked.size () == revoked.size ());
+
+            log << "verify on " << threads << " threads " << verify <<
+                " ms" << std::endl;
+        }
+    }
+};
+
+BEAST_DEFINE_TESTSUITE(ValidatorList, keys, ripple);
+BEAST_DEFINE_TESTSUITE_MANUAL(ValidatorListBench, keys, ripple);
+
+} // tests
+
+} // ripple
@@ -0,0 +1,115 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+/*  Builds libsecp256k1 under names of its own, so that several builds
+    can be linked into one program beside the one in ripple-libpp.
+
+    Define VK_VARIANT, the prefix for the names, and the field and
+    scalar implementations before including this file. Only the
+    functions defined at the end are used, through CryptoKernels.
+*/
+
+#define VK_NAME3(variant, name) vk_##variant##_##name
+#define VK_NAME2(variant, name) VK_NAME3(variant, name)
+#define VK_NAME(name) VK_NAME2(VK_VARIANT, name)
+
+#define secp256k1_context_create VK_NAME(secp256k1_context_create)
+#define secp256k1_context_clone VK_NAME(secp256k1_context_clone)
+#define secp256k1_context_destroy VK_NAME(secp256k1_context_destroy)
+#define secp256k1_context_randomize VK_NAME(secp256k1_context_randomize)
+#define secp256k1_context_set_error_callback \
+    VK_NAME(secp256k1_context_set_error_callback)
+#define secp256k1_context_set_illegal_callback \
+    VK_NAME(secp256k1_context_set_illegal_callback)
+#define secp256k1_context_no_precomp VK_NAME(secp256k1_context_no_precomp)
+#define secp256k1_ec_privkey_negate VK_NAME(secp256k1_ec_privkey_negate)
+#define secp256k1_ec_privkey_tweak_add VK_NAME(secp256k1_ec_privkey_tweak_add)
+#define secp256k1_ec_privkey_tweak_mul VK_NAME(secp256k1_ec_privkey_tweak_mul)
+#define secp256k1_ec_pubkey_combine VK_NAME(secp256k1_ec_pubkey_combine)
+#define secp256k1_ec_pubkey_create VK_NAME(secp256k1_ec_pubkey_create)
+#define secp256k1_ec_pubkey_negate VK_NAME(secp256k1_ec_pubkey_negate)
+#define secp256k1_ec_pubkey_parse VK_NAME(secp256k1_ec_pubkey_parse)
+#define secp256k1_ec_pubkey_serialize VK_NAME(secp256k1_ec_pubkey_serialize)
+#define secp256k1_ec_pubkey_tweak_add VK_NAME(secp256k1_ec_pubkey_tweak_add)
+#define secp256k1_ec_pubkey_tweak_mul VK_NAME(secp256k1_ec_pubkey_tweak_mul)
+#define secp256k1_ec_seckey_verify VK_NAME(secp256k1_ec_seckey_verify)
+#define secp256k1_ecdsa_sign VK_NAME(secp256k1_ecdsa_sign)
+#define secp256k1_ecdsa_signature_normalize \
+    VK_NAME(secp256k1_ecdsa_signature_normalize)
+#define secp256k1_ecdsa_signature_parse_compact \
+    VK_NAME(secp256k1_ecdsa_signature_parse_compact)
+#define secp256k1_ecdsa_signature_parse_der \
+    VK_NAME(secp256k1_ecdsa_signature_parse_der)
+#define secp256k1_ecdsa_signature_serialize_compact \
+    VK_NAME(secp256k1_ecdsa_signature_serialize_compact)
+#define secp256k1_ecdsa_signature_serialize_der \
+    VK_NAME(secp256k1_ecdsa_signature_serialize_der)
+#define secp256k1_ecdsa_verify VK_NAME(secp256k1_ecdsa_verify)
+#define secp256k1_nonce_function_default \
+    VK_NAME(secp256k1_nonce_function_default)
+#define secp256k1_nonce_function_rfc6979 \
+    VK_NAME(secp256k1_nonce_function_rfc6979)
+#define secp256k1_scratch_space_create VK_NAME(secp256k1_scratch_space_create)
+#define secp256k1_scratch_space_destroy \
+    VK_NAME(secp256k1_scratch_space_destroy)
+
+#define USE_NUM_NONE 1
+#define USE_FIELD_INV_BUILTIN 1
+#define USE_SCALAR_INV_BUILTIN 1
+#ifndef NDEBUG
+# define NDEBUG
+#endif
+
+#include <secp256k1/src/secp256k1.c>
+
+void*
+VK_NAME(secp256k1_new) (void)
+{
+    return secp256k1_context_create (SECP256K1_CONTEXT_SIGN);
+}
+
+int
+VK_NAME(secp256k1_public_key) (
+    void const* context,
+    unsigned char const* sk,
+    unsigned char* pk)
+{
+    secp256k1_context const* const ctx = context;
+    secp256k1_pubkey pubkey;
+    size_t size = 33;
+    return secp256k1_ec_pubkey_create (ctx, &pubkey, sk) &&
+        secp256k1_ec_pubkey_serialize (
+            ctx, pk, &size, &pubkey, SECP256K1_EC_COMPRESSED);
+}
+
+int
+VK_NAME(secp256k1_sign_digest) (
+    void const* context,
+    unsigned char const* digest,
+    unsigned char const* sk,
+    unsigned char* signature,
+    size_t* size)
+{
+    secp256k1_context const* const ctx = context;
+    secp256k1_ecdsa_signature sig;
+    return secp256k1_ecdsa_sign (ctx, &sig, digest, sk,
+            secp256k1_nonce_function_rfc6979, NULL) &&
+        secp256k1_ecdsa_signature_serialize_der (ctx, signature, size, &sig);
+}
@@ -0,0 +1,125 @@
+//------------------------------------------------------------------------------
+/*
+    This file is part of validator-keys-tool:
+        https://github.com/ripple/validator-keys-tool
+    Copyright (c) 2016 Ripple Labs Inc.
+
+    Permission to use, copy, modify, and/or distribute this software for any
+    purpose  with  or without fee is hereby granted, provided that the above
+    copyright notice and this permission notice appear in all copies.
+
+    THE  SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+    WITH  REGARD  TO  THIS  SOFTWARE  INCLUDING  ALL  IMPLIED  WARRANTIES  OF
+    MERCHANTABILITY  AND  FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+    ANY  SPECIAL ,  DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+    WHATSOEVER  RESULTING  FROM  LOSS  OF USE, DATA OR PROFITS, WHETHER IN AN
+    ACTION  OF  CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+    OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+*/
+//==============================================================================
+
+#ifndef VALIDATOR_KEYS_VALIDATORKEYS_C_H_INCLUDED
+#define VALIDATOR_KEYS_VALIDATORKEYS_C_H_INCLUDED
+
+/*  C interface to libvalidatorkeys
+
+    Functions that produce text write it, NUL terminated, to a buffer
+    owned by the caller. On entry *size holds the capacity of the buffer;
+    on return it holds the length of the text, excluding the terminator.
+    If the buffer is too small, VK_BUFFER_TOO_SMALL is returned and *size
+    holds the length needed, so callers may retry with a larger buffer.
+
+    Key files are locked as the validator-keys tool locks them, so the
+    library and tool may be used on the same key file at the same time.
+*/
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+# ifdef VK_BUILDING_SHARED
+#  define VK_API __declspec(dllexport)
+# elif defined(VK_USING_SHARED)
+#  define VK_API __declspec(dllimport)
+# else
+#  define VK_API
+# endif
+#else
+# define VK_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Length of the longest token or revocation, excluding the terminator
+
+    Buffers passed to vk_create_token and vk_revoke must hold more than
+    this, since what they write cannot be issued again.
+*/
+#define VK_MAX_TOKEN_SIZE 1024
+
+typedef enum
+{
+    VK_OK = 0,
+
+    /// Bad arguments, such as a null pointer
+    VK_INVALID_ARGUMENT = 1,
+
+    /// The output buffer is too small; *size holds the length needed
+    VK_BUFFER_TOO_SMALL = 2,
+
+    /// The operation failed; see vk_last_error
+    VK_ERROR = 3
+} vk_status;
+
+/// Validator keys loaded from a key file
+typedef struct vk_keys vk_keys;
+
+/** Returns a description of the last failure on the calling thread
+
+    The text remains valid until the next call on the same thread.
+*/
+VK_API char const*
+vk_last_error (void);
+
+/** Loads the keys in a key file
+
+    Release the keys with vk_free.
+*/
+VK_API vk_status
+vk_load (char const* key_file, vk_keys** keys);
+
+VK_API void
+vk_free (vk_keys* keys);
+
+/// Writes the base58-encoded validator public key
+VK_API vk_status
+vk_public_key (vk_keys const* keys, char* out, size_t* size);
+
+/// Writes the hex-encoded signature of data
+VK_API vk_status
+vk_sign (vk_keys const* keys,
+    void const* data, size_t data_size,
+    char* out, size_t* size);
+
+/** Writes a new base64-encoded validator token
+
+    The key file is updated with the token sequence.
+    See VK_MAX_TOKEN_SIZE.
+*/
+VK_API vk_status
+vk_create_token (char const* key_file, char* out, size_t* size);
+
+/** Revokes the keys in a key file and writes the base64-encoded
+    revocation
+
+    See VK_MAX_TOKEN_SIZE.
+*/
+VK_API vk_status
+vk_revoke (char const* key_file, char* out, size_t* size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif